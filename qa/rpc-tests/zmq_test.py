@@ -23,8 +23,13 @@ class ZMQTest(BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        # address deltas go to their own socket so the sequence numbers above are unaffected
+        self.zmqDeltaSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqDeltaSocket.connect("tcp://127.0.0.1:%i" % (self.port+1))
         return start_nodes(4, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port),
+             '-zmqpubaddressdelta=tcp://127.0.0.1:'+str(self.port+1), '-zmqpubcctx=tcp://127.0.0.1:'+str(self.port+1),
+             '-zmqpubnotarisation=tcp://127.0.0.1:'+str(self.port+1)],
             [],
             [],
             []
@@ -75,7 +80,9 @@ class ZMQTest(BitcoinTestFramework):
             assert_equal(genhashes[x], zmqHashes[x]) #blockhash from generate must be equal to the hash received over zmq
 
         #test tx from a second node
-        hashRPC = self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 1.0)
+        address = self.nodes[0].getnewaddress()
+        self.zmqDeltaSocket.setsockopt(zmq.SUBSCRIBE, b"addressdelta" + address.encode())
+        hashRPC = self.nodes[1].sendtoaddress(address, 1.0)
         self.sync_all()
 
         # now we should receive a zmq msg because the tx was broadcast
@@ -90,6 +97,25 @@ class ZMQTest(BitcoinTestFramework):
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        # the payment shows up as an address delta, unconfirmed first
+        msg = self.zmqDeltaSocket.recv_multipart()
+        assert_equal(msg[0], b"addressdelta" + address.encode())
+        txid, index, spending, satoshis, height = struct.unpack('<32sIBqi', msg[1])
+        assert_equal(bytes_to_hex_str(txid[::-1]), hashRPC)
+        assert_equal(spending, 0)
+        assert_equal(satoshis, 100000000)
+        assert_equal(height, -1)
+        assert_equal(self.nodes[1].getrawtransaction(hashRPC, 1)['vout'][index]['valueSat'], satoshis)
+
+        # and again once it is mined
+        self.nodes[1].generate(1)
+        self.sync_all()
+        msg = self.zmqDeltaSocket.recv_multipart()
+        txid, index, spending, satoshis, height = struct.unpack('<32sIBqi', msg[1])
+        assert_equal(bytes_to_hex_str(txid[::-1]), hashRPC)
+        assert_equal(satoshis, 100000000)
+        assert_equal(height, self.nodes[0].getblockcount())
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()
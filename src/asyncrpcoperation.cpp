@@ -99,6 +99,15 @@ void AsyncRPCOperation::stop_execution_clock() {
     end_time_ = std::chrono::system_clock::now();
 }
 
+/**
+ * Return the execution time of the last run of main()
+ */
+double AsyncRPCOperation::getExecutionSeconds() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::chrono::duration<double> elapsed_seconds = end_time_ - start_time_;
+    return elapsed_seconds.count();
+}
+
 /**
  * Implement this virtual method in any subclass.  This is just an example implementation.
  */
@@ -79,6 +79,14 @@ public:
     // Override this method to add data to the default status object.
     virtual UniValue getStatus() const;
 
+    // Override this method to name the RPC call in the queue's per-method statistics.
+    virtual std::string getMethodName() const {
+        return "unknown";
+    }
+
+    // Wall clock seconds spent in main(), valid once the operation has finished.
+    double getExecutionSeconds() const;
+
     UniValue getError() const;
     
     UniValue getResult() const;
@@ -121,8 +129,8 @@ protected:
     // the AsyncRPCQueue, which in turn invokes cancel() on all operations.
     // The member variables below are protected rather than private in order to
     // allow subclasses of AsyncRPCOperation the ability to access and update
-    // internal state.  Currently, all operations are executed in a single-thread
-    // by a single worker.
+    // internal state.  Operations may run concurrently on several workers when
+    // -rpcasyncthreads is above 1, so inputs must be reserved in the wallet.
     mutable std::mutex lock_;   // lock on this when read/writing non-atomics
     UniValue result_;
     int error_code_;
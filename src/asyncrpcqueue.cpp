@@ -80,11 +80,48 @@ void AsyncRPCQueue::run(size_t workerId) {
         } else if (operation->isCancelled()) {
             // skip cancelled operation
         } else {
+            std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
             operation->main();
+            record_operation(operation, start);
         }
     }
 }
 
+/**
+ * Fold a finished operation into the statistics for its RPC method
+ */
+void AsyncRPCQueue::record_operation(const std::shared_ptr<AsyncRPCOperation> &operation,
+                                     std::chrono::time_point<std::chrono::system_clock> start) {
+    double secs = operation->getExecutionSeconds();
+    std::string method = operation->getMethodName();
+
+    std::lock_guard<std::mutex> guard(lock_);
+    AsyncRPCOperationStats &stats = stats_[method];
+    if (operation->isSuccess()) {
+        stats.nSuccess++;
+    } else if (operation->isFailed()) {
+        stats.nFailed++;
+    } else {
+        stats.nCancelled++;
+    }
+    if (stats.nSuccess + stats.nFailed + stats.nCancelled == 1) {
+        stats.firstStart = start;
+    }
+    stats.lastFinish = std::chrono::system_clock::now();
+    stats.totalSecs += secs;
+    if (secs > stats.maxSecs) {
+        stats.maxSecs = secs;
+    }
+}
+
+/**
+ * Return a copy of the per-method execution statistics
+ */
+AsyncRPCOperationStatsMap AsyncRPCQueue::getOperationStats() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
+
 
 /**
  * Add shared_ptr to operation.
@@ -26,6 +26,7 @@
 #include <string>
 #include <chrono>
 #include <queue>
+#include <map>
 #include <unordered_map>
 #include <vector>
 #include <future>
@@ -36,6 +37,20 @@
 
 typedef std::unordered_map<AsyncRPCOperationId, std::shared_ptr<AsyncRPCOperation> > AsyncRPCOperationMap; 
 
+/**
+ * Running totals of the operations a queue has executed for one RPC method.
+ */
+struct AsyncRPCOperationStats {
+    uint64_t nSuccess = 0;
+    uint64_t nFailed = 0;
+    uint64_t nCancelled = 0;
+    double totalSecs = 0;
+    double maxSecs = 0;
+    std::chrono::time_point<std::chrono::system_clock> firstStart, lastFinish;
+};
+
+typedef std::map<std::string, AsyncRPCOperationStats> AsyncRPCOperationStatsMap;
+
 
 class AsyncRPCQueue {
 public:
@@ -64,11 +79,14 @@ public:
     std::shared_ptr<AsyncRPCOperation> popOperationForId(AsyncRPCOperationId);
     void addOperation(const std::shared_ptr<AsyncRPCOperation> &ptrOperation);
     std::vector<AsyncRPCOperationId> getAllOperationIds() const;
+    AsyncRPCOperationStatsMap getOperationStats() const;
 
 private:
     // addWorker() will spawn a new thread on run())
     void run(size_t workerId);
     void wait_for_worker_threads();
+    void record_operation(const std::shared_ptr<AsyncRPCOperation> &operation,
+                          std::chrono::time_point<std::chrono::system_clock> start);
 
     // Why this is not a recursive lock: http://www.zaval.org/resources/library/butenhof1.html
     mutable std::mutex lock_;
@@ -78,6 +96,7 @@ private:
     AsyncRPCOperationMap operation_map_;
     std::queue <AsyncRPCOperationId> operation_id_queue_;
     std::vector<std::thread> workers_;
+    AsyncRPCOperationStatsMap stats_;
 };
 
 #endif
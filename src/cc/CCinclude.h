@@ -65,6 +65,7 @@ Details.
 #include "../wallet/wallet.h"
 #include <univalue.h>
 #include <exception>
+#include <memory>
 #include "../komodo_defs.h"
 #include "../utlist.h"
 #include "../uthash.h"
@@ -713,6 +714,18 @@ bool Getscriptaddress(char *destaddr,const CScript &scriptPubKey);
 /// @returns true if success
 bool GetCustomscriptaddress(char *destaddr,const CScript &scriptPubKey,uint8_t taddr,uint8_t prefix,uint8_t prefix2);
 
+/// Last vout of a transaction, cached by txid by CCtxmeta_load
+struct CCtxmeta
+{
+    uint256 txid;
+    CScript opret;                      //!< last vout scriptPubKey
+};
+
+/// Returns the cached metadata for txid, loading the tx with myGetTransaction on a miss
+/// @param txid id of the transaction
+/// @returns null if the transaction cannot be loaded
+std::shared_ptr<const CCtxmeta> CCtxmeta_load(uint256 txid);
+
 /// Returns my pubkey, that is set by -pubkey komodod parameter
 /// @returns public key as byte array
 std::vector<uint8_t> Mypubkey();
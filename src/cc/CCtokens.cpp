@@ -897,23 +897,23 @@ bool TokensExactAmounts(bool goDeeper, struct CCcontract_info *cp, Eval* eval, c
 // get non-fungible data from 'tokenbase' tx (the data might be empty)
 void GetNonfungibleData(uint256 tokenid, vscript_t &vopretNonfungible)
 {
-    CTransaction tokenbasetx;
-    uint256 hashBlock;
+    // tokenbase is loaded for every token vout validated, so go through the tx metadata cache
+    std::shared_ptr<const CCtxmeta> tokenbase = CCtxmeta_load(tokenid);
 
-    if (!myGetTransaction(tokenid, tokenbasetx, hashBlock)) {
+    if (tokenbase == nullptr) {
         LOGSTREAM(cctokens_log, CCLOG_INFO, stream << "GetNonfungibleData() could not load token creation tx=" << tokenid.GetHex() << std::endl);
         return;
     }
 
     vopretNonfungible.clear();
     // check if it is non-fungible tx and get its second evalcode from non-fungible payload
-    if (tokenbasetx.vout.size() > 0) {
+    if (tokenbase->opret.size() > 0) {
         std::vector<uint8_t> origpubkey;
         std::string name, description;
         std::vector<vscript_t>  oprets;
         uint8_t funcid;
 
-        if (IsTokenCreateFuncid(DecodeTokenCreateOpRetV1(tokenbasetx.vout.back().scriptPubKey, origpubkey, name, description, oprets))) {
+        if (IsTokenCreateFuncid(DecodeTokenCreateOpRetV1(tokenbase->opret, origpubkey, name, description, oprets))) {
             if (oprets.size() > 0)
                 vopretNonfungible = oprets[0];
         }
@@ -928,14 +928,13 @@ CPubKey GetTokenOriginatorPubKey(CScript scriptPubKey) {
     std::vector<vscript_t> oprets;
 
     if ((funcId = DecodeTokenOpRetV1(scriptPubKey, tokenid, voutTokenPubkeys, oprets)) != 0) {
-        CTransaction tokenbasetx;
-        uint256 hashBlock;
+        std::shared_ptr<const CCtxmeta> tokenbase = CCtxmeta_load(tokenid);
 
-        if (myGetTransaction(tokenid, tokenbasetx, hashBlock) && tokenbasetx.vout.size() > 0) {
+        if (tokenbase != nullptr && tokenbase->opret.size() > 0) {
             vscript_t vorigpubkey;
             std::string name, desc;
             std::vector<vscript_t> oprets;
-            if (DecodeTokenCreateOpRetV1(tokenbasetx.vout.back().scriptPubKey, vorigpubkey, name, desc, oprets) != 0)
+            if (DecodeTokenCreateOpRetV1(tokenbase->opret, vorigpubkey, name, desc, oprets) != 0)
                 return pubkey2pk(vorigpubkey);
         }
     }
@@ -22,6 +22,8 @@
 #include "komodo_structs.h"
 #include "key_io.h"
 
+#include <deque>
+
 #ifdef TESTMODE           
     #define MIN_NON_NOTARIZED_CONFIRMS 2
 #else
@@ -212,9 +214,19 @@ void CCaddrTokens1of2set(struct CCcontract_info *cp, CPubKey pk1, CPubKey pk2, u
 	strcpy(cp->tokens1of2addr, tokenaddr);
 }
 
-bool Getscriptaddress(char *destaddr,const CScript &scriptPubKey)
+// Address derivation needs base58 and, for cc scripts, asn.1 encoding of the condition. The
+// results only depend on the inputs, so they are memoised in bounded maps that are dropped when full.
+#define CC_ADDRCACHE_MAX 65536
+#define CC_TXMETACACHE_MAX 4096
+static pthread_mutex_t CCcache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<CScript,std::string> CCscriptaddrs;
+static std::map<std::vector<uint8_t>,std::string> CCcondaddrs;
+static std::map<uint256,std::shared_ptr<const CCtxmeta> > CCtxmetas;
+static std::deque<uint256> CCtxmetaorder;
+
+static bool _Getscriptaddress(char *destaddr,const CScript &scriptPubKey)
 {
-    CTxDestination address; txnouttype whichType;
+    CTxDestination address;
     destaddr[0] = 0;
     if ( scriptPubKey.begin() != 0 )
     {
@@ -228,6 +240,116 @@ bool Getscriptaddress(char *destaddr,const CScript &scriptPubKey)
     return(false);
 }
 
+bool Getscriptaddress(char *destaddr,const CScript &scriptPubKey)
+{
+    std::map<CScript,std::string>::iterator it;
+    pthread_mutex_lock(&CCcache_mutex);
+    if ( (it= CCscriptaddrs.find(scriptPubKey)) != CCscriptaddrs.end() )
+    {
+        strcpy(destaddr,it->second.c_str());
+        pthread_mutex_unlock(&CCcache_mutex);
+        return(true);
+    }
+    pthread_mutex_unlock(&CCcache_mutex);
+    if ( _Getscriptaddress(destaddr,scriptPubKey) == 0 )
+        return(false);
+    pthread_mutex_lock(&CCcache_mutex);
+    if ( CCscriptaddrs.size() >= CC_ADDRCACHE_MAX )
+        CCscriptaddrs.clear();
+    CCscriptaddrs[scriptPubKey] = destaddr;
+    pthread_mutex_unlock(&CCcache_mutex);
+    return(true);
+}
+
+// key for the cc address cache: the eval codes followed by the pubkeys of the condition
+static std::vector<uint8_t> CCcondaddrkey(uint8_t type,uint8_t evalcode,uint8_t evalcode2,const CPubKey &pk,const CPubKey &pk2)
+{
+    std::vector<uint8_t> key;
+    key.reserve(3 + pk.size() + pk2.size());
+    key.push_back(type);
+    key.push_back(evalcode);
+    key.push_back(evalcode2);
+    key.insert(key.end(),pk.begin(),pk.end());
+    key.insert(key.end(),pk2.begin(),pk2.end());
+    return(key);
+}
+
+static bool CCcondaddr_find(char *destaddr,const std::vector<uint8_t> &key)
+{
+    std::map<std::vector<uint8_t>,std::string>::iterator it; bool retval = false;
+    pthread_mutex_lock(&CCcache_mutex);
+    if ( (it= CCcondaddrs.find(key)) != CCcondaddrs.end() )
+    {
+        strcpy(destaddr,it->second.c_str());
+        retval = true;
+    }
+    pthread_mutex_unlock(&CCcache_mutex);
+    return(retval);
+}
+
+static bool CCcondaddr_add(const std::vector<uint8_t> &key,CC *cond,char *destaddr)
+{
+    destaddr[0] = 0;
+    if ( cond == 0 )
+        return(false);
+    Getscriptaddress(destaddr,CCPubKey(cond));
+    cc_free(cond);
+    if ( destaddr[0] == 0 )
+        return(false);
+    pthread_mutex_lock(&CCcache_mutex);
+    if ( CCcondaddrs.size() >= CC_ADDRCACHE_MAX )
+        CCcondaddrs.clear();
+    CCcondaddrs[key] = destaddr;
+    pthread_mutex_unlock(&CCcache_mutex);
+    return(true);
+}
+
+static std::shared_ptr<const CCtxmeta> CCtxmeta_decode(const CTransaction &tx)
+{
+    std::shared_ptr<CCtxmeta> meta = std::make_shared<CCtxmeta>();
+    meta->txid = tx.GetHash();
+    if ( tx.vout.size() > 0 )
+        meta->opret = tx.vout.back().scriptPubKey;
+    return(meta);
+}
+
+static std::shared_ptr<const CCtxmeta> CCtxmeta_find(const uint256 &txid)
+{
+    std::map<uint256,std::shared_ptr<const CCtxmeta> >::iterator it; std::shared_ptr<const CCtxmeta> meta;
+    pthread_mutex_lock(&CCcache_mutex);
+    if ( (it= CCtxmetas.find(txid)) != CCtxmetas.end() )
+        meta = it->second;
+    pthread_mutex_unlock(&CCcache_mutex);
+    return(meta);
+}
+
+static void CCtxmeta_add(const std::shared_ptr<const CCtxmeta> &meta)
+{
+    pthread_mutex_lock(&CCcache_mutex);
+    if ( CCtxmetas.insert(std::make_pair(meta->txid,meta)).second != 0 )
+    {
+        CCtxmetaorder.push_back(meta->txid);
+        while ( CCtxmetaorder.size() > CC_TXMETACACHE_MAX )
+        {
+            CCtxmetas.erase(CCtxmetaorder.front());
+            CCtxmetaorder.pop_front();
+        }
+    }
+    pthread_mutex_unlock(&CCcache_mutex);
+}
+
+std::shared_ptr<const CCtxmeta> CCtxmeta_load(uint256 txid)
+{
+    CTransaction tx; uint256 hashBlock;
+    std::shared_ptr<const CCtxmeta> meta = CCtxmeta_find(txid);
+    if ( meta == 0 && myGetTransaction(txid,tx,hashBlock) != 0 )
+    {
+        meta = CCtxmeta_decode(tx);
+        CCtxmeta_add(meta);
+    }
+    return(meta);
+}
+
 bool GetCustomscriptaddress(char *destaddr,const CScript &scriptPubKey,uint8_t taddr,uint8_t prefix, uint8_t prefix2)
 {
     CTxDestination address; txnouttype whichType;
@@ -344,14 +466,10 @@ CPubKey CCCustomtxidaddr(char *txidaddr,uint256 txid,uint8_t taddr,uint8_t prefi
 
 bool _GetCCaddress(char *destaddr,uint8_t evalcode,CPubKey pk)
 {
-    CC *payoutCond;
-    destaddr[0] = 0;
-    if ( (payoutCond= MakeCCcond1(evalcode,pk)) != 0 )
-    {
-        Getscriptaddress(destaddr,CCPubKey(payoutCond));
-        cc_free(payoutCond);
-    }
-    return(destaddr[0] != 0);
+    std::vector<uint8_t> key = CCcondaddrkey('1',evalcode,0,pk,CPubKey());
+    if ( CCcondaddr_find(destaddr,key) != 0 )
+        return(true);
+    return(CCcondaddr_add(key,MakeCCcond1(evalcode,pk),destaddr));
 }
 
 bool GetCCaddress(struct CCcontract_info *cp,char *destaddr,CPubKey pk)
@@ -364,14 +482,10 @@ bool GetCCaddress(struct CCcontract_info *cp,char *destaddr,CPubKey pk)
 
 bool _GetTokensCCaddress(char *destaddr, uint8_t evalcode, uint8_t evalcode2, CPubKey pk)
 {
-	CC *payoutCond;
-	destaddr[0] = 0;
-	if ((payoutCond = MakeTokensCCcond1(evalcode, evalcode2, pk)) != 0)
-	{
-		Getscriptaddress(destaddr, CCPubKey(payoutCond));
-		cc_free(payoutCond);
-	}
-	return(destaddr[0] != 0);
+    std::vector<uint8_t> key = CCcondaddrkey('t', evalcode, evalcode2, pk, CPubKey());
+    if (CCcondaddr_find(destaddr, key))
+        return(true);
+    return(CCcondaddr_add(key, MakeTokensCCcond1(evalcode, evalcode2, pk), destaddr));
 }
 
 // get scriptPubKey adddress for three/dual eval token cc vout
@@ -386,26 +500,19 @@ bool GetTokensCCaddress(struct CCcontract_info *cp, char *destaddr, CPubKey pk)
 
 bool GetCCaddress1of2(struct CCcontract_info *cp,char *destaddr,CPubKey pk,CPubKey pk2)
 {
-    CC *payoutCond;
-    destaddr[0] = 0;
-    if ( (payoutCond= MakeCCcond1of2(cp->evalcode,pk,pk2)) != 0 )
-    {
-        Getscriptaddress(destaddr,CCPubKey(payoutCond));
-        cc_free(payoutCond);
-    }
-    return(destaddr[0] != 0);
+    std::vector<uint8_t> key = CCcondaddrkey('2',cp->evalcode,0,pk,pk2);
+    if ( CCcondaddr_find(destaddr,key) != 0 )
+        return(true);
+    return(CCcondaddr_add(key,MakeCCcond1of2(cp->evalcode,pk,pk2),destaddr));
 }
 
 bool GetTokensCCaddress1of2(struct CCcontract_info *cp, char *destaddr, CPubKey pk, CPubKey pk2)
 {
-	CC *payoutCond;
-	destaddr[0] = 0;
-	if ((payoutCond = MakeTokensCCcond1of2(cp->evalcode, cp->evalcodeNFT, pk, pk2)) != 0)  //  if additionalTokensEvalcode2 not set then it is dual-eval cc else three-eval cc
-	{
-		Getscriptaddress(destaddr, CCPubKey(payoutCond));
-		cc_free(payoutCond);
-	}
-	return(destaddr[0] != 0);
+    std::vector<uint8_t> key = CCcondaddrkey('T', cp->evalcode, cp->evalcodeNFT, pk, pk2);
+    if (CCcondaddr_find(destaddr, key))
+        return(true);
+    //  if additionalTokensEvalcode2 not set then it is dual-eval cc else three-eval cc
+    return(CCcondaddr_add(key, MakeTokensCCcond1of2(cp->evalcode, cp->evalcodeNFT, pk, pk2), destaddr));
 }
 
 // validate cc or normal vout address and value
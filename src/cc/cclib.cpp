@@ -98,6 +98,7 @@ CClib_methods[] =
     { (char *)"musig", (char *)"verify", (char *)"msg sig pubkey", 3, 3, 'V', EVAL_MUSIG },
     { (char *)"musig", (char *)"send", (char *)"combined_pk amount", 2, 2, 'x', EVAL_MUSIG },
     { (char *)"musig", (char *)"spend", (char *)"sendtxid sig scriptPubKey", 3, 3, 'y', EVAL_MUSIG },
+    { (char *)"musig", (char *)"bench", (char *)"[batchsize ...]", 0, 8, 'B', EVAL_MUSIG },
     { (char *)"dilithium", (char *)"keypair", (char *)"[hexseed]", 0, 1, 'K', EVAL_DILITHIUM },
     { (char *)"dilithium", (char *)"register", (char *)"handle, [hexseed]", 1, 2, 'R', EVAL_DILITHIUM },
     { (char *)"dilithium", (char *)"handleinfo", (char *)"handle", 1, 1, 'I', EVAL_DILITHIUM },
@@ -106,6 +107,7 @@ CClib_methods[] =
     { (char *)"dilithium", (char *)"send", (char *)"handle pubtxid amount", 3, 3, 'x', EVAL_DILITHIUM },
     { (char *)"dilithium", (char *)"spend", (char *)"sendtxid scriptPubKey [hexseed]", 2, 3, 'y', EVAL_DILITHIUM },
     { (char *)"dilithium", (char *)"Qsend", (char *)"mypubtxid hexseed/'mypriv' destpubtxid,amount, ...", 4, 66, 'Q', EVAL_DILITHIUM },
+    { (char *)"dilithium", (char *)"bench", (char *)"txid [iterations]", 1, 2, 'B', EVAL_DILITHIUM },
 #endif
 };
 
@@ -145,6 +147,7 @@ UniValue musig_partialsig(uint64_t txfee,struct CCcontract_info *cp,cJSON *param
 UniValue musig_verify(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
 UniValue musig_send(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
 UniValue musig_spend(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
+UniValue musig_bench(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
 
 bool dilithium_validate(struct CCcontract_info *cp,int32_t height,Eval *eval,const CTransaction tx);
 UniValue dilithium_register(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
@@ -155,6 +158,7 @@ UniValue dilithium_keypair(uint64_t txfee,struct CCcontract_info *cp,cJSON *para
 UniValue dilithium_sign(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
 UniValue dilithium_verify(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
 UniValue dilithium_Qsend(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
+UniValue dilithium_bench(uint64_t txfee,struct CCcontract_info *cp,cJSON *params);
 
 #endif
 
@@ -276,6 +280,8 @@ UniValue CClib_method(struct CCcontract_info *cp,char *method,char *jsonstr)
             return(musig_send(txfee,cp,params));
         else if ( strcmp(method,"spend") == 0 )
             return(musig_spend(txfee,cp,params));
+        else if ( strcmp(method,"bench") == 0 )
+            return(musig_bench(txfee,cp,params));
         else
         {
             result.push_back(Pair("result","error"));
@@ -302,6 +308,8 @@ UniValue CClib_method(struct CCcontract_info *cp,char *method,char *jsonstr)
             return(dilithium_sign(txfee,cp,params));
         else if ( strcmp(method,"verify") == 0 )
             return(dilithium_verify(txfee,cp,params));
+        else if ( strcmp(method,"bench") == 0 )
+            return(dilithium_bench(txfee,cp,params));
         else
         {
             result.push_back(Pair("result","error"));
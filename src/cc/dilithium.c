@@ -3109,9 +3109,45 @@ char *dilithium_hexstr(char *str,uint8_t *buf,int32_t len)
     return(str);
 }
 
+// registration txid -> decoded handle, pub33 and bigpub. a txid commits to its opret, so entries never go stale
+struct dilithium_bigpubentry
+{
+    std::string handle;
+    CPubKey pk33;
+    uint8_t pk[CRYPTO_PUBLICKEYBYTES];
+};
+std::map<uint256,struct dilithium_bigpubentry> Dilithium_bigpubs;
+
+// successful (msg32, sighash, pubtxid) verifications, shared by validation and the verify rpc
+#define DILITHIUM_MAXVERIFIED 8192
+std::set<uint256> Dilithium_verified;
+std::deque<uint256> Dilithium_verifiedorder;
+pthread_mutex_t DILITHIUM_CACHEMUTEX = PTHREAD_MUTEX_INITIALIZER;
+
+void dilithium_bigpubadd(uint256 pubtxid,std::string handle,CPubKey pk33,uint8_t *pk)
+{
+    struct dilithium_bigpubentry *ptr;
+    pthread_mutex_lock(&DILITHIUM_CACHEMUTEX);
+    ptr = &Dilithium_bigpubs[pubtxid];
+    ptr->handle = handle;
+    ptr->pk33 = pk33;
+    memcpy(ptr->pk,pk,CRYPTO_PUBLICKEYBYTES);
+    pthread_mutex_unlock(&DILITHIUM_CACHEMUTEX);
+}
+
 int32_t dilithium_bigpubget(std::string &handle,CPubKey &pk33,uint8_t *pk,uint256 pubtxid)
 {
-    CTransaction tx; uint8_t funcid; uint256 hashBlock; int32_t numvouts=0; std::vector<uint8_t> bigpub;
+    CTransaction tx; uint8_t funcid; uint256 hashBlock; int32_t numvouts=0; std::vector<uint8_t> bigpub; std::map<uint256,struct dilithium_bigpubentry>::iterator it;
+    pthread_mutex_lock(&DILITHIUM_CACHEMUTEX);
+    if ( (it= Dilithium_bigpubs.find(pubtxid)) != Dilithium_bigpubs.end() )
+    {
+        handle = it->second.handle;
+        pk33 = it->second.pk33;
+        memcpy(pk,it->second.pk,CRYPTO_PUBLICKEYBYTES);
+        pthread_mutex_unlock(&DILITHIUM_CACHEMUTEX);
+        return(0);
+    }
+    pthread_mutex_unlock(&DILITHIUM_CACHEMUTEX);
     if ( myGetTransaction(pubtxid,tx,hashBlock) != 0 )
     {
         if ( (numvouts= tx.vout.size()) > 1 )
@@ -3119,6 +3155,7 @@ int32_t dilithium_bigpubget(std::string &handle,CPubKey &pk33,uint8_t *pk,uint25
             if ( (funcid= dilithium_registeropretdecode(handle,pk33,bigpub,tx.vout[numvouts-1].scriptPubKey)) == 'R' && bigpub.size() == CRYPTO_PUBLICKEYBYTES )
             {
                 memcpy(pk,&bigpub[0],CRYPTO_PUBLICKEYBYTES);
+                dilithium_bigpubadd(pubtxid,handle,pk33,pk);
                 return(0);
             } else return(-2);
         }
@@ -3126,6 +3163,50 @@ int32_t dilithium_bigpubget(std::string &handle,CPubKey &pk33,uint8_t *pk,uint25
     return(-1);
 }
 
+uint256 dilithium_verifiedkey(uint8_t *msg,uint8_t *sm,int32_t smlen,uint256 pubtxid)
+{
+    CScript data; uint256 sighash;
+    vcalc_sha256(0,(uint8_t *)&sighash,sm,smlen);
+    data << E_MARSHAL(ss << std::vector<uint8_t>(msg,msg+32) << sighash << pubtxid);
+    return(Hash(data.begin(),data.end()));
+}
+
+// returns 0 if sm is a valid signature of msg by the bigpub registered in pubtxid, -1 on verify error, -2 on message mismatch
+int32_t dilithium_verifycached(uint8_t *msg,uint8_t *sm,int32_t smlen,uint8_t *pk,uint256 pubtxid)
+{
+    uint8_t msg2[CRYPTO_BYTES+32]; int32_t mlen = 0,found; uint256 key = dilithium_verifiedkey(msg,sm,smlen,pubtxid);
+    pthread_mutex_lock(&DILITHIUM_CACHEMUTEX);
+    found = (Dilithium_verified.count(key) != 0);
+    pthread_mutex_unlock(&DILITHIUM_CACHEMUTEX);
+    if ( found != 0 )
+        return(0);
+    if ( smlen > sizeof(msg2) || _dilithium_verify(msg2,&mlen,sm,smlen,pk) < 0 )
+        return(-1);
+    else if ( mlen != 32 || memcmp(msg,msg2,32) != 0 )
+        return(-2);
+    pthread_mutex_lock(&DILITHIUM_CACHEMUTEX);
+    if ( Dilithium_verified.insert(key).second != 0 )
+    {
+        Dilithium_verifiedorder.push_back(key);
+        if ( Dilithium_verifiedorder.size() > DILITHIUM_MAXVERIFIED )
+        {
+            Dilithium_verified.erase(Dilithium_verifiedorder.front());
+            Dilithium_verifiedorder.pop_front();
+        }
+    }
+    pthread_mutex_unlock(&DILITHIUM_CACHEMUTEX);
+    return(0);
+}
+
+void dilithium_cachesclear()
+{
+    pthread_mutex_lock(&DILITHIUM_CACHEMUTEX);
+    Dilithium_bigpubs.clear();
+    Dilithium_verified.clear();
+    Dilithium_verifiedorder.clear();
+    pthread_mutex_unlock(&DILITHIUM_CACHEMUTEX);
+}
+
 UniValue dilithium_keypair(uint64_t txfee,struct CCcontract_info *cp,cJSON *params)
 {
     UniValue result(UniValue::VOBJ); uint8_t seed[SEEDBYTES],pk[CRYPTO_PUBLICKEYBYTES],sk[CRYPTO_SECRETKEYBYTES]; char coinaddr[64],str[CRYPTO_SECRETKEYBYTES*2+1]; int32_t i,n,externalflag=0;
@@ -3273,11 +3354,9 @@ UniValue dilithium_verify(uint64_t txfee,struct CCcontract_info *cp,cJSON *param
         {
             calc_rmd160_sha256(rmd160,sm,smlen);
             result.push_back(Pair("sighash",dilithium_hexstr(str,rmd160,20)));
-            if ( _dilithium_verify(msg2,&mlen,sm,smlen,pk) < 0 )
+            if ( (mlen= dilithium_verifycached(msg,sm,smlen,pk,pubtxid)) == -1 )
                 return(cclib_error(result,"dilithium verify error"));
-            else if ( mlen != 32 )
-                return(cclib_error(result,"message len mismatch"));
-            else if ( memcmp(msg2,msg,32) != 0 )
+            else if ( mlen < 0 )
                 return(cclib_error(result,"message content mismatch"));
             result.push_back(Pair("msg32",dilithium_hexstr(str,msg,32)));
             result.push_back(Pair("handle",handle));
@@ -3544,16 +3623,13 @@ bool dilithium_Qvalidate(struct CCcontract_info *cp,int32_t height,Eval *eval,co
                 return eval->Invalid("couldnt get bigpub");
             else
             {
-                if ( _dilithium_verify(msg2,&mlen,&sig[0],smlen,pk) < 0 )
+                if ( (mlen= dilithium_verifycached(msg,&sig[0],smlen,pk,signerpubtxid)) == -1 )
                     return eval->Invalid("failed dilithium verify");
-                else if ( mlen != 32 || memcmp(msg,msg2,32) != 0 )
+                else if ( mlen < 0 )
                 {
                     for (i=0; i<32; i++)
                         fprintf(stderr,"%02x",msg[i]);
-                    fprintf(stderr," vs ");
-                    for (i=0; i<mlen; i++)
-                        fprintf(stderr,"%02x",msg2[i]);
-                    fprintf(stderr,"mlen.%d\n",mlen);
+                    fprintf(stderr," msg mismatch\n");
                     return eval->Invalid("failed dilithium msg verify");
                 }
                 else return true;
@@ -3594,6 +3670,8 @@ void dilithium_handleinit(struct CCcontract_info *cp)
         {
             if ( dilithium_registeropretdecode(handle,pub33,bigpub,txi.vout[numvouts-1].scriptPubKey) == 'R' )
             {
+                if ( bigpub.size() == CRYPTO_PUBLICKEYBYTES )
+                    dilithium_bigpubadd(txid,handle,pub33,&bigpub[0]);
                 if ( (hashstr= dilithium_handlenew((char *)handle.c_str())) != 0 )
                 {
                     if ( hashstr->destpubtxid != txid )
@@ -3716,9 +3794,9 @@ bool dilithium_validate(struct CCcontract_info *cp,int32_t height,Eval *eval,con
                         return eval->Invalid("couldnt get bigpub");
                     else
                     {
-                        if ( _dilithium_verify(msg2,&mlen,&sig[0],smlen,pk) < 0 )
+                        if ( (mlen= dilithium_verifycached(msg,&sig[0],smlen,pk,destpubtxid)) == -1 )
                             return eval->Invalid("failed dilithium verify");
-                        else if ( mlen != 32 || memcmp(msg,msg2,32) != 0 )
+                        else if ( mlen < 0 )
                             return eval->Invalid("failed dilithium msg verify");
                         else return(true);
                     }
@@ -3728,3 +3806,38 @@ bool dilithium_validate(struct CCcontract_info *cp,int32_t height,Eval *eval,con
     } else return eval->Invalid("couldnt find vin0 tx");
 }
 
+UniValue dilithium_bench(uint64_t txfee,struct CCcontract_info *cp,cJSON *params)
+{
+    UniValue result(UniValue::VOBJ); CTransaction tx; uint256 txid,hashBlock; int32_t i,n,iters=100,height,coldvalid=0,warmvalid=0; int64_t coldtime=0,warmtime=0,t0;
+    if ( params != 0 && ((n= cJSON_GetArraySize(params)) == 1 || n == 2) )
+    {
+        txid = juint256(jitem(params,0));
+        if ( n == 2 && (iters= jint(jitem(params,1),0)) <= 0 )
+            return(cclib_error(result,"iterations must be positive"));
+        if ( myGetTransaction(txid,tx,hashBlock) == 0 || tx.vout.size() < 2 )
+            return(cclib_error(result,"couldnt find dilithium tx"));
+        height = komodo_nextheight();
+        for (i=0; i<iters; i++)
+        {
+            Eval eval;
+            dilithium_cachesclear();
+            t0 = GetTimeMicros();
+            coldvalid += dilithium_validate(cp,height,&eval,tx);
+            coldtime += GetTimeMicros() - t0;
+        }
+        for (i=0; i<iters; i++)
+        {
+            Eval eval;
+            t0 = GetTimeMicros();
+            warmvalid += dilithium_validate(cp,height,&eval,tx);
+            warmtime += GetTimeMicros() - t0;
+        }
+        result.push_back(Pair("result","success"));
+        result.push_back(Pair("txid",txid.GetHex()));
+        result.push_back(Pair("iterations",iters));
+        result.push_back(Pair("valid",coldvalid == iters && warmvalid == iters));
+        result.push_back(Pair("uncached_tx_per_sec",coldtime > 0 ? (double)iters * 1000000 / coldtime : 0.));
+        result.push_back(Pair("cached_tx_per_sec",warmtime > 0 ? (double)iters * 1000000 / warmtime : 0.));
+        return(result);
+    } else return(cclib_error(result,"not enough parameters"));
+}
@@ -16,6 +16,7 @@
 #include "CCGateways.h"
 #include "CCtokens.h"
 #include "key_io.h"
+#include "validationinterface.h"
 
 /*
  prevent duplicate bindtxid via mempool scan
@@ -1053,14 +1054,181 @@ UniValue GatewaysMarkDone(const CPubKey& pk, uint64_t txfee,uint256 withdrawsign
     CCERR_RESULT("gatewayscc",CCLOG_ERROR, stream << "error adding funds for markdone");
 }
 
+// Pending deposits and withdraws are the unspent CC_MARKER_VALUE vout 0 of 'D', 'W' and 'S' txs. They are indexed by
+// (bindtxid,funcid) so the pending queue rpcs only load their own items instead of every gateways utxo. The index follows
+// the chain through ChainTip and merges in the address index of a marker address the first time that address is queried.
+// The mempool is still overlaid by the rpcs with myIsutxo_spentinmempool and myGet_mempool_txs.
+struct gateways_pendingitem
+{
+    uint256 bindtxid;
+    uint8_t funcid;
+    std::string coinaddr;
+};
+
+static pthread_mutex_t GatewaysPending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<uint256,gateways_pendingitem> GatewaysPendingItems;
+static std::map<std::pair<uint256,uint8_t>,std::set<uint256> > GatewaysPendingQueues;
+static std::set<std::string> GatewaysPendingScanned;
+
+static bool GatewaysPendingDecode(const CTransaction &tx,gateways_pendingitem &item)
+{
+    CTransaction withdrawtx; std::string coin,hex; std::vector<CPubKey> publishers,signingpubkeys; std::vector<uint256> txids; std::vector<uint8_t> proof;
+    uint256 tokenid,hashBlock,cointxid,withdrawtxid,lasttxid; CPubKey destpub,tmppk,withdrawpub; int32_t height,claimvout,numvouts; int64_t amount; uint8_t K;
+    char coinaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    if ( (numvouts= tx.vout.size()) < 2 || tx.vout[0].nValue != CC_MARKER_VALUE || tx.vout[0].scriptPubKey.IsPayToCryptoCondition() == 0 )
+        return(false);
+    switch ( (item.funcid= DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey)) )
+    {
+        case 'D':
+            if ( DecodeGatewaysDepositOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,item.bindtxid,coin,publishers,txids,height,cointxid,claimvout,hex,proof,destpub,amount) != 'D' )
+                return(false);
+            break;
+        case 'W':
+            if ( DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,item.bindtxid,tmppk,coin,withdrawpub,amount) != 'W' )
+                return(false);
+            break;
+        case 'S':
+            if ( DecodeGatewaysWithdrawSignOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,lasttxid,signingpubkeys,coin,K,hex) != 'S' ||
+                myGetTransaction(withdrawtxid,withdrawtx,hashBlock) == 0 || (numvouts= withdrawtx.vout.size()) <= 0 ||
+                DecodeGatewaysWithdrawOpRet(withdrawtx.vout[numvouts-1].scriptPubKey,tokenid,item.bindtxid,tmppk,coin,withdrawpub,amount) != 'W' )
+                return(false);
+            break;
+        default:
+            return(false);
+    }
+    if ( Getscriptaddress(coinaddr,tx.vout[0].scriptPubKey) == 0 )
+        return(false);
+    item.coinaddr = coinaddr;
+    return(true);
+}
+
+static void GatewaysPendingAdd(const uint256 &txid,const gateways_pendingitem &item)
+{
+    pthread_mutex_lock(&GatewaysPending_mutex);
+    if ( GatewaysPendingItems.insert(std::make_pair(txid,item)).second != 0 )
+        GatewaysPendingQueues[std::make_pair(item.bindtxid,item.funcid)].insert(txid);
+    pthread_mutex_unlock(&GatewaysPending_mutex);
+}
+
+static void GatewaysPendingRemove(const uint256 &txid)
+{
+    std::map<uint256,gateways_pendingitem>::iterator it;
+    pthread_mutex_lock(&GatewaysPending_mutex);
+    if ( (it= GatewaysPendingItems.find(txid)) != GatewaysPendingItems.end() )
+    {
+        std::pair<uint256,uint8_t> key = std::make_pair(it->second.bindtxid,it->second.funcid);
+        GatewaysPendingQueues[key].erase(txid);
+        if ( GatewaysPendingQueues[key].empty() != 0 )
+            GatewaysPendingQueues.erase(key);
+        GatewaysPendingItems.erase(it);
+    }
+    pthread_mutex_unlock(&GatewaysPending_mutex);
+}
+
+class CGatewaysPendingIndex : public CValidationInterface
+{
+protected:
+    void ChainTip(const CBlockIndex *pindex,const CBlock *pblock,SproutMerkleTree sproutTree,SaplingMerkleTree saplingTree,bool added)
+    {
+        gateways_pendingitem item; CTransaction vintx; uint256 hashBlock; int32_t i,numvouts;
+        if ( pblock == 0 )
+            return;
+        if ( added != 0 )
+        {
+            BOOST_FOREACH(const CTransaction &tx,pblock->vtx)
+            {
+                BOOST_FOREACH(const CTxIn &vin,tx.vin)
+                    if ( vin.prevout.n == 0 )
+                        GatewaysPendingRemove(vin.prevout.hash);
+                if ( GatewaysPendingDecode(tx,item) != 0 )
+                    GatewaysPendingAdd(tx.GetHash(),item);
+            }
+        }
+        else
+        {
+            for (i=(int32_t)pblock->vtx.size()-1; i>=0; i--)
+            {
+                const CTransaction &tx = pblock->vtx[i];
+                GatewaysPendingRemove(tx.GetHash());
+                if ( (numvouts= tx.vout.size()) <= 0 || DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey) == 0 )
+                    continue;
+                BOOST_FOREACH(const CTxIn &vin,tx.vin)
+                    if ( vin.prevout.n == 0 && myGetTransaction(vin.prevout.hash,vintx,hashBlock) != 0 && GatewaysPendingDecode(vintx,item) != 0 )
+                        GatewaysPendingAdd(vin.prevout.hash,item);
+            }
+        }
+    }
+};
+static CGatewaysPendingIndex GatewaysPendingIndex;
+
+// merges the unspent markers of coinaddr into the index the first time it is queried
+static void GatewaysPendingScan(char *coinaddr)
+{
+    static bool registered;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    gateways_pendingitem item; CTransaction tx; uint256 hashBlock; bool scanned;
+
+    LOCK(cs_main);
+    if ( registered == 0 )
+    {
+        RegisterValidationInterface(&GatewaysPendingIndex);
+        registered = true;
+    }
+    pthread_mutex_lock(&GatewaysPending_mutex);
+    scanned = GatewaysPendingScanned.count(coinaddr) != 0;
+    pthread_mutex_unlock(&GatewaysPending_mutex);
+    if ( scanned != 0 )
+        return;
+    SetCCunspents(unspentOutputs,coinaddr,true);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    {
+        if ( it->first.index == 0 && it->second.satoshis == CC_MARKER_VALUE && myGetTransaction(it->first.txhash,tx,hashBlock) != 0 && GatewaysPendingDecode(tx,item) != 0 )
+            GatewaysPendingAdd(it->first.txhash,item);
+    }
+    pthread_mutex_lock(&GatewaysPending_mutex);
+    GatewaysPendingScanned.insert(coinaddr);
+    pthread_mutex_unlock(&GatewaysPending_mutex);
+}
+
+// returns the pending funcid items of bindtxid whose marker is on coinaddr, in txid order like the address index
+static std::vector<uint256> GatewaysPendingList(uint256 bindtxid,uint8_t funcid,char *coinaddr)
+{
+    std::vector<uint256> txids; std::map<std::pair<uint256,uint8_t>,std::set<uint256> >::iterator it;
+    if ( KOMODO_NSPV_SUPERLITE )
+    {
+        // no ChainTip in superlite mode, so the unspents are always fetched from the remote node
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+        gateways_pendingitem item; CTransaction tx; uint256 hashBlock;
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator uit=unspentOutputs.begin(); uit!=unspentOutputs.end(); uit++)
+        {
+            if ( uit->first.index == 0 && uit->second.satoshis == CC_MARKER_VALUE && myGetTransaction(uit->first.txhash,tx,hashBlock) != 0 &&
+                GatewaysPendingDecode(tx,item) != 0 && item.bindtxid == bindtxid && item.funcid == funcid )
+                txids.push_back(uit->first.txhash);
+        }
+        return(txids);
+    }
+    GatewaysPendingScan(coinaddr);
+    pthread_mutex_lock(&GatewaysPending_mutex);
+    if ( (it= GatewaysPendingQueues.find(std::make_pair(bindtxid,funcid))) != GatewaysPendingQueues.end() )
+    {
+        for (std::set<uint256>::const_iterator txit=it->second.begin(); txit!=it->second.end(); txit++)
+            if ( GatewaysPendingItems[*txit].coinaddr == coinaddr )
+                txids.push_back(*txit);
+    }
+    pthread_mutex_unlock(&GatewaysPending_mutex);
+    return(txids);
+}
+
 UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string refcoin)
 {
     UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin,hex,pub; 
     CPubKey mypk,gatewayspk,destpub; std::vector<CPubKey> pubkeys,publishers; std::vector<uint256> txids;
     uint256 tmpbindtxid,hashBlock,txid,tokenid,oracletxid,cointxid; uint8_t M,N,taddr,prefix,prefix2,wiftype;
     char depositaddr[65],coinaddr[65],str[65],destaddr[65],txidaddr[65]; std::vector<uint8_t> proof;
-    int32_t numvouts,vout,claimvout,height; int64_t totalsupply,nValue,amount; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    int32_t numvouts,vout,claimvout,height; int64_t totalsupply,amount; struct CCcontract_info *cp,C;
+    std::vector<uint256> pendingtxids;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1078,13 +1246,12 @@ UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string
         result.push_back(Pair("error",strprintf("invalid bindtxid %s coin.%s",uint256_str(str,bindtxid),coin.c_str())));     
         return(result);
     }  
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    pendingtxids = GatewaysPendingList(bindtxid,'D',coinaddr);
+    for (std::vector<uint256>::const_iterator it=pendingtxids.begin(); it!=pendingtxids.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
+        txid = *it;
+        vout = 0;
+        if ( myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
             DecodeGatewaysDepositOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmpbindtxid,coin,publishers,txids,height,cointxid,claimvout,hex,proof,destpub,amount) == 'D'
             && tmpbindtxid==bindtxid && refcoin == coin && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
         {   
@@ -1113,8 +1280,8 @@ UniValue GatewaysPendingSignWithdraws(const CPubKey& pk, uint256 bindtxid,std::s
     UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx,withdrawtx; std::string coin,hex; CPubKey mypk,tmppk,gatewayspk,withdrawpub;
     std::vector<CPubKey> msigpubkeys; uint256 hashBlock,txid,tmpbindtxid,tokenid,tmptokenid,oracletxid,withdrawtxid,tmplasttxid; uint8_t K=0,M,N,taddr,prefix,prefix2,wiftype;
     char funcid,gatewaystokensaddr[65],str[65],depositaddr[65],coinaddr[65],destaddr[65],withaddr[65],numstr[32],signeraddr[65],txidaddr[65];
-    int32_t i,n,numvouts,vout,queueflag; int64_t amount,nValue,totalsupply; struct CCcontract_info *cp,C; std::vector<CPubKey> signingpubkeys;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::vector<CTransaction> txs; std::vector<CTransaction> tmp_txs;
+    int32_t i,n,numvouts,vout,queueflag; int64_t amount,totalsupply; struct CCcontract_info *cp,C; std::vector<CPubKey> signingpubkeys;
+    std::vector<uint256> pendingtxids; std::vector<CTransaction> txs; std::vector<CTransaction> tmp_txs;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1150,13 +1317,12 @@ UniValue GatewaysPendingSignWithdraws(const CPubKey& pk, uint256 bindtxid,std::s
     }
     if (txs.empty())
     {
-        SetCCunspents(unspentOutputs,coinaddr,true);
-        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        pendingtxids = GatewaysPendingList(bindtxid,'S',coinaddr);
+        for (std::vector<uint256>::const_iterator it=pendingtxids.begin(); it!=pendingtxids.end(); it++)
         {
-            txid = it->first.txhash;
-            vout = (int32_t)it->first.index;
-            nValue = (int64_t)it->second.satoshis;
-            if (myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 && vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 &&
+            txid = *it;
+            vout = 0;
+            if (myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 && myGetTransaction(txid,tx,hashBlock) != 0 &&
                 (numvouts= tx.vout.size())>0 && DecodeGatewaysWithdrawSignOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,tmplasttxid,signingpubkeys,coin,K,hex)=='S' && myGetTransaction(withdrawtxid,withdrawtx,hashBlock)!=0
                 && (numvouts=withdrawtx.vout.size())>0 && DecodeGatewaysWithdrawOpRet(withdrawtx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,tmppk,coin,withdrawpub,amount)=='W' && refcoin==coin && tmpbindtxid==bindtxid && tmptokenid==tokenid)
             {
@@ -1167,12 +1333,12 @@ UniValue GatewaysPendingSignWithdraws(const CPubKey& pk, uint256 bindtxid,std::s
     }
     if (txs.empty())
     {
-        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        pendingtxids = GatewaysPendingList(bindtxid,'W',coinaddr);
+        for (std::vector<uint256>::const_iterator it=pendingtxids.begin(); it!=pendingtxids.end(); it++)
         {
-            txid = it->first.txhash;
-            vout = (int32_t)it->first.index;
-            nValue = (int64_t)it->second.satoshis;
-            if (myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 && vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 &&
+            txid = *it;
+            vout = 0;
+            if (myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 && myGetTransaction(txid,tx,hashBlock) != 0 &&
                 (numvouts= tx.vout.size())>0 && DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,tmppk,coin,withdrawpub,amount)=='W' &&
                 tmpbindtxid==bindtxid && tmptokenid==tokenid && komodo_get_blocktime(hashBlock)+3600>GetTime())
             {
@@ -1241,8 +1407,8 @@ UniValue GatewaysSignedWithdraws(const CPubKey& pk, uint256 bindtxid,std::string
     CPubKey mypk,tmppk,gatewayspk,withdrawpub; std::vector<CPubKey> msigpubkeys;
     uint256 withdrawtxid,tmplasttxid,tmpbindtxid,tokenid,tmptokenid,hashBlock,txid,oracletxid; uint8_t K,M,N,taddr,prefix,prefix2,wiftype;
     char depositaddr[65],signeraddr[65],coinaddr[65],numstr[32],withaddr[65],txidaddr[65];
-    int32_t i,n,numvouts,vout,queueflag; int64_t nValue,amount,totalsupply; struct CCcontract_info *cp,C; std::vector<CPubKey> signingpubkeys;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::vector<CTransaction> txs; std::vector<CTransaction> tmp_txs;
+    int32_t i,n,numvouts,vout,queueflag; int64_t amount,totalsupply; struct CCcontract_info *cp,C; std::vector<CPubKey> signingpubkeys;
+    std::vector<uint256> pendingtxids; std::vector<CTransaction> txs; std::vector<CTransaction> tmp_txs;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1271,13 +1437,12 @@ UniValue GatewaysSignedWithdraws(const CPubKey& pk, uint256 bindtxid,std::string
             DecodeGatewaysWithdrawOpRet(withdrawtx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,tmppk,coin,withdrawpub,amount) == 'W' && tmpbindtxid==bindtxid && tmptokenid==tokenid)
                 txs.push_back(tx);
     }
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    pendingtxids = GatewaysPendingList(bindtxid,'S',coinaddr);
+    for (std::vector<uint256>::const_iterator it=pendingtxids.begin(); it!=pendingtxids.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if ( myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 && vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
+        txid = *it;
+        vout = 0;
+        if ( myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
             DecodeGatewaysWithdrawSignOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,tmplasttxid,signingpubkeys,coin,K,hex)=='S' && K>=M && refcoin==coin &&
             myGetTransaction(withdrawtxid,withdrawtx,hashBlock) != 0 && (numvouts= withdrawtx.vout.size())>0 &&
             DecodeGatewaysWithdrawOpRet(withdrawtx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,tmppk,coin,withdrawpub,amount) == 'W' &&  tmpbindtxid==bindtxid && tmptokenid==tokenid)
@@ -185,6 +185,7 @@ a10001ffffffff0200e1f5050000000023210255c46dbce584e3751081b39d7fc054fc807100557e
 #include "../secp256k1/include/secp256k1.h"
 #include "../secp256k1/src/ecmult.h"
 #include "../secp256k1/src/ecmult_gen.h"
+#include "../secp256k1/src/scratch_impl.h"
 
 typedef struct { unsigned char data[64]; } secp256k1_schnorrsig;
 struct secp256k1_context_struct {
@@ -206,9 +207,14 @@ extern "C" int secp256k1_schnorrsig_parse(const secp256k1_context* ctx, secp256k
 extern "C" int secp256k1_musig_pubkey_combine(const secp256k1_context* ctx, secp256k1_scratch_space *scratch, secp256k1_pubkey *combined_pk, unsigned char *pk_hash32, const secp256k1_pubkey *pubkeys, size_t n_pubkeys);
 extern "C" int secp256k1_musig_session_initialize(const secp256k1_context* ctx, secp256k1_musig_session *session, secp256k1_musig_session_signer_data *signers, unsigned char *nonce_commitment32, const unsigned char *session_id32, const unsigned char *msg32, const secp256k1_pubkey *combined_pk, const unsigned char *pk_hash32, size_t n_signers, size_t my_index, const unsigned char *seckey);
 extern "C" int secp256k1_schnorrsig_serialize(const secp256k1_context* ctx, unsigned char *out64, const secp256k1_schnorrsig* sig);
+extern "C" int secp256k1_schnorrsig_verify_batch(const secp256k1_context *ctx, secp256k1_scratch *scratch, const secp256k1_schnorrsig *const *sig, const unsigned char *const *msg32, const secp256k1_pubkey *const *pk, size_t n_sigs);
+extern "C" int secp256k1_schnorrsig_sign(const secp256k1_context* ctx, secp256k1_schnorrsig *sig, int *nonce_is_negated, const unsigned char *msg32, const unsigned char *seckey, secp256k1_nonce_function noncefp, void *ndata);
 
 #define MUSIG_PREVN 0   // for now, just use vout0 for the musig output
 #define MUSIG_TXFEE 10000
+#define MUSIG_MAXVERIFIED 16384
+#define MUSIG_MAXCOMBINED 4096
+#define MUSIG_SCRATCHSIZE (4 * 1024 * 1024)
 
 struct musig_info
 {
@@ -269,6 +275,101 @@ void musig_infofree(struct musig_info *mp)
     free(mp);
 }
 
+// hash(msg, musig64, combined_pk) of signatures known to verify, filled by the block level batch
+// verification below and by single verifies, so a spend checked in the mempool is not checked again
+std::set<uint256> MUSIG_VERIFIED;
+std::deque<uint256> MUSIG_VERIFIEDORDER;
+// ordered pubkey set -> combined_pk and pkhash
+std::map<uint256,std::pair<secp256k1_pubkey,uint256> > MUSIG_COMBINED;
+uint256 MUSIG_BATCHBLOCK;
+pthread_mutex_t MUSIG_CACHEMUTEX = PTHREAD_MUTEX_INITIALIZER;
+extern const CBlock *KOMODO_CONNECTINGBLOCK;
+
+struct musig_batchitem
+{
+    uint8_t msg[32],musig64[64];
+    CPubKey pk;
+};
+
+uint256 musig_verifiedkey(const uint8_t *msg,const uint8_t *musig64,const CPubKey &pk)
+{
+    uint8_t buf[32+64+33];
+    memcpy(buf,msg,32);
+    memcpy(&buf[32],musig64,64);
+    memcpy(&buf[96],pk.begin(),33);
+    return(Hash(buf,buf+sizeof(buf)));
+}
+
+int32_t musig_isverified(uint256 key)
+{
+    int32_t retval;
+    pthread_mutex_lock(&MUSIG_CACHEMUTEX);
+    retval = (MUSIG_VERIFIED.count(key) != 0);
+    pthread_mutex_unlock(&MUSIG_CACHEMUTEX);
+    return(retval);
+}
+
+void musig_addverified(uint256 key)
+{
+    pthread_mutex_lock(&MUSIG_CACHEMUTEX);
+    if ( MUSIG_VERIFIED.insert(key).second != 0 )
+    {
+        MUSIG_VERIFIEDORDER.push_back(key);
+        if ( MUSIG_VERIFIEDORDER.size() > MUSIG_MAXVERIFIED )
+        {
+            MUSIG_VERIFIED.erase(MUSIG_VERIFIEDORDER.front());
+            MUSIG_VERIFIEDORDER.pop_front();
+        }
+    }
+    pthread_mutex_unlock(&MUSIG_CACHEMUTEX);
+}
+
+// returns 1 if musig64 is a valid signature of msg by combined pk
+int32_t musig_verifysig(secp256k1_context *ctx,const uint8_t *msg,const uint8_t *musig64,const CPubKey &pk)
+{
+    secp256k1_schnorrsig musig; secp256k1_pubkey combined_pk; uint256 key = musig_verifiedkey(msg,musig64,pk);
+    if ( musig_isverified(key) != 0 )
+        return(1);
+    if ( secp256k1_schnorrsig_parse((const secp256k1_context *)ctx,&musig,musig64) > 0 && secp256k1_ec_pubkey_parse(ctx,&combined_pk,pk.begin(),33) > 0 && secp256k1_schnorrsig_verify((const secp256k1_context *)ctx,&musig,msg,&combined_pk) > 0 )
+    {
+        musig_addverified(key);
+        return(1);
+    }
+    return(0);
+}
+
+// verifies all items with one multi scalar multiplication, on failure falls back to single verifies to find the bad ones. returns number of valid items
+int32_t musig_batchverify(secp256k1_context *ctx,std::vector<struct musig_batchitem> &items)
+{
+    std::vector<secp256k1_schnorrsig> sigs(items.size()); std::vector<secp256k1_pubkey> pks(items.size()); std::vector<const secp256k1_schnorrsig *> sigptrs; std::vector<const uint8_t *> msgptrs; std::vector<const secp256k1_pubkey *> pkptrs; secp256k1_scratch *scratch; int32_t i,n = (int32_t)items.size(),valid = 0,rv = 0;
+    for (i=0; i<n; i++)
+    {
+        if ( secp256k1_schnorrsig_parse((const secp256k1_context *)ctx,&sigs[i],items[i].musig64) <= 0 || secp256k1_ec_pubkey_parse(ctx,&pks[i],items[i].pk.begin(),33) <= 0 )
+            break;
+        sigptrs.push_back(&sigs[i]);
+        msgptrs.push_back(items[i].msg);
+        pkptrs.push_back(&pks[i]);
+    }
+    if ( i == n && n > 0 && (scratch= secp256k1_scratch_create(&ctx->error_callback,MUSIG_SCRATCHSIZE)) != 0 )
+    {
+        rv = secp256k1_schnorrsig_verify_batch((const secp256k1_context *)ctx,scratch,&sigptrs[0],&msgptrs[0],&pkptrs[0],n);
+        secp256k1_scratch_destroy(scratch);
+    }
+    if ( rv > 0 )
+    {
+        for (i=0; i<n; i++)
+            musig_addverified(musig_verifiedkey(items[i].msg,items[i].musig64,items[i].pk));
+        return(n);
+    }
+    for (i=0; i<n; i++)
+    {
+        if ( musig_verifysig(ctx,items[i].msg,items[i].musig64,items[i].pk) != 0 )
+            valid++;
+        else fprintf(stderr,"musig batch item.%d of %d failed verify\n",i,n);
+    }
+    return(valid);
+}
+
 CScript musig_sendopret(uint8_t funcid,CPubKey pk)
 {
     CScript opret; uint8_t evalcode = EVAL_MUSIG;
@@ -390,7 +491,26 @@ UniValue musig_combine(uint64_t txfee,struct CCcontract_info *cp,cJSON *params)
                 return(cclib_error(result,"error parsing pk"));
             pubkeys.push_back(spk);
         }
-        if ( secp256k1_musig_pubkey_combine(ctx,NULL,&combined_pk,pkhash,&pubkeys[0],n) > 0 )
+        uint256 setkey = Hash((uint8_t *)&pubkeys[0],(uint8_t *)&pubkeys[0] + n*sizeof(pubkeys[0]));
+        std::map<uint256,std::pair<secp256k1_pubkey,uint256> >::iterator it; int32_t combined = 0;
+        pthread_mutex_lock(&MUSIG_CACHEMUTEX);
+        if ( (it= MUSIG_COMBINED.find(setkey)) != MUSIG_COMBINED.end() )
+        {
+            combined_pk = it->second.first;
+            memcpy(pkhash,it->second.second.begin(),32);
+            combined = 1;
+        }
+        pthread_mutex_unlock(&MUSIG_CACHEMUTEX);
+        if ( combined == 0 && secp256k1_musig_pubkey_combine(ctx,NULL,&combined_pk,pkhash,&pubkeys[0],n) > 0 )
+        {
+            pthread_mutex_lock(&MUSIG_CACHEMUTEX);
+            if ( MUSIG_COMBINED.size() >= MUSIG_MAXCOMBINED )
+                MUSIG_COMBINED.clear();
+            MUSIG_COMBINED[setkey] = std::make_pair(combined_pk,uint256(std::vector<uint8_t>(pkhash,pkhash+32)));
+            pthread_mutex_unlock(&MUSIG_CACHEMUTEX);
+            combined = 1;
+        }
+        if ( combined != 0 )
         {
             if ( secp256k1_ec_pubkey_serialize(ctx,(uint8_t *)pk.begin(),&clen,&combined_pk,SECP256K1_EC_COMPRESSED) > 0 && clen == 33 )
             {
@@ -720,7 +840,8 @@ UniValue musig_verify(uint64_t txfee,struct CCcontract_info *cp,cJSON *params)
         result.push_back(Pair("combinedsig",str));
         if ( secp256k1_schnorrsig_parse(ctx,&musig,&musig64[0]) > 0 )
         {
-            if ( secp256k1_schnorrsig_verify(ctx,&musig,msg,&combined_pk) > 0 )
+            CPubKey pk(ParseHex(jstr(jitem(params,1),0)));
+            if ( musig_verifysig(ctx,msg,musig64,pk) != 0 )
             {
                 result.push_back(Pair("result","success"));
                 return(result);
@@ -835,12 +956,40 @@ UniValue musig_spend(uint64_t txfee,struct CCcontract_info *cp,cJSON *params)
     } else return(cclib_error(result,"params parse error"));
 }
 
+// the first musig spend validated while a block connects batch verifies the signatures of every musig spend in that block
+void musig_blockbatch(secp256k1_context *ctx)
+{
+    std::vector<struct musig_batchitem> items; struct musig_batchitem item; std::vector<uint8_t> musig64; uint256 hash; int32_t i;
+    pthread_mutex_lock(&MUSIG_CACHEMUTEX);
+    if ( KOMODO_CONNECTINGBLOCK == 0 || (hash= KOMODO_CONNECTINGBLOCK->GetHash()) == MUSIG_BATCHBLOCK )
+    {
+        pthread_mutex_unlock(&MUSIG_CACHEMUTEX);
+        return;
+    }
+    MUSIG_BATCHBLOCK = hash;
+    pthread_mutex_unlock(&MUSIG_CACHEMUTEX);
+    for (i=0; i<KOMODO_CONNECTINGBLOCK->vtx.size(); i++)
+    {
+        const CTransaction &tx = KOMODO_CONNECTINGBLOCK->vtx[i];
+        if ( tx.vout.size() != 2 || tx.vin.size() != 1 || musig_spendopretdecode(item.pk,musig64,tx.vout[1].scriptPubKey) != 'y' || musig64.size() != 64 )
+            continue;
+        if ( musig_prevoutmsg(item.msg,tx.vin[0].prevout.hash,tx.vout[0].scriptPubKey) < 0 )
+            continue;
+        memcpy(item.musig64,&musig64[0],64);
+        if ( musig_isverified(musig_verifiedkey(item.msg,item.musig64,item.pk)) == 0 )
+            items.push_back(item);
+    }
+    if ( items.size() > 1 )
+        musig_batchverify(ctx,items);
+}
+
 bool musig_validate(struct CCcontract_info *cp,int32_t height,Eval *eval,const CTransaction tx)
 {
     static secp256k1_context *ctx;
-    secp256k1_pubkey combined_pk; CPubKey pk,checkpk; secp256k1_schnorrsig musig; uint256 hashBlock; CTransaction vintx; int32_t numvouts; std::vector<uint8_t> musig64; uint8_t msg[32];
+    CPubKey pk,checkpk; uint256 hashBlock; CTransaction vintx; int32_t numvouts; std::vector<uint8_t> musig64; uint8_t msg[32];
     if ( ctx == 0 )
         ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    musig_blockbatch(ctx);
     if ( tx.vout.size() != 2 )
         return eval->Invalid("numvouts != 2");
     else if ( tx.vin.size() != 1 )
@@ -855,11 +1004,10 @@ bool musig_validate(struct CCcontract_info *cp,int32_t height,Eval *eval,const C
             {
                 if ( pk == checkpk )
                 {
-                    if ( secp256k1_schnorrsig_parse((const secp256k1_context *)ctx,&musig,(const uint8_t *)&musig64[0]) > 0 &&
-                        secp256k1_ec_pubkey_parse(ctx,&combined_pk,pk.begin(),33) > 0 )
+                    if ( musig64.size() == 64 )
                     {
                         musig_prevoutmsg(msg,tx.vin[0].prevout.hash,tx.vout[0].scriptPubKey);
-                        if ( !secp256k1_schnorrsig_verify((const secp256k1_context *)ctx,&musig,(const uint8_t *)msg,(const secp256k1_pubkey *)&combined_pk) )
+                        if ( musig_verifysig(ctx,msg,&musig64[0],pk) == 0 )
                             return eval->Invalid("failed schnorrsig_verify");
                         else return(true);
                     } else return eval->Invalid("couldnt parse pk or musig");
@@ -868,3 +1016,71 @@ bool musig_validate(struct CCcontract_info *cp,int32_t height,Eval *eval,const C
         } else return eval->Invalid("couldnt decode send opret");
     } else return eval->Invalid("couldnt find vin0 tx");
 }
+
+UniValue musig_bench(uint64_t txfee,struct CCcontract_info *cp,cJSON *params)
+{
+    static secp256k1_context *ctx;
+    UniValue result(UniValue::VOBJ),a(UniValue::VARR); std::vector<int32_t> sizes; std::vector<struct musig_batchitem> items; secp256k1_schnorrsig sig; secp256k1_pubkey spk; secp256k1_scratch *scratch; uint8_t seckey[32]; size_t clen; int32_t i,j,n,valid; int64_t t0,singletime,batchtime;
+    if ( ctx == 0 )
+        ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if ( params != 0 && (n= cJSON_GetArraySize(params)) > 0 )
+    {
+        for (i=0; i<n; i++)
+            if ( jint(jitem(params,i),0) > 0 )
+                sizes.push_back(jint(jitem(params,i),0));
+    }
+    else
+    {
+        sizes.push_back(1);
+        sizes.push_back(64);
+        sizes.push_back(1024);
+    }
+    for (j=0; j<sizes.size(); j++)
+    {
+        n = sizes[j];
+        items.resize(n);
+        for (i=0; i<n; i++)
+        {
+            do GetRandBytes(seckey,sizeof(seckey));
+            while ( secp256k1_ec_seckey_verify(ctx,seckey) == 0 );
+            GetRandBytes(items[i].msg,32);
+            clen = CPubKey::PUBLIC_KEY_SIZE;
+            if ( secp256k1_ec_pubkey_create(ctx,&spk,seckey) == 0 || secp256k1_ec_pubkey_serialize(ctx,(uint8_t *)items[i].pk.begin(),&clen,&spk,SECP256K1_EC_COMPRESSED) == 0 || secp256k1_schnorrsig_sign(ctx,&sig,NULL,items[i].msg,seckey,NULL,NULL) == 0 )
+                return(cclib_error(result,"error generating test signature"));
+            secp256k1_schnorrsig_serialize(ctx,items[i].musig64,&sig);
+        }
+        memset(seckey,0,sizeof(seckey));
+        // both paths bypass the verified cache
+        valid = 0;
+        t0 = GetTimeMicros();
+        for (i=0; i<n; i++)
+        {
+            secp256k1_schnorrsig_parse(ctx,&sig,items[i].musig64);
+            secp256k1_ec_pubkey_parse(ctx,&spk,items[i].pk.begin(),33);
+            valid += secp256k1_schnorrsig_verify(ctx,&sig,items[i].msg,&spk);
+        }
+        singletime = GetTimeMicros() - t0;
+        std::vector<secp256k1_schnorrsig> sigs(n); std::vector<secp256k1_pubkey> pks(n); std::vector<const secp256k1_schnorrsig *> sigptrs(n); std::vector<const uint8_t *> msgptrs(n); std::vector<const secp256k1_pubkey *> pkptrs(n);
+        t0 = GetTimeMicros();
+        for (i=0; i<n; i++)
+        {
+            secp256k1_schnorrsig_parse(ctx,&sigs[i],items[i].musig64);
+            secp256k1_ec_pubkey_parse(ctx,&pks[i],items[i].pk.begin(),33);
+            sigptrs[i] = &sigs[i], msgptrs[i] = items[i].msg, pkptrs[i] = &pks[i];
+        }
+        scratch = secp256k1_scratch_create(&ctx->error_callback,MUSIG_SCRATCHSIZE);
+        i = secp256k1_schnorrsig_verify_batch(ctx,scratch,&sigptrs[0],&msgptrs[0],&pkptrs[0],n);
+        secp256k1_scratch_destroy(scratch);
+        batchtime = GetTimeMicros() - t0;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("batchsize",n));
+        obj.push_back(Pair("valid",valid == n && i > 0));
+        obj.push_back(Pair("single_usec_per_sig",(double)singletime / n));
+        obj.push_back(Pair("batch_usec_per_sig",(double)batchtime / n));
+        obj.push_back(Pair("speedup",batchtime > 0 ? (double)singletime / batchtime : 0.));
+        a.push_back(obj);
+    }
+    result.push_back(Pair("result","success"));
+    result.push_back(Pair("benchmarks",a));
+    return(result);
+}
@@ -124,7 +124,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_ACTIVATES_UPGRADE  =   128, //! block activates a network upgrade
-    BLOCK_IN_TMPFILE         =   256 
+    BLOCK_IN_TMPFILE         =   256,
+    BLOCK_HAVE_SUPPLY        =   512, //! coin supply accounting (nBlockSupply) is stored in the block index
 };
 
 //! Short-hand for the highest consensus validity we implement.
@@ -133,6 +134,41 @@ static const BlockStatus BLOCK_VALID_CONSENSUS = BLOCK_VALID_SCRIPTS;
 
 class CBlockIndex;
 
+/** Coin supply accounting for a block, or for a chain of blocks up to and including one (see komodo_coinsupply) */
+struct CBlockSupply
+{
+    CAmount nSupply;        //! transparent coins created, as komodo_newcoins counts them
+    CAmount nZfunds;        //! net value moved from transparent into shielded pools
+    CAmount nSproutFunds;   //! net value moved from transparent into the Sprout pool
+    CAmount nBurned;        //! value sent to opreturns or the burn address
+    CAmount nInterest;      //! KMD interest claimed
+
+    CBlockSupply() : nSupply(0), nZfunds(0), nSproutFunds(0), nBurned(0), nInterest(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nSupply);
+        READWRITE(nZfunds);
+        READWRITE(nSproutFunds);
+        READWRITE(nBurned);
+        READWRITE(nInterest);
+    }
+
+    CBlockSupply& operator+=(const CBlockSupply& b)
+    {
+        nSupply += b.nSupply;
+        nZfunds += b.nZfunds;
+        nSproutFunds += b.nSproutFunds;
+        nBurned += b.nBurned;
+        nInterest += b.nInterest;
+        return *this;
+    }
+
+    friend CBlockSupply operator+(CBlockSupply a, const CBlockSupply& b) { a += b; return a; }
+};
+
 // This class provides an accumulator for both the chainwork and the chainPOS value
 // CChainPower's can be compared, and the comparison ensures that work and proof of stake power
 // are both used equally to determine which chain has the most work. This makes an attack
@@ -298,6 +334,14 @@ public:
     //! Will be boost::none if nChainTx is zero.
     boost::optional<CAmount> nChainSaplingValue;
 
+    //! Coin supply accounting for this block, set at ConnectBlock.
+    //! Only valid if nStatus has BLOCK_HAVE_SUPPLY, blocks connected by older nodes get it from BuildCoinSupplyIndex.
+    CBlockSupply nBlockSupply;
+
+    //! (memory only) Coin supply accounting up to and including this block.
+    //! Will be boost::none if this block or any of its ancestors is missing nBlockSupply.
+    boost::optional<CBlockSupply> nChainSupply;
+
     //! block header
     int nVersion;
     uint256 hashMerkleRoot;
@@ -333,6 +377,8 @@ public:
         nChainSproutValue = boost::none;
         nSaplingValue = 0;
         nChainSaplingValue = boost::none;
+        nBlockSupply = CBlockSupply();
+        nChainSupply = boost::none;
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -561,6 +607,16 @@ public:
             READWRITE(segid);
         }
         
+        // Kept last so that older clients, which stop reading after segid, can still load this index.
+        // They keep the status bit but drop nBlockSupply when they rewrite the entry, so an entry
+        // without it is read as having no accounting and BuildCoinSupplyIndex fills it in again.
+        if ((s.GetType() & SER_DISK) && (nStatus & BLOCK_HAVE_SUPPLY)) {
+            if (SupplyMissing(s, ser_action))
+                nStatus &= ~BLOCK_HAVE_SUPPLY;
+            else
+                READWRITE(nBlockSupply);
+        }
+
         /*if ( (s.GetType() & SER_DISK) && (is_STAKED(ASSETCHAINS_SYMBOL) != 0) && ASSETCHAINS_NOTARY_PAY[0] != 0 )
         {
             READWRITE(nNotaryPay);
@@ -568,6 +624,18 @@ public:
         }*/
     }
 
+    template <typename Stream>
+    bool SupplyMissing(Stream& s, CSerActionSerialize act)
+    {
+        return false;
+    }
+
+    template <typename Stream>
+    bool SupplyMissing(Stream& s, CSerActionUnserialize act)
+    {
+        return s.empty();
+    }
+
     uint256 GetBlockHash() const
     {
         CBlockHeader block;
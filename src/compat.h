@@ -58,7 +58,10 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
+// wait on sockets with poll(), which unlike select() is not limited to FD_SETSIZE descriptors
+#define USE_POLL
 #endif
 
 #ifdef _WIN32
@@ -109,7 +112,7 @@ size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
 bool static inline IsSelectableSocket(SOCKET s) {
-#ifdef _WIN32
+#if defined(_WIN32) || defined(USE_POLL)
     return true;
 #else
     return (s < FD_SETSIZE);
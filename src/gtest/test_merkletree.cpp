@@ -342,3 +342,83 @@ TEST(merkletree, testZeroElements) {
         ASSERT_TRUE(newTree.root() == oldroot);
     }
 }
+
+TEST(merkletree, appendBatchMatchesAppend) {
+    SproutMerkleTree tree;
+    std::vector<SproutWitness> witnesses;
+    std::vector<SproutWitness> batched;
+    witnesses.reserve(100);
+    batched.reserve(100);
+
+    // Witness every seventh commitment, bringing the existing witnesses
+    // up to date one at a time and as a batch before each new one.
+    std::vector<libzcash::SHA256Compress> run;
+    for (int i = 0; i < 700; i++) {
+        uint256 cm;
+        cm.begin()[0] = i & 0xff;
+        cm.begin()[1] = i >> 8;
+        tree.append(cm);
+        run.push_back(cm);
+
+        if (i % 7 == 0 || i == 699) {
+            for (SproutWitness& witness : witnesses) {
+                for (const libzcash::SHA256Compress& obj : run) {
+                    witness.append(obj);
+                }
+            }
+            std::vector<SproutWitness*> vBatch;
+            for (SproutWitness& witness : batched) {
+                vBatch.push_back(&witness);
+            }
+            SproutWitness::append_batch(vBatch, run);
+            run.clear();
+
+            for (size_t j = 0; j < witnesses.size(); j++) {
+                ASSERT_TRUE(batched[j] == witnesses[j]);
+                ASSERT_TRUE(batched[j].root() == tree.root());
+            }
+
+            witnesses.push_back(tree.witness());
+            batched.push_back(tree.witness());
+        }
+    }
+}
+
+TEST(merkletree, appendBatchMixedSizes) {
+    SproutMerkleTree tree;
+    std::vector<SproutWitness> witnesses;
+    std::vector<SproutWitness> batched;
+
+    // Take witnesses at several tree sizes and leave them behind
+    for (int i = 0; i < 40; i++) {
+        uint256 cm;
+        cm.begin()[0] = i;
+        tree.append(cm);
+        if (i % 5 == 0) {
+            witnesses.push_back(tree.witness());
+            batched.push_back(tree.witness());
+        }
+    }
+
+    // A batch of out of step witnesses matches appending to each one
+    std::vector<libzcash::SHA256Compress> run;
+    for (int i = 40; i < 80; i++) {
+        uint256 cm;
+        cm.begin()[0] = i;
+        run.push_back(cm);
+    }
+    for (SproutWitness& witness : witnesses) {
+        for (const libzcash::SHA256Compress& obj : run) {
+            witness.append(obj);
+        }
+    }
+    std::vector<SproutWitness*> vBatch;
+    for (SproutWitness& witness : batched) {
+        vBatch.push_back(&witness);
+    }
+    SproutWitness::append_batch(vBatch, run);
+
+    for (size_t j = 0; j < witnesses.size(); j++) {
+        ASSERT_TRUE(batched[j] == witnesses[j]);
+    }
+}
@@ -71,10 +71,16 @@ private:
     CWaitableCriticalSection cs;
     CConditionVariable cond;
     /* XXX in C++11 we can use std::unique_ptr here and avoid manual cleanup */
-    std::deque<WorkItem*> queue;
+    std::deque<std::pair<WorkItem*, int64_t> > queue; //!< items with their enqueue time
     bool running;
     size_t maxDepth;
     int numThreads;
+    /** Statistics for getrpcstats */
+    size_t peakDepth;
+    uint64_t numEnqueued;
+    uint64_t numRejected;
+    int64_t totalWaitMicros;
+    int64_t maxWaitMicros;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
@@ -97,7 +103,12 @@ private:
 public:
     WorkQueue(size_t maxDepth) : running(true),
                                  maxDepth(maxDepth),
-                                 numThreads(0)
+                                 numThreads(0),
+                                 peakDepth(0),
+                                 numEnqueued(0),
+                                 numRejected(0),
+                                 totalWaitMicros(0),
+                                 maxWaitMicros(0)
     {
     }
     /*( Precondition: worker threads have all stopped
@@ -106,7 +117,7 @@ public:
     ~WorkQueue()
     {
         while (!queue.empty()) {
-            delete queue.front();
+            delete queue.front().first;
             queue.pop_front();
         }
     }
@@ -115,9 +126,12 @@ public:
     {
         boost::unique_lock<boost::mutex> lock(cs);
         if (queue.size() >= maxDepth) {
+            numRejected++;
             return false;
         }
-        queue.push_back(item);
+        queue.push_back(std::make_pair(item, GetTimeMicros()));
+        numEnqueued++;
+        peakDepth = std::max(peakDepth, queue.size());
         cond.notify_one();
         return true;
     }
@@ -133,8 +147,11 @@ public:
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = queue.front();
+                i = queue.front().first;
+                int64_t waitMicros = GetTimeMicros() - queue.front().second;
                 queue.pop_front();
+                totalWaitMicros += waitMicros;
+                maxWaitMicros = std::max(maxWaitMicros, waitMicros);
             }
             (*i)();
             delete i;
@@ -161,6 +178,19 @@ public:
         boost::unique_lock<boost::mutex> lock(cs);
         return queue.size();
     }
+    /** Return depth and wait time statistics */
+    void GetStats(HTTPWorkQueueStats& stats)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        stats.depth = queue.size();
+        stats.maxDepth = maxDepth;
+        stats.peakDepth = peakDepth;
+        stats.numThreads = numThreads;
+        stats.numEnqueued = numEnqueued;
+        stats.numRejected = numRejected;
+        stats.totalWaitMicros = totalWaitMicros;
+        stats.maxWaitMicros = maxWaitMicros;
+    }
 };
 
 struct HTTPPathHandler
@@ -485,6 +515,14 @@ void InterruptHTTPServer()
         workQueue->Interrupt();
 }
 
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats)
+{
+    if (!workQueue)
+        return false;
+    workQueue->GetStats(stats);
+    return true;
+}
+
 void StopHTTPServer()
 {
     LogPrint("http", "Stopping HTTP server\n");
@@ -492,6 +530,7 @@ void StopHTTPServer()
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
         workQueue->WaitExit();
         delete workQueue;
+        workQueue = 0;
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -635,6 +674,158 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** State of a chunked reply, shared by the worker writing it and the main http thread */
+struct HTTPChunkState
+{
+    boost::mutex cs;
+    boost::condition_variable cond;
+    size_t nPending;   //!< bytes passed to WriteReplyChunk that are not sent yet
+    size_t nHanded;    //!< part of nPending already handed to libevent
+    bool fClosed;      //!< the connection is gone, the evhttp_request is freed
+
+    HTTPChunkState() : nPending(0), nHanded(0), fClosed(false) {}
+};
+
+/** Called by libevent once the connection's output buffer has been written out */
+static void http_chunk_written_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkState* state = (HTTPChunkState*)arg;
+    boost::lock_guard<boost::mutex> lock(state->cs);
+    state->nPending -= state->nHanded;
+    state->nHanded = 0;
+    state->cond.notify_all();
+}
+
+/** Called by libevent when the connection closes in the middle of a chunked reply */
+static void http_chunk_close_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkState* state = (HTTPChunkState*)arg;
+    boost::lock_guard<boost::mutex> lock(state->cs);
+    state->fClosed = true;
+    state->cond.notify_all();
+}
+
+void HTTPRequest::StartReplyChunks(int nStatus)
+{
+    assert(!replySent && req);
+    chunkState.reset(new HTTPChunkState());
+    // The chunk events are triggered in order on the main http thread. Each
+    // holds a reference to the state, which keeps it alive for the callbacks
+    // until EndReplyChunks or AbortReplyChunks unregisters them.
+    auto req_copy = req;
+    boost::shared_ptr<HTTPChunkState> state = chunkState;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus, state]{
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn)
+            evhttp_connection_set_closecb(conn, http_chunk_close_cb, state.get());
+        evhttp_send_reply_start(req_copy, nStatus, (const char*)NULL);
+    });
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && req && chunkState);
+    boost::shared_ptr<HTTPChunkState> state = chunkState;
+    size_t nSize = strChunk.size();
+    {
+        // Wait for the client to take what is queued before adding more
+        boost::unique_lock<boost::mutex> lock(state->cs);
+        boost::chrono::seconds timeout(GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT));
+        while (!state->fClosed && state->nPending >= HTTP_MAX_PENDING_CHUNK_BYTES) {
+            if (state->cond.wait_for(lock, timeout) == boost::cv_status::timeout) {
+                LogPrint("http", "Client stopped reading a chunked reply, dropping it\n");
+                return false;
+            }
+        }
+        if (state->fClosed)
+            return false;
+        state->nPending += nSize;
+    }
+
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), nSize);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb, nSize, state]{
+        bool fClosed;
+        {
+            boost::lock_guard<boost::mutex> lock(state->cs);
+            fClosed = state->fClosed;
+            if (!fClosed)
+                state->nHanded += nSize;
+        }
+        if (!fClosed)
+            evhttp_send_reply_chunk_with_cb(req_copy, evb, http_chunk_written_cb, state.get());
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+    return true;
+}
+
+bool HTTPRequest::ReplyChunksClosed()
+{
+    if (!chunkState)
+        return false;
+    boost::lock_guard<boost::mutex> lock(chunkState->cs);
+    return chunkState->fClosed;
+}
+
+void HTTPRequest::AbortReplyChunks()
+{
+    assert(!replySent && req && chunkState);
+    auto req_copy = req;
+    boost::shared_ptr<HTTPChunkState> state = chunkState;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, state]{
+        {
+            boost::lock_guard<boost::mutex> lock(state->cs);
+            if (state->fClosed)
+                return;
+            state->fClosed = true;
+        }
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, NULL, NULL);
+            evhttp_connection_free(conn);
+        }
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::EndReplyChunks()
+{
+    assert(!replySent && req && chunkState);
+    auto req_copy = req;
+    boost::shared_ptr<HTTPChunkState> state = chunkState;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, state]{
+        {
+            boost::lock_guard<boost::mutex> lock(state->cs);
+            if (state->fClosed)
+                return;
+        }
+        // The connection may outlive the request, stop it calling back into the state
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn)
+            evhttp_connection_set_closecb(conn, NULL, NULL);
+        evhttp_send_reply_end(req_copy);
+        // Re-enable reading from the socket, see WriteReply.
+        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+            if (conn) {
+                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+                if (bev) {
+                    bufferevent_enable(bev, EV_READ | EV_WRITE);
+                }
+            }
+        }
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -13,15 +13,19 @@
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Bytes of a chunked reply that may wait for the client before the writer blocks */
+static const size_t HTTP_MAX_PENDING_CHUNK_BYTES = 1024 * 1024;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPChunkState;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -37,6 +41,22 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Statistics of the HTTP work queue */
+struct HTTPWorkQueueStats
+{
+    size_t depth;            //!< items waiting now
+    size_t maxDepth;         //!< -rpcworkqueue
+    size_t peakDepth;        //!< most items waiting at once
+    int numThreads;          //!< running worker threads
+    uint64_t numEnqueued;    //!< items accepted
+    uint64_t numRejected;    //!< items rejected because the queue was full
+    int64_t totalWaitMicros; //!< time items waited for a worker, summed
+    int64_t maxWaitMicros;   //!< longest wait for a worker
+};
+
+/** Get statistics of the work queue, returns false if the server is not running */
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats);
+
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<void(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
 /** Register handler for prefix.
@@ -118,6 +138,30 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write a chunked HTTP reply, for large replies produced piece by piece.
+     * Call StartReplyChunks once, WriteReplyChunk any number of times and
+     * finish with EndReplyChunks, or with AbortReplyChunks on failure.
+     *
+     * WriteReplyChunk blocks while more than HTTP_MAX_PENDING_CHUNK_BYTES are
+     * waiting to be sent to the client. It returns false once the client has
+     * gone away or stopped reading for -rpcservertimeout seconds, and so does
+     * ReplyChunksClosed, so the caller can stop producing the reply.
+     *
+     * @note Headers must be written before StartReplyChunks. EndReplyChunks
+     * and AbortReplyChunks give the request back to the main thread like
+     * WriteReply does. AbortReplyChunks drops the connection without the
+     * final chunk, so the client can tell the reply is incomplete.
+     */
+    virtual void StartReplyChunks(int nStatus);
+    virtual bool WriteReplyChunk(const std::string& strChunk);
+    virtual void EndReplyChunks();
+    virtual void AbortReplyChunks();
+    bool ReplyChunksClosed();
+
+private:
+    boost::shared_ptr<HTTPChunkState> chunkState;
 };
 
 /** Event handler closure.
@@ -49,6 +49,7 @@
 #include "scheduler.h"
 #include "txdb.h"
 #include "torcontrol.h"
+#include "transaction_builder.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -380,6 +381,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 288));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
+    strUsage += HelpMessageOpt("-checkthreads=<n>", strprintf(_("Set the number of threads reading and checking blocks for -checkblocks (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+        1, MAX_SCRIPTCHECK_THREADS, DEFAULT_VERIFYDB_THREADS));
+    strUsage += HelpMessageOpt("-checktime=<n>", _("Stop the verification of -checkblocks after <n> seconds, 0 = no limit (default: 0)"));
     strUsage += HelpMessageOpt("-clientname=<SomeName>", _("Full node client name, default 'MagicBean'"));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), "komodo.conf"));
     if (mode == HMM_BITCOIND)
@@ -391,9 +395,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-exportdir=<dir>", _("Specify directory to be used when exporting data"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-coinssplitoutputs=<n>", strprintf(_("Store the unspent outputs of transactions with at least <n> outputs one record per outpoint, migrating existing chainstate on startup (0 = off, which merges existing per-outpoint records back so older versions can open the chainstate; default: %d)"), DEFAULT_COINS_SPLIT_OUTPUTS));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes, evicting the lowest fee rate packages first (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempooltxinputlimit=<n>", _("[DEPRECATED FROM OVERWINTER] Set the maximum number of transparent inputs in a transaction that the mempool will accept (default: 0 = no limit applied)"));
+    strUsage += HelpMessageOpt("-saplingbuilderthreads=<n>", strprintf(_("Set the number of threads deriving keys, nullifiers and note encryptions when building Sapling transactions (up to %d, 0 = one per core, <0 = leave that many cores free, default: %d)"),
+        MAX_SAPLING_BUILDER_THREADS, DEFAULT_SAPLING_BUILDER_THREADS));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef _WIN32
@@ -403,6 +411,9 @@ std::string HelpMessage(HelpMessageMode mode)
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files on startup"));
+    strUsage += HelpMessageOpt("-reindexbuffer=<n>", strprintf(_("Maximum MiB of blocks queued between the read, check and connect stages of -reindex and -loadblock (default: %u)"), DEFAULT_IMPORT_BUFFER_MB));
+    strUsage += HelpMessageOpt("-reindexthreads=<n>", strprintf(_("Set the number of threads verifying block headers during -reindex and -loadblock (%u to %d, 0 = auto, default: %d)"),
+        1, MAX_SCRIPTCHECK_THREADS, DEFAULT_IMPORT_CHECK_THREADS));
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -425,6 +436,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect)"));
     strUsage += HelpMessageOpt("-listenonion", strprintf(_("Automatically create Tor hidden service (default: %d)"), DEFAULT_LISTEN_ONION));
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
+    strUsage += HelpMessageOpt("-netthreads=<n>", strprintf(_("Number of threads sending and receiving peer data, each serving a share of the peers (1 to %d, default: %d)"), MAX_NET_THREADS, DEFAULT_NET_THREADS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
@@ -476,6 +488,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubcctx=<address>", _("Enable publish CC transactions by eval code and funcid in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubnotarisation=<address>", _("Enable publish notarisations in connected blocks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubaddressdelta=<address>", _("Enable publish address index deltas of transactions in <address>"));
+    strUsage += HelpMessageOpt("-zmqaddressfilter=<address>", _("Publish address deltas only for this address (can be specified multiple times)"));
 #endif
 
 #if ENABLE_PROTON
@@ -569,8 +585,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
-    // Disabled until we can lock notes and also tune performance of libsnark which by default uses multiple threads
-    //strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service Async RPC calls (default: %d)"), 1));
+    strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service Async RPC calls, inputs are reserved per operation so they can run concurrently (default: %d)"), DEFAULT_RPC_ASYNC_THREADS));
 
     if (mode == HMM_BITCOIND) {
         strUsage += HelpMessageGroup(_("Metrics Options (only if -daemon and -printtoconsole are not set):"));
@@ -736,6 +751,9 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    // one-time build of the coin supply accounting on upgrade, a no-op once every block has it
+    BuildCoinSupplyIndex();
 }
 
 void ThreadNotifyRecentlyAdded()
@@ -1094,7 +1112,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     //fprintf(stderr,"nMaxConnections %d\n",nMaxConnections);
+#ifndef USE_POLL
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+#endif
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     //fprintf(stderr,"nMaxConnections %d FD_SETSIZE.%d nBind.%d expr.%d \n",nMaxConnections,FD_SETSIZE,nBind,(int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
@@ -1282,6 +1302,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
 #endif
 
+    if (GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) < 1)
+        return InitError(_("-maxmempool must be at least 1 MB"));
+    if (GetArg("-rpcasyncthreads", DEFAULT_RPC_ASYNC_THREADS) < 1)
+        return InitError(_("-rpcasyncthreads must be at least 1"));
+
     // Default value of 0 for mempooltxinputlimit means no limit is applied
     if (mapArgs.count("-mempooltxinputlimit")) {
         int64_t limit = GetArg("-mempooltxinputlimit", 0);
@@ -1784,7 +1809,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 if ( KOMODO_REWIND == 0 )
                 {
                     if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 3),
-                                              GetArg("-checkblocks", 288))) {
+                                              GetArg("-checkblocks", 288), GetArg("-checktime", 0))) {
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
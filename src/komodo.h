@@ -820,6 +820,7 @@ int32_t komodo_connectblock(bool fJustCheck, CBlockIndex *pindex,CBlock& block)
     uint64_t signedmask,voutmask; char symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN]; struct komodo_state *sp;
     uint8_t scriptbuf[10001],pubkeys[64][33],rmd160[20],scriptPubKey[35]; uint256 zero,btctxid,txhash;
     int32_t i,j,k,numnotaries,notarized,scriptlen,isratification,nid,numvalid,specialtx,notarizedheight,notaryid,len,numvouts,numvins,height,txn_count;
+    const struct komodo_notaryset *notaryset;
     if ( pindex == 0 )
     {
         fprintf(stderr,"komodo_connectblock null pindex\n");
@@ -848,7 +849,9 @@ int32_t komodo_connectblock(bool fJustCheck, CBlockIndex *pindex,CBlock& block)
         }
     }
     numnotaries = komodo_notaries(pubkeys,pindex->GetHeight(),pindex->GetBlockTime());
-    calc_rmd160_sha256(rmd160,pubkeys[0],33);
+    if ( (notaryset= komodo_notaryset(pindex->GetHeight(),pindex->GetBlockTime())) != 0 )
+        memcpy(rmd160,notaryset->rmd160s[0],20);
+    else calc_rmd160_sha256(rmd160,pubkeys[0],33);
     if ( pindex->GetHeight() > hwmheight )
         hwmheight = pindex->GetHeight();
     else
@@ -18,8 +18,13 @@
 /*
  MAKE SURE YOU NTP sync your node, precise timestamps are assumed
  
- _functions() assume DEX_globalmutex is locked when it is called
- functions() assume that DEX_globalmutes is not locked when it is called and must lock/unlock to call _functions()
+ _functions() assume DEX_rwlock is held when it is called, for writing if they add, cancel or purge datablobs
+ functions() assume that DEX_rwlock is not held when it is called and must lock/unlock to call _functions()
+
+ locking:
+ DEX_rwlock protects the Hashtables ring, the four index hashtables with their lists, the slab pools and the lifetime of every datablob. Readers (DEX_list, DEX_orderbook, DEX_get, stats, pings and gets from peers, the ping pass of DEXpoll) share it, only adding, cancelling and purging take it exclusively. RPC readers copy what they need under the readlock and build the JSON after releasing it, so a long DEX_list doesnt stall the message handler.
+ the per datablob gossip state (peermask, numsent, requested) and G->Numrequested[modval] can be changed by readers, so it is partitioned by hash slot: DEX_slotmutex[modval % KOMODO_DEX_SLOTLOCKS] must also be held unless DEX_rwlock is held for writing. Only one slotmutex is ever held at a time and always after DEX_rwlock.
+ peermaps, Pendings and the static ping buffers are only touched from the message handler thread.
  
  message format: <relay depth> <funcid> <timestamp> <payload>
  
@@ -109,6 +114,15 @@ int32_t komodo_DEX_request(int32_t priority,uint32_t shorthash,uint32_t timestam
 #define KOMODO_DEX_STREAMSIZE 100
 #define KOMODO_DEX_ANONSIZE 1024
 
+#define KOMODO_DEX_SLABMIN 9    // smallest pooled datablob is 512 bytes, header included
+#define KOMODO_DEX_SLABMAX 16   // largest pooled datablob is 64KB, bigger ones are calloc'ed directly
+#define KOMODO_DEX_SLABDIRECT 0xff
+#define KOMODO_DEX_INDEXCARVE 256 // DEX_index entries are carved this many at a time and never released
+#define KOMODO_DEX_SLOTLOCKS 64 // gossip state of modval is guarded by DEX_slotmutex[modval % KOMODO_DEX_SLOTLOCKS]
+#define KOMODO_DEX_POWTHREADS 8 // max threads of a nonce search, the caller included
+#define KOMODO_DEX_POWBATCH 64  // nonces tried between timestamp refreshes, progress updates and cancel checks
+#define KOMODO_DEX_POWINLINE 4  // priorities below this expect so few tries that waking the pool costs more than it saves
+
 #define _komodo_DEXquotehash(hash,len) (uint32_t)(((hash).ulongs[0] >> (KOMODO_DEX_TXPOWBITS + komodo_DEX_sizepriority(len))))
 #define komodo_DEX_id(ptr) _komodo_DEXquotehash(ptr->hash,ptr->datalen)
 
@@ -124,7 +138,8 @@ struct DEX_datablob
     uint32_t recvtime,cancelled,lastlist,shorthash;
     int32_t datalen;
     int8_t priority,sizepriority;
-    uint8_t numsent,offset,linkmask,requested;
+    uint64_t seqid;
+    uint8_t numsent,offset,linkmask,requested,slabid;
     uint8_t data[];
 };
 
@@ -138,6 +153,15 @@ struct DEX_index
     uint8_t key[KOMODO_DEX_MAXKEYSIZE];
 } *DEX_destpubs,*DEX_tagAs,*DEX_tagBs,*DEX_tagABs;
 
+struct DEX_poolitem { struct DEX_poolitem *next; };
+
+struct DEX_pool
+{
+    struct DEX_poolitem *freelist;
+    int64_t inuse,numfree,peak,allocs,recycled,released;
+    int32_t itemsize,carve;
+};
+
 struct DEX_orderbookentry
 {
     bits256 hash;
@@ -151,12 +175,14 @@ struct DEX_orderbookentry
 static double DEX_lag,DEX_lag2,DEX_lag3;
 static int64_t DEX_totalsent,DEX_totalrecv,DEX_totaladd,DEX_duplicate,DEX_progress;
 static int64_t DEX_lookup32,DEX_collision32,DEX_add32,DEX_maxlag;
-static int64_t DEX_Numpending,DEX_freed,DEX_truncated;
+static int64_t DEX_Numpending,DEX_freed,DEX_truncated,DEX_skippedscan;
 // end perf metrics
 
 static uint32_t Got_Recent_Quote;
+static uint64_t DEX_seqid; // bumped for every added datablob, peers remember the last one they were pinged up to
 bits256 DEX_pubkey,GENESIS_PUBKEY,GENESIS_PRIVKEY;
-pthread_mutex_t DEX_globalmutex;
+pthread_rwlock_t DEX_rwlock;
+pthread_mutex_t DEX_slotmutex[KOMODO_DEX_SLOTLOCKS];
 
 static struct DEX_globals
 {
@@ -164,6 +190,8 @@ static struct DEX_globals
     uint32_t Pendings[KOMODO_DEX_MAXLAG * KOMODO_DEX_MAXPERSEC - 1];
     
     struct DEX_datablob *Hashtables[KOMODO_DEX_PURGETIME];
+    uint32_t Numrequested[KOMODO_DEX_PURGETIME]; // datablobs with requested > 0 force a full scan of their modval
+    struct DEX_pool Blobpools[KOMODO_DEX_SLABMAX+1],Indexpool;
 #if KOMODO_DEX_PURGELIST
     struct DEX_datablob *Purgelist[KOMODO_DEX_MAXPERSEC * KOMODO_DEX_MAXLAG];
     int32_t numpurges;
@@ -187,9 +215,25 @@ void komodo_DEX_init()
     {
         decode_hex(GENESIS_PUBKEY.bytes,sizeof(GENESIS_PUBKEY),GENESIS_PUBKEYSTR);
         decode_hex(GENESIS_PRIVKEY.bytes,sizeof(GENESIS_PRIVKEY),GENESIS_PRIVKEYSTR);
-        pthread_mutex_init(&DEX_globalmutex,0);
+#ifdef __GLIBC__
+        {
+            pthread_rwlockattr_t attr; // a steady stream of RPC readers must not starve adds and purges
+            pthread_rwlockattr_init(&attr);
+            pthread_rwlockattr_setkind_np(&attr,PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+            pthread_rwlock_init(&DEX_rwlock,&attr);
+            pthread_rwlockattr_destroy(&attr);
+        }
+#else
+        pthread_rwlock_init(&DEX_rwlock,0);
+#endif
+        for (modval=0; modval<KOMODO_DEX_SLOTLOCKS; modval++)
+            pthread_mutex_init(&DEX_slotmutex[modval],0);
         komodo_DEX_pubkeyupdate();
         G = (struct DEX_globals *)calloc(1,sizeof(*G));
+        for (modval=KOMODO_DEX_SLABMIN; modval<=KOMODO_DEX_SLABMAX; modval++)
+            G->Blobpools[modval].itemsize = (1 << modval);
+        G->Indexpool.itemsize = sizeof(struct DEX_index);
+        G->Indexpool.carve = KOMODO_DEX_INDEXCARVE;
         if ( (G->fp= fopen((char *)"DEX.log",(char *)"wb")) == 0 )
         {
             fprintf(stderr,"FATAL ERROR couldnt open DEX.log file\n");
@@ -200,12 +244,143 @@ void komodo_DEX_init()
     }
 }
 
+void komodo_DEX_slotlock(int32_t modval)
+{
+    pthread_mutex_lock(&DEX_slotmutex[modval % KOMODO_DEX_SLOTLOCKS]);
+}
+
+void komodo_DEX_slotunlock(int32_t modval)
+{
+    pthread_mutex_unlock(&DEX_slotmutex[modval % KOMODO_DEX_SLOTLOCKS]);
+}
+
+struct DEX_datablob *komodo_DEX_blobcopy(struct DEX_datablob *ptr)
+{
+    // snapshot of the immutable fields, for building JSON after DEX_rwlock is released. free() when done
+    struct DEX_datablob *copy;
+    if ( (copy= (struct DEX_datablob *)calloc(1,sizeof(*copy) + ptr->datalen)) != 0 )
+    {
+        copy->hash = ptr->hash;
+        copy->recvtime = ptr->recvtime;
+        copy->cancelled = ptr->cancelled;
+        copy->shorthash = ptr->shorthash;
+        copy->datalen = ptr->datalen;
+        copy->priority = ptr->priority;
+        copy->sizepriority = ptr->sizepriority;
+        copy->offset = ptr->offset;
+        copy->seqid = ptr->seqid;
+        copy->slabid = KOMODO_DEX_SLABDIRECT;
+        memcpy(copy->data,ptr->data,ptr->datalen);
+    }
+    return(copy);
+}
+
 uint32_t komodo_DEX_listid()
 {
     static uint32_t listid;
     return(++listid);
 }
 
+void *_komodo_DEX_poolget(struct DEX_pool *pool)
+{
+    struct DEX_poolitem *item; uint8_t *block; int32_t i;
+    if ( (item= pool->freelist) == 0 )
+    {
+        if ( pool->carve > 1 )
+        {
+            if ( (block= (uint8_t *)calloc(pool->carve,pool->itemsize)) == 0 )
+                return(0);
+            for (i=pool->carve-1; i>=0; i--)
+            {
+                item = (struct DEX_poolitem *)&block[i * pool->itemsize];
+                item->next = pool->freelist;
+                pool->freelist = item;
+            }
+            pool->numfree += pool->carve;
+            pool->allocs++;
+            item = pool->freelist;
+        }
+        else
+        {
+            if ( (item= (struct DEX_poolitem *)malloc(pool->itemsize)) == 0 )
+                return(0);
+            pool->allocs++;
+            pool->numfree++;
+            item->next = 0;
+        }
+    } else pool->recycled++;
+    pool->freelist = item->next;
+    pool->numfree--;
+    if ( ++pool->inuse > pool->peak )
+        pool->peak = pool->inuse;
+    return((void *)item);
+}
+
+void _komodo_DEX_poolput(struct DEX_pool *pool,void *ptr)
+{
+    struct DEX_poolitem *item = (struct DEX_poolitem *)ptr;
+    item->next = pool->freelist;
+    pool->freelist = item;
+    pool->numfree++;
+    pool->inuse--;
+}
+
+int32_t _komodo_DEX_pooltrim(struct DEX_pool *pool)
+{
+    // keep enough free items to cover the last window's high water mark, release the rest
+    struct DEX_poolitem *item; int32_t n = 0;
+    if ( pool->carve <= 1 )
+    {
+        while ( pool->numfree > 0 && pool->inuse + pool->numfree > pool->peak && (item= pool->freelist) != 0 )
+        {
+            pool->freelist = item->next;
+            pool->numfree--;
+            pool->released++;
+            free(item);
+            n++;
+        }
+    }
+    pool->peak = pool->inuse;
+    return(n);
+}
+
+struct DEX_datablob *_komodo_DEX_bloballoc(int32_t len)
+{
+    struct DEX_datablob *ptr; int32_t slabid,size = (int32_t)sizeof(*ptr) + len;
+    for (slabid=KOMODO_DEX_SLABMIN; slabid<=KOMODO_DEX_SLABMAX; slabid++)
+        if ( size <= (1 << slabid) )
+            break;
+    if ( slabid > KOMODO_DEX_SLABMAX )
+    {
+        if ( (ptr= (struct DEX_datablob *)calloc(1,size)) != 0 )
+            ptr->slabid = KOMODO_DEX_SLABDIRECT;
+        return(ptr);
+    }
+    if ( (ptr= (struct DEX_datablob *)_komodo_DEX_poolget(&G->Blobpools[slabid])) != 0 )
+    {
+        memset(ptr,0,size);
+        ptr->slabid = slabid;
+    }
+    return(ptr);
+}
+
+void _komodo_DEX_blobfree(struct DEX_datablob *ptr)
+{
+    if ( ptr->slabid >= KOMODO_DEX_SLABMIN && ptr->slabid <= KOMODO_DEX_SLABMAX )
+        _komodo_DEX_poolput(&G->Blobpools[ptr->slabid],ptr);
+    else free(ptr);
+    DEX_freed++;
+}
+
+int32_t _komodo_DEX_pooltrims()
+{
+    int32_t slabid,n = 0;
+    for (slabid=KOMODO_DEX_SLABMIN; slabid<=KOMODO_DEX_SLABMAX; slabid++)
+        n += _komodo_DEX_pooltrim(&G->Blobpools[slabid]);
+    _komodo_DEX_pooltrim(&G->Indexpool);
+    return(n);
+}
+
 int32_t komodo_DEX_islagging()
 {
     if ( (DEX_lag > DEX_lag2 && DEX_lag2 > DEX_lag3 && DEX_lag > KOMODO_DEX_MAXLAG/KOMODO_DEX_MAXHOPS && DEX_Numpending >= KOMODO_DEX_MAXPERSEC/2) || DEX_Numpending >= KOMODO_DEX_MAXPERSEC )
@@ -428,8 +603,7 @@ int32_t _komodo_DEX_purgeindex(int32_t ind,struct DEX_index *index,uint32_t cuto
 #if KOMODO_DEX_PURGELIST
                 G->Purgelist[G->numpurges++] = ptr;
 #else
-                free(ptr);
-                DEX_freed++;
+                _komodo_DEX_blobfree(ptr);
 #endif
              } // else fprintf(stderr,"%p ind.%d linkmask.%x\n",ptr,ind,ptr->linkmask);
              ptr = index->head;
@@ -465,6 +639,9 @@ int32_t _komodo_DEXpurge(uint32_t cutoff)
             if ( ptr->recvtime >= t )
                 lagsum += (ptr->recvtime - t);
             purgehash ^= ptr->shorthash;
+            if ( ptr->requested > 0 && G->Numrequested[modval] > 0 )
+                G->Numrequested[modval]--;
+            ptr->requested = 0;
             HASH_DELETE(hh,G->Hashtables[modval],ptr);
             ptr->datalen = 0;
             CLEARBIT(&ptr->linkmask,KOMODO_DEX_MAXINDICES);
@@ -480,7 +657,10 @@ int32_t _komodo_DEXpurge(uint32_t cutoff)
         totalhash = 0;
         total = 0;
         if ( (modval % 60) == 0 )
+        {
             totalhash = _komodo_DEXtotal(histo,total);
+            _komodo_DEX_pooltrims();
+        }
         fprintf(stderr,"%d: del.%d %08x, RAM.%d %08x R.%lld S.%lld A.%lld dup.%lld | L.%lld A.%lld coll.%lld | lag  %.3f (%.4f %.4f %.4f) err.%lld pend.%lld T/F %lld/%lld | ",modval,n,purgehash,total,totalhash,(long long)DEX_totalrecv,(long long)DEX_totalsent,(long long)DEX_totaladd,(long long)DEX_duplicate,(long long)DEX_lookup32,(long long)DEX_add32,(long long)DEX_collision32,n>0?(double)lagsum/n:0,DEX_lag,DEX_lag2,DEX_lag3,(long long)DEX_maxlag,(long long)DEX_Numpending,(long long)DEX_truncated,(long long)DEX_freed);
         for (i=13; i>=0; i--)
             fprintf(stderr,"%.0f ",(double)histo[i]);//1000.*histo[i]/(total+1)); // expected 1 1 2 5 | 10 10 10 10 10 | 10 9 9 7 5
@@ -539,8 +719,7 @@ int32_t _komodo_DEX_purgeindices(uint32_t cutoff)
                     G->Purgelist[i] = G->Purgelist[--G->numpurges];
                     G->Purgelist[G->numpurges] = 0;
                     i--;
-                    free(ptr);
-                    DEX_freed++;
+                    _komodo_DEX_blobfree(ptr);
                 } else fprintf(stderr,"ptr is still accessed? linkmask.%x\n",ptr->linkmask);
             }
         } else fprintf(stderr,"unexpected null ptr at %d of %d\n",i,G->numpurges);
@@ -594,12 +773,13 @@ struct DEX_index *_komodo_DEX_indexfind(int32_t ind,uint8_t *keybuf,int32_t keyl
 
 struct DEX_index *_komodo_DEX_indexcreate(int32_t ind,uint8_t *key,int8_t keylen,struct DEX_datablob *ptr)
 {
-    struct DEX_index *index = (struct DEX_index *)calloc(1,sizeof(*index));
+    struct DEX_index *index = (struct DEX_index *)_komodo_DEX_poolget(&G->Indexpool);
     if ( index == 0 )
     {
         fprintf(stderr,"out of memory\n");
         return(0);
     }
+    memset(index,0,sizeof(*index));
     memcpy(index->key,key,keylen);
     if ( 0 )
     {
@@ -837,8 +1017,9 @@ struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uin
     memset(tagB,0,sizeof(tagB));
     if ( (offset= komodo_DEX_extract(amountA,amountB,lenA,tagA,lenB,tagB,destpub33,plen,&msg[KOMODO_DEX_ROUTESIZE],len-KOMODO_DEX_ROUTESIZE)) < 0 )
         return(0);
-    if ( (ptr= (struct DEX_datablob *)calloc(1,sizeof(*ptr) + len)) != 0 )
+    if ( (ptr= _komodo_DEX_bloballoc(len)) != 0 )
     {
+        ptr->seqid = ++DEX_seqid;
         ptr->recvtime = now;
         ptr->hash = hash;
         ptr->shorthash = shorthash;
@@ -892,9 +1073,183 @@ int32_t komodo_DEXgenping(uint8_t funcid,std::vector<uint8_t> &ping,uint32_t tim
     return(len);
 }
 
+struct DEX_powstatus { volatile int32_t cancel,active,priority; uint32_t started; uint64_t tries,expected; };
+
+struct DEX_powsearch
+{
+    uint8_t *quote; int32_t len,priority,stride; uint32_t nonce0;
+    struct DEX_powstatus *status;
+    int32_t done; // 1 when solved, -1 when cancelled
+    bits256 hash; uint32_t timestamp,nonce;
+};
+
+static pthread_mutex_t DEX_powsearchmutex = PTHREAD_MUTEX_INITIALIZER; // one search owns the pool at a time
+static pthread_mutex_t DEX_powmutex = PTHREAD_MUTEX_INITIALIZER; // guards the job handoff, the solution and progress
+static pthread_cond_t DEX_powcond = PTHREAD_COND_INITIALIZER,DEX_powdonecond = PTHREAD_COND_INITIALIZER;
+static struct DEX_powsearch *DEX_powjob;
+static uint32_t DEX_powgen;
+static int32_t DEX_numpowthreads,DEX_powbusy;
+static int64_t DEX_powtries,DEX_powmicros;
+struct DEX_powstatus DEX_powcurrent;
+
+int32_t komodo_DEX_powvalid(uint64_t h,int32_t priority)
+{
+    int32_t j;
+    if ( (h & KOMODO_DEX_TXPOWMASK) != (0x777 & KOMODO_DEX_TXPOWMASK) )
+        return(0);
+    h >>= KOMODO_DEX_TXPOWBITS;
+    for (j=0; j<priority; j++,h>>=1)
+        if ( (h & 1) != 0 )
+            return(0);
+    return(1);
+}
+
+void _komodo_DEXpowscan(struct DEX_powsearch *job,int32_t slot)
+{
+    // the quote hash is sha256 over quote[1..len), so everything but the nonce at the end is folded into a
+    // midstate that only changes when the coarse timestamp does. the shared quote is never written here
+    struct sha256_vstate md,mdnonce; bits256 tmp,tmp2,hash; uint8_t buf[sizeof(uint32_t)]; uint32_t now,timestamp = 0,nonce = job->nonce0 + slot; int32_t i,done = 0;
+    while ( done == 0 )
+    {
+        if ( (now= (uint32_t)time(NULL)) != timestamp )
+        {
+            timestamp = now;
+            sha256_vinit(&md);
+            sha256_vprocess(&md,&job->quote[1],1);
+            iguana_rwnum(1,buf,sizeof(timestamp),&timestamp);
+            sha256_vprocess(&md,buf,sizeof(timestamp));
+            sha256_vprocess(&md,&job->quote[2 + sizeof(timestamp)],job->len - (2 + sizeof(timestamp)) - sizeof(nonce));
+        }
+        for (i=0; i<KOMODO_DEX_POWBATCH; i++,nonce+=job->stride)
+        {
+            mdnonce = md;
+            iguana_rwnum(1,buf,sizeof(nonce),&nonce);
+            sha256_vprocess(&mdnonce,buf,sizeof(nonce));
+            sha256_vdone(&mdnonce,tmp.bytes);
+            tmp2 = curve25519(tmp,curve25519_basepoint9());
+            vcalc_sha256(0,hash.bytes,tmp2.bytes,sizeof(tmp2));
+            if ( komodo_DEX_powvalid(hash.ulongs[0],job->priority) != 0 )
+                break;
+        }
+        pthread_mutex_lock(&DEX_powmutex);
+        if ( job->status != 0 )
+            job->status->tries += i + (i < KOMODO_DEX_POWBATCH);
+        DEX_powtries += i + (i < KOMODO_DEX_POWBATCH);
+        if ( job->done == 0 )
+        {
+            if ( i < KOMODO_DEX_POWBATCH )
+            {
+                job->done = 1;
+                job->hash = hash;
+                job->timestamp = timestamp;
+                job->nonce = nonce;
+            }
+            else if ( (job->status != 0 && job->status->cancel != 0) || ShutdownRequested() != 0 )
+                job->done = -1;
+        }
+        done = job->done;
+        pthread_mutex_unlock(&DEX_powmutex);
+    }
+}
+
+void *komodo_DEXpowloop(void *arg)
+{
+    int32_t slot = (int32_t)(long)arg; uint32_t gen = 0; struct DEX_powsearch *job;
+    pthread_mutex_lock(&DEX_powmutex);
+    while ( 1 )
+    {
+        while ( DEX_powgen == gen )
+            pthread_cond_wait(&DEX_powcond,&DEX_powmutex);
+        gen = DEX_powgen;
+        job = DEX_powjob;
+        pthread_mutex_unlock(&DEX_powmutex);
+        _komodo_DEXpowscan(job,slot);
+        pthread_mutex_lock(&DEX_powmutex);
+        if ( --DEX_powbusy == 0 )
+            pthread_cond_signal(&DEX_powdonecond);
+    }
+    return(0);
+}
+
+int32_t komodo_DEXpowsearch(uint8_t *quote,int32_t len,int32_t priority,struct DEX_powstatus *status)
+{
+    // finds a nonce for the last 4 bytes of quote so its hash meets KOMODO_DEX_TXPOWMASK and priority. the timestamp
+    // at quote[2] is refreshed once a second. returns 0 with the solution written into quote, -1 if cancelled
+    struct DEX_powsearch job; pthread_t tid; int64_t started = GetTimeMicros(); int32_t i,numthreads;
+    if ( len < 2 + sizeof(uint32_t)*2 )
+        return(-1);
+    memset(&job,0,sizeof(job));
+    job.quote = quote;
+    job.len = len;
+    job.priority = priority;
+    job.status = status;
+    job.nonce0 = rand();
+    pthread_mutex_lock(&DEX_powsearchmutex);
+    if ( DEX_numpowthreads == 0 )
+    {
+        numthreads = GetNumCores();
+        if ( numthreads > KOMODO_DEX_POWTHREADS )
+            numthreads = KOMODO_DEX_POWTHREADS;
+        for (i=1; i<numthreads; i++)
+        {
+            if ( pthread_create(&tid,NULL,komodo_DEXpowloop,(void *)(long)i) != 0 )
+                break;
+            pthread_detach(tid);
+        }
+        DEX_numpowthreads = i;
+    }
+    numthreads = (priority < KOMODO_DEX_POWINLINE) ? 1 : DEX_numpowthreads;
+    job.stride = numthreads;
+    if ( status != 0 )
+    {
+        pthread_mutex_lock(&DEX_powmutex);
+        status->active = 1;
+        status->cancel = 0; // reset together with active under DEX_powmutex, which komodo_DEXpowcancel also holds
+        status->priority = priority;
+        status->started = (uint32_t)time(NULL);
+        status->tries = 0;
+        status->expected = 1LL << (KOMODO_DEX_TXPOWBITS + (priority < 48 ? priority : 48));
+        pthread_mutex_unlock(&DEX_powmutex);
+    }
+    if ( numthreads > 1 )
+    {
+        pthread_mutex_lock(&DEX_powmutex);
+        DEX_powjob = &job;
+        DEX_powbusy = numthreads - 1;
+        DEX_powgen++;
+        pthread_cond_broadcast(&DEX_powcond);
+        pthread_mutex_unlock(&DEX_powmutex);
+    }
+    _komodo_DEXpowscan(&job,0);
+    pthread_mutex_lock(&DEX_powmutex);
+    while ( numthreads > 1 && DEX_powbusy > 0 )
+        pthread_cond_wait(&DEX_powdonecond,&DEX_powmutex);
+    DEX_powjob = 0;
+    DEX_powmicros += GetTimeMicros() - started;
+    if ( status != 0 )
+        status->active = 0;
+    pthread_mutex_unlock(&DEX_powmutex);
+    pthread_mutex_unlock(&DEX_powsearchmutex);
+    if ( job.done < 0 )
+        return(-1);
+    iguana_rwnum(1,&quote[2],sizeof(job.timestamp),&job.timestamp);
+    iguana_rwnum(1,&quote[len - sizeof(job.nonce)],sizeof(job.nonce),&job.nonce);
+    return(0);
+}
+
+int32_t komodo_DEXpowcancel()
+{
+    int32_t active;
+    pthread_mutex_lock(&DEX_powmutex);
+    active = DEX_powcurrent.active;
+    DEX_powcurrent.cancel = active;
+    pthread_mutex_unlock(&DEX_powmutex);
+    return(active);
+}
+
 int32_t komodo_DEXgenquote(uint8_t funcid,int32_t priority,bits256 &hash,uint32_t &shorthash,std::vector<uint8_t> &quote,uint32_t timestamp,uint8_t hdr[],int32_t hdrlen,uint8_t data[],int32_t datalen)
 {
-    int32_t i,j,len = 0; uint64_t h; uint32_t nonce = rand();
+    int32_t i,len = 0; uint32_t nonce = rand();
     quote.resize(2 + sizeof(uint32_t) + hdrlen + datalen + sizeof(nonce)); // send list of recently added shorthashes
     quote[len++] = KOMODO_DEX_RELAYDEPTH;
     quote[len++] = funcid;
@@ -908,29 +1263,9 @@ int32_t komodo_DEXgenquote(uint8_t funcid,int32_t priority,bits256 &hash,uint32_
     }
     len += sizeof(nonce);
 #if KOMODO_DEX_TXPOWMASK
-    for (i=0; i<0xffffffff; i++,nonce++)
-    {
-        timestamp = (uint32_t)time(NULL);
-        iguana_rwnum(1,&quote[2],sizeof(timestamp),&timestamp);
-        iguana_rwnum(1,&quote[len - sizeof(nonce)],sizeof(nonce),&nonce);
-        shorthash = komodo_DEXquotehash(hash,&quote[0],len);
-        h = hash.ulongs[0];
-        if ( (h & KOMODO_DEX_TXPOWMASK) == (0x777 & KOMODO_DEX_TXPOWMASK) )
-        {
-            h >>= KOMODO_DEX_TXPOWBITS;
-            for (j=0; j<priority; j++,h>>=1)
-                if ( (h & 1) != 0 )
-                    break;
-            if ( j < priority )
-            {
-                //fprintf(stderr,"i.%u j.%d failed priority.%d ulongs[0] %016llx\n",i,j,priority,(long long)hash.ulongs[0]);
-                continue;
-            }
-            if ( i > 10000000 )
-                fprintf(stderr,"nonce calc: i.%u j.%d priority.%d ulongs[0] %016llx\n",i,j,priority,(long long)hash.ulongs[0]);
-            break;
-        }
-    }
+    if ( komodo_DEXpowsearch(&quote[0],len,priority,&DEX_powcurrent) < 0 )
+        return(-1);
+    shorthash = komodo_DEXquotehash(hash,&quote[0],len);
 #else
     iguana_rwnum(1,&quote[len - sizeof(nonce)],sizeof(nonce),&nonce);
     shorthash = komodo_DEXquotehash(hash,&quote[0],len);
@@ -955,67 +1290,80 @@ int32_t komodo_DEXpacketsend(CNode *peer,uint8_t peerpos,struct DEX_datablob *pt
     return(ptr->datalen);
 }
 
-int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
+void _komodo_DEXmodval_item(uint32_t now,const int32_t modval,CNode *peer,uint16_t peerpos,struct DEX_datablob *ptr,uint32_t recents[16][KOMODO_DEX_MAXPERSEC],uint16_t num[16],int32_t &vip)
 {
-    static uint32_t recents[16][KOMODO_DEX_MAXPERSEC],sendbuf[KOMODO_DEX_MAXPING];
-    std::vector<uint8_t> packet; int32_t i,j,n=0,mult,p,vip=0,maxp=0,sum=0; uint16_t peerpos,num[16]; uint8_t priority,relay,funcid,*msg; uint32_t t,h; struct DEX_datablob *ptr=0,*tmp;
-    if ( modval < 0 || modval >= KOMODO_DEX_PURGETIME || (peerpos= _komodo_DEXpeerpos(now,peer->id)) == 0xffff )
-        return(-1);
-    memset(num,0,sizeof(num));
-    HASH_ITER(hh,G->Hashtables[modval],ptr,tmp)
+    int32_t p; uint8_t relay,*msg; uint32_t t;
+    if ( ptr->datalen >= KOMODO_DEX_ROUTESIZE && ptr->datalen < KOMODO_DEX_MAXPACKETSIZE )
     {
-        n++;
-        h = ptr->shorthash;
-        if ( ptr->datalen >= KOMODO_DEX_ROUTESIZE && ptr->datalen < KOMODO_DEX_MAXPACKETSIZE )
+        msg = &ptr->data[0];
+        relay = msg[0];
+        iguana_rwnum(0,&msg[2],sizeof(t),&t);
+        if ( now < t+KOMODO_DEX_MAXLAG || ptr->priority >= KOMODO_DEX_VIPLEVEL || ptr->requested > 0 ) //|| now < ptr->recvtime+KOMODO_DEX_MAXHOPS/2+1 )
         {
-            msg = &ptr->data[0];
-            relay = msg[0];
-            funcid = msg[1];
-            iguana_rwnum(0,&msg[2],sizeof(t),&t);
-            if ( now < t+KOMODO_DEX_MAXLAG || ptr->priority >= KOMODO_DEX_VIPLEVEL || ptr->requested > 0 ) //|| now < ptr->recvtime+KOMODO_DEX_MAXHOPS/2+1 )
+            if ( GETBIT(ptr->peermask,peerpos) == 0 || ptr->requested > 0 )
             {
-                if ( GETBIT(ptr->peermask,peerpos) == 0 || ptr->requested > 0 )
+                if ( (p= ptr->priority) >= 16 )
+                    p = 15;
+                if ( p < 0 )
                 {
-                    if ( (p= ptr->priority) >= 16 )
-                        p = 15;
-                    if ( p < 0 )
-                    {
-                        fprintf(stderr,"unexpected negative priority.%d\n",p);
-                        continue;
-                    }
-                    if ( p > maxp )
-                        maxp = p;
-                    if ( num[p] >= (int32_t)(sizeof(recents[p])/sizeof(*recents[p])) )
-                    {
-                        fprintf(stderr,"num[%d] %d is full\n",p,num[p]);
-                        continue;
-                    }
-                    /*if ( GETBIT(ptr->peermask,peerpos) == 0 && ptr->priority >= KOMODO_DEX_VIPLEVEL )
-                    {
-                        //fprintf(G->fp,"%08x ",ptr->shorthash);
-                        vip++;
-                    }*/
-                    recents[p][num[p]++] = h;
-                    if ( ptr->requested > 0 )
-                    {
-                        //fprintf(G->fp,"%08x.R%d.%d ",ptr->shorthash,ptr->requested,GETBIT(ptr->peermask,peerpos));
-                        ptr->requested--;
-                        vip++;
-                    }
-                    if ( ptr->numsent < KOMODO_DEX_MAXFANOUT )
+                    fprintf(stderr,"unexpected negative priority.%d\n",p);
+                    return;
+                }
+                if ( num[p] >= KOMODO_DEX_MAXPERSEC )
+                {
+                    fprintf(stderr,"num[%d] %d is full\n",p,num[p]);
+                    return;
+                }
+                recents[p][num[p]++] = ptr->shorthash;
+                if ( ptr->requested > 0 )
+                {
+                    //fprintf(G->fp,"%08x.R%d.%d ",ptr->shorthash,ptr->requested,GETBIT(ptr->peermask,peerpos));
+                    if ( --ptr->requested == 0 && G->Numrequested[modval] > 0 )
+                        G->Numrequested[modval]--;
+                    vip++;
+                }
+                if ( ptr->numsent < KOMODO_DEX_MAXFANOUT )
+                {
+                    if ( (relay >= 0 && relay <= KOMODO_DEX_RELAYDEPTH && now < t+KOMODO_DEX_LOCALHEARTBEAT) )
                     {
-                        if ( (relay >= 0 && relay <= KOMODO_DEX_RELAYDEPTH && now < t+KOMODO_DEX_LOCALHEARTBEAT) )
+                        if ( komodo_DEX_islagging() == 0 )
                         {
-                            if ( komodo_DEX_islagging() == 0 )
-                            {
-                                komodo_DEXpacketsend(peer,peerpos,ptr,ptr->data[0]);
-                                ptr->numsent++;
-                            }
+                            komodo_DEXpacketsend(peer,peerpos,ptr,ptr->data[0]);
+                            ptr->numsent++;
                         }
                     }
                 }
             }
-        } else fprintf(stderr,"ptr.%p %08x with illegal size %d\n",ptr,ptr->shorthash,ptr->datalen);
+        }
+    } else fprintf(stderr,"ptr.%p %08x with illegal size %d\n",ptr,ptr->shorthash,ptr->datalen);
+}
+
+// fullscan == 0 only visits the datablobs added since this peer's previous incremental ping (seqid > lastseq), walking back from the tail of the modval hashtable. Datablobs that need to be pinged again (VIP, requested, peerclear) are picked up by the periodic fullscan and by the modvals with pending requests
+
+int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer,int32_t fullscan,uint64_t lastseq)
+{
+    static uint32_t recents[16][KOMODO_DEX_MAXPERSEC],sendbuf[KOMODO_DEX_MAXPING];
+    std::vector<uint8_t> packet; int32_t i,n=0,mult,p,vip=0,sum=0; uint16_t peerpos,num[16]; struct DEX_datablob *ptr=0,*tmp; UT_hash_table *tbl;
+    if ( modval < 0 || modval >= KOMODO_DEX_PURGETIME || (peerpos= _komodo_DEXpeerpos(now,peer->id)) == 0xffff )
+        return(-1);
+    memset(num,0,sizeof(num));
+    if ( fullscan != 0 || G->Numrequested[modval] != 0 )
+    {
+        HASH_ITER(hh,G->Hashtables[modval],ptr,tmp)
+        {
+            n++;
+            _komodo_DEXmodval_item(now,modval,peer,peerpos,ptr,recents,num,vip);
+        }
+    }
+    else if ( G->Hashtables[modval] != 0 )
+    {
+        tbl = G->Hashtables[modval]->hh.tbl;
+        for (ptr=(struct DEX_datablob *)ELMT_FROM_HH(tbl,tbl->tail); ptr!=0 && ptr->seqid>lastseq; ptr=(struct DEX_datablob *)ptr->hh.prev)
+        {
+            n++;
+            _komodo_DEXmodval_item(now,modval,peer,peerpos,ptr,recents,num,vip);
+        }
+        DEX_skippedscan += (HASH_COUNT(G->Hashtables[modval]) - n);
     }
     if ( vip != 0 )
     {
@@ -1161,7 +1509,7 @@ int32_t _komodo_DEX_cancelpubkey(char *tagA,char *tagB,uint8_t *cancelkey33,uint
 int32_t _komodo_DEX_locatorsextract(int32_t sendflag,uint32_t shorthash,int32_t modval,int32_t priority)
 {
     static bits256 zero;
-    uint8_t *allocated=0,*decoded; int32_t i,j,n=0,numrequests,newlen=0; bits256 senderpub; uint64_t locator; struct DEX_datablob *refptr,*ptr;
+    uint8_t *allocated=0,*decoded; int32_t i,j,n=0,numrequests,newlen=0,m; bits256 senderpub; uint64_t locator; struct DEX_datablob *refptr,*ptr;
     if ( (refptr= _komodo_DEXfind(modval,shorthash)) == 0 )
         return(-1);
     if ( (decoded= komodo_DEX_datablobdecrypt(&senderpub,&allocated,&newlen,refptr,zero,(char *)"")) != 0 && (newlen & 7) == 0 )
@@ -1172,9 +1520,14 @@ int32_t _komodo_DEX_locatorsextract(int32_t sendflag,uint32_t shorthash,int32_t
         for (i=sizeof(uint64_t),j=0; i<newlen; i+=8,j++)
         {
             iguana_rwnum(0,&decoded[j*8 + 8],sizeof(locator),&locator);
-            if ( (ptr= _komodo_DEXfind((int32_t)(locator >> 32) % KOMODO_DEX_PURGETIME,(uint32_t)locator)) != 0 )
+            m = (int32_t)(locator >> 32) % KOMODO_DEX_PURGETIME;
+            if ( (ptr= _komodo_DEXfind(m,(uint32_t)locator)) != 0 )
             {
+                komodo_DEX_slotlock(m);
+                if ( ptr->requested == 0 )
+                    G->Numrequested[m]++;
                 ptr->requested = numrequests;
+                komodo_DEX_slotunlock(m);
                 //fprintf(stderr,"%u ",ptr->shorthash);
                 n++;
             }
@@ -1374,6 +1727,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                 offset += iguana_rwnum(0,&msg[offset],sizeof(m),&m);
                 if ( offset+n*sizeof(uint32_t) == len && m >= 0 && m < KOMODO_DEX_PURGETIME )
                 {
+                    komodo_DEX_slotlock(m);
                     for (flag=i=0; i<n; i++)
                     {
                         offset += iguana_rwnum(0,&msg[offset],sizeof(h),&h);
@@ -1404,6 +1758,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                         }
                         //fprintf(G->fp,"%d/%08x ",m,h);
                     }
+                    komodo_DEX_slotunlock(m);
                     if ( (0) && flag != 0 )
                     {
                         fprintf(stderr," f.%c t.%u [%d] ",funcid,t,relay);
@@ -1632,15 +1987,15 @@ UniValue komodo_DEX_dataobj(struct DEX_datablob *ptr)
     return(item);
 }
 
-UniValue _komodo_DEXget(uint32_t shorthash)
+struct DEX_datablob *_komodo_DEXget(uint32_t shorthash)
 {
-    UniValue result; int32_t modval; struct DEX_datablob *ptr;
+    int32_t modval; struct DEX_datablob *ptr;
     for (modval=0; modval<KOMODO_DEX_PURGETIME; modval++)
     {
         if ( (ptr= _komodo_DEXfind(modval,shorthash)) != 0 )
-            return(komodo_DEX_dataobj(ptr));
+            return(komodo_DEX_blobcopy(ptr));
     }
-    return(result);
+    return(0);
 }
 
 UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int32_t priority,char *tagA,char *tagB,char *destpub33,char *volA,char *volB)
@@ -1758,7 +2113,7 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
             memset(priv0.bytes,0,sizeof(priv0));
         } else payload2 = payload;
         explen = (int32_t)(KOMODO_DEX_ROUTESIZE + len + datalen + sizeof(uint32_t));
-        if ( (m= komodo_DEXgenquote(funcid,KOMODO_DEX_BLAST + priority + komodo_DEX_sizepriority(explen),hash,shorthash,packet,timestamp,quote,len,payload2,datalen)) != explen )
+        if ( (m= komodo_DEXgenquote(funcid,KOMODO_DEX_BLAST + priority + komodo_DEX_sizepriority(explen),hash,shorthash,packet,timestamp,quote,len,payload2,datalen)) != explen && m >= 0 )
             fprintf(stderr,"unexpected packetsize n.%d != %d\n",m,explen);
         if ( allocated != 0 )
         {
@@ -1771,6 +2126,11 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
                 free(payload);
             payload = 0;
         }
+        if ( m < 0 )
+        {
+            fprintf(stderr,"nonce search cancelled\n");
+            return(0);
+        }
         if ( blastflag != 0 && komodo_DEX_priority(hash.ulongs[0],explen) > priority + KOMODO_DEX_BLAST )
         {
             //fprintf(stderr,"skip harder than specified %d vs %d\n",komodo_DEX_priority(hash.ulongs[0],explen), priority + iter + komodo_DEX_sizepriority(explen));
@@ -1782,7 +2142,7 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
             return(0);
         }
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            pthread_rwlock_wrlock(&DEX_rwlock);
             iguana_rwnum(0,&packet[2],sizeof(timestamp),&timestamp);
             modval = (timestamp % KOMODO_DEX_PURGETIME);
             if ( (ptr= _komodo_DEXfind(modval,shorthash)) == 0 )
@@ -1802,7 +2162,7 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
                     fprintf(stderr," cant issue duplicate order modval.%d t.%u %08x %016llx\n",modval,timestamp,shorthash,(long long)hash.ulongs[0]);
                 srand((int32_t)timestamp);
             }
-            pthread_mutex_unlock(&DEX_globalmutex);
+            pthread_rwlock_unlock(&DEX_rwlock);
         }
         if ( blastflag == 0 )
             break;
@@ -1811,7 +2171,9 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
     if ( blastflag == 0 && ptr != 0 )
     {
         usleep(1000);
+        pthread_rwlock_rdlock(&DEX_rwlock);
         result = komodo_DEX_dataobj(ptr);
+        pthread_rwlock_unlock(&DEX_rwlock);
         if ( locatorp != 0 )
         {
             iguana_rwnum(0,&ptr->data[2],sizeof(timestamp),&timestamp);
@@ -1821,6 +2183,41 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
     } else return(0);
 }
 
+// adds a quote to the local datablobs only, for benchmarks: there is no nonce search, and the blob is marked as already known to every peer and fully sent, so it is never pinged or relayed
+int32_t komodo_DEXlocalquote(char *tagA,char *tagB,uint64_t amountA,uint64_t amountB,uint8_t *data,int32_t datalen)
+{
+    std::vector<uint8_t> packet; struct DEX_datablob *ptr; bits256 hash; uint32_t shorthash,timestamp,nonce; int32_t i,len=0,slenA,slenB,modval;
+    if ( tagA == 0 || tagB == 0 || (slenA= (int32_t)strlen(tagA)) >= KOMODO_DEX_TAGSIZE || (slenB= (int32_t)strlen(tagB)) >= KOMODO_DEX_TAGSIZE )
+        return(-1);
+    timestamp = (uint32_t)time(NULL);
+    nonce = rand();
+    packet.resize(KOMODO_DEX_ROUTESIZE + sizeof(amountA) + sizeof(amountB) + 3 + slenA + slenB + datalen + sizeof(nonce));
+    packet[len++] = 0;
+    packet[len++] = 'Q';
+    len += iguana_rwnum(1,&packet[len],sizeof(timestamp),&timestamp);
+    len += iguana_rwnum(1,&packet[len],sizeof(amountA),&amountA);
+    len += iguana_rwnum(1,&packet[len],sizeof(amountB),&amountB);
+    packet[len++] = 0;
+    packet[len++] = slenA;
+    memcpy(&packet[len],tagA,slenA), len += slenA;
+    packet[len++] = slenB;
+    memcpy(&packet[len],tagB,slenB), len += slenB;
+    for (i=0; i<datalen; i++)
+        packet[len++] = data[i];
+    len += iguana_rwnum(1,&packet[len],sizeof(nonce),&nonce);
+    shorthash = komodo_DEXquotehash(hash,&packet[0],len);
+    hash.ulongs[0] = (hash.ulongs[0] & ~KOMODO_DEX_TXPOWMASK) | (0x777 & KOMODO_DEX_TXPOWMASK); // the shorthash is above the pow bits
+    modval = (timestamp % KOMODO_DEX_PURGETIME);
+    pthread_rwlock_wrlock(&DEX_rwlock);
+    if ( _komodo_DEXfind(modval,shorthash) == 0 && (ptr= _komodo_DEXadd(timestamp,modval,hash,shorthash,&packet[0],len)) != 0 )
+    {
+        memset(ptr->peermask,0xff,sizeof(ptr->peermask));
+        ptr->numsent = KOMODO_DEX_MAXFANOUT;
+    } else len = -1;
+    pthread_rwlock_unlock(&DEX_rwlock);
+    return(len);
+}
+
 int32_t _komodo_DEX_gettips(struct DEX_index *tips[KOMODO_DEX_MAXINDICES],int8_t &lenA,char *tagA,int8_t &lenB,char *tagB,int8_t &plen,uint8_t *destpub,char *destpub33,uint64_t &minamountA,char *minA,uint64_t &maxamountA,char *maxA,uint64_t &minamountB,char *minB,uint64_t &maxamountB,char *maxB)
 {
     memset(tips,0,sizeof(*tips)*KOMODO_DEX_MAXINDICES);
@@ -1914,21 +2311,15 @@ int32_t komodo_DEX_ptrfilter(uint64_t &amountA,uint64_t &amountB,struct DEX_data
     return(skipflag);
 }
 
-UniValue _komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB,char *stophashstr)
+int32_t _komodo_DEXlist(std::vector<struct DEX_datablob *> &snapshot,uint32_t stopat,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB,char *stophashstr)
 {
-    UniValue result(UniValue::VOBJ),a(UniValue::VARR);  struct DEX_datablob *ptr; int32_t err,ind,n=0,skipflag; bits256 stophash; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33]; uint32_t thislist;
+    struct DEX_datablob *ptr; int32_t err,ind,n=0,skipflag; bits256 stophash; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33]; std::set<struct DEX_datablob *> listed;
     if ( stophashstr != 0 && is_hexstr(stophashstr,0) == 64 )
         decode_hex(stophash.bytes,32,stophashstr);
     else memset(stophash.bytes,0,32);
     //fprintf(stderr,"DEX_list (%s) (%s)\n",tagA,tagB);
     if ( (err= _komodo_DEX_gettips(tips,lenA,tagA,lenB,tagB,plen,destpub,destpub33,minamountA,minA,maxamountA,maxA,minamountB,minB,maxamountB,maxB)) < 0 )
-    {
-        result.push_back(Pair((char *)"result",(char *)"error"));
-        result.push_back(Pair((char *)"errcode",err));
-        return(result);
-    }
-    thislist = komodo_DEX_listid();
-    n = 0;
+        return(err);
     for (ind=0; ind<KOMODO_DEX_MAXINDICES; ind++)
     {
         if ( (index= tips[ind]) != 0 )
@@ -1938,11 +2329,10 @@ UniValue _komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *ta
                 if ( (stopat != 0 && komodo_DEX_id(ptr) == stopat) || memcmp(stophash.bytes,ptr->hash.bytes,32) == 0 )
                     break;
                 skipflag = komodo_DEX_ptrfilter(amountA,amountB,ptr,minpriority,lenA,tagA,lenB,tagB,plen,destpub,minamountA,maxamountA,minamountB,maxamountB);
-                if ( skipflag == 0 && ptr->lastlist != thislist )
+                if ( skipflag == 0 && listed.insert(ptr).second != 0 )
                 {
-                    ptr->lastlist = thislist;
                     //fprintf(stderr,"%u ",ptr->shorthash);
-                    a.push_back(komodo_DEX_dataobj(ptr));
+                    snapshot.push_back(komodo_DEX_blobcopy(ptr));
                     n++;
                 }
                 if ( ptr == index->head )
@@ -1950,14 +2340,7 @@ UniValue _komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *ta
             }
         }
     }
-    //fprintf(stderr,"ids\n");
-    result.push_back(Pair((char *)"result",(char *)"success"));
-    result.push_back(Pair((char *)"matches",a));
-    result.push_back(Pair((char *)"tagA",tagA));
-    result.push_back(Pair((char *)"tagB",tagB));
-    result.push_back(Pair((char *)"pubkey",destpub33));
-    result.push_back(Pair((char *)"n",n));
-    return(result);
+    return(n);
 }
 
 // orderbook support
@@ -2077,25 +2460,14 @@ struct DEX_orderbookentry *DEX_orderbookentry(struct DEX_datablob *ptr,int32_t r
     return(op);
 }
 
-UniValue _komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB)
+int32_t _komodo_DEXorderbook(std::vector<struct DEX_orderbookentry *> &orders,int32_t revflag,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB)
 {
-    UniValue result(UniValue::VOBJ),a(UniValue::VARR); struct DEX_orderbookentry *op; std::vector<struct DEX_orderbookentry *>orders; struct DEX_datablob *ptr; uint32_t thislist; int32_t i,err,ind,n=0,skipflag; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33];
-    if ( maxentries <= 0 )
-        maxentries = 10;
-    if ( tagA[0] == 0 || tagB[0] == 0 )
-    {
-        fprintf(stderr,"need both tagA and tagB to specify base/rel for orderbook\n");
-        result.push_back(Pair((char *)"result",(char *)"error"));
-        result.push_back(Pair((char *)"errcode",-13));
-        return(result);
-    }
+    struct DEX_orderbookentry *op; struct DEX_datablob *ptr; int32_t err,ind,n=0,skipflag; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33]; std::set<struct DEX_datablob *> listed;
     if ( (err= _komodo_DEX_gettips(tips,lenA,tagA,lenB,tagB,plen,destpub,destpub33,minamountA,minA,maxamountA,maxA,minamountB,minB,maxamountB,maxB)) < 0 )
     {
         //fprintf(stderr,"couldnt find any\n");
-        return(a);
+        return(err);
     }
-    thislist = komodo_DEX_listid();
-    n = 0;
     for (ind=KOMODO_DEX_MAXINDICES-1; ind<KOMODO_DEX_MAXINDICES; ind++) // only need tagABs
     {
         if ( (index= tips[ind]) != 0 )
@@ -2105,32 +2477,20 @@ UniValue _komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minprio
                 skipflag = komodo_DEX_ptrfilter(amountA,amountB,ptr,minpriority,lenA,tagA,lenB,tagB,plen,destpub,minamountA,maxamountA,minamountB,maxamountB);
                 if ( skipflag == 0 && ptr->cancelled == 0 && amountA != 0 && amountB != 0 )
                 {
-                    if ( ptr->lastlist != thislist && (op= DEX_orderbookentry(ptr,revflag,tagA,tagB)) != 0 ) //
+                    if ( listed.count(ptr) == 0 && (op= DEX_orderbookentry(ptr,revflag,tagA,tagB)) != 0 ) //
                     {
-                        //fprintf(stderr,"ADD n.%d lastlist.%u vs %u\n",n,ptr->lastlist,thislist);
-                        ptr->lastlist = thislist;
+                        //fprintf(stderr,"ADD n.%d\n",n);
+                        listed.insert(ptr);
                         orders.push_back(op);
                         n++;
-                    } else fprintf(stderr,"skip ptr->lastlist.%u vs thislist.%d\n",ptr->lastlist,thislist);
+                    } else fprintf(stderr,"skip ptr.%p already listed\n",ptr);
                 } //else fprintf(stderr,"skipflag.%d cancelled.%u plen.%d amountA %.8f amountB %.8f\n",skipflag,ptr->cancelled,plen,dstr(amountA),dstr(amountB));
                 if ( ptr == index->head )
                     break;
             }
         }
     }
-    if ( n > 0 )
-    {
-        //fprintf(stderr,"sort %d orders for %s/%s\n",n,tagA,tagB);
-        qsort(&orders[0],n,sizeof(struct DEX_orderbookentry *),revflag != 0 ? _revcmp_orderbook : _cmp_orderbook);
-        for (i=0; i<maxentries&&i<n; i++)
-        {
-            a.push_back(DEX_orderbookjson(orders[i]));
-            free(orders[i]);
-        }
-        for (; i<n; i++)
-            free(orders[i]);
-    }
-    return(a);
+    return(n);
 }
 
 // general stats
@@ -2138,9 +2498,14 @@ UniValue _komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minprio
 UniValue komodo_DEX_stats()
 {
     static uint32_t lastadd,lasttime;
-    UniValue result(UniValue::VOBJ); char str[65],pubstr[67],logstr[1024],recvaddr[64],*taddr; int32_t i,total,histo[64]; uint32_t now,totalhash,d;
+    UniValue result(UniValue::VOBJ),pools(UniValue::VARR),peers(UniValue::VARR); char str[65],pubstr[67],logstr[1024],recvaddr[64],*taddr; int32_t i,total,histo[64]; uint32_t now,totalhash,d; int64_t pooled=0; std::vector<std::pair<NodeId,uint64_t> > peerseqs;
     pubkey2addr(recvaddr,NOTARY_PUBKEY33);
-    pthread_mutex_lock(&DEX_globalmutex);
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode *pnode,vNodes)
+            peerseqs.push_back(std::make_pair(pnode->id,pnode->dexlastseq));
+    }
+    pthread_rwlock_rdlock(&DEX_rwlock);
     now = (uint32_t)time(NULL);
     bits256_str(pubstr+2,DEX_pubkey);
     pubstr[0] = '0';
@@ -2158,6 +2523,19 @@ UniValue komodo_DEX_stats()
     result.push_back(Pair((char *)"cmdpriority",(int64_t)KOMODO_DEX_CMDPRIORITY));
     if ( DEX_progress >= 0 )
         result.push_back(Pair((char *)"progress",(double)DEX_progress/100.));
+    pthread_mutex_lock(&DEX_powmutex);
+    result.push_back(Pair((char *)"powthreads",(int64_t)DEX_numpowthreads));
+    result.push_back(Pair((char *)"powrate",DEX_powmicros > 0 ? (double)DEX_powtries * 1000000. / DEX_powmicros : 0.));
+    if ( DEX_powcurrent.active != 0 )
+    {
+        UniValue pow(UniValue::VOBJ);
+        pow.push_back(Pair((char *)"priority",(int64_t)DEX_powcurrent.priority));
+        pow.push_back(Pair((char *)"tries",(int64_t)DEX_powcurrent.tries));
+        pow.push_back(Pair((char *)"expected",(int64_t)DEX_powcurrent.expected));
+        pow.push_back(Pair((char *)"elapsed",(int64_t)(now - DEX_powcurrent.started)));
+        result.push_back(Pair((char *)"powsearch",pow));
+    }
+    pthread_mutex_unlock(&DEX_powmutex);
     memset(histo,0,sizeof(histo));
     totalhash = _komodo_DEXtotal(histo,total);
     sprintf(logstr,"RAM.%d %08x R.%lld S.%lld A.%lld dup.%lld | L.%lld A.%lld coll.%lld | lag (%.4f %.4f %.4f) err.%lld pend.%lld T/F %lld/%lld | ",total,totalhash,(long long)DEX_totalrecv,(long long)DEX_totalsent,(long long)DEX_totaladd,(long long)DEX_duplicate,(long long)DEX_lookup32,(long long)DEX_add32,(long long)DEX_collision32,DEX_lag,DEX_lag2,DEX_lag3,(long long)DEX_maxlag,(long long)DEX_Numpending,(long long)DEX_truncated,(long long)DEX_freed);
@@ -2169,7 +2547,33 @@ UniValue komodo_DEX_stats()
     lasttime = now;
     lastadd = DEX_totaladd;
     result.push_back(Pair((char *)"perfstats",logstr));
-    pthread_mutex_unlock(&DEX_globalmutex);
+    for (i=KOMODO_DEX_SLABMIN; i<=KOMODO_DEX_SLABMAX+1; i++)
+    {
+        UniValue item(UniValue::VOBJ); struct DEX_pool *pool = (i <= KOMODO_DEX_SLABMAX) ? &G->Blobpools[i] : &G->Indexpool;
+        item.push_back(Pair((char *)"itemsize",(int64_t)pool->itemsize));
+        item.push_back(Pair((char *)"inuse",(int64_t)pool->inuse));
+        item.push_back(Pair((char *)"free",(int64_t)pool->numfree));
+        item.push_back(Pair((char *)"peak",(int64_t)pool->peak));
+        item.push_back(Pair((char *)"allocs",(int64_t)pool->allocs));
+        item.push_back(Pair((char *)"recycled",(int64_t)pool->recycled));
+        item.push_back(Pair((char *)"released",(int64_t)pool->released));
+        if ( pool == &G->Indexpool )
+            item.push_back(Pair((char *)"pool",(char *)"index"));
+        pooled += (pool->inuse + pool->numfree) * pool->itemsize;
+        pools.push_back(item);
+    }
+    result.push_back(Pair((char *)"pools",pools));
+    result.push_back(Pair((char *)"pooledbytes",pooled));
+    result.push_back(Pair((char *)"skippedscan",DEX_skippedscan));
+    for (i=0; i<(int32_t)peerseqs.size(); i++)
+    {
+        UniValue item(UniValue::VOBJ);
+        item.push_back(Pair((char *)"id",(int64_t)peerseqs[i].first));
+        item.push_back(Pair((char *)"backlog",(int64_t)(DEX_seqid - peerseqs[i].second)));
+        peers.push_back(item);
+    }
+    result.push_back(Pair((char *)"peers",peers));
+    pthread_rwlock_unlock(&DEX_rwlock);
     return(result);
 }
 
@@ -2184,9 +2588,9 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
     {
         len = iguana_rwnum(1,&hex[len],sizeof(shorthash),&shorthash);
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            pthread_rwlock_wrlock(&DEX_rwlock);
             _komodo_DEX_cancelid(shorthash,DEX_pubkey,(uint32_t)time(NULL));
-            pthread_mutex_unlock(&DEX_globalmutex);
+            pthread_rwlock_unlock(&DEX_rwlock);
         }
     }
     else if ( pubkeystr[0] != 0 )
@@ -2202,9 +2606,9 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
         decode_hex(hex,33,checkstr);
         len = 33;
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            pthread_rwlock_wrlock(&DEX_rwlock);
             _komodo_DEX_cancelpubkey((char *)"",(char *)"",pub33,(uint32_t)time(NULL));
-            pthread_mutex_unlock(&DEX_globalmutex);
+            pthread_rwlock_unlock(&DEX_rwlock);
         }
     }
     else if ( tagA[0] != 0 && tagB[0] != 0 )
@@ -2224,9 +2628,9 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
         hex[len++] = lenB;
         memcpy(&hex[len],tagB,lenB), len += lenB;
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            pthread_rwlock_wrlock(&DEX_rwlock);
             _komodo_DEX_cancelpubkey(tagA,tagB,pub33,(uint32_t)time(NULL));
-            pthread_mutex_unlock(&DEX_globalmutex);
+            pthread_rwlock_unlock(&DEX_rwlock);
         }
     }
     for (i=0; i<len; i++)
@@ -2240,29 +2644,76 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
 
 UniValue komodo_DEXget(uint32_t shorthash)
 {
-    UniValue result;
-    pthread_mutex_lock(&DEX_globalmutex);
-    result = _komodo_DEXget(shorthash);
-    pthread_mutex_unlock(&DEX_globalmutex);
+    UniValue result; struct DEX_datablob *ptr;
+    pthread_rwlock_rdlock(&DEX_rwlock);
+    ptr = _komodo_DEXget(shorthash);
+    pthread_rwlock_unlock(&DEX_rwlock);
+    if ( ptr != 0 )
+    {
+        result = komodo_DEX_dataobj(ptr);
+        free(ptr);
+    }
     return(result);
 }
 
 UniValue komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB,char *stophashstr)
 {
-    UniValue result;
-    pthread_mutex_lock(&DEX_globalmutex);
-    result = _komodo_DEXlist(stopat,minpriority,tagA,tagB,destpub33,minA,maxA,minB,maxB,stophashstr);
-    pthread_mutex_unlock(&DEX_globalmutex);
+    UniValue result(UniValue::VOBJ),a(UniValue::VARR); std::vector<struct DEX_datablob *> snapshot; int32_t i,n;
+    pthread_rwlock_rdlock(&DEX_rwlock);
+    n = _komodo_DEXlist(snapshot,stopat,minpriority,tagA,tagB,destpub33,minA,maxA,minB,maxB,stophashstr);
+    pthread_rwlock_unlock(&DEX_rwlock);
+    if ( n < 0 )
+    {
+        result.push_back(Pair((char *)"result",(char *)"error"));
+        result.push_back(Pair((char *)"errcode",n));
+        return(result);
+    }
+    for (i=n=0; i<(int32_t)snapshot.size(); i++)
+    {
+        if ( snapshot[i] != 0 )
+        {
+            a.push_back(komodo_DEX_dataobj(snapshot[i]));
+            free(snapshot[i]);
+            n++;
+        }
+    }
+    result.push_back(Pair((char *)"result",(char *)"success"));
+    result.push_back(Pair((char *)"matches",a));
+    result.push_back(Pair((char *)"tagA",tagA));
+    result.push_back(Pair((char *)"tagB",tagB));
+    result.push_back(Pair((char *)"pubkey",destpub33));
+    result.push_back(Pair((char *)"n",n));
     return(result);
 }
 
 UniValue komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB)
 {
-    UniValue result;
-    pthread_mutex_lock(&DEX_globalmutex);
-    result = _komodo_DEXorderbook(revflag,maxentries,minpriority,tagA,tagB,destpub33,minA,maxA,minB,maxB);
-    pthread_mutex_unlock(&DEX_globalmutex);
-    return(result);
+    UniValue result(UniValue::VOBJ),a(UniValue::VARR); std::vector<struct DEX_orderbookentry *> orders; int32_t i,n;
+    if ( maxentries <= 0 )
+        maxentries = 10;
+    if ( tagA[0] == 0 || tagB[0] == 0 )
+    {
+        fprintf(stderr,"need both tagA and tagB to specify base/rel for orderbook\n");
+        result.push_back(Pair((char *)"result",(char *)"error"));
+        result.push_back(Pair((char *)"errcode",-13));
+        return(result);
+    }
+    pthread_rwlock_rdlock(&DEX_rwlock);
+    n = _komodo_DEXorderbook(orders,revflag,minpriority,tagA,tagB,destpub33,minA,maxA,minB,maxB);
+    pthread_rwlock_unlock(&DEX_rwlock);
+    if ( n > 0 )
+    {
+        //fprintf(stderr,"sort %d orders for %s/%s\n",n,tagA,tagB);
+        qsort(&orders[0],n,sizeof(struct DEX_orderbookentry *),revflag != 0 ? _revcmp_orderbook : _cmp_orderbook);
+        for (i=0; i<maxentries&&i<n; i++)
+        {
+            a.push_back(DEX_orderbookjson(orders[i]));
+            free(orders[i]);
+        }
+        for (; i<n; i++)
+            free(orders[i]);
+    }
+    return(a);
 }
 
 bits256 komodo_DEX_filehash(FILE *fp,uint64_t offset0,uint64_t rlen,char *fname)
@@ -2355,7 +2806,10 @@ int32_t komodo_DEX_request(int32_t priority,uint32_t shorthash,uint32_t timestam
     str[1] = '1';
     bits256_str(str+2,DEX_pubkey);
     komodo_DEXbroadcast(0,'R',hexstr,priority+KOMODO_DEX_CMDPRIORITY,tagA,tagB,str,(char *)"",(char *)"");
-    return(_komodo_DEX_locatorsextract(1,shorthash,timestamp % KOMODO_DEX_PURGETIME,priority));
+    pthread_rwlock_rdlock(&DEX_rwlock);
+    n = _komodo_DEX_locatorsextract(1,shorthash,timestamp % KOMODO_DEX_PURGETIME,priority);
+    pthread_rwlock_unlock(&DEX_rwlock);
+    return(n);
 }
 
 int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,uint64_t locator,long offset,bits256 senderpub,char *tagA)
@@ -2363,15 +2817,14 @@ int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,ui
     uint32_t t,h; struct DEX_datablob *fragptr; int32_t fraglen,errflag=0; uint8_t buf[KOMODO_DEX_FILEBUFSIZE];
     t = locator >> 32;
     h = locator & 0xffffffff;
-    {
-        pthread_mutex_lock(&DEX_globalmutex);
-        fragptr = _komodo_DEXfind(t % KOMODO_DEX_PURGETIME,h);
-        pthread_mutex_unlock(&DEX_globalmutex);
-    }
     errflag = 0;
+    pthread_rwlock_rdlock(&DEX_rwlock);
+    if ( (fragptr= _komodo_DEXfind(t % KOMODO_DEX_PURGETIME,h)) != 0 )
+        fraglen = komodo_DEX_decryptbuf(buf,sizeof(buf),fragptr,senderpub,(char *)tagA);
+    pthread_rwlock_unlock(&DEX_rwlock);
     if ( fragptr != 0 )
     {
-        if ( (fraglen= komodo_DEX_decryptbuf(buf,sizeof(buf),fragptr,senderpub,(char *)tagA)) > 0 )
+        if ( fraglen > 0 )
         {
             fseek(fp,offset,SEEK_SET);
             if ( fwrite(buf,1,fraglen,fp) != fraglen )
@@ -2432,7 +2885,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
         sprintf(tagBstr,"locators");
     }
     {
-        pthread_mutex_lock(&DEX_globalmutex);
+        pthread_rwlock_rdlock(&DEX_rwlock);
         memset(checkhash.bytes,0,sizeof(checkhash));
         if ( (ptr= _komodo_DEX_latestptr(sliceid == 0 ? (char *)"files" : (char *)"slices",origfname,publisher,offset0)) != 0 )
         {
@@ -2463,7 +2916,9 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
                     break;
             }
         }
-        pthread_mutex_unlock(&DEX_globalmutex);
+        if ( ptr != 0 )
+            ptr = komodo_DEX_blobcopy(ptr);
+        pthread_rwlock_unlock(&DEX_rwlock);
     }
     if ( ptr == 0 )
     {
@@ -2478,6 +2933,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
     {
         result.push_back(Pair((char *)"result",(char *)"error"));
         result.push_back(Pair((char *)"error",(char *)"couldnt extract tags"));
+        free(ptr);
         return(result);
     }
     if ( strcmp((char *)tagA,origfname) != 0 || strcmp((char *)tagB,tagBstr) != 0 )
@@ -2489,6 +2945,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
         result.push_back(Pair((char *)"tagB",(char *)tagB));
         result.push_back(Pair((char *)"tagBstr",(char *)tagBstr));
         result.push_back(Pair((char *)"sliceid",(int64_t)sliceid));
+        free(ptr);
         return(result);
     }
     memcpy(pubkey.bytes,pubkey33+1,32);
@@ -2610,6 +3067,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
         result.push_back(Pair((char *)"status","request sent to get missing blocks"));
         result.push_back(Pair((char *)"n",n));
     }
+    free(ptr);
     return(result);
 }
 
@@ -2855,7 +3313,10 @@ UniValue komodo_DEXstream(char *fname,int32_t priority)
         offset0 = ((uint64_t)sliceid - 1) * mult;
         prevsliceid = sliceid;
         sprintf(tagBstr,"%llu",(long long)offset0);
-        if ( (ptr= _komodo_DEX_latestptr(fname,tagBstr,pubkeystr,0)) == 0 )
+        pthread_rwlock_rdlock(&DEX_rwlock);
+        ptr = _komodo_DEX_latestptr(fname,tagBstr,pubkeystr,0);
+        pthread_rwlock_unlock(&DEX_rwlock);
+        if ( ptr == 0 )
         {
             //fprintf(stderr,"sliceid.%d cant find (%s/%s) %s\n",sliceid,fname,tagBstr,pubkeystr);
             break;
@@ -3062,7 +3523,7 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
     pubkeystr[1] = '1';
     bits256_str(pubkeystr+2,DEX_pubkey);
     {
-        pthread_mutex_lock(&DEX_globalmutex);
+        pthread_rwlock_rdlock(&DEX_rwlock);
         if ( (ptr= _komodo_DEX_latestptr(coin,(char *)"notarizations",pubkeystr,0)) != 0 )
         {
             if ( (decoded= komodo_DEX_datablobdecrypt(&senderpub,&allocated,&newlen,ptr,DEX_pubkey,coin)) != 0 && newlen == 40 )
@@ -3115,7 +3576,7 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
                 free(allocated), allocated = 0;
         }
         //fprintf(stderr,"fname.%s auto search %s %s %s shorthash.%08x sliceid.%d\n",fname,origfname,tagBstr,publisher,shorthash,sliceid);
-         pthread_mutex_unlock(&DEX_globalmutex);
+         pthread_rwlock_unlock(&DEX_rwlock);
     }
     return(result);
 }
@@ -3123,24 +3584,26 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
 void komodo_DEXmsg(CNode *pfrom,std::vector<uint8_t> request) // received a packet during interrupt time
 {
     int32_t len; std::vector<uint8_t> response; bits256 hash; uint32_t timestamp = (uint32_t)time(NULL);
-    if ( (len= request.size()) > 0 )
+    if ( (len= request.size()) > 1 )
     {
-        pthread_mutex_lock(&DEX_globalmutex);
+        if ( request[1] == 'P' || request[1] == 'p' || request[1] == 'G' ) // pings and gets dont add datablobs
+            pthread_rwlock_rdlock(&DEX_rwlock);
+        else pthread_rwlock_wrlock(&DEX_rwlock);
         _komodo_DEXprocess(timestamp,pfrom,&request[0],len);
-        pthread_mutex_unlock(&DEX_globalmutex);
+        pthread_rwlock_unlock(&DEX_rwlock);
     }
 }
 
 void komodo_DEXpoll(CNode *pto) // from mainloop polling
 {
     static uint32_t purgetime;
-    std::vector<uint8_t> packet; uint32_t i,now,numiters,shorthash,len,ptime,modval,peerpos;
+    std::vector<uint8_t> packet; uint32_t i,now,numiters,shorthash,len,ptime,modval,peerpos; int32_t fullscan; uint64_t lastseq;
     now = (uint32_t)time(NULL);
     ptime = now - KOMODO_DEX_PURGETIME + 6;
-    pthread_mutex_lock(&DEX_globalmutex);
     peerpos = _komodo_DEXpeerpos(now,pto->id);
     if ( ptime > purgetime )
     {
+        pthread_rwlock_wrlock(&DEX_rwlock);
         if ( purgetime == 0 )
             purgetime = ptime;
         else
@@ -3150,24 +3613,37 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
             _komodo_DEX_purgeindices(ptime - 3); // call once at the end
         }
         DEX_Numpending *= 0.999; // decay pending to compensate for hashcollision remnants
+        pthread_rwlock_unlock(&DEX_rwlock);
     }
+    pthread_rwlock_rdlock(&DEX_rwlock);
     if ( (now == Got_Recent_Quote && now > pto->dexlastping) || now >= pto->dexlastping+KOMODO_DEX_LOCALHEARTBEAT )
     {
         if ( ((now + peerpos) % KOMODO_DEX_POLLVIP) == 0 ) // check the VIP packets
         {
             numiters = KOMODO_DEX_PURGETIME - KOMODO_DEX_MAXLAG;
+            fullscan = 1;
             pto->dexlastping = now;
-        } else numiters = KOMODO_DEX_MAXLAG - KOMODO_DEX_MAXHOPS;
+        }
+        else
+        {
+            numiters = KOMODO_DEX_MAXLAG - KOMODO_DEX_MAXHOPS;
+            fullscan = 0;
+        }
+        lastseq = DEX_seqid;
         for (i=0; i<numiters; i++)
         {
             modval = (now + 1 - i) % KOMODO_DEX_PURGETIME;
-            if ( _komodo_DEXmodval(now,modval,pto) > 0 )
+            komodo_DEX_slotlock(modval);
+            if ( _komodo_DEXmodval(now,modval,pto,fullscan,pto->dexlastseq) > 0 )
                 pto->dexlastping = now;
+            komodo_DEX_slotunlock(modval);
             if ( komodo_DEX_islagging() != 0 && i > KOMODO_DEX_MAXLAG )
                 break;
         }
         pto->dexlastping = now;
+        if ( i == numiters ) // seqids are global, so after a lag break the skipped modvals can still hold blobs newer than dexlastseq
+            pto->dexlastseq = lastseq;
     }
-    pthread_mutex_unlock(&DEX_globalmutex);
+    pthread_rwlock_unlock(&DEX_rwlock);
 }
 
@@ -1698,10 +1698,10 @@ arith_uint256 komodo_PoWtarget(int32_t *percPoSp,arith_uint256 target,int32_t he
     return(bnTarget);
 }
 
-uint32_t komodo_stake(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeight,uint256 txid,int32_t vout,uint32_t blocktime,uint32_t prevtime,char *destaddr,int32_t PoSperc)
+// komodo_stake2 is komodo_stake with the utxo time, stake value and destination address already resolved (see komodo_txtime2)
+uint32_t komodo_stake2(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeight,uint256 txid,int32_t vout,uint32_t blocktime,uint32_t prevtime,int32_t PoSperc,uint32_t txtime,uint64_t value,char *address)
 {
-    bool fNegative,fOverflow; uint8_t hashbuf[256]; char address[64]; bits256 addrhash; arith_uint256 hashval,mindiff,ratio,coinage256; uint256 hash,pasthash; int32_t segid,minage,iter=0; int64_t diff=0; uint32_t txtime,segid32,winner = 0 ; uint64_t value,coinage;
-    txtime = komodo_txtime2(&value,txid,vout,address);
+    bool fNegative,fOverflow; uint8_t hashbuf[256]; bits256 addrhash; arith_uint256 hashval,mindiff,ratio,coinage256; uint256 hash,pasthash; int32_t segid,minage,iter=0; int64_t diff=0; uint32_t segid32,winner = 0 ; uint64_t coinage;
     if ( validateflag == 0 )
     {
         //fprintf(stderr,"blocktime.%u -> ",blocktime);
@@ -1817,6 +1817,14 @@ uint32_t komodo_stake(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeigh
     return(blocktime * winner);
 }
 
+uint32_t komodo_stake(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeight,uint256 txid,int32_t vout,uint32_t blocktime,uint32_t prevtime,char *destaddr,int32_t PoSperc)
+{
+    char address[64]; uint64_t value; uint32_t txtime;
+    address[0] = 0;
+    txtime = komodo_txtime2(&value,txid,vout,address);
+    return(komodo_stake2(validateflag,bnTarget,nHeight,txid,vout,blocktime,prevtime,PoSperc,txtime,value,address));
+}
+
 int32_t komodo_is_PoSblock(int32_t slowflag,int32_t height,CBlock *pblock,arith_uint256 bnTarget,arith_uint256 bhash)
 {
     CBlockIndex *previndex,*pindex; char voutaddr[64],destaddr[64]; uint256 txid, merkleroot; uint32_t txtime,prevtime=0; int32_t ret,vout,PoSperc,txn_count,eligible=0,isPoS = 0,segid; uint64_t value; arith_uint256 POWTarget;
@@ -2619,43 +2627,29 @@ int32_t komodo_acpublic(uint32_t tiptime)
     return(acpublic);
 }
 
-int64_t komodo_newcoins(int64_t *zfundsp,int64_t *sproutfundsp,int32_t nHeight,CBlock *pblock)
+// fills the supply accounting of a block whose non-coinbase inputs sum to vinsum, shared by ConnectBlock and komodo_newcoins
+void komodo_blocksupply(CBlockSupply *bs,int32_t nHeight,const CBlock *pblock,int64_t vinsum,int64_t interest)
 {
-    CTxDestination address; int32_t i,j,m,n,vout; uint8_t *script; uint256 txid,hashBlock; int64_t zfunds=0,vinsum=0,voutsum=0,sproutfunds=0;
+    CTxDestination address; int32_t i,j,m,n; const uint8_t *script; int64_t zfunds=0,voutsum=0,sproutfunds=0,burned=0;
     n = pblock->vtx.size();
     for (i=0; i<n; i++)
     {
-        CTransaction vintx,&tx = pblock->vtx[i];
-        if ( (m= tx.vin.size()) > 0 )
-        {
-            for (j=0; j<m; j++)
-            {
-                if ( i == 0 )
-                    continue;
-                txid = tx.vin[j].prevout.hash;
-                vout = tx.vin[j].prevout.n;
-                if ( !GetTransaction(txid,vintx,hashBlock, false) || vout >= vintx.vout.size() )
-                {
-                    fprintf(stderr,"ERROR: %s/v%d cant find\n",txid.ToString().c_str(),vout);
-                    return(0);
-                }
-                vinsum += vintx.vout[vout].nValue;
-            }
-        }
+        const CTransaction &tx = pblock->vtx[i];
         if ( (m= tx.vout.size()) > 0 )
         {
             for (j=0; j<m-1; j++)
             {
                 if ( ExtractDestination(tx.vout[j].scriptPubKey,address) != 0 && strcmp("RD6GgnrMpPaTSMn8vai6yiGA7mN4QGPVMY",CBitcoinAddress(address).ToString().c_str()) != 0 )
                     voutsum += tx.vout[j].nValue;
-                else printf("skip %.8f -> %s\n",dstr(tx.vout[j].nValue),CBitcoinAddress(address).ToString().c_str());
+                else burned += tx.vout[j].nValue;
             }
-            script = (uint8_t *)&tx.vout[j].scriptPubKey[0];
+            script = tx.vout[j].scriptPubKey.size() > 0 ? &tx.vout[j].scriptPubKey[0] : 0;
             if ( script == 0 || script[0] != 0x6a )
             {
                 if ( ExtractDestination(tx.vout[j].scriptPubKey,address) != 0 && strcmp("RD6GgnrMpPaTSMn8vai6yiGA7mN4QGPVMY",CBitcoinAddress(address).ToString().c_str()) != 0 )
                     voutsum += tx.vout[j].nValue;
-            }
+                else burned += tx.vout[j].nValue;
+            } else burned += tx.vout[j].nValue;
         }
         BOOST_FOREACH(const JSDescription& joinsplit, tx.vjoinsplit)
         {
@@ -2666,13 +2660,43 @@ int64_t komodo_newcoins(int64_t *zfundsp,int64_t *sproutfundsp,int32_t nHeight,C
         }
         zfunds -= tx.valueBalance;
     }
-    *zfundsp = zfunds;
-    *sproutfundsp = sproutfunds;
+    bs->nZfunds = zfunds;
+    bs->nSproutFunds = sproutfunds;
+    bs->nBurned = burned;
+    bs->nInterest = interest;
     if ( ASSETCHAINS_SYMBOL[0] == 0 && (voutsum-vinsum) == 100003*SATOSHIDEN ) // 15 times
-        return(3 * SATOSHIDEN);
+        bs->nSupply = 3 * SATOSHIDEN;
+    else bs->nSupply = voutsum - vinsum;
     //if ( voutsum-vinsum+zfunds > 100000*SATOSHIDEN || voutsum-vinsum+zfunds < 0 )
     //.    fprintf(stderr,"ht.%d vins %.8f, vouts %.8f -> %.8f zfunds %.8f\n",nHeight,dstr(vinsum),dstr(voutsum),dstr(voutsum)-dstr(vinsum),dstr(zfunds));
-    return(voutsum - vinsum);
+}
+
+int64_t komodo_newcoins(int64_t *zfundsp,int64_t *sproutfundsp,int32_t nHeight,CBlock *pblock)
+{
+    int32_t i,j,m,n,vout; uint256 txid,hashBlock; int64_t vinsum=0; CBlockSupply bs;
+    n = pblock->vtx.size();
+    for (i=1; i<n; i++)
+    {
+        CTransaction vintx,&tx = pblock->vtx[i];
+        if ( (m= tx.vin.size()) > 0 )
+        {
+            for (j=0; j<m; j++)
+            {
+                txid = tx.vin[j].prevout.hash;
+                vout = tx.vin[j].prevout.n;
+                if ( !GetTransaction(txid,vintx,hashBlock, false) || vout >= vintx.vout.size() )
+                {
+                    fprintf(stderr,"ERROR: %s/v%d cant find\n",txid.ToString().c_str(),vout);
+                    return(0);
+                }
+                vinsum += vintx.vout[vout].nValue;
+            }
+        }
+    }
+    komodo_blocksupply(&bs,nHeight,pblock,vinsum,0);
+    *zfundsp = bs.nZfunds;
+    *sproutfundsp = bs.nSproutFunds;
+    return(bs.nSupply);
 }
 
 int64_t komodo_coinsupply(int64_t *zfundsp,int64_t *sproutfundsp,int32_t height)
@@ -2682,9 +2706,22 @@ int64_t komodo_coinsupply(int64_t *zfundsp,int64_t *sproutfundsp,int32_t height)
     *zfundsp = *sproutfundsp = 0;
     if ( (pindex= komodo_chainactive(height)) != 0 )
     {
+        if ( pindex->nChainSupply )
+        {
+            // accumulated at ConnectBlock (or by BuildCoinSupplyIndex), no need to walk the chain
+            *zfundsp = pindex->nChainSupply->nZfunds;
+            *sproutfundsp = pindex->nChainSupply->nSproutFunds;
+            return(pindex->nChainSupply->nSupply);
+        }
         while ( pindex != 0 && pindex->GetHeight() > 0 )
         {
-            if ( pindex->newcoins == 0 && pindex->zfunds == 0 )
+            if ( (pindex->nStatus & BLOCK_HAVE_SUPPLY) != 0 )
+            {
+                pindex->newcoins = pindex->nBlockSupply.nSupply;
+                pindex->zfunds = pindex->nBlockSupply.nZfunds;
+                pindex->sproutfunds = pindex->nBlockSupply.nSproutFunds;
+            }
+            else if ( pindex->newcoins == 0 && pindex->zfunds == 0 )
             {
                 if ( komodo_blockload(block,pindex) == 0 )
                     pindex->newcoins = komodo_newcoins(&pindex->zfunds,&pindex->sproutfunds,pindex->GetHeight(),&block);
@@ -2737,17 +2774,225 @@ struct komodo_staking *komodo_addutxo(struct komodo_staking *array,int32_t *numk
     return(array);
 }
 
+/*
+ Persistent staking candidate set used by komodo_staked. Utxos are kept by outpoint and bucketed by segid32 & 0x3f, so at
+ height ht the utxos of segid s are in bucket (s - ht) & 0x3f and can be scanned in eligibility order without a resort.
+ Within a bucket they are ordered by utxo time, oldest (largest coinage) first.
+ Wallet utxos are updated incrementally from CWallet::NotifyTransactionChanged, marmara utxos are diffed against the
+ activated and locked-in-loop CC indexes once per new tip. A full resync is only done at start, on reorg and every
+ KOMODO_STAKINGSET_RESYNC seconds as a backstop.
+*/
+#define KOMODO_STAKINGSET_RESYNC 3600
+
+struct komodo_stakingset
+{
+    std::map<COutPoint,struct komodo_staking> utxos;
+    std::set<std::pair<uint32_t,COutPoint> > buckets[64];
+    std::set<uint256> immature; // wallet coinbases to add once they mature
+    uint256 tiphash;
+    uint32_t lastresync;
+    bool notifyconnected;
+};
+static struct komodo_stakingset KOMODO_STAKINGSET;
+static std::set<uint256> KOMODO_STAKINGSET_PENDING; // wallet txids changed since the last staking round
+static CCriticalSection cs_stakingset_pending;
+
+void komodo_stakingset_notify(CWallet *wallet,const uint256 &hashTx,ChangeType status)
+{
+    LOCK(cs_stakingset_pending);
+    KOMODO_STAKINGSET_PENDING.insert(hashTx);
+}
+
+void komodo_stakingset_remove(const COutPoint &outpt)
+{
+    std::map<COutPoint,struct komodo_staking>::iterator it;
+    if ( (it= KOMODO_STAKINGSET.utxos.find(outpt)) != KOMODO_STAKINGSET.utxos.end() )
+    {
+        KOMODO_STAKINGSET.buckets[it->second.segid32 & 0x3f].erase(std::make_pair(it->second.txtime,outpt));
+        KOMODO_STAKINGSET.utxos.erase(it);
+    }
+}
+
+void komodo_stakingset_removetx(const uint256 &txid)
+{
+    std::map<COutPoint,struct komodo_staking>::iterator it = KOMODO_STAKINGSET.utxos.lower_bound(COutPoint(txid,0));
+    while ( it != KOMODO_STAKINGSET.utxos.end() && it->first.hash == txid )
+    {
+        KOMODO_STAKINGSET.buckets[it->second.segid32 & 0x3f].erase(std::make_pair(it->second.txtime,it->first));
+        KOMODO_STAKINGSET.utxos.erase(it++);
+    }
+}
+
+void komodo_stakingset_add(struct komodo_staking *kp)
+{
+    COutPoint outpt(kp->txid,kp->vout);
+    if ( KOMODO_STAKINGSET.utxos.count(outpt) != 0 )
+        return;
+    // bucket by the address komodo_stake hashes, which for CC vouts differs from the staking address
+    kp->segid32 = komodo_segid32(kp->stakeaddr);
+    KOMODO_STAKINGSET.utxos.insert(std::make_pair(outpt,*kp));
+    KOMODO_STAKINGSET.buckets[kp->segid32 & 0x3f].insert(std::make_pair(kp->txtime,outpt));
+}
+
+// adds a confirmed wallet utxo, resolving the stake value and address from the tx we already have instead of komodo_txtime2
+void komodo_stakingset_addwallet(const CWalletTx &wtx,int32_t vout,CBlockIndex *pindex,char *address)
+{
+    struct komodo_staking kp; CTxDestination dest; CTransaction tx(wtx);
+    kp.txid = wtx.GetHash();
+    kp.vout = vout;
+    kp.txtime = (uint32_t)pindex->nTime;
+    kp.nValue = (uint64_t)wtx.vout[vout].nValue;
+    kp.stakevalue = kp.nValue * GetStakeMultiplier(tx,vout);
+    kp.scriptPubKey = wtx.vout[vout].scriptPubKey;
+    strcpy(kp.address,address);
+    kp.stakeaddr[0] = 0;
+    if ( ExtractDestination(kp.scriptPubKey,dest) )
+        strcpy(kp.stakeaddr,CBitcoinAddress(dest).ToString().c_str());
+    komodo_stakingset_add(&kp);
+}
+
+// applies the same filters as the AvailableCoins scan in komodo_stakingset_resync to one vout
+bool komodo_stakingset_walletvout(const CWalletTx &wtx,int32_t vout,CBlockIndex **pindexp,CTxDestination &address)
+{
+    if ( wtx.vout[vout].nValue < COIN || pwalletMain->IsSpent(wtx.GetHash(),vout) != 0 )
+        return(false);
+    if ( !CheckFinalTx(wtx) || (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) )
+        return(false);
+    if ( pwalletMain->IsLockedCoin(wtx.GetHash(),vout) || pwalletMain->IsReservedCoin(COutPoint(wtx.GetHash(),vout)) )
+        return(false);
+    if ( (pwalletMain->IsMine(wtx.vout[vout]) & ISMINE_SPENDABLE) == 0 )
+        return(false);
+    if ( ExtractDestination(wtx.vout[vout].scriptPubKey,address) == 0 || IsMine(*pwalletMain,address) == 0 )
+        return(false);
+    if ( (*pindexp= komodo_getblockindex(wtx.hashBlock)) == 0 || chainActive.Contains(*pindexp) == 0 )
+        return(false);
+    return(true);
+}
+
+// cs_main and cs_wallet must be held
+void komodo_stakingset_wallettx(const uint256 &txid)
+{
+    const CWalletTx *wtx; CBlockIndex *pindex; CTxDestination address; int32_t i,depth;
+    komodo_stakingset_removetx(txid);
+    if ( (wtx= pwalletMain->GetWalletTx(txid)) == 0 || (depth= wtx->GetDepthInMainChain()) < 0 )
+        return;
+    BOOST_FOREACH(const CTxIn &txin,wtx->vin)
+        komodo_stakingset_remove(txin.prevout);
+    if ( depth < 1 )
+        return;
+    if ( wtx->IsCoinBase() && wtx->GetBlocksToMaturity() > 0 )
+    {
+        KOMODO_STAKINGSET.immature.insert(txid);
+        return;
+    }
+    for (i=0; i<wtx->vout.size(); i++)
+    {
+        if ( komodo_stakingset_walletvout(*wtx,i,&pindex,address) )
+            komodo_stakingset_addwallet(*wtx,i,pindex,(char *)CBitcoinAddress(address).ToString().c_str());
+    }
+}
+
+// cs_main and cs_wallet must be held
+void komodo_stakingset_resync(uint8_t *hashbuf)
+{
+    std::vector<COutput> vecOutputs; CBlockIndex *pindex; CTxDestination address; int32_t i;
+    if ( ASSETCHAINS_MARMARA == 0 )
+    {
+        for (i=0; i<64; i++)
+            KOMODO_STAKINGSET.buckets[i].clear();
+        KOMODO_STAKINGSET.utxos.clear();
+        KOMODO_STAKINGSET.immature.clear();
+        pwalletMain->AvailableCoins(vecOutputs, false, NULL, true);
+        BOOST_FOREACH(const COutput& out, vecOutputs)
+        {
+            if ( out.nDepth < 1 || !out.fSpendable )
+                continue;
+            if ( out.tx->IsCoinBase() && out.tx->GetBlocksToMaturity() > 0 )
+            {
+                KOMODO_STAKINGSET.immature.insert(out.tx->GetHash());
+                continue;
+            }
+            if ( komodo_stakingset_walletvout(*out.tx,out.i,&pindex,address) )
+                komodo_stakingset_addwallet(*out.tx,out.i,pindex,(char *)CBitcoinAddress(address).ToString().c_str());
+        }
+    }
+    else
+    {
+        // diff against the CC indexes, so only utxos new to the set need their stake value resolved
+        struct komodo_staking *array = 0; int32_t numkp = 0,maxkp = 0; std::set<COutPoint> current; std::vector<COutPoint> stale;
+        array = MarmaraGetStakingUtxos(array, &numkp, &maxkp, hashbuf);
+        for (i=0; i<numkp; i++)
+        {
+            COutPoint outpt(array[i].txid,array[i].vout);
+            current.insert(outpt);
+            if ( KOMODO_STAKINGSET.utxos.count(outpt) == 0 )
+            {
+                array[i].txtime = komodo_txtime2(&array[i].stakevalue,array[i].txid,array[i].vout,array[i].stakeaddr);
+                if ( array[i].txtime != 0 )
+                    komodo_stakingset_add(&array[i]);
+            }
+        }
+        for (std::map<COutPoint,struct komodo_staking>::iterator it=KOMODO_STAKINGSET.utxos.begin(); it!=KOMODO_STAKINGSET.utxos.end(); it++)
+            if ( current.count(it->first) == 0 )
+                stale.push_back(it->first);
+        BOOST_FOREACH(const COutPoint &outpt,stale)
+            komodo_stakingset_remove(outpt);
+        if ( array != 0 )
+            free(array);
+    }
+    LOGSTREAMFN(LOG_KOMODOBITCOIND, CCLOG_DEBUG1, stream << "staking set resynced, utxos=" << KOMODO_STAKINGSET.utxos.size() << std::endl);
+}
+
+// brings the staking set up to date with tipindex, cs_main and cs_wallet must be held
+void komodo_stakingset_update(CBlockIndex *tipindex,uint8_t *hashbuf)
+{
+    std::set<uint256> pending; bool reorg;
+    if ( KOMODO_STAKINGSET.notifyconnected == false )
+    {
+        pwalletMain->NotifyTransactionChanged.connect(&komodo_stakingset_notify);
+        KOMODO_STAKINGSET.notifyconnected = true;
+    }
+    {
+        LOCK(cs_stakingset_pending);
+        pending.swap(KOMODO_STAKINGSET_PENDING);
+    }
+    reorg = !KOMODO_STAKINGSET.tiphash.IsNull() && KOMODO_STAKINGSET.tiphash != tipindex->GetBlockHash() && (tipindex->pprev == 0 || KOMODO_STAKINGSET.tiphash != tipindex->pprev->GetBlockHash());
+    if ( reorg || KOMODO_STAKINGSET.lastresync == 0 || time(NULL) > KOMODO_STAKINGSET.lastresync+KOMODO_STAKINGSET_RESYNC )
+    {
+        komodo_stakingset_resync(hashbuf);
+        KOMODO_STAKINGSET.lastresync = (uint32_t)time(NULL);
+    }
+    else if ( ASSETCHAINS_MARMARA != 0 )
+    {
+        if ( KOMODO_STAKINGSET.tiphash != tipindex->GetBlockHash() )
+            komodo_stakingset_resync(hashbuf);
+    }
+    else
+    {
+        // coinbases that matured since the last round are added like changed txs
+        for (std::set<uint256>::iterator it=KOMODO_STAKINGSET.immature.begin(); it!=KOMODO_STAKINGSET.immature.end(); )
+        {
+            const CWalletTx *wtx = pwalletMain->GetWalletTx(*it);
+            if ( wtx == 0 || wtx->GetBlocksToMaturity() == 0 )
+            {
+                pending.insert(*it);
+                KOMODO_STAKINGSET.immature.erase(it++);
+            } else it++;
+        }
+        BOOST_FOREACH(const uint256 &txid,pending)
+            komodo_stakingset_wallettx(txid);
+    }
+    KOMODO_STAKINGSET.tiphash = tipindex->GetBlockHash();
+}
+
 int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blocktimep,uint32_t *txtimep,uint256 *utxotxidp,int32_t *utxovoutp,uint64_t *utxovaluep,uint8_t *utxosig, uint256 merkleroot)
 {
-    static struct komodo_staking *array; static int32_t numkp,maxkp; static uint32_t lasttime;
     int32_t PoSperc = 0, newStakerActive; 
-    set<CBitcoinAddress> setAddress; struct komodo_staking *kp; int32_t winners,segid,minage,nHeight,counter=0,i,m,siglen=0,nMinDepth = 1,nMaxDepth = 99999999; vector<COutput> vecOutputs; uint32_t block_from_future_rejecttime,besttime,eligible,earliest = 0; CScript best_scriptPubKey; arith_uint256 mindiff,ratio,bnTarget,tmpTarget; CBlockIndex *tipindex,*pindex; CTxDestination address; bool fNegative,fOverflow; uint8_t hashbuf[256]; CTransaction tx; uint256 hashBlock;
+    struct komodo_staking *kp; int32_t segid,nHeight,counter=0,i,siglen=0; uint32_t prevtime,eligible,earliest = 0; CScript best_scriptPubKey; arith_uint256 bnTarget; CBlockIndex *tipindex; bool fNegative,fOverflow; uint8_t hashbuf[256];
     uint64_t cbPerc = *utxovaluep, tocoinbase = 0;
     if (!EnsureWalletIsAvailable(0))
         return 0;
 
-    const bool needSpecialStakeUtxo = (ASSETCHAINS_MARMARA != 0);   //conditions of contracts or params for which non-basic utxo for staking are needed
-
     bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
     assert(pwalletMain != NULL);
     *utxovaluep = 0;
@@ -2757,126 +3002,57 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
     if ( (tipindex= chainActive.Tip()) == 0 )
         return(0);
     nHeight = tipindex->GetHeight() + 1;
-    if ( (minage= nHeight*3) > 6000 ) // about 100 blocks
-        minage = 6000;
     if ( *blocktimep < tipindex->nTime+60 )
         *blocktimep = tipindex->nTime+60;
     komodo_segids(hashbuf,nHeight-101,100);
     // this was for VerusHash PoS64
     //tmpTarget = komodo_PoWtarget(&PoSperc,bnTarget,nHeight,ASSETCHAINS_STAKED);
-    bool resetstaker = false;
-    if ( array != 0 )
     {
-        LOCK(cs_main);
-        CBlockIndex* pblockindex = chainActive[tipindex->GetHeight()];
-        CBlock block; CTxDestination addressout;
-        if (needSpecialStakeUtxo)
-            resetstaker = true;
-        else if ( ReadBlockFromDisk(block, pblockindex, 1) && komodo_isPoS(&block, nHeight, &addressout) != 0 && IsMine(*pwalletMain,addressout) != 0 )
-        {
-              resetstaker = true;
-              fprintf(stderr, "[%s:%d] Reset ram staker after mining a block!\n",ASSETCHAINS_SYMBOL,nHeight);
-        }
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 != nHeight )
+            return(0);
+        komodo_stakingset_update(tipindex,hashbuf);
     }
-
-    if ( resetstaker || array == 0 || time(NULL) > lasttime+600 )
+    prevtime = (uint32_t)tipindex->nTime + ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF;
+    for (segid=0; segid<64; segid++)
     {
-        LOCK2(cs_main, pwalletMain->cs_wallet);
-        pwalletMain->AvailableCoins(vecOutputs, false, NULL, true);
-        if ( array != 0 )
-        {
-            free(array);
-            array = 0;
-            maxkp = numkp = 0;
-            lasttime = 0;
-        }
-        if (!needSpecialStakeUtxo)
+        // an utxo in segid can not become eligible before prevtime+3+segid*2, so later segids can not beat earliest
+        if ( earliest != 0 && nHeight >= 10 && prevtime+3+segid*2 > earliest )
+            break;
+        std::set<std::pair<uint32_t,COutPoint> > &bucket = KOMODO_STAKINGSET.buckets[(segid - nHeight) & 0x3f];
+        for (std::set<std::pair<uint32_t,COutPoint> >::iterator it=bucket.begin(); it!=bucket.end(); it++,counter++)
         {
-            // add normal staking UTXO:
-            BOOST_FOREACH(const COutput& out, vecOutputs)
+            if ( fRequestShutdown || !GetBoolArg("-gen",false) )
+                return(0);
+            if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
             {
-                if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
-                {
-                    fprintf(stderr,"[%s:%d] chain tip changed during staking loop t.%u counter.%d\n",ASSETCHAINS_SYMBOL,nHeight,(uint32_t)time(NULL),counter);
-                    return(0);
-                }
-                counter++;
-                if ( out.nDepth < nMinDepth || out.nDepth > nMaxDepth )
-                {
-                    //fprintf(stderr,"komodo_staked invalid depth %d\n",(int32_t)out.nDepth);
-                    continue;
-                }
-                CAmount nValue = out.tx->vout[out.i].nValue;
-                if ( nValue < COIN  || !out.fSpendable )
-                    continue;
-                const CScript& pk = out.tx->vout[out.i].scriptPubKey;
-                if ( ExtractDestination(pk,address) != 0 )
-                {
-                    if ( IsMine(*pwalletMain,address) == 0 )
-                        continue;
-                    if ( myGetTransaction(out.tx->GetHash(),tx,hashBlock) != 0 && (pindex= komodo_getblockindex(hashBlock)) != 0 )
-                    {
-                        array = komodo_addutxo(array,&numkp,&maxkp,(uint32_t)pindex->nTime,(uint64_t)nValue,out.tx->GetHash(),out.i,(char *)CBitcoinAddress(address).ToString().c_str(),hashbuf,(CScript)pk);
-                        //fprintf(stderr,"addutxo numkp.%d vs max.%d\n",numkp,maxkp);
-                    }
-                }
-            }
-        }
-        else  
-        {
-            // placeholder for special staking utxo cases:
-            // marmara case:
-            if (ASSETCHAINS_MARMARA != 0) {
-                array = MarmaraGetStakingUtxos(array, &numkp, &maxkp, hashbuf);
+                fprintf(stderr,"[%s:%d] chain tip changed during staking loop t.%u counter.%d\n",ASSETCHAINS_SYMBOL,nHeight,(uint32_t)time(NULL),counter);
+                return(0);
             }
-        }
-        lasttime = (uint32_t)time(NULL);
-        //fprintf(stderr,"finished kp data of utxo for staking %u ht.%d numkp.%d maxkp.%d\n",(uint32_t)time(NULL),nHeight,numkp,maxkp);
-    }
-    block_from_future_rejecttime = (uint32_t)GetTime() + ASSETCHAINS_STAKED_BLOCK_FUTURE_MAX;    
-    for (i=winners=0; i<numkp; i++)
-    {
-        if ( fRequestShutdown || !GetBoolArg("-gen",false) )
-            return(0);
-        if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
-        {
-            fprintf(stderr,"[%s:%d] chain tip changed during staking loop t.%u counter.%d\n",ASSETCHAINS_SYMBOL,nHeight,(uint32_t)time(NULL),i);
-            return(0);
-        }
-        kp = &array[i];
-        eligible = komodo_stake(0,bnTarget,nHeight,kp->txid,kp->vout,0,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc);
-        if ( eligible > 0 )
-        {
-            besttime = 0;
-            if ( eligible == komodo_stake(1,bnTarget,nHeight,kp->txid,kp->vout,eligible,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc) )
+            kp = &KOMODO_STAKINGSET.utxos[it->second];
+            // lockunspent and async reservations do not notify the set, so check them when staking
+            if ( ASSETCHAINS_MARMARA == 0 && (pwalletMain->IsLockedCoin(kp->txid,kp->vout) || pwalletMain->IsReservedCoin(it->second)) )
+                continue;
+            eligible = komodo_stake2(0,bnTarget,nHeight,kp->txid,kp->vout,0,prevtime,PoSperc,kp->txtime,kp->stakevalue,kp->stakeaddr);
+            if ( eligible > 0 )
             {
-                // have elegible utxo to stake with. 
-                if ( earliest == 0 || eligible < earliest || (eligible == earliest && (*utxovaluep == 0 || kp->nValue < *utxovaluep)) )
+                if ( eligible == komodo_stake(1,bnTarget,nHeight,kp->txid,kp->vout,eligible,prevtime,kp->address,PoSperc) )
                 {
-                    // is better than the previous best, so use it instead.
-                    earliest = eligible;
-                    best_scriptPubKey = kp->scriptPubKey;
-                    *utxovaluep = (uint64_t)kp->nValue;
-                    decode_hex((uint8_t *)utxotxidp,32,(char *)kp->txid.GetHex().c_str());
-                    *utxovoutp = kp->vout;
-                    *txtimep = kp->txtime;
+                    // have elegible utxo to stake with. 
+                    if ( earliest == 0 || eligible < earliest || (eligible == earliest && (*utxovaluep == 0 || kp->nValue < *utxovaluep)) )
+                    {
+                        // is better than the previous best, so use it instead.
+                        earliest = eligible;
+                        best_scriptPubKey = kp->scriptPubKey;
+                        *utxovaluep = (uint64_t)kp->nValue;
+                        decode_hex((uint8_t *)utxotxidp,32,(char *)kp->txid.GetHex().c_str());
+                        *utxovoutp = kp->vout;
+                        *txtimep = kp->txtime;
+                    }
                 }
-                /*if ( eligible < block_from_future_rejecttime )
-                { 
-                    // better to scan all and choose earliest! 
-                    fprintf(stderr, "block_from_future_rejecttime.%u vs eligible.%u \n", block_from_future_rejecttime, eligible);
-                    break;
-                } */ 
             }
         }
     }
-    if ( numkp < 500 && array != 0 )
-    {
-        free(array);
-        array = 0;
-        maxkp = numkp = 0;
-        lasttime = 0;
-    }
     if ( earliest != 0 )
     {
         bool signSuccess; SignatureData sigdata; uint64_t txfee; uint8_t *ptr; uint256 revtxid,utxotxid;
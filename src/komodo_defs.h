@@ -526,6 +526,8 @@ struct komodo_staking
     uint32_t segid32, txtime;
     int32_t vout;
     CScript scriptPubKey;
+    uint64_t stakevalue;    // value with stake multiplier, as komodo_txtime2 returns it
+    char stakeaddr[64];     // vout destination address, as komodo_txtime2 returns it
 };
 struct komodo_staking *komodo_addutxo(struct komodo_staking *array, int32_t *numkp, int32_t *maxkp, uint32_t txtime, uint64_t nValue, uint256 txid, int32_t vout, char *address, uint8_t *hashbuf, CScript pk);
 void komodo_createminerstransactions();
@@ -19,10 +19,18 @@
 
 #include "komodo_DEX.h"
 
-// nSPV client. VERY simplistic "single threaded" networking model. for production GUI best to multithread, etc.
-// no caching, no optimizations, no reducing the number of ntzsproofs needed by detecting overlaps, etc.
-// advantage is that it is simpler to implement and understand to create a design for a more performant version
+// nSPV client. simple networking model: requests go out with NSPV_req and the caller waits for the matching response.
+// responses carry no request id, so each request is matched to its response by peer, response type and the txid/height it answers.
+// txproofs, notarizations and ntzsproofs are kept in LRU caches so a spend only fetches what it hasnt seen before
 
+#include <list>
+#include <unordered_map>
+
+#define NSPV_TXPROOF_CACHEBYTES (8 * 1024 * 1024)
+#define NSPV_NTZSPROOF_CACHEBYTES (16 * 1024 * 1024)
+#define NSPV_NTZS_CACHEBYTES (1024 * 1024)
+#define NSPV_LATENCY_INIT 500000 // usecs assumed for a peer that hasnt answered yet
+#define NSPV_PENDINGMICROS ((int64_t)NSPV_POLLITERS * NSPV_POLLMICROS)
 
 CAmount AmountFromValue(const UniValue& value);
 int32_t bitcoin_base58decode(uint8_t *data,char *coinaddr);
@@ -41,100 +49,310 @@ struct NSPV_ntzsproofresp NSPV_ntzsproofresult;
 struct NSPV_txproof NSPV_txproofresult;
 struct NSPV_broadcastresp NSPV_broadcastresult;
 
-struct NSPV_ntzsresp NSPV_ntzsresp_cache[NSPV_MAXVINS];
-struct NSPV_ntzsproofresp NSPV_ntzsproofresp_cache[NSPV_MAXVINS * 2];
-struct NSPV_txproof NSPV_txproof_cache[NSPV_MAXVINS * 4];
+// NSPV_mutex guards the caches, the pending requests and the peer latencies. NSPV_cond is signalled for every response
+
+pthread_mutex_t NSPV_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t NSPV_cond = PTHREAD_COND_INITIALIZER;
+uint32_t NSPV_respseqs[256];
 
-struct NSPV_ntzsresp *NSPV_ntzsresp_find(int32_t reqheight)
+struct NSPV_pending
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
-        if ( NSPV_ntzsresp_cache[i].reqheight == reqheight )
-            return(&NSPV_ntzsresp_cache[i]);
-    return(0);
+    uint256 txid,txid2;
+    int64_t reqid,senttime;
+    int32_t nodeid,height;
+    uint8_t resptype;
+};
+std::list<struct NSPV_pending> NSPV_pendings;
+std::map<int32_t,int64_t> NSPV_latencies; // nodeid -> smoothed usecs from request to response
+int64_t NSPV_lastreqid;
+
+struct NSPV_txidhash { size_t operator()(const uint256 &txid) const { return(txid.GetCheapHash()); } };
+struct NSPV_txidpairhash { size_t operator()(const std::pair<uint256,uint256> &pair) const { return(pair.first.GetCheapHash() ^ (pair.second.GetCheapHash() * 31)); } };
+
+int64_t NSPV_cachesize(struct NSPV_ntzsresp *ptr) { return(sizeof(*ptr)); }
+int64_t NSPV_cachesize(struct NSPV_txproof *ptr) { return(sizeof(*ptr) + ptr->txlen + ptr->txprooflen); }
+int64_t NSPV_cachesize(struct NSPV_ntzsproofresp *ptr) { return(sizeof(*ptr) + ptr->common.numhdrs*sizeof(*ptr->common.hdrs) + ptr->prevtxlen + ptr->nexttxlen); }
+void NSPV_cachecopy(struct NSPV_ntzsresp *dest,struct NSPV_ntzsresp *ptr) { NSPV_ntzsresp_copy(dest,ptr); }
+void NSPV_cachecopy(struct NSPV_txproof *dest,struct NSPV_txproof *ptr) { NSPV_txproof_copy(dest,ptr); }
+void NSPV_cachecopy(struct NSPV_ntzsproofresp *dest,struct NSPV_ntzsproofresp *ptr) { NSPV_ntzsproofresp_copy(dest,ptr); }
+void NSPV_cachepurge(struct NSPV_ntzsresp *ptr) { NSPV_ntzsresp_purge(ptr); }
+void NSPV_cachepurge(struct NSPV_txproof *ptr) { NSPV_txproof_purge(ptr); }
+void NSPV_cachepurge(struct NSPV_ntzsproofresp *ptr) { NSPV_ntzsproofresp_purge(ptr); }
+
+// LRU cache with a byte budget. values are malloced structs, pointers returned by find are only valid while NSPV_mutex is held
+
+template <typename K,typename V,typename H> struct NSPV_lrucache
+{
+    typedef std::list<std::pair<K,V *> > lrulist;
+    lrulist lru;
+    std::unordered_map<K,typename lrulist::iterator,H> index;
+    int64_t numbytes,maxbytes;
+    NSPV_lrucache(int64_t _maxbytes) : numbytes(0),maxbytes(_maxbytes) {}
+    V *find(const K &key)
+    {
+        typename std::unordered_map<K,typename lrulist::iterator,H>::iterator it;
+        if ( (it= index.find(key)) == index.end() )
+            return(0);
+        lru.splice(lru.begin(),lru,it->second);
+        return(it->second->second);
+    }
+    V *add(const K &key,V *src)
+    {
+        V *ptr = (V *)calloc(1,sizeof(*ptr));
+        NSPV_cachecopy(ptr,src);
+        remove(key);
+        lru.push_front(std::make_pair(key,ptr));
+        index[key] = lru.begin();
+        numbytes += NSPV_cachesize(ptr);
+        while ( numbytes > maxbytes && lru.size() > 1 )
+            remove(lru.back().first);
+        return(ptr);
+    }
+    void remove(const K &key)
+    {
+        typename std::unordered_map<K,typename lrulist::iterator,H>::iterator it; V *ptr;
+        if ( (it= index.find(key)) != index.end() )
+        {
+            ptr = it->second->second;
+            numbytes -= NSPV_cachesize(ptr);
+            NSPV_cachepurge(ptr);
+            free(ptr);
+            lru.erase(it->second);
+            index.erase(it);
+        }
+    }
+    void clear()
+    {
+        while ( lru.size() > 0 )
+            remove(lru.back().first);
+    }
+};
+
+NSPV_lrucache<int32_t,struct NSPV_ntzsresp,std::hash<int32_t> > NSPV_ntzsresp_cache(NSPV_NTZS_CACHEBYTES);
+NSPV_lrucache<std::pair<uint256,uint256>,struct NSPV_ntzsproofresp,NSPV_txidpairhash> NSPV_ntzsproofresp_cache(NSPV_NTZSPROOF_CACHEBYTES);
+NSPV_lrucache<uint256,struct NSPV_txproof,NSPV_txidhash> NSPV_txproof_cache(NSPV_TXPROOF_CACHEBYTES);
+
+// the cached structs can be evicted by the message handler as soon as NSPV_mutex is released, so find copies the entry into
+// the caller's struct, which the caller purges. dest == 0 only checks for it
+
+int32_t NSPV_ntzsresp_find(struct NSPV_ntzsresp *dest,int32_t reqheight)
+{
+    struct NSPV_ntzsresp *ptr; int32_t retval = 0;
+    pthread_mutex_lock(&NSPV_mutex);
+    if ( (ptr= NSPV_ntzsresp_cache.find(reqheight)) != 0 )
+    {
+        if ( dest != 0 )
+        {
+            NSPV_ntzsresp_purge(dest);
+            NSPV_ntzsresp_copy(dest,ptr);
+        }
+        retval = 1;
+    }
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(retval);
 }
 
-struct NSPV_ntzsresp *NSPV_ntzsresp_add(struct NSPV_ntzsresp *ptr)
+void NSPV_ntzsresp_add(struct NSPV_ntzsresp *ptr)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
-        if ( NSPV_ntzsresp_cache[i].reqheight == 0 )
-            break;
-    if ( i == sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache) )
-        i = (rand() % (sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache)));
-    NSPV_ntzsresp_purge(&NSPV_ntzsresp_cache[i]);
-    NSPV_ntzsresp_copy(&NSPV_ntzsresp_cache[i],ptr);
+    pthread_mutex_lock(&NSPV_mutex);
+    NSPV_ntzsresp_cache.add(ptr->reqheight,ptr);
+    pthread_mutex_unlock(&NSPV_mutex);
     fprintf(stderr,"ADD CACHE ntzsresp req.%d\n",ptr->reqheight);
-    return(&NSPV_ntzsresp_cache[i]);
 }
 
-struct NSPV_txproof *NSPV_txproof_find(uint256 txid)
+int32_t NSPV_txproof_find(struct NSPV_txproof *dest,uint256 txid)
 {
-    int32_t i; struct NSPV_txproof *backup = 0;
-    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
-        if ( NSPV_txproof_cache[i].txid == txid )
+    struct NSPV_txproof *ptr; int32_t retval = 0;
+    pthread_mutex_lock(&NSPV_mutex);
+    if ( (ptr= NSPV_txproof_cache.find(txid)) != 0 )
+    {
+        if ( dest != 0 )
         {
-            if ( NSPV_txproof_cache[i].txprooflen != 0 )
-                return(&NSPV_txproof_cache[i]);
-            else backup = &NSPV_txproof_cache[i];
+            NSPV_txproof_purge(dest);
+            NSPV_txproof_copy(dest,ptr);
         }
-    return(backup);
+        retval = 1;
+    }
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(retval);
 }
 
-struct NSPV_txproof *NSPV_txproof_add(struct NSPV_txproof *ptr)
+void NSPV_txproof_add(struct NSPV_txproof *ptr)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
-        if ( NSPV_txproof_cache[i].txid == ptr->txid )
+    struct NSPV_txproof *cached;
+    pthread_mutex_lock(&NSPV_mutex);
+    if ( (cached= NSPV_txproof_cache.find(ptr->txid)) == 0 || (cached->txprooflen == 0 && ptr->txprooflen != 0) )
+    {
+        NSPV_txproof_cache.add(ptr->txid,ptr);
+        fprintf(stderr,"ADD CACHE txproof %s\n",ptr->txid.GetHex().c_str());
+    }
+    pthread_mutex_unlock(&NSPV_mutex);
+}
+
+int32_t NSPV_ntzsproof_find(struct NSPV_ntzsproofresp *dest,uint256 prevtxid,uint256 nexttxid)
+{
+    struct NSPV_ntzsproofresp *ptr; int32_t retval = 0;
+    pthread_mutex_lock(&NSPV_mutex);
+    if ( (ptr= NSPV_ntzsproofresp_cache.find(std::make_pair(prevtxid,nexttxid))) != 0 )
+    {
+        if ( dest != 0 )
         {
-            if ( NSPV_txproof_cache[i].txprooflen == 0 && ptr->txprooflen != 0 )
-            {
-                NSPV_txproof_purge(&NSPV_txproof_cache[i]);
-                NSPV_txproof_copy(&NSPV_txproof_cache[i],ptr);
-                return(&NSPV_txproof_cache[i]);
-            }
-            else if ( NSPV_txproof_cache[i].txprooflen != 0 || ptr->txprooflen == 0 )
-                return(&NSPV_txproof_cache[i]);
+            NSPV_ntzsproofresp_purge(dest);
+            NSPV_ntzsproofresp_copy(dest,ptr);
         }
-    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
-        if ( NSPV_txproof_cache[i].txlen == 0 )
-            break;
-    if ( i == sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache) )
-        i = (rand() % (sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache)));
-    NSPV_txproof_purge(&NSPV_txproof_cache[i]);
-    NSPV_txproof_copy(&NSPV_txproof_cache[i],ptr);
-    fprintf(stderr,"ADD CACHE txproof %s\n",ptr->txid.GetHex().c_str());
-    return(&NSPV_txproof_cache[i]);
+        retval = 1;
+    }
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(retval);
 }
 
-struct NSPV_ntzsproofresp *NSPV_ntzsproof_find(uint256 prevtxid,uint256 nexttxid)
+void NSPV_ntzsproof_add(struct NSPV_ntzsproofresp *ptr)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
-        if ( NSPV_ntzsproofresp_cache[i].prevtxid == prevtxid && NSPV_ntzsproofresp_cache[i].nexttxid == nexttxid )
-            return(&NSPV_ntzsproofresp_cache[i]);
-    return(0);
+    pthread_mutex_lock(&NSPV_mutex);
+    NSPV_ntzsproofresp_cache.add(std::make_pair(ptr->prevtxid,ptr->nexttxid),ptr);
+    pthread_mutex_unlock(&NSPV_mutex);
+    fprintf(stderr,"ADD CACHE ntzsproof %s %s\n",ptr->prevtxid.GetHex().c_str(),ptr->nexttxid.GetHex().c_str());
+}
+
+void NSPV_cacheclear()
+{
+    pthread_mutex_lock(&NSPV_mutex);
+    NSPV_ntzsproofresp_cache.clear();
+    NSPV_txproof_cache.clear();
+    NSPV_ntzsresp_cache.clear();
+    pthread_mutex_unlock(&NSPV_mutex);
+}
+
+// pending requests. a peer that lets a request expire gets the full timeout as its latency sample
+
+void _NSPV_latency(int32_t nodeid,int64_t sample)
+{
+    std::map<int32_t,int64_t>::iterator it;
+    if ( (it= NSPV_latencies.find(nodeid)) == NSPV_latencies.end() )
+        NSPV_latencies[nodeid] = sample;
+    else it->second = (it->second*3 + sample) / 4;
+}
+
+int64_t NSPV_latency(int32_t nodeid)
+{
+    std::map<int32_t,int64_t>::iterator it; int64_t latency = NSPV_LATENCY_INIT;
+    pthread_mutex_lock(&NSPV_mutex);
+    if ( (it= NSPV_latencies.find(nodeid)) != NSPV_latencies.end() )
+        latency = it->second;
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(latency);
+}
+
+void _NSPV_pendingexpire(int64_t now)
+{
+    std::list<struct NSPV_pending>::iterator it;
+    for (it=NSPV_pendings.begin(); it!=NSPV_pendings.end(); )
+    {
+        if ( now > it->senttime + NSPV_PENDINGMICROS )
+        {
+            _NSPV_latency(it->nodeid,NSPV_PENDINGMICROS);
+            it = NSPV_pendings.erase(it);
+        } else it++;
+    }
+}
+
+int64_t NSPV_pendingadd(CNode *pnode,uint8_t resptype,uint256 txid,uint256 txid2,int32_t height)
+{
+    struct NSPV_pending P; int64_t now = GetTimeMicros();
+    P.txid = txid, P.txid2 = txid2, P.height = height;
+    P.resptype = resptype;
+    P.nodeid = (int32_t)pnode->GetId();
+    P.senttime = now;
+    pthread_mutex_lock(&NSPV_mutex);
+    _NSPV_pendingexpire(now);
+    P.reqid = ++NSPV_lastreqid;
+    NSPV_pendings.push_back(P);
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(P.reqid);
 }
 
-struct NSPV_ntzsproofresp *NSPV_ntzsproof_add(struct NSPV_ntzsproofresp *ptr)
+int32_t NSPV_pendingactive(int64_t reqid)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
-        if ( NSPV_ntzsproofresp_cache[i].common.hdrs == 0 )
+    std::list<struct NSPV_pending>::iterator it; int32_t retval = 0;
+    pthread_mutex_lock(&NSPV_mutex);
+    _NSPV_pendingexpire(GetTimeMicros());
+    for (it=NSPV_pendings.begin(); it!=NSPV_pendings.end(); it++)
+        if ( it->reqid == reqid )
+        {
+            retval = 1;
             break;
-    if ( i == sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache) )
-        i = (rand() % (sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache)));
-    NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresp_cache[i]);
-    NSPV_ntzsproofresp_copy(&NSPV_ntzsproofresp_cache[i],ptr);
-    fprintf(stderr,"ADD CACHE ntzsproof %s %s\n",ptr->prevtxid.GetHex().c_str(),ptr->nexttxid.GetHex().c_str());
-    return(&NSPV_ntzsproofresp_cache[i]);
+        }
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(retval);
+}
+
+// completes the oldest request to pfrom that this response answers and wakes up all waiters
+
+void NSPV_pendingdone(CNode *pfrom,uint8_t resptype,uint256 txid,uint256 txid2,int32_t height)
+{
+    std::list<struct NSPV_pending>::iterator it,match; int32_t nodeid = (int32_t)pfrom->GetId(); int64_t now = GetTimeMicros();
+    pthread_mutex_lock(&NSPV_mutex);
+    match = NSPV_pendings.end();
+    for (it=NSPV_pendings.begin(); it!=NSPV_pendings.end(); it++)
+    {
+        if ( it->nodeid != nodeid || it->resptype != resptype )
+            continue;
+        if ( it->txid == txid && it->txid2 == txid2 && it->height == height )
+        {
+            match = it;
+            break;
+        }
+        else if ( match == NSPV_pendings.end() )
+            match = it;
+    }
+    if ( match != NSPV_pendings.end() )
+    {
+        _NSPV_latency(nodeid,now - match->senttime);
+        NSPV_pendings.erase(match);
+    }
+    NSPV_respseqs[resptype]++;
+    pthread_cond_broadcast(&NSPV_cond);
+    pthread_mutex_unlock(&NSPV_mutex);
+}
+
+uint32_t NSPV_respseq(uint8_t resptype)
+{
+    uint32_t seq;
+    pthread_mutex_lock(&NSPV_mutex);
+    seq = NSPV_respseqs[resptype];
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(seq);
+}
+
+int64_t NSPV_deadline()
+{
+    return(GetTimeMicros() + NSPV_PENDINGMICROS);
+}
+
+// blocks until a response of resptype newer than *seqp arrives (returns 1) or deadline passes (returns 0)
+
+int32_t NSPV_respwait(uint8_t resptype,uint32_t *seqp,int64_t deadline)
+{
+    struct timespec ts; int32_t retval = 0;
+    ts.tv_sec = deadline / 1000000;
+    ts.tv_nsec = (deadline % 1000000) * 1000;
+    pthread_mutex_lock(&NSPV_mutex);
+    while ( NSPV_respseqs[resptype] == *seqp && GetTimeMicros() < deadline )
+        pthread_cond_timedwait(&NSPV_cond,&NSPV_mutex,&ts);
+    if ( NSPV_respseqs[resptype] != *seqp )
+    {
+        *seqp = NSPV_respseqs[resptype];
+        retval = 1;
+    }
+    pthread_mutex_unlock(&NSPV_mutex);
+    return(retval);
 }
 
 // komodo_nSPVresp is called from async message processing
 
 void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a response
 {
-    struct NSPV_inforesp I; int32_t len; uint32_t timestamp = (uint32_t)time(NULL);
+    struct NSPV_inforesp I; int32_t len,height = 0; uint256 txid,txid2; uint32_t timestamp = (uint32_t)time(NULL);
     strncpy(NSPV_lastpeer,pfrom->addr.ToString().c_str(),sizeof(NSPV_lastpeer)-1);
     if ( (len= response.size()) > 0 )
     {
@@ -177,22 +395,24 @@ void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a r
            case NSPV_NTZSRESP:
                 NSPV_ntzsresp_purge(&NSPV_ntzsresult);
                 NSPV_rwntzsresp(0,&response[1],&NSPV_ntzsresult);
-                if ( NSPV_ntzsresp_find(NSPV_ntzsresult.reqheight) == 0 )
+                if ( NSPV_ntzsresp_find(0,NSPV_ntzsresult.reqheight) == 0 )
                     NSPV_ntzsresp_add(&NSPV_ntzsresult);
+                height = NSPV_ntzsresult.reqheight;
                 fprintf(stderr,"got ntzs response %u size.%d %s prev.%d, %s next.%d\n",timestamp,(int32_t)response.size(),NSPV_ntzsresult.prevntz.txid.GetHex().c_str(),NSPV_ntzsresult.prevntz.height,NSPV_ntzsresult.nextntz.txid.GetHex().c_str(),NSPV_ntzsresult.nextntz.height);
                 break;
             case NSPV_NTZSPROOFRESP:
                 NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresult);
                 NSPV_rwntzsproofresp(0,&response[1],&NSPV_ntzsproofresult);
-                if ( NSPV_ntzsproof_find(NSPV_ntzsproofresult.prevtxid,NSPV_ntzsproofresult.nexttxid) == 0 )
+                if ( NSPV_ntzsproof_find(0,NSPV_ntzsproofresult.prevtxid,NSPV_ntzsproofresult.nexttxid) == 0 )
                     NSPV_ntzsproof_add(&NSPV_ntzsproofresult);
+                txid = NSPV_ntzsproofresult.prevtxid, txid2 = NSPV_ntzsproofresult.nexttxid;
                 fprintf(stderr,"got ntzproof response %u size.%d prev.%d next.%d\n",timestamp,(int32_t)response.size(),NSPV_ntzsproofresult.common.prevht,NSPV_ntzsproofresult.common.nextht);
                 break;
             case NSPV_TXPROOFRESP:
                 NSPV_txproof_purge(&NSPV_txproofresult);
                 NSPV_rwtxproof(0,&response[1],&NSPV_txproofresult);
-                if ( NSPV_txproof_find(NSPV_txproofresult.txid) == 0 )
-                    NSPV_txproof_add(&NSPV_txproofresult);
+                NSPV_txproof_add(&NSPV_txproofresult);
+                txid = NSPV_txproofresult.txid;
                 fprintf(stderr,"got txproof response %u size.%d %s ht.%d\n",timestamp,(int32_t)response.size(),NSPV_txproofresult.txid.GetHex().c_str(),NSPV_txproofresult.height);
                 break;
             case NSPV_SPENTINFORESP:
@@ -212,16 +432,22 @@ void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a r
                 break;
 
             default: fprintf(stderr,"unexpected response %02x size.%d at %u\n",response[0],(int32_t)response.size(),timestamp);
-                break;
+                return;
         }
+        NSPV_pendingdone(pfrom,response[0],txid,txid2,height);
     }
 }
 
 // superlite message issuing
 
-CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
+// picks the faster of two random eligible peers, so requests spread over all peers but slow ones get fewer.
+// a peer is eligible once per second per request type, same as the fullnode rate limiter
+
+CNode *NSPV_reqsend(int64_t *reqidp,CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind,uint256 txid,uint256 txid2,int32_t height)
 {
-    int32_t n,flag = 0; CNode *pnodes[64]; uint32_t timestamp = (uint32_t)time(NULL);
+    int32_t n,flag = 0; int64_t reqid; CNode *pnodes[64],*alt; uint32_t timestamp = (uint32_t)time(NULL);
+    if ( reqidp != 0 )
+        *reqidp = 0;
     if ( KOMODO_NSPV_FULLNODE )
         return(0);
     if ( pnode == 0 )
@@ -244,7 +470,12 @@ CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
             } // else fprintf(stderr,"nServices %llx vs mask %llx, t%u vs %u, ind.%d\n",(long long)ptr->nServices,(long long)mask,timestamp,ptr->prevtimes[ind],ind);
         }
         if ( n > 0 )
+        {
             pnode = pnodes[rand() % n];
+            alt = pnodes[rand() % n];
+            if ( NSPV_latency((int32_t)alt->GetId()) < NSPV_latency((int32_t)pnode->GetId()) )
+                pnode = alt;
+        }
     } else flag = 1;
     if ( pnode != 0 )
     {
@@ -253,6 +484,9 @@ CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
         memcpy(&request[0],msg,len);
         if ( (0) && KOMODO_NSPV_SUPERLITE )
             fprintf(stderr,"pushmessage [%d] len.%d\n",msg[0],len);
+        reqid = NSPV_pendingadd(pnode,msg[0]+1,txid,txid2,height);
+        if ( reqidp != 0 )
+            *reqidp = reqid;
         pnode->PushMessage("getnSPV",request);
         pnode->prevtimes[ind] = timestamp;
         return(pnode);
@@ -260,6 +494,11 @@ CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
     return(0);
 }
 
+CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
+{
+    return(NSPV_reqsend(0,pnode,msg,len,mask,ind,zeroid,zeroid,0));
+}
+
 UniValue NSPV_logout()
 {
     UniValue result(UniValue::VOBJ);
@@ -267,9 +506,7 @@ UniValue NSPV_logout()
     if ( NSPV_logintime != 0 )
         fprintf(stderr,"scrub wif and privkey from NSPV memory\n");
     else result.push_back(Pair("status","wasnt logged in"));
-    memset(NSPV_ntzsproofresp_cache,0,sizeof(NSPV_ntzsproofresp_cache));
-    memset(NSPV_txproof_cache,0,sizeof(NSPV_txproof_cache));
-    memset(NSPV_ntzsresp_cache,0,sizeof(NSPV_ntzsresp_cache));
+    NSPV_cacheclear();
     memset(NSPV_wifstr,0,sizeof(NSPV_wifstr));
     memset(&NSPV_key,0,sizeof(NSPV_key));
     NSPV_logintime = 0;
@@ -555,20 +792,23 @@ UniValue NSPV_login(char *wifstr)
 
 UniValue NSPV_getinfo_req(int32_t reqht)
 {
-    uint8_t msg[512]; int32_t i,iter,len = 0; struct NSPV_inforesp I;
+    uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,len = 0; struct NSPV_inforesp I;
     NSPV_inforesp_purge(&NSPV_inforesult);
     msg[len++] = NSPV_INFO;
     len += iguana_rwnum(1,&msg[len],sizeof(reqht),&reqht);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_inforesult.height != 0 )
-                return(NSPV_getinfo_json(&NSPV_inforesult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_inforesult.height != 0 )
+                    return(NSPV_getinfo_json(&NSPV_inforesult));
+            }
+        } else sleep(1);
+    }
     memset(&I,0,sizeof(I));
     return(NSPV_getinfo_json(&NSPV_inforesult));
 }
@@ -593,7 +833,7 @@ uint32_t NSPV_blocktime(int32_t hdrheight)
 
 UniValue NSPV_addressutxos(char *coinaddr,int32_t CCflag,int32_t skipcount,int32_t filter)
 {
-    UniValue result(UniValue::VOBJ); uint8_t msg[512]; int32_t i,iter,slen,len = 0;
+    UniValue result(UniValue::VOBJ); uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,slen,len = 0;
     //fprintf(stderr,"utxos %s NSPV addr %s\n",coinaddr,NSPV_address.c_str());
     //if ( NSPV_utxosresult.nodeheight >= NSPV_inforesult.height && strcmp(coinaddr,NSPV_utxosresult.coinaddr) == 0 && CCflag == NSPV_utxosresult.CCflag  && skipcount == NSPV_utxosresult.skipcount && filter == NSPV_utxosresult.filter )
     //    return(NSPV_utxosresp_json(&NSPV_utxosresult));
@@ -614,15 +854,18 @@ UniValue NSPV_addressutxos(char *coinaddr,int32_t CCflag,int32_t skipcount,int32
     len += iguana_rwnum(1,&msg[len],sizeof(skipcount),&skipcount);
     len += iguana_rwnum(1,&msg[len],sizeof(filter),&filter);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_ADDRINDEX,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_ADDRINDEX,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( (NSPV_inforesult.height == 0 || NSPV_utxosresult.nodeheight >= NSPV_inforesult.height) && strcmp(coinaddr,NSPV_utxosresult.coinaddr) == 0 && CCflag == NSPV_utxosresult.CCflag )
-                return(NSPV_utxosresp_json(&NSPV_utxosresult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( (NSPV_inforesult.height == 0 || NSPV_utxosresult.nodeheight >= NSPV_inforesult.height) && strcmp(coinaddr,NSPV_utxosresult.coinaddr) == 0 && CCflag == NSPV_utxosresult.CCflag )
+                    return(NSPV_utxosresp_json(&NSPV_utxosresult));
+            }
+        } else sleep(1);
+    }
     result.push_back(Pair("result","error"));
     result.push_back(Pair("error","no utxos result"));
     result.push_back(Pair("lastpeer",NSPV_lastpeer));
@@ -631,7 +874,7 @@ UniValue NSPV_addressutxos(char *coinaddr,int32_t CCflag,int32_t skipcount,int32
 
 UniValue NSPV_addresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,int32_t filter)
 {
-    UniValue result(UniValue::VOBJ); uint8_t msg[512]; int32_t i,iter,slen,len = 0;
+    UniValue result(UniValue::VOBJ); uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,slen,len = 0;
     if ( NSPV_txidsresult.nodeheight >= NSPV_inforesult.height && strcmp(coinaddr,NSPV_txidsresult.coinaddr) == 0 && CCflag == NSPV_txidsresult.CCflag && skipcount == NSPV_txidsresult.skipcount )
         return(NSPV_txidsresp_json(&NSPV_txidsresult));
     if ( skipcount < 0 )
@@ -652,15 +895,18 @@ UniValue NSPV_addresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,int32
     len += iguana_rwnum(1,&msg[len],sizeof(filter),&filter);
     //fprintf(stderr,"skipcount.%d\n",skipcount);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_ADDRINDEX,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_ADDRINDEX,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( (NSPV_inforesult.height == 0 || NSPV_txidsresult.nodeheight >= NSPV_inforesult.height) && strcmp(coinaddr,NSPV_txidsresult.coinaddr) == 0 && CCflag == NSPV_txidsresult.CCflag )
-                return(NSPV_txidsresp_json(&NSPV_txidsresult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( (NSPV_inforesult.height == 0 || NSPV_txidsresult.nodeheight >= NSPV_inforesult.height) && strcmp(coinaddr,NSPV_txidsresult.coinaddr) == 0 && CCflag == NSPV_txidsresult.CCflag )
+                    return(NSPV_txidsresp_json(&NSPV_txidsresult));
+            }
+        } else sleep(1);
+    }
     result.push_back(Pair("result","error"));
     result.push_back(Pair("error","no txid result"));
     result.push_back(Pair("lastpeer",NSPV_lastpeer));
@@ -669,7 +915,7 @@ UniValue NSPV_addresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,int32
 
 UniValue NSPV_ccaddresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,uint256 filtertxid,uint8_t evalcode, uint8_t func)
 {
-    UniValue result(UniValue::VOBJ); uint8_t msg[512],funcid=NSPV_CC_TXIDS; char zeroes[64]; int32_t i,iter,slen,len = 0,vout;
+    UniValue result(UniValue::VOBJ); uint8_t msg[512],funcid=NSPV_CC_TXIDS; char zeroes[64]; uint32_t seq; int64_t deadline; int32_t iter,slen,len = 0,vout;
     NSPV_mempoolresp_purge(&NSPV_mempoolresult);
     memset(zeroes,0,sizeof(zeroes));
     if ( coinaddr == 0 )
@@ -691,15 +937,18 @@ UniValue NSPV_ccaddresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,uin
     memcpy(&msg[len],coinaddr,slen), len += slen;
     fprintf(stderr,"(%s) func.%d CC.%d %s skipcount.%d len.%d\n",coinaddr,NSPV_CC_TXIDS,CCflag,filtertxid.GetHex().c_str(),skipcount,len);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_mempoolresult.nodeheight >= NSPV_inforesult.height && strcmp(coinaddr,NSPV_mempoolresult.coinaddr) == 0 && CCflag == NSPV_mempoolresult.CCflag && filtertxid == NSPV_mempoolresult.txid && vout == NSPV_mempoolresult.vout && funcid == NSPV_mempoolresult.funcid )
-                return(NSPV_mempoolresp_json(&NSPV_mempoolresult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_mempoolresult.nodeheight >= NSPV_inforesult.height && strcmp(coinaddr,NSPV_mempoolresult.coinaddr) == 0 && CCflag == NSPV_mempoolresult.CCflag && filtertxid == NSPV_mempoolresult.txid && vout == NSPV_mempoolresult.vout && funcid == NSPV_mempoolresult.funcid )
+                    return(NSPV_mempoolresp_json(&NSPV_mempoolresult));
+            }
+        } else sleep(1);
+    }
     result.push_back(Pair("result","error"));
     result.push_back(Pair("error","no txid result"));
     result.push_back(Pair("lastpeer",NSPV_lastpeer));
@@ -708,7 +957,7 @@ UniValue NSPV_ccaddresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,uin
 
 UniValue NSPV_mempooltxids(char *coinaddr,int32_t CCflag,uint8_t funcid,uint256 txid,int32_t vout)
 {
-    UniValue result(UniValue::VOBJ); uint8_t msg[512]; char zeroes[64]; int32_t i,iter,slen,len = 0;
+    UniValue result(UniValue::VOBJ); uint8_t msg[512]; char zeroes[64]; uint32_t seq; int64_t deadline; int32_t iter,slen,len = 0;
     NSPV_mempoolresp_purge(&NSPV_mempoolresult);
     memset(zeroes,0,sizeof(zeroes));
     if ( coinaddr == 0 )
@@ -729,15 +978,18 @@ UniValue NSPV_mempooltxids(char *coinaddr,int32_t CCflag,uint8_t funcid,uint256
     memcpy(&msg[len],coinaddr,slen), len += slen;
     fprintf(stderr,"(%s) func.%d CC.%d %s/v%d len.%d\n",coinaddr,funcid,CCflag,txid.GetHex().c_str(),vout,len);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_mempoolresult.nodeheight >= NSPV_inforesult.height && strcmp(coinaddr,NSPV_mempoolresult.coinaddr) == 0 && CCflag == NSPV_mempoolresult.CCflag && txid == NSPV_mempoolresult.txid && vout == NSPV_mempoolresult.vout && funcid == NSPV_mempoolresult.funcid )
-                return(NSPV_mempoolresp_json(&NSPV_mempoolresult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_mempoolresult.nodeheight >= NSPV_inforesult.height && strcmp(coinaddr,NSPV_mempoolresult.coinaddr) == 0 && CCflag == NSPV_mempoolresult.CCflag && txid == NSPV_mempoolresult.txid && vout == NSPV_mempoolresult.vout && funcid == NSPV_mempoolresult.funcid )
+                    return(NSPV_mempoolresp_json(&NSPV_mempoolresult));
+            }
+        } else sleep(1);
+    }
     result.push_back(Pair("result","error"));
     result.push_back(Pair("error","no txid result"));
     result.push_back(Pair("lastpeer",NSPV_lastpeer));
@@ -783,125 +1035,277 @@ bool NSPV_evalcode_inmempool(uint8_t evalcode,uint8_t funcid)
     else return(false);
 }
 
-UniValue NSPV_notarizations(int32_t reqheight)
+// txproofs, notarizations and ntzsproofs can be in flight to several peers at once. responses land in the caches,
+// so the waits below check the cache rather than the global result, which another response may have overwritten
+
+int32_t NSPV_ntzsmsg(uint8_t *msg,int32_t reqheight)
 {
-    uint8_t msg[512]; int32_t i,iter,len = 0; struct NSPV_ntzsresp N,*ptr;
-    if ( (ptr= NSPV_ntzsresp_find(reqheight)) != 0 )
-    {
-        fprintf(stderr,"FROM CACHE NSPV_notarizations.%d\n",reqheight);
-        NSPV_ntzsresp_purge(&NSPV_ntzsresult);
-        NSPV_ntzsresp_copy(&NSPV_ntzsresult,ptr);
-        return(NSPV_ntzsresp_json(ptr));
-    }
+    int32_t len = 0;
     msg[len++] = NSPV_NTZS;
     len += iguana_rwnum(1,&msg[len],sizeof(reqheight),&reqheight);
-    for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
+    return(len);
+}
+
+int32_t NSPV_ntzsproofmsg(uint8_t *msg,uint256 prevtxid,uint256 nexttxid)
+{
+    int32_t len = 0;
+    msg[len++] = NSPV_NTZSPROOF;
+    len += iguana_rwbignum(1,&msg[len],sizeof(prevtxid),(uint8_t *)&prevtxid);
+    len += iguana_rwbignum(1,&msg[len],sizeof(nexttxid),(uint8_t *)&nexttxid);
+    return(len);
+}
+
+int32_t NSPV_txproofmsg(uint8_t *msg,int32_t vout,uint256 txid,int32_t height)
+{
+    int32_t len = 0;
+    msg[len++] = NSPV_TXPROOF;
+    len += iguana_rwnum(1,&msg[len],sizeof(height),&height);
+    len += iguana_rwnum(1,&msg[len],sizeof(vout),&vout);
+    len += iguana_rwbignum(1,&msg[len],sizeof(txid),(uint8_t *)&txid);
+    return(len);
+}
+
+struct NSPV_prefetchreq
+{
+    uint8_t msg[128];
+    uint256 txid,txid2;
+    int64_t reqid;
+    int32_t len,height,tries;
+};
+
+struct NSPV_prefetchreq NSPV_prefetchreq_ntzs(int32_t reqheight)
+{
+    struct NSPV_prefetchreq R;
+    memset(&R,0,sizeof(R));
+    R.len = NSPV_ntzsmsg(R.msg,reqheight);
+    R.height = reqheight;
+    return(R);
+}
+
+struct NSPV_prefetchreq NSPV_prefetchreq_ntzsproof(uint256 prevtxid,uint256 nexttxid)
+{
+    struct NSPV_prefetchreq R;
+    memset(&R,0,sizeof(R));
+    R.len = NSPV_ntzsproofmsg(R.msg,prevtxid,nexttxid);
+    R.txid = prevtxid, R.txid2 = nexttxid;
+    return(R);
+}
+
+struct NSPV_prefetchreq NSPV_prefetchreq_txproof(int32_t vout,uint256 txid,int32_t height)
+{
+    struct NSPV_prefetchreq R;
+    memset(&R,0,sizeof(R));
+    R.len = NSPV_txproofmsg(R.msg,vout,txid,height);
+    R.txid = txid;
+    return(R);
+}
+
+int32_t NSPV_prefetched(struct NSPV_prefetchreq *req)
+{
+    switch ( req->msg[0] )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        case NSPV_NTZS: return(NSPV_ntzsresp_find(0,req->height));
+        case NSPV_NTZSPROOF: return(NSPV_ntzsproof_find(0,req->txid,req->txid2));
+        case NSPV_TXPROOF: return(NSPV_txproof_find(0,req->txid));
+    }
+    return(1);
+}
+
+// sends a batch of same type requests to as many peers as the rate limiter allows, resends whatever is still missing
+// each second and returns once all are cached, have failed 3 times, or nothing arrived for NSPV_PENDINGMICROS
+
+int32_t NSPV_prefetch(std::vector<struct NSPV_prefetchreq> &reqs)
+{
+    int32_t i,numdone,prevdone = 0,numwaiting,numblocked; uint32_t seq; int64_t now,deadline,waituntil;
+    if ( reqs.size() == 0 )
+        return(0);
+    deadline = NSPV_deadline();
+    while ( 1 )
+    {
+        seq = NSPV_respseq(reqs[0].msg[0]+1);
+        numdone = numwaiting = numblocked = 0;
+        for (i=0; i<reqs.size(); i++)
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_ntzsresult.reqheight == reqheight )
-                return(NSPV_ntzsresp_json(&NSPV_ntzsresult));
+            if ( NSPV_prefetched(&reqs[i]) != 0 )
+                numdone++;
+            else if ( reqs[i].reqid != 0 && NSPV_pendingactive(reqs[i].reqid) != 0 )
+                numwaiting++;
+            else if ( reqs[i].tries < 3 )
+            {
+                if ( numblocked == 0 && NSPV_reqsend(&reqs[i].reqid,0,reqs[i].msg,reqs[i].len,NODE_NSPV,reqs[i].msg[0]>>1,reqs[i].txid,reqs[i].txid2,reqs[i].height) != 0 )
+                {
+                    reqs[i].tries++;
+                    numwaiting++;
+                } else numblocked++;
+            }
         }
-    } else sleep(1);
-    memset(&N,0,sizeof(N));
-    return(NSPV_ntzsresp_json(&N));
+        now = GetTimeMicros();
+        if ( numdone > prevdone )
+        {
+            prevdone = numdone;
+            deadline = now + NSPV_PENDINGMICROS;
+        }
+        if ( (numwaiting == 0 && numblocked == 0) || now >= deadline )
+            break;
+        waituntil = deadline;
+        if ( numblocked != 0 && (now/1000000 + 1) * 1000000 < waituntil )
+            waituntil = (now/1000000 + 1) * 1000000;
+        NSPV_respwait(reqs[0].msg[0]+1,&seq,waituntil);
+    }
+    LogPrint("nspv", "prefetch type.%d %d of %d\n", reqs[0].msg[0], numdone, (int32_t)reqs.size());
+    return(numdone);
 }
 
-UniValue NSPV_txidhdrsproof(uint256 prevtxid,uint256 nexttxid)
+// the _get functions request whatever is not cached yet and copy the response into dest, which the caller purges.
+// NSPV_ntzsresult, NSPV_ntzsproofresult and NSPV_txproofresult are only written by the message handler
+
+int32_t NSPV_ntzsresp_get(struct NSPV_ntzsresp *dest,int32_t reqheight)
 {
-    uint8_t msg[512]; int32_t i,iter,len = 0; struct NSPV_ntzsproofresp P,*ptr;
-    if ( (ptr= NSPV_ntzsproof_find(prevtxid,nexttxid)) != 0 )
+    uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,len;
+    if ( NSPV_ntzsresp_find(dest,reqheight) != 0 )
     {
-        fprintf(stderr,"FROM CACHE NSPV_txidhdrsproof %s %s\n",ptr->prevtxid.GetHex().c_str(),ptr->nexttxid.GetHex().c_str());
-        NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresult);
-        NSPV_ntzsproofresp_copy(&NSPV_ntzsproofresult,ptr);
-        return(NSPV_ntzsproof_json(ptr));
+        fprintf(stderr,"FROM CACHE NSPV_notarizations.%d\n",reqheight);
+        return(1);
     }
-    NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresult);
-    msg[len++] = NSPV_NTZSPROOF;
-    len += iguana_rwbignum(1,&msg[len],sizeof(prevtxid),(uint8_t *)&prevtxid);
-    len += iguana_rwbignum(1,&msg[len],sizeof(nexttxid),(uint8_t *)&nexttxid);
+    len = NSPV_ntzsmsg(msg,reqheight);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_ntzsproofresult.prevtxid == prevtxid && NSPV_ntzsproofresult.nexttxid == nexttxid )
-                return(NSPV_ntzsproof_json(&NSPV_ntzsproofresult));
-        }
-    } else sleep(1);
-    memset(&P,0,sizeof(P));
-    return(NSPV_ntzsproof_json(&P));
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_ntzsresp_find(dest,reqheight) != 0 )
+                    return(1);
+            }
+        } else sleep(1);
+    }
+    return(0);
 }
 
-UniValue NSPV_hdrsproof(int32_t prevht,int32_t nextht)
+int32_t NSPV_ntzsproof_get(struct NSPV_ntzsproofresp *dest,uint256 prevtxid,uint256 nexttxid)
 {
-    uint256 prevtxid,nexttxid;
-    NSPV_notarizations(prevht);
-    prevtxid = NSPV_ntzsresult.prevntz.txid;
-    NSPV_notarizations(nextht);
-    nexttxid = NSPV_ntzsresult.nextntz.txid;
-    return(NSPV_txidhdrsproof(prevtxid,nexttxid));
+    uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,len;
+    if ( NSPV_ntzsproof_find(dest,prevtxid,nexttxid) != 0 )
+    {
+        fprintf(stderr,"FROM CACHE NSPV_txidhdrsproof %s %s\n",prevtxid.GetHex().c_str(),nexttxid.GetHex().c_str());
+        return(1);
+    }
+    len = NSPV_ntzsproofmsg(msg,prevtxid,nexttxid);
+    for (iter=0; iter<3; iter++)
+    {
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
+        {
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_ntzsproof_find(dest,prevtxid,nexttxid) != 0 )
+                    return(1);
+            }
+        } else sleep(1);
+    }
+    return(0);
 }
 
-UniValue NSPV_txproof(int32_t vout,uint256 txid,int32_t height)
+int32_t NSPV_txproof_get(struct NSPV_txproof *dest,int32_t vout,uint256 txid,int32_t height)
 {
-    uint8_t msg[512]; int32_t i,iter,len = 0; struct NSPV_txproof P,*ptr;
-    if ( (ptr= NSPV_txproof_find(txid)) != 0 )
+    uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,len;
+    if ( NSPV_txproof_find(dest,txid) != 0 )
     {
         fprintf(stderr,"FROM CACHE NSPV_txproof %s\n",txid.GetHex().c_str());
-        NSPV_txproof_purge(&NSPV_txproofresult);
-        NSPV_txproof_copy(&NSPV_txproofresult,ptr);
-        return(NSPV_txproof_json(ptr));
+        return(1);
     }
-    NSPV_txproof_purge(&NSPV_txproofresult);
-    msg[len++] = NSPV_TXPROOF;
-    len += iguana_rwnum(1,&msg[len],sizeof(height),&height);
-    len += iguana_rwnum(1,&msg[len],sizeof(vout),&vout);
-    len += iguana_rwbignum(1,&msg[len],sizeof(txid),(uint8_t *)&txid);
+    len = NSPV_txproofmsg(msg,vout,txid,height);
     fprintf(stderr,"req txproof %s/v%d at height.%d\n",txid.GetHex().c_str(),vout,height);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_txproofresult.txid == txid )
-                return(NSPV_txproof_json(&NSPV_txproofresult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_txproof_find(dest,txid) != 0 )
+                    return(1);
+            }
+        } else sleep(1);
+    }
     fprintf(stderr,"txproof timeout\n");
+    return(0);
+}
+
+UniValue NSPV_notarizations(int32_t reqheight)
+{
+    UniValue result; struct NSPV_ntzsresp N;
+    memset(&N,0,sizeof(N));
+    NSPV_ntzsresp_get(&N,reqheight);
+    result = NSPV_ntzsresp_json(&N);
+    NSPV_ntzsresp_purge(&N);
+    return(result);
+}
+
+UniValue NSPV_txidhdrsproof(uint256 prevtxid,uint256 nexttxid)
+{
+    UniValue result; struct NSPV_ntzsproofresp P;
     memset(&P,0,sizeof(P));
-    return(NSPV_txproof_json(&P));
+    NSPV_ntzsproof_get(&P,prevtxid,nexttxid);
+    result = NSPV_ntzsproof_json(&P);
+    NSPV_ntzsproofresp_purge(&P);
+    return(result);
+}
+
+UniValue NSPV_hdrsproof(int32_t prevht,int32_t nextht)
+{
+    uint256 prevtxid,nexttxid; struct NSPV_ntzsresp N;
+    memset(&N,0,sizeof(N));
+    NSPV_ntzsresp_get(&N,prevht);
+    prevtxid = N.prevntz.txid;
+    NSPV_ntzsresp_purge(&N);
+    NSPV_ntzsresp_get(&N,nextht);
+    nexttxid = N.nextntz.txid;
+    NSPV_ntzsresp_purge(&N);
+    return(NSPV_txidhdrsproof(prevtxid,nexttxid));
+}
+
+UniValue NSPV_txproof(int32_t vout,uint256 txid,int32_t height)
+{
+    UniValue result; struct NSPV_txproof P;
+    memset(&P,0,sizeof(P));
+    NSPV_txproof_get(&P,vout,txid,height);
+    result = NSPV_txproof_json(&P);
+    NSPV_txproof_purge(&P);
+    return(result);
 }
 
 UniValue NSPV_spentinfo(uint256 txid,int32_t vout)
 {
-    uint8_t msg[512]; int32_t i,iter,len = 0; struct NSPV_spentinfo I;
+    uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter,len = 0; struct NSPV_spentinfo I;
     NSPV_spentinfo_purge(&NSPV_spentresult);
     msg[len++] = NSPV_SPENTINFO;
     len += iguana_rwnum(1,&msg[len],sizeof(vout),&vout);
     len += iguana_rwbignum(1,&msg[len],sizeof(txid),(uint8_t *)&txid);
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_SPENTINDEX,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_SPENTINDEX,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_spentresult.txid == txid && NSPV_spentresult.vout == vout )
-                return(NSPV_spentinfo_json(&NSPV_spentresult));
-        }
-    } else sleep(1);
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
+            {
+                if ( NSPV_spentresult.txid == txid && NSPV_spentresult.vout == vout )
+                    return(NSPV_spentinfo_json(&NSPV_spentresult));
+            }
+        } else sleep(1);
+    }
     memset(&I,0,sizeof(I));
     return(NSPV_spentinfo_json(&I));
 }
 
 UniValue NSPV_broadcast(char *hex)
 {
-    uint8_t *msg,*data; uint256 txid; int32_t i,n,iter,len = 0; struct NSPV_broadcastresp B;
+    uint8_t *msg,*data; uint256 txid; uint32_t seq; int64_t deadline; int32_t n,iter,len = 0; struct NSPV_broadcastresp B;
     NSPV_broadcast_purge(&NSPV_broadcastresult);
     n = (int32_t)strlen(hex) >> 1;
     data = (uint8_t *)malloc(n);
@@ -915,18 +1319,21 @@ UniValue NSPV_broadcast(char *hex)
     free(data);
     //fprintf(stderr,"send txid.%s\n",txid.GetHex().c_str());
     for (iter=0; iter<3; iter++)
-    if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
     {
-        for (i=0; i<NSPV_POLLITERS; i++)
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1) != 0 )
         {
-            usleep(NSPV_POLLMICROS);
-            if ( NSPV_broadcastresult.txid == txid )
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
             {
-                free(msg);
-                return(NSPV_broadcast_json(&NSPV_broadcastresult,txid));
+                if ( NSPV_broadcastresult.txid == txid )
+                {
+                    free(msg);
+                    return(NSPV_broadcast_json(&NSPV_broadcastresult,txid));
+                }
             }
-        }
-    } else sleep(1);
+        } else sleep(1);
+    }
     free(msg);
     memset(&B,0,sizeof(B));
     B.retcode = -2;
@@ -939,7 +1346,7 @@ UniValue NSPV_broadcast(char *hex)
 // For second+ funcids the filtertxid will be compared to txid in opret
 UniValue NSPV_ccmoduleutxos(char *coinaddr, int64_t amount, uint8_t evalcode, std::string funcids, uint256 filtertxid)
 {
-    UniValue result(UniValue::VOBJ); uint8_t msg[512]; int32_t i, iter, slen, len = 0;
+    UniValue result(UniValue::VOBJ); uint8_t msg[512]; uint32_t seq; int64_t deadline; int32_t iter, slen, len = 0;
     uint8_t CCflag = 1;
 
     NSPV_utxosresp_purge(&NSPV_utxosresult);
@@ -963,17 +1370,19 @@ UniValue NSPV_ccmoduleutxos(char *coinaddr, int64_t amount, uint8_t evalcode, st
     memcpy(&msg[len], funcids.data(), slen), len += slen;
 
     len += iguana_rwbignum(1, &msg[len], sizeof(filtertxid), (uint8_t *)&filtertxid);
-    for (iter = 0; iter<3; iter++)
-        if (NSPV_req(0, msg, len, NODE_ADDRINDEX, msg[0] >> 1) != 0)
+    for (iter=0; iter<3; iter++)
+    {
+        seq = NSPV_respseq(msg[0]+1);
+        if ( NSPV_req(0,msg,len,NODE_ADDRINDEX,msg[0]>>1) != 0 )
         {
-            for (i = 0; i<NSPV_POLLITERS; i++)
+            deadline = NSPV_deadline();
+            while ( NSPV_respwait(msg[0]+1,&seq,deadline) != 0 )
             {
-                usleep(NSPV_POLLMICROS);
                 if ((NSPV_inforesult.height == 0 || NSPV_utxosresult.nodeheight >= NSPV_inforesult.height) && strcmp(coinaddr, NSPV_utxosresult.coinaddr) == 0 && CCflag == NSPV_utxosresult.CCflag)
                     return(NSPV_utxosresp_json(&NSPV_utxosresult));
             }
-        }
-        else sleep(1);
+        } else sleep(1);
+    }
         result.push_back(Pair("result", "error"));
         result.push_back(Pair("error", "no utxos result"));
         result.push_back(Pair("lastpeer", NSPV_lastpeer));
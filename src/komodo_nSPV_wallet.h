@@ -44,7 +44,6 @@ int32_t NSPV_validatehdrs(struct NSPV_ntzsproofresp *ptr)
         if ( blockhash != ptr->common.hdrs[i].hashPrevBlock )
             return(-i-13);
     }
-    sleep(1); // need this to get past the once per second rate limiter per message
     if ( NSPV_txextract(tx,ptr->prevntz,ptr->prevtxlen) < 0 )
         return(-8);
     else if ( tx.GetHash() != ptr->prevtxid )
@@ -60,28 +59,28 @@ int32_t NSPV_validatehdrs(struct NSPV_ntzsproofresp *ptr)
 
 int32_t NSPV_gettransaction(int32_t skipvalidation,int32_t vout,uint256 txid,int32_t height,CTransaction &tx,uint256 &hashblock,int32_t &txheight,int32_t &currentheight,int64_t extradata,uint32_t tiptime,int64_t &rewardsum)
 {
-    struct NSPV_txproof *ptr; int32_t i,offset,retval; int64_t rewards = 0; uint32_t nLockTime; std::vector<uint8_t> proof;
+    struct NSPV_txproof P; struct NSPV_ntzsresp N; struct NSPV_ntzsproofresp H; int32_t i,offset,retval; int64_t rewards = 0; uint32_t nLockTime; std::vector<uint8_t> proof;
     retval = skipvalidation != 0 ? 0 : -1;
+    memset(&P,0,sizeof(P));
+    memset(&N,0,sizeof(N));
+    memset(&H,0,sizeof(H));
 
     //fprintf(stderr,"NSPV_gettx %s/v%d ht.%d\n",txid.GetHex().c_str(),vout,height);
-    if ( (ptr= NSPV_txproof_find(txid)) == 0 )
-    {
-        NSPV_txproof(vout,txid,height);
-        ptr = &NSPV_txproofresult;
-    }
-    hashblock=ptr->hashblock;
-    txheight=ptr->height;
+    NSPV_txproof_get(&P,vout,txid,height);
+    hashblock=P.hashblock;
+    txheight=P.height;
     currentheight=NSPV_inforesult.height;
-    if ( ptr->txid != txid )
+    if ( P.txid != txid )
     {
-        fprintf(stderr,"txproof error %s != %s\n",ptr->txid.GetHex().c_str(),txid.GetHex().c_str());
+        fprintf(stderr,"txproof error %s != %s\n",P.txid.GetHex().c_str(),txid.GetHex().c_str());
+        NSPV_txproof_purge(&P);
         return(-1);
     }
-    else if ( NSPV_txextract(tx,ptr->tx,ptr->txlen) < 0 || ptr->txlen <= 0 )
+    else if ( NSPV_txextract(tx,P.tx,P.txlen) < 0 || P.txlen <= 0 )
         retval = -2000;
     else if ( tx.GetHash() != txid )
         retval = -2001;
-    else if ( skipvalidation == 0 && ptr->unspentvalue <= 0 )
+    else if ( skipvalidation == 0 && P.unspentvalue <= 0 )
         retval = -2002;
     else if ( ASSETCHAINS_SYMBOL[0] == 0 && tiptime != 0 )
     {
@@ -96,42 +95,44 @@ int32_t NSPV_gettransaction(int32_t skipvalidation,int32_t vout,uint256 txid,int
     
     if ( skipvalidation == 0 )
     {
-        if ( ptr->txprooflen > 0 )
+        if ( P.txprooflen > 0 )
         {
-            proof.resize(ptr->txprooflen);
-            memcpy(&proof[0],ptr->txproof,ptr->txprooflen);
+            proof.resize(P.txprooflen);
+            memcpy(&proof[0],P.txproof,P.txprooflen);
         }
-        NSPV_notarizations(height); // gets the prev and next notarizations
-        if ( NSPV_inforesult.notarization.height >= height && (NSPV_ntzsresult.prevntz.height == 0 || NSPV_ntzsresult.prevntz.height >= NSPV_ntzsresult.nextntz.height) )
+        NSPV_ntzsresp_get(&N,height); // gets the prev and next notarizations
+        if ( NSPV_inforesult.notarization.height >= height && (N.prevntz.height == 0 || N.prevntz.height >= N.nextntz.height) )
         {
             fprintf(stderr,"issue manual bracket\n");
             NSPV_notarizations(height-1);
             NSPV_notarizations(height+1);
-            NSPV_notarizations(height); // gets the prev and next notarizations
+            NSPV_ntzsresp_get(&N,height); // gets the prev and next notarizations
         }
-        if ( NSPV_ntzsresult.prevntz.height != 0 && NSPV_ntzsresult.prevntz.height <= NSPV_ntzsresult.nextntz.height )
+        if ( N.prevntz.height != 0 && N.prevntz.height <= N.nextntz.height )
         {
-            fprintf(stderr,">>>>> gettx ht.%d prev.%d next.%d\n",height,NSPV_ntzsresult.prevntz.height, NSPV_ntzsresult.nextntz.height);
-            offset = (height - NSPV_ntzsresult.prevntz.height);
-            if ( offset >= 0 && height <= NSPV_ntzsresult.nextntz.height )
+            fprintf(stderr,">>>>> gettx ht.%d prev.%d next.%d\n",height,N.prevntz.height, N.nextntz.height);
+            offset = (height - N.prevntz.height);
+            if ( offset >= 0 && height <= N.nextntz.height )
             {
-                //fprintf(stderr,"call NSPV_txidhdrsproof %s %s\n",NSPV_ntzsresult.prevntz.txid.GetHex().c_str(),NSPV_ntzsresult.nextntz.txid.GetHex().c_str());
-                NSPV_txidhdrsproof(NSPV_ntzsresult.prevntz.txid,NSPV_ntzsresult.nextntz.txid);
-                usleep(10000);
-                if ( (retval= NSPV_validatehdrs(&NSPV_ntzsproofresult)) == 0 )
+                //fprintf(stderr,"call NSPV_txidhdrsproof %s %s\n",N.prevntz.txid.GetHex().c_str(),N.nextntz.txid.GetHex().c_str());
+                NSPV_ntzsproof_get(&H,N.prevntz.txid,N.nextntz.txid);
+                if ( (retval= NSPV_validatehdrs(&H)) == 0 )
                 {
                     std::vector<uint256> txids; uint256 proofroot;
                     proofroot = BitcoinGetProofMerkleRoot(proof,txids);
-                    if ( proofroot != NSPV_ntzsproofresult.common.hdrs[offset].hashMerkleRoot || txids[0] != txid )
+                    if ( proofroot != H.common.hdrs[offset].hashMerkleRoot || txids[0] != txid )
                     {
                         fprintf(stderr,"txid.%s vs txids[0] %s\n",txid.GetHex().c_str(),txids[0].GetHex().c_str());
-                        fprintf(stderr,"prooflen.%d proofroot.%s vs %s\n",(int32_t)proof.size(),proofroot.GetHex().c_str(),NSPV_ntzsproofresult.common.hdrs[offset].hashMerkleRoot.GetHex().c_str());
+                        fprintf(stderr,"prooflen.%d proofroot.%s vs %s\n",(int32_t)proof.size(),proofroot.GetHex().c_str(),H.common.hdrs[offset].hashMerkleRoot.GetHex().c_str());
                         retval = -2003;
                     } else retval = 0;
                 }
             } else retval = -2005;
         } else retval = -2004;
     }
+    NSPV_txproof_purge(&P);
+    NSPV_ntzsresp_purge(&N);
+    NSPV_ntzsproofresp_purge(&H);
     return(retval);
 }
 
@@ -259,6 +260,36 @@ bool NSPV_SignTx(CMutableTransaction &mtx,int32_t vini,int64_t utxovalue,const C
     return(false);
 }
 
+// gets the txproofs, then the notarizations, then the ntzsproofs for all vins from several peers at once,
+// so the per vin NSPV_gettransaction calls in NSPV_signtx are served from the caches
+
+void NSPV_prefetchvins(CMutableTransaction &mtx,struct NSPV_utxoresp used[])
+{
+    std::vector<struct NSPV_prefetchreq> reqs; std::set<int32_t> heights; std::set<std::pair<uint256,uint256> > pairs; std::set<int32_t>::iterator it; struct NSPV_ntzsresp N; int32_t i;
+    for (i=0; i<mtx.vin.size(); i++)
+    {
+        reqs.push_back(NSPV_prefetchreq_txproof(mtx.vin[i].prevout.n,mtx.vin[i].prevout.hash,used[i].height));
+        heights.insert(used[i].height);
+    }
+    NSPV_prefetch(reqs);
+    reqs.clear();
+    for (it=heights.begin(); it!=heights.end(); it++)
+        reqs.push_back(NSPV_prefetchreq_ntzs(*it));
+    NSPV_prefetch(reqs);
+    reqs.clear();
+    memset(&N,0,sizeof(N));
+    for (it=heights.begin(); it!=heights.end(); it++)
+    {
+        if ( NSPV_ntzsresp_find(&N,*it) != 0 && N.prevntz.height != 0 && N.prevntz.height <= N.nextntz.height )
+        {
+            if ( pairs.insert(std::make_pair(N.prevntz.txid,N.nextntz.txid)).second )
+                reqs.push_back(NSPV_prefetchreq_ntzsproof(N.prevntz.txid,N.nextntz.txid));
+        }
+    }
+    NSPV_ntzsresp_purge(&N);
+    NSPV_prefetch(reqs);
+}
+
 std::string NSPV_signtx(int64_t &rewardsum,int64_t &interestsum,UniValue &retcodes,CMutableTransaction &mtx,uint64_t txfee,CScript opret,struct NSPV_utxoresp used[])
 {
     CTransaction vintx; std::string hex; uint256 hashBlock; int64_t interest=0,change,totaloutputs=0,totalinputs=0; int32_t i,utxovout,n,validation,txheight,currentheight;
@@ -279,11 +310,10 @@ std::string NSPV_signtx(int64_t &rewardsum,int64_t &interestsum,UniValue &retcod
     }
     if ( opret.size() > 0 )
         mtx.vout.push_back(CTxOut(0,opret));
+    NSPV_prefetchvins(mtx,used);
     for (i=0; i<n; i++)
     {
         utxovout = mtx.vin[i].prevout.n;
-        if ( i > 0 )
-            sleep(1);
         validation = NSPV_gettransaction(0,utxovout,mtx.vin[i].prevout.hash,used[i].height,vintx,hashBlock,txheight,currentheight,used[i].extradata,NSPV_tiptime,rewardsum);
         retcodes.push_back(validation);
         if ( validation != -1 ) // most others are degraded security
@@ -87,58 +87,99 @@ int32_t getacseason(uint32_t timestamp)
     return(0);
 }
 
-int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestamp)
+/*
+ The hardcoded KMD seasons and LABS eras are decoded once into komodo_notarytables and never modified afterwards,
+ so komodo_notaries can serve them without komodo_mutex or hex decoding. Only the legacy ratified notaries
+ (Pubkeys[htind]) still go through the uthash lookup.
+*/
+struct komodo_notaryset
 {
-    int32_t i,htind,n; uint64_t mask = 0; struct knotary_entry *kp,*tmp;
-    static uint8_t kmd_pubkeys[NUM_KMD_SEASONS][64][33],didinit[NUM_KMD_SEASONS];
-    
+    int32_t numnotaries;
+    uint8_t pubkeys[64][33];
+    uint8_t rmd160s[64][20];    // hash160 of each pubkey, as komodo_notarycmp and the p2pkh notary checks use it
+    char addresses[64][64];
+};
+
+struct komodo_notarytables
+{
+    struct komodo_notaryset seasons[NUM_KMD_SEASONS];
+    struct komodo_notaryset eras[NUM_STAKED_ERAS];
+};
+
+void komodo_notaryset_decode(struct komodo_notaryset *set,const char *notaries[64][2],int32_t num)
+{
+    int32_t i;
+    set->numnotaries = num;
+    for (i=0; i<num; i++)
+    {
+        decode_hex(set->pubkeys[i],33,(char *)notaries[i][1]);
+        calc_rmd160_sha256(set->rmd160s[i],set->pubkeys[i],33);
+        pubkey2addr(set->addresses[i],set->pubkeys[i]);
+    }
+}
+
+struct komodo_notarytables *komodo_notarytables_build()
+{
+    struct komodo_notarytables *tables; int32_t i;
+    tables = (struct komodo_notarytables *)calloc(1,sizeof(*tables));
+    for (i=0; i<NUM_KMD_SEASONS; i++)
+    {
+        komodo_notaryset_decode(&tables->seasons[i],notaries_elected[i],NUM_KMD_NOTARIES);
+        if ( ASSETCHAINS_PRIVATE != 0 )
+        {
+            // this is PIRATE, the notary exemptions use the address array
+            memcpy(NOTARY_ADDRESSES[i],tables->seasons[i].addresses,sizeof(NOTARY_ADDRESSES[i]));
+        }
+    }
+    for (i=0; i<NUM_STAKED_ERAS; i++)
+        komodo_notaryset_decode(&tables->eras[i],notaries_STAKED[i],num_notaries_STAKED[i]);
+    return(tables);
+}
+
+const struct komodo_notarytables *komodo_notarytables()
+{
+    // built on first use, which happens after chain params (and so the address prefixes) are selected
+    static const struct komodo_notarytables *tables = komodo_notarytables_build();
+    return(tables);
+}
+
+// returns the hardcoded season or era notaries for height/timestamp, or 0 when the ratified Pubkeys apply (or in a LABS era gap)
+const struct komodo_notaryset *komodo_notaryset(int32_t height,uint32_t timestamp)
+{
+    int32_t season,era;
     if ( timestamp == 0 && ASSETCHAINS_SYMBOL[0] != 0 )
         timestamp = komodo_heightstamp(height);
     else if ( ASSETCHAINS_SYMBOL[0] == 0 )
         timestamp = 0;
-
-    // If this chain is not a staked chain, use the normal Komodo logic to determine notaries. This allows KMD to still sync and use its proper pubkeys for dPoW.
     if ( is_STAKED(ASSETCHAINS_SYMBOL) == 0 )
     {
-        int32_t kmd_season = 0;
+        // KMD uses block heights to determine the notary season, non LABS assetchains use the timestamp
         if ( ASSETCHAINS_SYMBOL[0] == 0 )
-        {
-            // This is KMD, use block heights to determine the KMD notary season.. 
-            if ( height >= KOMODO_NOTARIES_HARDCODED )
-                kmd_season = getkmdseason(height);
-        }
-        else 
-        {
-            // This is a non LABS assetchain, use timestamp to detemine notary pubkeys. 
-            kmd_season = getacseason(timestamp);
-        }
-        if ( kmd_season != 0 )
-        {
-            if ( didinit[kmd_season-1] == 0 )
-            {
-                for (i=0; i<NUM_KMD_NOTARIES; i++) 
-                    decode_hex(kmd_pubkeys[kmd_season-1][i],33,(char *)notaries_elected[kmd_season-1][i][1]);
-                if ( ASSETCHAINS_PRIVATE != 0 )
-                {
-                    // this is PIRATE, we need to populate the address array for the notary exemptions. 
-                    for (i = 0; i<NUM_KMD_NOTARIES; i++)
-                        pubkey2addr((char *)NOTARY_ADDRESSES[kmd_season-1][i],(uint8_t *)kmd_pubkeys[kmd_season-1][i]);
-                }
-                didinit[kmd_season-1] = 1;
-            }
-            memcpy(pubkeys,kmd_pubkeys[kmd_season-1],NUM_KMD_NOTARIES * 33);
-            return(NUM_KMD_NOTARIES);
-        }
+            season = (height >= KOMODO_NOTARIES_HARDCODED) ? getkmdseason(height) : 0;
+        else season = getacseason(timestamp);
+        if ( season != 0 )
+            return(&komodo_notarytables()->seasons[season-1]);
     }
-    else if ( timestamp != 0 )
-    { 
-        // here we can activate our pubkeys for LABS chains everythig is in notaries_staked.cpp
-        int32_t staked_era; int8_t numSN;
-        uint8_t staked_pubkeys[64][33];
-        staked_era = STAKED_era(timestamp);
-        numSN = numStakedNotaries(staked_pubkeys,staked_era);
-        memcpy(pubkeys,staked_pubkeys,numSN * 33);
-        return(numSN);
+    else if ( timestamp != 0 && (era= STAKED_era(timestamp)) != 0 )
+        return(&komodo_notarytables()->eras[era-1]);
+    return(0);
+}
+
+int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestamp)
+{
+    int32_t i,htind,n; uint64_t mask = 0; struct knotary_entry *kp,*tmp; const struct komodo_notaryset *set;
+    
+    if ( (set= komodo_notaryset(height,timestamp)) != 0 )
+    {
+        memcpy(pubkeys,set->pubkeys,set->numnotaries * 33);
+        return(set->numnotaries);
+    }
+    if ( timestamp == 0 && ASSETCHAINS_SYMBOL[0] != 0 )
+        timestamp = komodo_heightstamp(height);
+    if ( is_STAKED(ASSETCHAINS_SYMBOL) != 0 && timestamp != 0 )
+    {
+        // LABS chain in an era gap, everything is in notaries_staked.cpp
+        return(numStakedNotaries(pubkeys,0));
     }
 
     htind = height / KOMODO_ELECTION_GAP;
@@ -170,7 +211,17 @@ int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestam
 
 int32_t komodo_electednotary(int32_t *numnotariesp,uint8_t *pubkey33,int32_t height,uint32_t timestamp)
 {
-    int32_t i,n; uint8_t pubkeys[64][33];
+    int32_t i,n; uint8_t pubkeys[64][33]; const struct komodo_notaryset *set;
+    if ( (set= komodo_notaryset(height,timestamp)) != 0 )
+    {
+        *numnotariesp = set->numnotaries;
+        for (i=0; i<set->numnotaries; i++)
+        {
+            if ( memcmp(pubkey33,set->pubkeys[i],33) == 0 )
+                return(i);
+        }
+        return(-1);
+    }
     n = komodo_notaries(pubkeys,height,timestamp);
     *numnotariesp = n;
     for (i=0; i<n; i++)
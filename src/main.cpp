@@ -52,10 +52,12 @@
 #include "notaries_staked.h"
 
 #include <cstring>
+#include <deque>
 #include <algorithm>
 #include <atomic>
 #include <sstream>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -83,6 +85,7 @@ CCriticalSection cs_main;
 extern uint8_t NOTARY_PUBKEY33[33];
 extern int32_t KOMODO_LOADINGBLOCKS,KOMODO_LONGESTCHAIN,KOMODO_INSYNC,KOMODO_CONNECTING,KOMODO_EXTRASATOSHI;
 int32_t KOMODO_NEWBLOCKS;
+const CBlock *KOMODO_CONNECTINGBLOCK; // block ConnectTip is connecting, lets CC validation batch work per block
 int32_t komodo_block2pubkey33(uint8_t *pubkey33,CBlock *block);
 //void komodo_broadcast(CBlock *pblock,int32_t limit);
 bool Getscriptaddress(char *destaddr,const CScript &scriptPubKey);
@@ -402,16 +405,11 @@ namespace {
         mapNodeState.erase(nodeid);
     }
 
-    void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
+    void LimitMempoolSize(CTxMemPool& pool, size_t limit)
     {
-        /*    int expired = pool.Expire(GetTime() - age);
-         if (expired != 0)
-         LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
-
-         std::vector<uint256> vNoSpendsRemaining;
-         pool.TrimToSize(limit, &vNoSpendsRemaining);
-         BOOST_FOREACH(const uint256& removed, vNoSpendsRemaining)
-         pcoinsTip->Uncache(removed);*/
+        unsigned int nRemoved = pool.TrimToSize(limit);
+        if (nRemoved != 0)
+            LogPrint("mempool", "Evicted %u transactions to keep the memory pool below %u bytes\n", nRemoved, limit);
     }
 
     // Requires cs_main.
@@ -1437,18 +1435,16 @@ bool CheckTransaction(uint32_t tiptime,const CTransaction& tx, CValidationState
 int32_t komodo_isnotaryvout(char *coinaddr,uint32_t tiptime) // from ac_private chains only
 {
     int32_t season = getacseason(tiptime);
-    if ( NOTARY_ADDRESSES[season-1][0][0] == 0 )
-    {
-        uint8_t pubkeys[64][33];
-        komodo_notaries(pubkeys,0,tiptime);
-    }
     if ( strcmp(coinaddr,CRYPTO777_KMDADDR) == 0 )
         return(1);
-    for (int32_t i = 0; i < NUM_KMD_NOTARIES; i++) 
+    if ( season == 0 )
+        return(0);
+    const struct komodo_notaryset *set = &komodo_notarytables()->seasons[season-1];
+    for (int32_t i = 0; i < set->numnotaries; i++) 
     {
-        if ( strcmp(coinaddr,NOTARY_ADDRESSES[season-1][i]) == 0 )
+        if ( strcmp(coinaddr,set->addresses[i]) == 0 )
         {
-            //fprintf(stderr, "coinaddr.%s notaryaddress[%i].%s\n",coinaddr,i,NOTARY_ADDRESSES[season-1][i]);
+            //fprintf(stderr, "coinaddr.%s notaryaddress[%i].%s\n",coinaddr,i,set->addresses[i]);
             return(1);
         }
     }
@@ -1988,15 +1984,16 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
             return state.DoS(100, error("AcceptToMemoryPool: GetValueOut too big"),REJECT_INVALID,"tx valueout is too big");
   
         // Keep track of transactions that spend a coinbase, which we re-scan
-        // during reorgs to ensure COINBASE_MATURITY is still met.
-        bool fSpendsCoinbase = false;
+        // during reorgs to ensure COINBASE_MATURITY is still met. CC spends
+        // are evicted last when the mempool is trimmed.
+        bool fSpendsCoinbase = false, fSpendsCC = false;
         if (!tx.IsCoinImport() && !tx.IsPegsImport()) {
             BOOST_FOREACH(const CTxIn &txin, tx.vin) {
                 const CCoins *coins = view.AccessCoins(txin.prevout.hash);
-                if (coins->IsCoinBase()) {
+                if (coins->IsCoinBase())
                     fSpendsCoinbase = true;
-                    break;
-                }
+                if (coins->IsAvailable(txin.prevout.n) && coins->vout[txin.prevout.n].scriptPubKey.IsPayToCryptoCondition())
+                    fSpendsCC = true;
             }
         }
 //fprintf(stderr,"addmempool 5\n");
@@ -2006,6 +2003,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
         auto consensusBranchId = CurrentEpochBranchId(chainActive.Height() + 1, Params().GetConsensus());
         
         CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), mempool.HasNoInputsOf(tx), fSpendsCoinbase, consensusBranchId);
+        if (fSpendsCC)
+            entry.SetProtected();
         unsigned int nSize = entry.GetTxSize();
         
         // Accept a tx if it contains joinsplits and has at least the default fee specified by z_sendmany.
@@ -2021,6 +2020,18 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
             }
         }
         
+        // Once the pool has been trimmed, require at least the fee rate of the
+        // packages evicted since the last block. This applies to protected
+        // transactions too, otherwise they would be a free way to fill the pool.
+        {
+            double dPriorityDelta = 0;
+            CAmount nFeeDelta = 0;
+            pool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+            if (mempoolRejectFee > 0 && nFees + nFeeDelta < mempoolRejectFee)
+                return state.DoS(0, error("AcceptToMemoryPool: mempool min fee not met %s, %d < %d", hash.ToString(), nFees + nFeeDelta, mempoolRejectFee), REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+        }
+
         // Require that free transactions have sufficient priority to be mined in the next block.
         if (GetBoolArg("-relaypriority", false) && nFees < ::minRelayTxFee.GetFee(nSize) && !AllowFree(view.GetPriority(tx, chainActive.Height() + 1))) {
             fprintf(stderr,"accept failure.6\n");
@@ -2115,6 +2126,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                 }
             }
         }
+
+        // Trim the pool back under -maxmempool, which may evict the new entry itself
+        LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+        if (!pool.exists(hash))
+            return state.DoS(0, error("AcceptToMemoryPool: mempool full %s", hash.ToString()), REJECT_INSUFFICIENTFEE, "mempool full");
     }
     // This should be here still? 
     //SyncWithWallets(tx, NULL); 
@@ -2180,6 +2196,30 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool ForEachAddressIndex(uint160 addressHash, int type, int start, int end,
+                         const std::function<bool(const CAddressIndexKey&, CAmount)>& fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ForEachAddressIndex(addressHash, type, start, end, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool ForEachAddressUnspent(uint160 addressHash, int type,
+                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ForEachAddressUnspent(addressHash, type, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
 struct CompareBlocksByHeightMain
 {
     bool operator()(const CBlockIndex* a, const CBlockIndex* b) const
@@ -3528,6 +3568,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             pindex->hashSproutAnchor = tree.root();
             // The genesis block contained no JoinSplits
             pindex->hashFinalSproutRoot = pindex->hashSproutAnchor;
+            // Nor does its unspendable coinbase count towards the coin supply
+            pindex->nChainSupply = CBlockSupply();
         }
         return true;
     }
@@ -3564,7 +3606,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CAmount nFees = 0;
     int nInputs = 0;
     uint64_t valueout;
-    int64_t voutsum = 0, prevsum = 0, interest, sum = 0, stakeTxValue = 0;
+    int64_t voutsum = 0, prevsum = 0, interest, sum = 0, stakeTxValue = 0, supplyvinsum = 0;
     unsigned int nSigOps = 0;
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
@@ -3623,6 +3665,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             if (!view.HaveJoinSplitRequirements(tx))
                 return state.DoS(100, error("ConnectBlock(): JoinSplit requirements not met"),
                                  REJECT_INVALID, "bad-txns-joinsplit-requirements-not-met");
+            for (size_t j = 0; j < tx.vin.size(); j++)
+            {
+                if (tx.IsPegsImport() && j==0) continue;
+                supplyvinsum += view.GetOutputFor(tx.vin[j]).nValue;
+            }
 
             if (fAddressIndex || fSpentIndex)
             {
@@ -3807,6 +3854,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     if (fJustCheck)
         return true;
 
+    // Record the coin supply accounting, so komodo_coinsupply does not need to walk the chain
+    if (!(pindex->nStatus & BLOCK_HAVE_SUPPLY))
+    {
+        komodo_blocksupply(&pindex->nBlockSupply, pindex->GetHeight(), &block, supplyvinsum, sum);
+        pindex->nStatus |= BLOCK_HAVE_SUPPLY;
+        setDirtyBlockIndex.insert(pindex);
+    }
+    if (pindex->pprev && pindex->pprev->nChainSupply)
+        pindex->nChainSupply = *pindex->pprev->nChainSupply + pindex->nBlockSupply;
+    else
+        pindex->nChainSupply = boost::none;
+
     // Write undo information to disk
     //fprintf(stderr,"nFile.%d isNull %d vs isvalid %d nStatus %x\n",(int32_t)pindex->nFile,pindex->GetUndoPos().IsNull(),pindex->IsValid(BLOCK_VALID_SCRIPTS),(uint32_t)pindex->nStatus);
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS))
@@ -4271,6 +4330,7 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
         pblock = &block;
     }
     KOMODO_CONNECTING = (int32_t)pindexNew->GetHeight();
+    KOMODO_CONNECTINGBLOCK = pblock;
     //fprintf(stderr,"%s connecting ht.%d maxsize.%d vs %d\n",ASSETCHAINS_SYMBOL,(int32_t)pindexNew->GetHeight(),MAX_BLOCK_SIZE(pindexNew->GetHeight()),(int32_t)::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
     // Get the current commitment tree
     SproutMerkleTree oldSproutTree;
@@ -4288,6 +4348,7 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, true);
         KOMODO_CONNECTING = -1;
+        KOMODO_CONNECTINGBLOCK = 0;
         GetMainSignals().BlockChecked(*pblock, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -4686,7 +4747,7 @@ bool InvalidateBlock(CValidationState& state, CBlockIndex *pindex) {
             return false;
         }
     }
-    //LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
 
     // The resulting new best tip may not be in setBlockIndexCandidates anymore, so
     // add it again.
@@ -6125,6 +6186,12 @@ bool static LoadBlockIndexDB()
                 pindex->nChainSaplingValue = pindex->nSaplingValue;
             }
         }
+        if (!pindex->pprev)
+            pindex->nChainSupply = CBlockSupply();
+        else if (pindex->pprev->nChainSupply && (pindex->nStatus & BLOCK_HAVE_SUPPLY))
+            pindex->nChainSupply = *pindex->pprev->nChainSupply + pindex->nBlockSupply;
+        else
+            pindex->nChainSupply = boost::none;
         // Construct in-memory chain of branch IDs.
         // Relies on invariant: a block that does not activate a network upgrade
         // will always be valid under the same consensus rules as its parent.
@@ -6276,7 +6343,106 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100);
 }
 
-bool CVerifyDB::VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
+/**
+ * Read-ahead for VerifyDB. Worker threads run the per-block, context-free part of the checks
+ * (level 0 block read, the Equihash solution of level 1 and level 2 undo read) for a window of
+ * blocks ahead of the verifying thread, which keeps cs_main and consumes the results in order
+ * for the contextual CheckBlock, disconnect and reconnect passes.
+ */
+class CVerifyDBQueue
+{
+public:
+    struct Job
+    {
+        CBlockIndex *pindex;
+        CBlock block;
+        CBlockUndo undo;
+        bool fReadOK, fUndoOK, fDone;
+        int64_t nReadMicros, nCheckMicros, nUndoMicros;
+        Job(CBlockIndex *pindexIn) : pindex(pindexIn), fReadOK(false), fUndoOK(true), fDone(false), nReadMicros(0), nCheckMicros(0), nUndoMicros(0) {}
+    };
+
+    CVerifyDBQueue(const std::vector<CBlockIndex *> &vIndexIn, int nCheckLevelIn, int nThreads, size_t nWindowIn) :
+        vIndex(vIndexIn), nCheckLevel(nCheckLevelIn), nWindow(nWindowIn), nNext(0), nConsumed(0), fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CVerifyDBQueue::Worker, this));
+    }
+
+    ~CVerifyDBQueue()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fStop = true;
+            condWorker.notify_all();
+        }
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+
+    //! Wait for the next block in order; returns NULL once all were handed out.
+    std::shared_ptr<Job> Next()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if ( nConsumed == vIndex.size() )
+            return std::shared_ptr<Job>();
+        while ( mapJobs.count(nConsumed) == 0 || !mapJobs[nConsumed]->fDone )
+            condMaster.wait(lock);
+        std::shared_ptr<Job> job = mapJobs[nConsumed];
+        mapJobs.erase(nConsumed++);
+        condWorker.notify_one();
+        return job;
+    }
+
+private:
+    boost::thread_group threadGroup;
+    boost::mutex mutex;
+    boost::condition_variable condWorker, condMaster;
+    const std::vector<CBlockIndex *> &vIndex;
+    std::map<size_t, std::shared_ptr<Job> > mapJobs;
+    int nCheckLevel;
+    size_t nWindow, nNext, nConsumed;
+    bool fStop;
+
+    void Worker()
+    {
+        const CChainParams& chainparams = Params();
+        while ( 1 )
+        {
+            std::shared_ptr<Job> job;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while ( !fStop && nNext < vIndex.size() && nNext >= nConsumed + nWindow )
+                    condWorker.wait(lock);
+                if ( fStop || nNext == vIndex.size() )
+                    return;
+                job = std::make_shared<Job>(vIndex[nNext]);
+                mapJobs[nNext++] = job;
+            }
+            int64_t nTime0 = GetTimeMicros();
+            job->fReadOK = ReadBlockFromDisk(job->block, job->pindex, 0);
+            int64_t nTime1 = GetTimeMicros();
+            // CheckBlock repeats this under cs_main, where it hits the verified solution cache
+            if ( job->fReadOK && nCheckLevel >= 1 )
+                CheckEquihashSolution(&job->block, chainparams);
+            int64_t nTime2 = GetTimeMicros();
+            if ( job->fReadOK && nCheckLevel >= 2 && job->pindex->pprev != NULL )
+            {
+                CDiskBlockPos pos = job->pindex->GetUndoPos();
+                if ( !pos.IsNull() )
+                    job->fUndoOK = UndoReadFromDisk(job->undo, pos, job->pindex->pprev->GetBlockHash());
+            }
+            job->nReadMicros = nTime1 - nTime0;
+            job->nCheckMicros = nTime2 - nTime1;
+            job->nUndoMicros = GetTimeMicros() - nTime2;
+            boost::unique_lock<boost::mutex> lock(mutex);
+            job->fDone = true;
+            condMaster.notify_one();
+        }
+    }
+};
+
+bool CVerifyDB::VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth, int64_t nCheckSeconds)
 {
     LOCK(cs_main);
     if (chainActive.Tip() == NULL || chainActive.Tip()->pprev == NULL)
@@ -6288,7 +6454,12 @@ bool CVerifyDB::VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth
     if (nCheckDepth > chainActive.Height())
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
-    LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    int nThreads = GetArg("-checkthreads", DEFAULT_VERIFYDB_THREADS);
+    if ( nThreads <= 0 )
+        nThreads += GetNumCores();
+    nThreads = std::max(1, std::min(nThreads, MAX_SCRIPTCHECK_THREADS));
+    int64_t nDeadline = nCheckSeconds > 0 ? GetTimeMillis() + nCheckSeconds * 1000 : 0;
+    LogPrintf("Verifying last %i blocks at level %i using %d threads%s\n", nCheckDepth, nCheckLevel, nThreads, nCheckSeconds > 0 ? strprintf(", time budget %ds", nCheckSeconds) : "");
     CCoinsViewCache coins(coinsview);
     CBlockIndex* pindexState = chainActive.Tip();
     CBlockIndex* pindexFailure = NULL;
@@ -6296,66 +6467,97 @@ bool CVerifyDB::VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth
     CValidationState state;
     // No need to verify JoinSplits twice
     auto verifier = libzcash::ProofVerifier::Disabled();
-    //fprintf(stderr,"start VerifyDB %u\n",(uint32_t)time(NULL));
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
-    {
-        boost::this_thread::interruption_point();
-        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->GetHeight())) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
-        if (pindex->GetHeight() < chainActive.Height()-nCheckDepth)
-            break;
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex,0))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        int32_t futureblock;
-        if (nCheckLevel >= 1 && !CheckBlock(&futureblock,pindex->GetHeight(),pindex,block, state, verifier,0) )
-            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            bool fClean = true;
-            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-            pindexState = pindex->pprev;
-            if (!fClean) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else
-                nGoodTransactions += block.vtx.size();
-        }
-        if (ShutdownRequested())
-            return true;
+    // per level busy time, levels 0 and 2 and the Equihash part of level 1 summed over the worker threads
+    int64_t nLevelMicros[5] = { 0, 0, 0, 0, 0 };
+    int nVerified = 0, nReportStep = std::max(1, nCheckDepth / 10);
+    bool fOutOfTime = false;
+    std::vector<CBlockIndex *> vIndex;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev && pindex->GetHeight() >= chainActive.Height()-nCheckDepth; pindex = pindex->pprev)
+        vIndex.push_back(pindex);
+    {
+        CVerifyDBQueue queue(vIndex, nCheckLevel, nThreads, 16 * nThreads);
+        std::shared_ptr<CVerifyDBQueue::Job> job;
+        while ( (job= queue.Next()) )
+        {
+            boost::this_thread::interruption_point();
+            CBlockIndex *pindex = job->pindex;
+            CBlock &block = job->block;
+            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->GetHeight())) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
+            if ( nDeadline != 0 && GetTimeMillis() > nDeadline )
+            {
+                fOutOfTime = true;
+                break;
+            }
+            nLevelMicros[0] += job->nReadMicros;
+            nLevelMicros[1] += job->nCheckMicros;
+            nLevelMicros[2] += job->nUndoMicros;
+            // check level 0: read from disk
+            if (!job->fReadOK)
+                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+            // check level 1: verify block validity
+            int32_t futureblock;
+            int64_t nTimeStart = GetTimeMicros();
+            if (nCheckLevel >= 1 && !CheckBlock(&futureblock,pindex->GetHeight(),pindex,block, state, verifier,0) )
+                return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+            nLevelMicros[1] += GetTimeMicros() - nTimeStart;
+            // check level 2: verify undo validity
+            if (!job->fUndoOK)
+                return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+            nTimeStart = GetTimeMicros();
+            if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                bool fClean = true;
+                if (!DisconnectBlock(block, state, pindex, coins, &fClean))
+                    return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+                pindexState = pindex->pprev;
+                if (!fClean) {
+                    nGoodTransactions = 0;
+                    pindexFailure = pindex;
+                } else
+                    nGoodTransactions += block.vtx.size();
+            }
+            nLevelMicros[3] += GetTimeMicros() - nTimeStart;
+            if ( ++nVerified % nReportStep == 0 )
+                LogPrintf("VerifyDB: verified %i of %i blocks at level %i, height %d\n", nVerified, nCheckDepth, nCheckLevel, pindex->GetHeight());
+            if (ShutdownRequested())
+                return true;
+        }
     }
-    //fprintf(stderr,"end VerifyDB %u\n",(uint32_t)time(NULL));
+    if ( fOutOfTime )
+        LogPrintf("VerifyDB: time budget of %ds reached after %i of %i blocks\n", nCheckSeconds, nVerified, nCheckDepth);
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->GetHeight() + 1, nGoodTransactions);
 
-    // check level 4: try reconnecting blocks
-    if (nCheckLevel >= 4) {
-        CBlockIndex *pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
+    // check level 4: try reconnecting blocks, reading them ahead on the worker threads
+    if (nCheckLevel >= 4 && pindexState != chainActive.Tip()) {
+        std::vector<CBlockIndex *> vReconnect;
+        for (CBlockIndex *pindex = chainActive.Next(pindexState); pindex != NULL; pindex = chainActive.Next(pindex))
+            vReconnect.push_back(pindex);
+        CVerifyDBQueue queue(vReconnect, 0, nThreads, 16 * nThreads);
+        std::shared_ptr<CVerifyDBQueue::Job> job;
+        while ( (job= queue.Next()) )
+        {
             boost::this_thread::interruption_point();
+            CBlockIndex *pindex = job->pindex;
             uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->GetHeight())) / (double)nCheckDepth * 50))));
-            pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex,0))
+            nLevelMicros[0] += job->nReadMicros;
+            if (!job->fReadOK)
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-            if (!ConnectBlock(block, state, pindex, coins,false, true))
+            int64_t nTimeStart = GetTimeMicros();
+            if (!ConnectBlock(job->block, state, pindex, coins,false, true))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+            nLevelMicros[4] += GetTimeMicros() - nTimeStart;
+            if ( nDeadline != 0 && GetTimeMillis() > nDeadline )
+            {
+                LogPrintf("VerifyDB: time budget of %ds reached while reconnecting at height %d\n", nCheckSeconds, pindex->GetHeight());
+                break;
+            }
         }
     }
 
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", chainActive.Height() - pindexState->GetHeight(), nGoodTransactions);
-    
+    for (int i = 0; i <= nCheckLevel; i++)
+        LogPrintf("VerifyDB: level %d took %.3fs\n", i, nLevelMicros[i] * 0.000001);
     return true;
 }
 
@@ -6549,6 +6751,80 @@ bool LoadBlockIndex()
     return true;
 }
 
+bool BuildCoinSupplyIndex()
+{
+    // Blocks connected before supply accounting was recorded at ConnectBlock are filled in from their undo data,
+    // a batch at a time so cs_main is not held for the whole chain.
+    const int nBatchSize = 1000;
+    int nHeight = 1, nBuilt = 0;
+    int64_t nStart = GetTimeMillis();
+    while (!ShutdownRequested())
+    {
+        CValidationState state;
+        LOCK(cs_main);
+        if (nHeight > chainActive.Height())
+        {
+            // Recompute the chain totals now that every active block has its accounting.
+            chainActive.Genesis()->nChainSupply = CBlockSupply();
+            for (CBlockIndex *pindex = chainActive.Next(chainActive.Genesis()); pindex != NULL; pindex = chainActive.Next(pindex))
+            {
+                if (pindex->pprev->nChainSupply && (pindex->nStatus & BLOCK_HAVE_SUPPLY))
+                    pindex->nChainSupply = *pindex->pprev->nChainSupply + pindex->nBlockSupply;
+                else
+                    pindex->nChainSupply = boost::none;
+            }
+            if (nBuilt > 0)
+                LogPrintf("%s: built coin supply accounting for %d blocks in %dms\n", __func__, nBuilt, GetTimeMillis() - nStart);
+            return true;
+        }
+        for (int n = 0; n < nBatchSize && nHeight <= chainActive.Height(); n++, nHeight++)
+        {
+            CBlockIndex *pindex = chainActive[nHeight];
+            if (pindex->nStatus & BLOCK_HAVE_SUPPLY)
+                continue;
+            CBlock block;
+            CBlockUndo blockUndo;
+            CDiskBlockPos pos = pindex->GetUndoPos();
+            if (pos.IsNull() || !ReadBlockFromDisk(block, pindex, false))
+                return error("%s: cannot read block %d", __func__, nHeight);
+            if (!UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash()) || blockUndo.vtxundo.size() + 1 != block.vtx.size())
+                return error("%s: cannot read undo data for block %d", __func__, nHeight);
+            int64_t vinsum = 0, interest = 0;
+            for (size_t i = 1; i < block.vtx.size(); i++)
+            {
+                const CTransaction &tx = block.vtx[i];
+                const CTxUndo &txundo = blockUndo.vtxundo[i - 1];
+                size_t k = 0;
+                if (tx.IsMint())
+                    continue;
+                // vprevout follows vin, less the pegs burn input UpdateCoins skips
+                for (size_t j = 0; j < tx.vin.size() && k < txundo.vprevout.size(); j++)
+                {
+                    if (tx.IsPegsImport() && tx.vin[j].prevout.n == 10e8)
+                        continue;
+                    int64_t value = txundo.vprevout[k++].txout.nValue;
+                    if (tx.IsPegsImport() && j == 0)
+                        continue;
+                    vinsum += value;
+#ifdef KOMODO_ENABLE_INTEREST
+                    if (ASSETCHAINS_SYMBOL[0] == 0 && nHeight-1 >= 60000 && value >= 10*COIN)
+                    {
+                        int32_t txheight; uint32_t locktime;
+                        interest += komodo_accrued_interest(&txheight,&locktime,tx.vin[j].prevout.hash,tx.vin[j].prevout.n,0,value,nHeight-1);
+                    }
+#endif
+                }
+            }
+            komodo_blocksupply(&pindex->nBlockSupply, nHeight, &block, vinsum, interest);
+            pindex->nStatus |= BLOCK_HAVE_SUPPLY;
+            setDirtyBlockIndex.insert(pindex);
+            nBuilt++;
+        }
+        FlushStateToDisk(state, FLUSH_STATE_PERIODIC);
+    }
+    return true;
+}
+
 
 bool InitBlockIndex() {
     const CChainParams& chainparams = Params();
@@ -6613,14 +6889,111 @@ bool InitBlockIndex() {
 
 
 
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
+/**
+ * Queue between the stages of LoadExternalBlockFile. A reader thread scans the file and
+ * deserializes blocks in file order, worker threads pre-verify the Equihash solution of each
+ * queued block (CheckEquihashSolution remembers the result), and the importing thread pops
+ * checked blocks in the same order and connects them. The queue is bounded by the serialized
+ * size of the blocks it holds, always admitting at least one block.
+ */
+class CBlockImportQueue
 {
-    const CChainParams& chainparams = Params();
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+public:
+    struct Entry
+    {
+        CBlock block;
+        CDiskBlockPos pos;
+        uint256 hash;
+        unsigned int nSize;
+        bool fChecked;
+        Entry() : nSize(0), fChecked(false) {}
+    };
 
-    int nLoaded = 0;
+    std::atomic<int64_t> nReadMicros, nCheckMicros, nConnectMicros;
+    std::atomic<uint64_t> nReadBytes, nReadBlocks, nCheckedBlocks;
+
+    CBlockImportQueue(size_t nMaxBytesIn) : nReadMicros(0), nCheckMicros(0), nConnectMicros(0), nReadBytes(0), nReadBlocks(0), nCheckedBlocks(0),
+        nMaxBytes(nMaxBytesIn), nBytes(0), nNextCheck(0), fReaderDone(false), fStop(false) {}
+
+    //! Called by the reader; blocks while the queue is full. Returns false once stopped.
+    bool Push(const std::shared_ptr<Entry> &entry)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while ( !fStop && !queue.empty() && nBytes + entry->nSize > nMaxBytes )
+            condReader.wait(lock);
+        if ( fStop )
+            return false;
+        nBytes += entry->nSize;
+        queue.push_back(entry);
+        condWorker.notify_one();
+        return true;
+    }
+
+    void ReaderDone()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fReaderDone = true;
+        condWorker.notify_all();
+        condConnect.notify_all();
+    }
+
+    //! Called by the workers; returns the oldest unclaimed block, or NULL when there is no more work.
+    std::shared_ptr<Entry> NextUnchecked()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while ( !fStop && !fReaderDone && nNextCheck == queue.size() )
+            condWorker.wait(lock);
+        if ( fStop || nNextCheck == queue.size() )
+            return std::shared_ptr<Entry>();
+        return queue[nNextCheck++];
+    }
+
+    void MarkChecked(const std::shared_ptr<Entry> &entry)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        entry->fChecked = true;
+        if ( entry == queue.front() )
+            condConnect.notify_one();
+    }
+
+    //! Called by the importing thread; returns the next block in file order once checked, or NULL at the end.
+    std::shared_ptr<Entry> PopChecked()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while ( !fStop && (queue.empty() ? !fReaderDone : !queue.front()->fChecked) )
+            condConnect.wait(lock);
+        if ( fStop || queue.empty() )
+            return std::shared_ptr<Entry>();
+        std::shared_ptr<Entry> entry = queue.front();
+        queue.pop_front();
+        nNextCheck--;
+        nBytes -= entry->nSize;
+        condReader.notify_one();
+        return entry;
+    }
+
+    void Stop()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        condReader.notify_all();
+        condWorker.notify_all();
+        condConnect.notify_all();
+    }
+
+private:
+    boost::mutex mutex;
+    boost::condition_variable condReader, condWorker, condConnect;
+    std::deque<std::shared_ptr<Entry> > queue;
+    size_t nMaxBytes;
+    size_t nBytes;
+    size_t nNextCheck; //!< index in queue of the first block not yet claimed by a worker
+    bool fReaderDone;
+    bool fStop;
+};
+
+static void ThreadImportRead(CBlockImportQueue *importqueue, FILE* fileIn, CDiskBlockPos pos, bool fHavePos)
+{
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         //CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
@@ -6651,29 +7024,94 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
             }
             try {
                 // read block
-                CBlock block;
+                int64_t nTimeStart = GetTimeMicros();
+                std::shared_ptr<CBlockImportQueue::Entry> entry = std::make_shared<CBlockImportQueue::Entry>();
                 uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
+                entry->pos = pos;
+                entry->pos.nPos = nBlockPos;
+                entry->nSize = nSize;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                blkdat >> block;
-                
+                blkdat >> entry->block;
                 nRewind = blkdat.GetPos();
+                importqueue->nReadMicros += GetTimeMicros() - nTimeStart;
+                importqueue->nReadBytes += nSize;
+                importqueue->nReadBlocks++;
+                if ( !fHavePos )
+                    entry->pos.SetNull();
+                if ( !importqueue->Push(entry) )
+                    break;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    importqueue->ReaderDone();
+}
+
+static void ThreadImportCheck(CBlockImportQueue *importqueue)
+{
+    const CChainParams& chainparams = Params();
+    std::shared_ptr<CBlockImportQueue::Entry> entry;
+    while ( (entry= importqueue->NextUnchecked()) )
+    {
+        int64_t nTimeStart = GetTimeMicros();
+        entry->hash = entry->block.GetHash();
+        // the result is only cached here, ProcessNewBlock repeats the check and rejects the block
+        CheckEquihashSolution(&entry->block, chainparams);
+        importqueue->nCheckMicros += GetTimeMicros() - nTimeStart;
+        importqueue->nCheckedBlocks++;
+        importqueue->MarkChecked(entry);
+    }
+}
+
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
+{
+    const CChainParams& chainparams = Params();
+    // Map of disk positions for blocks with unknown parent (only used for reindex)
+    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    int64_t nStart = GetTimeMillis();
+
+    int nThreads = GetArg("-reindexthreads", DEFAULT_IMPORT_CHECK_THREADS);
+    if ( nThreads <= 0 )
+        nThreads += GetNumCores() - 1;
+    nThreads = std::max(1, std::min(nThreads, MAX_SCRIPTCHECK_THREADS));
+    int64_t nBufferMB = std::max((int64_t)1, GetArg("-reindexbuffer", DEFAULT_IMPORT_BUFFER_MB));
+
+    CBlockImportQueue importqueue((size_t)nBufferMB << 20);
+    boost::thread_group threadGroup;
+    threadGroup.create_thread(boost::bind(&ThreadImportRead, &importqueue, fileIn, dbp != NULL ? *dbp : CDiskBlockPos(), dbp != NULL));
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&ThreadImportCheck, &importqueue));
+
+    int nLoaded = 0;
+    try {
+        std::shared_ptr<CBlockImportQueue::Entry> entry;
+        while ( (entry= importqueue.PopChecked()) )
+        {
+            boost::this_thread::interruption_point();
+            int64_t nTimeStart = GetTimeMicros();
+            CBlock &block = entry->block;
+            if (dbp)
+                dbp->nPos = entry->pos.nPos;
+            CDiskBlockPos *pblockpos = dbp != NULL ? &entry->pos : NULL;
+            try {
                 // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
+                uint256 hash = entry->hash;
                 if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                              block.hashPrevBlock.ToString());
                     if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, entry->pos));
                     continue;
                 }
 
                 // process in case the block isn't known yet
                 if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
                     CValidationState state;
-                    if (ProcessNewBlock(0,0,state, NULL, &block, true, dbp))
+                    if (ProcessNewBlock(0,0,state, NULL, &block, true, pblockpos))
                         nLoaded++;
                     if (state.IsError())
                         break;
@@ -6709,12 +7147,27 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+            importqueue.nConnectMicros += GetTimeMicros() - nTimeStart;
         }
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
+    } catch (...) {
+        importqueue.Stop();
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        throw;
     }
+    importqueue.Stop();
+    threadGroup.join_all();
+
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    // busy time per stage, the check stage summed over its threads
+    double readsecs = importqueue.nReadMicros * 0.000001, checksecs = importqueue.nCheckMicros * 0.000001, connectsecs = importqueue.nConnectMicros * 0.000001;
+    LogPrint("reindex", "%s: read %u blocks %.2fMB in %.2fs (%.2fMB/s), checked %u blocks in %.2fs on %d threads (%.1f blocks/s), connected %i blocks in %.2fs (%.1f blocks/s)\n", __func__,
+             (uint64_t)importqueue.nReadBlocks, importqueue.nReadBytes * 0.000001, readsecs, readsecs > 0 ? importqueue.nReadBytes * 0.000001 / readsecs : 0.,
+             (uint64_t)importqueue.nCheckedBlocks, checksecs, nThreads, checksecs > 0 ? importqueue.nCheckedBlocks * nThreads / checksecs : 0.,
+             nLoaded, connectsecs, connectsecs > 0 ? nLoaded / connectsecs : 0.);
     return nLoaded > 0;
 }
 
@@ -46,6 +46,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -66,6 +67,8 @@ class PrecomputedTransactionData;
 
 struct CNodeStateStats;
 #define DEFAULT_MEMPOOL_EXPIRY 1
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
 #define _COINBASE_MATURITY 100
 
 /** Default for -blockmaxsize and -blockminsize, which control the range of sizes the mining code will create **/
@@ -100,6 +103,12 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -reindexthreads default (number of block import check threads, 0 = auto) */
+static const int DEFAULT_IMPORT_CHECK_THREADS = 0;
+/** -reindexbuffer default (MiB of deserialized blocks queued between import stages) */
+static const int DEFAULT_IMPORT_BUFFER_MB = 256;
+/** -checkthreads default (number of VerifyDB read-ahead threads, 0 = auto) */
+static const int DEFAULT_VERIFYDB_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -228,6 +237,8 @@ bool InitBlockIndex();
 bool LoadBlockIndex();
 /** Unload database information */
 void UnloadBlockIndex();
+/** Fill in the coin supply accounting of active chain blocks connected before it was recorded */
+bool BuildCoinSupplyIndex();
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom);
 /**
@@ -802,6 +813,11 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Stream the address index to fn without collecting it, fn returns false to stop */
+bool ForEachAddressIndex(uint160 addressHash, int type, int start, int end,
+                         const std::function<bool(const CAddressIndexKey&, CAmount)>& fn);
+bool ForEachAddressUnspent(uint160 addressHash, int type,
+                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
@@ -914,7 +930,8 @@ class CVerifyDB {
 public:
     CVerifyDB();
     ~CVerifyDB();
-    bool VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
+    //! nCheckSeconds > 0 stops verifying, without failing, once that many seconds have passed
+    bool VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth, int64_t nCheckSeconds = 0);
 };
 
 /** Find the last common block between the parameter chain and a locator. */
@@ -116,6 +116,8 @@ CCriticalSection cs_nLastNodeId;
 
 static CSemaphore *semOutbound = NULL;
 static boost::condition_variable messageHandlerCondition;
+static boost::mutex messageHandlerMutex;
+static bool fMessageHandlerWake = false; //!< set when a message completes, so a wakeup during processing is not lost
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -432,10 +434,13 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
 void CNode::CloseSocketDisconnect()
 {
     fDisconnect = true;
-    if (hSocket != INVALID_SOCKET)
     {
-        LogPrint("net", "disconnecting peer=%d\n", id);
-        CloseSocket(hSocket);
+        LOCK(cs_hSocket);
+        if (hSocket != INVALID_SOCKET)
+        {
+            LogPrint("net", "disconnecting peer=%d\n", id);
+            CloseSocket(hSocket);
+        }
     }
 
     // in case this fails, we'll empty the recv buffer when the CNode is deleted
@@ -638,7 +643,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            WakeMessageHandler();
         }
     }
 
@@ -694,6 +699,60 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
 
 
+void WakeMessageHandler()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(messageHandlerMutex);
+        fMessageHandlerWake = true;
+    }
+    messageHandlerCondition.notify_one();
+}
+
+bool WaitSocketEvents(std::vector<std::pair<SOCKET, int> > &vSockets, int64_t nTimeoutMs)
+{
+#ifdef USE_POLL
+    std::vector<struct pollfd> vPollFds(vSockets.size());
+    for (size_t i = 0; i < vSockets.size(); i++) {
+        vPollFds[i].fd = vSockets[i].first;
+        vPollFds[i].events = ((vSockets[i].second & SOCKET_EVENT_RECV) ? POLLIN : 0) | ((vSockets[i].second & SOCKET_EVENT_SEND) ? POLLOUT : 0);
+        vPollFds[i].revents = 0;
+    }
+    if (poll(vPollFds.empty() ? NULL : &vPollFds[0], vPollFds.size(), nTimeoutMs) == SOCKET_ERROR)
+        return false;
+    for (size_t i = 0; i < vSockets.size(); i++) {
+        short revents = vPollFds[i].revents;
+        vSockets[i].second = ((revents & POLLIN) ? SOCKET_EVENT_RECV : 0) | ((revents & POLLOUT) ? SOCKET_EVENT_SEND : 0) |
+            ((revents & (POLLERR | POLLHUP | POLLNVAL)) ? SOCKET_EVENT_ERR : 0);
+    }
+#else
+    struct timeval timeout = MillisToTimeval(nTimeoutMs);
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    for (size_t i = 0; i < vSockets.size(); i++) {
+        SOCKET hSocket = vSockets[i].first;
+        if (vSockets[i].second & SOCKET_EVENT_RECV)
+            FD_SET(hSocket, &fdsetRecv);
+        if (vSockets[i].second & SOCKET_EVENT_SEND)
+            FD_SET(hSocket, &fdsetSend);
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = max(hSocketMax, hSocket);
+    }
+    if (select(vSockets.empty() ? 0 : hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout) == SOCKET_ERROR)
+        return false;
+    for (size_t i = 0; i < vSockets.size(); i++) {
+        SOCKET hSocket = vSockets[i].first;
+        vSockets[i].second = (FD_ISSET(hSocket, &fdsetRecv) ? SOCKET_EVENT_RECV : 0) | (FD_ISSET(hSocket, &fdsetSend) ? SOCKET_EVENT_SEND : 0) |
+            (FD_ISSET(hSocket, &fdsetError) ? SOCKET_EVENT_ERR : 0);
+    }
+#endif
+    return true;
+}
+
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode)
 {
@@ -702,7 +761,13 @@ void SocketSendData(CNode *pnode)
     while (it != pnode->vSendMsg.end()) {
         const CSerializeData &data = *it;
         assert(data.size() > pnode->nSendOffset);
-        int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        int nBytes;
+        {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                break;
+            nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
@@ -1017,7 +1082,9 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
-void ThreadSocketHandler()
+// Each socket thread serves the peers whose id falls in its share, thread 0 also accepts
+// connections and releases disconnected nodes.
+void ThreadSocketHandler(int nThread, int nThreads)
 {
     unsigned int nPrevNodeCount = 0;
     while (true)
@@ -1025,6 +1092,7 @@ void ThreadSocketHandler()
         //
         // Disconnect nodes
         //
+        if (nThread == 0)
         {
             LOCK(cs_vNodes);
             // Disconnect unused nodes
@@ -1050,6 +1118,7 @@ void ThreadSocketHandler()
                 }
             }
         }
+        if (nThread == 0)
         {
             // Delete disconnected nodes
             list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
@@ -1080,7 +1149,7 @@ void ThreadSocketHandler()
                 }
             }
         }
-        if(vNodes.size() != nPrevNodeCount) {
+        if(nThread == 0 && vNodes.size() != nPrevNodeCount) {
             nPrevNodeCount = vNodes.size();
             uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
         }
@@ -1088,34 +1157,20 @@ void ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+        int64_t nTimeoutMs = 50; // frequency to poll pnode->vSend
+        std::vector<std::pair<SOCKET, int> > vSockets;
+
+        if (nThread == 0) {
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+                vSockets.push_back(std::make_pair(hListenSocket.socket, (int)SOCKET_EVENT_RECV));
         }
 
         {
             LOCK(cs_vNodes);
             BOOST_FOREACH(CNode* pnode, vNodes)
             {
-                if (pnode->hSocket == INVALID_SOCKET)
+                if (pnode->hSocket == INVALID_SOCKET || pnode->id % nThreads != nThread)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
 
                 // Implement the following logic:
                 // * If there is data to send, select() for sending data. As this only
@@ -1132,10 +1187,11 @@ void ThreadSocketHandler()
                 // * We send some data.
                 // * We wait for data to be received (and disconnect after timeout).
                 // * We process a message in the buffer (message handler thread).
+                int nEvents = SOCKET_EVENT_ERR;
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
                     if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
+                        vSockets.push_back(std::make_pair(pnode->hSocket, nEvents | SOCKET_EVENT_SEND));
                         continue;
                     }
                 }
@@ -1144,37 +1200,38 @@ void ThreadSocketHandler()
                     if (lockRecv && (
                         pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
                         pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                        nEvents |= SOCKET_EVENT_RECV;
                 }
+                vSockets.push_back(std::make_pair(pnode->hSocket, nEvents));
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        bool fWaitOK = WaitSocketEvents(vSockets, nTimeoutMs);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
+        if (!fWaitOK)
         {
-            if (have_fds)
+            if (!vSockets.empty())
             {
                 int nErr = WSAGetLastError();
                 LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
+            for (size_t i = 0; i < vSockets.size(); i++)
+                vSockets[i].second = SOCKET_EVENT_RECV;
+            MilliSleep(nTimeoutMs);
         }
+        std::map<SOCKET, int> mapEvents(vSockets.begin(), vSockets.end());
 
         //
         // Accept new connections
         //
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
-        {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+        if (nThread == 0) {
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
             {
-                AcceptConnection(hListenSocket);
+                if (hListenSocket.socket != INVALID_SOCKET && (mapEvents[hListenSocket.socket] & SOCKET_EVENT_RECV))
+                {
+                    AcceptConnection(hListenSocket);
+                }
             }
         }
 
@@ -1184,9 +1241,13 @@ void ThreadSocketHandler()
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH(CNode* pnode, vNodesCopy)
-                pnode->AddRef();
+            BOOST_FOREACH(CNode* pnode, vNodes)
+            {
+                if (pnode->id % nThreads == nThread) {
+                    pnode->AddRef();
+                    vNodesCopy.push_back(pnode);
+                }
+            }
         }
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
@@ -1197,7 +1258,9 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+            std::map<SOCKET, int>::const_iterator itEvents = mapEvents.find(pnode->hSocket);
+            int nEvents = itEvents != mapEvents.end() ? itEvents->second : 0;
+            if (nEvents & (SOCKET_EVENT_RECV | SOCKET_EVENT_ERR))
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv)
@@ -1205,7 +1268,18 @@ void ThreadSocketHandler()
                     {
                         // typical socket buffer is 8K-64K
                         char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                        int nBytes = 0;
+                        bool fClosed = false;
+                        {
+                            // another thread may have closed the socket, and its fd may be reused by now
+                            LOCK(pnode->cs_hSocket);
+                            if (pnode->hSocket == INVALID_SOCKET)
+                                fClosed = true;
+                            else
+                                nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                        }
+                        if (fClosed)
+                            continue;
                         if (nBytes > 0)
                         {
                             if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
@@ -1241,7 +1315,7 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend))
+            if (nEvents & SOCKET_EVENT_SEND)
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
@@ -1574,9 +1648,6 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 
 void ThreadMessageHandler()
 {
-    boost::mutex condition_mutex;
-    boost::unique_lock<boost::mutex> lock(condition_mutex);
-
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
     while (true)
     {
@@ -1635,8 +1706,10 @@ void ThreadMessageHandler()
                 pnode->Release();
         }
 
-        if (fSleep)
+        boost::unique_lock<boost::mutex> lock(messageHandlerMutex);
+        if (fSleep && !fMessageHandlerWake)
             messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(100));
+        fMessageHandlerWake = false;
     }
 }
 
@@ -1831,7 +1904,9 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
         threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "dnsseed", &ThreadDNSAddressSeed));
 
     // Send and receive from sockets, accept connections
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
+    int nNetThreads = std::max(1, std::min((int)GetArg("-netthreads", DEFAULT_NET_THREADS), MAX_NET_THREADS));
+    for (int i = 0; i < nNetThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "net", boost::function<void()>(boost::bind(&ThreadSocketHandler, i, nNetThreads))));
 
     // Initiate outbound connections from -addnode
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "addcon", &ThreadOpenAddedConnections));
@@ -2114,6 +2189,8 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     nRecvBytes = 0;
     nTimeConnected = GetTime();
     nTimeOffset = 0;
+    dexlastping = 0;
+    dexlastseq = 0;
     addr = addrIn;
     addrName = addrNameIn == "" ? addr.ToStringIPPort() : addrNameIn;
     nVersion = 0;
@@ -75,6 +75,10 @@ static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 384;
+/** -netthreads default, the number of threads doing socket I/O */
+static const int DEFAULT_NET_THREADS = 1;
+/** Maximum number of socket I/O threads */
+static const int MAX_NET_THREADS = 16;
 /** The period before a network upgrade activates, where connections to upgrading peers are preferred (in blocks). */
 static const int NETWORK_UPGRADE_PEER_PREFERENCE_BLOCK_PERIOD = 24 * 24 * 3;
 
@@ -94,6 +98,18 @@ bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
+void WakeMessageHandler();
+
+/** Socket readiness requested from and reported by WaitSocketEvents */
+enum
+{
+    SOCKET_EVENT_RECV = 1,
+    SOCKET_EVENT_SEND = 2,
+    SOCKET_EVENT_ERR = 4,
+};
+/** Wait up to nTimeoutMs for the requested events on each socket and replace them with the events
+ *  that occurred. Uses poll() where available, so any number of sockets can be waited on. */
+bool WaitSocketEvents(std::vector<std::pair<SOCKET, int> > &vSockets, int64_t nTimeoutMs);
 
 typedef int NodeId;
 
@@ -267,6 +283,7 @@ public:
     // socket
     uint64_t nServices;
     SOCKET hSocket;
+    CCriticalSection cs_hSocket; // held to send on, receive on or close hSocket, which any net thread may close
     CDataStream ssSend;
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
@@ -285,6 +302,7 @@ public:
     int64_t nTimeConnected;
     int64_t nTimeOffset;
     uint32_t prevtimes[16],dexlastping;
+    uint64_t dexlastseq;
     // Address of this peer
     CAddress addr;
     // Bind address of our side of the connection
@@ -27,9 +27,13 @@
 #include "crypto/equihash.h"
 #include "primitives/block.h"
 #include "streams.h"
+#include "sync.h"
 #include "uint256.h"
 #include "util.h"
 
+#include <deque>
+#include <set>
+
 #include "sodium.h"
 
 #ifdef ENABLE_RUST
@@ -758,6 +762,34 @@ uint32_t lwmaGetNextPOSRequired(const CBlockIndex* pindexLast, const Consensus::
     return nextTarget.GetCompact();
 }
 
+// Headers whose Equihash solution already verified. The same header is checked by
+// AcceptBlockHeader, CheckBlock (twice, once more from ConnectBlock) and komodo_checkPOW,
+// and the -reindex pipeline pre-verifies solutions on worker threads, so remember the
+// most recent successes. The hash commits to nSolution, so a hit is always safe.
+static const size_t MAX_EQUIHASH_CACHE = 8192;
+static CCriticalSection cs_equihashcache;
+static std::set<uint256> setEquihashValid;
+static std::deque<uint256> dequeEquihashValid;
+
+static bool EquihashCacheContains(const uint256 &hash)
+{
+    LOCK(cs_equihashcache);
+    return setEquihashValid.count(hash) != 0;
+}
+
+static void EquihashCacheAdd(const uint256 &hash)
+{
+    LOCK(cs_equihashcache);
+    if ( !setEquihashValid.insert(hash).second )
+        return;
+    dequeEquihashValid.push_back(hash);
+    while ( dequeEquihashValid.size() > MAX_EQUIHASH_CACHE )
+    {
+        setEquihashValid.erase(dequeEquihashValid.front());
+        dequeEquihashValid.pop_front();
+    }
+}
+
 bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& params)
 {
     if (ASSETCHAINS_ALGO != ASSETCHAINS_EQUIHASH)
@@ -771,6 +803,9 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
 
     if ( Params().NetworkIDString() == "regtest" )
         return(true);
+    uint256 hash = pblock->GetHash();
+    if ( EquihashCacheContains(hash) )
+        return(true);
     // Hash state
     crypto_generichash_blake2b_state state;
     EhInitialiseState(n, k, state);
@@ -791,6 +826,7 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
     if (!isValid)
         return error("CheckEquihashSolution(): invalid solution");
 
+    EquihashCacheAdd(hash);
     return true;
 }
 
@@ -18,6 +18,7 @@
  *                                                                            *
  ******************************************************************************/
 
+#include "base58.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
@@ -37,6 +38,7 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t REST_STREAM_CHUNK_SIZE = 64 * 1024; //flush streamed replies in chunks of this many bytes
 
 enum RetFormat {
     RF_UNDEF,
@@ -71,6 +73,173 @@ struct CCoin {
     }
 };
 
+struct CAddressUtxoRecord {
+    std::string address; // not serialized, the address is in the request
+    uint256 txhash;
+    uint32_t index;
+    CScript script;
+    CAmount satoshis;
+    int32_t height;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txhash);
+        READWRITE(index);
+        READWRITE(*(CScriptBase*)(&script));
+        READWRITE(satoshis);
+        READWRITE(height);
+    }
+
+    UniValue ToJSON() const
+    {
+        UniValue output(UniValue::VOBJ);
+        output.push_back(Pair("address", address));
+        output.push_back(Pair("txid", txhash.GetHex()));
+        output.push_back(Pair("outputIndex", (int)index));
+        output.push_back(Pair("script", HexStr(script.begin(), script.end())));
+        output.push_back(Pair("satoshis", satoshis));
+        output.push_back(Pair("height", height));
+        return output;
+    }
+};
+
+struct CAddressDeltaRecord {
+    std::string address; // not serialized, the address is in the request
+    uint256 txhash;
+    uint32_t index;
+    uint32_t blockindex;
+    int32_t height;
+    CAmount satoshis;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txhash);
+        READWRITE(index);
+        READWRITE(blockindex);
+        READWRITE(height);
+        READWRITE(satoshis);
+    }
+
+    UniValue ToJSON() const
+    {
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", satoshis));
+        delta.push_back(Pair("txid", txhash.GetHex()));
+        delta.push_back(Pair("index", (int)index));
+        delta.push_back(Pair("blockindex", (int)blockindex));
+        delta.push_back(Pair("height", height));
+        delta.push_back(Pair("address", address));
+        return delta;
+    }
+};
+
+struct CAddressTxidRecord {
+    uint256 txhash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txhash);
+    }
+
+    UniValue ToJSON() const
+    {
+        return UniValue(txhash.GetHex());
+    }
+};
+
+/**
+ * Chunked reply for REST requests answered record by record from an index
+ * iterator, so the reply is never held as one document. Binary replies are
+ * the serialized records back to back, hex replies the same bytes in hex
+ * and JSON replies an array of one object per record.
+ *
+ * Write returns false once the client has gone away, which the index walk
+ * passes on to stop early. A reply that did not complete is aborted rather
+ * than closed, so a JSON client never sees a well formed but short array.
+ */
+class RESTStream
+{
+private:
+    HTTPRequest* req;
+    RetFormat rf;
+    std::string strBuffer;
+    bool fFirst;
+    bool fFailed;
+
+    bool Flush()
+    {
+        if (!strBuffer.empty()) {
+            if (!req->WriteReplyChunk(strBuffer))
+                fFailed = true;
+            strBuffer.clear();
+        }
+        return !fFailed;
+    }
+
+public:
+    RESTStream(HTTPRequest* reqIn, RetFormat rfIn) : req(reqIn), rf(rfIn), fFirst(true), fFailed(false)
+    {
+        if (rf == RF_BINARY)
+            req->WriteHeader("Content-Type", "application/octet-stream");
+        else if (rf == RF_HEX)
+            req->WriteHeader("Content-Type", "text/plain");
+        else
+            req->WriteHeader("Content-Type", "application/json");
+        req->StartReplyChunks(HTTP_OK);
+        if (rf == RF_JSON)
+            strBuffer = "[";
+    }
+
+    template <typename Record>
+    bool Write(const Record& record)
+    {
+        if (fFailed || req->ReplyChunksClosed()) {
+            fFailed = true;
+            return false;
+        }
+        if (rf == RF_JSON) {
+            if (!fFirst)
+                strBuffer += ",";
+            strBuffer += record.ToJSON().write();
+        } else {
+            CDataStream ssRecord(SER_NETWORK, PROTOCOL_VERSION);
+            ssRecord << record;
+            if (rf == RF_BINARY)
+                strBuffer.append(ssRecord.begin(), ssRecord.end());
+            else
+                strBuffer += HexStr(ssRecord.begin(), ssRecord.end());
+        }
+        fFirst = false;
+        if (strBuffer.size() >= REST_STREAM_CHUNK_SIZE)
+            return Flush();
+        return true;
+    }
+
+    void Finish(bool fComplete)
+    {
+        if (!fComplete || fFailed) {
+            req->AbortReplyChunks();
+            return;
+        }
+        if (rf == RF_JSON)
+            strBuffer += "]\n";
+        else if (rf == RF_HEX)
+            strBuffer += "\n";
+        Flush();
+        req->EndReplyChunks();
+    }
+};
+
+extern bool fAddressIndex, fSpentIndex;
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
@@ -605,6 +774,207 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/**
+ * Parse "<address>[/<start>/<end>]" of an address index request into the
+ * index key of the address and an optional block height range.
+ */
+static bool ParseAddressRange(HTTPRequest* req, const std::string& strPath, bool ccflag,
+                              std::string& strAddress, uint160& hashBytes, int& type, int& start, int& end)
+{
+    vector<string> uriParts;
+    boost::split(uriParts, strPath, boost::is_any_of("/"));
+    if (uriParts.size() != 1 && uriParts.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /<address>[/<start>/<end>].<ext>");
+
+    strAddress = uriParts[0];
+    CBitcoinAddress address(strAddress);
+    if (!address.GetIndexKey(hashBytes, type, ccflag))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + strAddress);
+
+    start = end = 0;
+    if (uriParts.size() == 3) {
+        if (!ParseInt32(uriParts[1], &start) || !ParseInt32(uriParts[2], &end) || start <= 0 || end < start)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height range, expected 0 < start <= end");
+    }
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index not enabled, start with -addressindex");
+    return true;
+}
+
+static bool rest_address_unspent(HTTPRequest* req, const std::string& strURIPart, bool ccflag)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::string strAddress;
+    uint160 hashBytes;
+    int type = 0, start, end;
+    if (!ParseAddressRange(req, params[0], ccflag, strAddress, hashBytes, type, start, end))
+        return false;
+
+    // Unspent outputs are keyed by txid, so a height range is a filter rather than a seek
+    RESTStream stream(req, rf);
+    bool fComplete = ForEachAddressUnspent(hashBytes, type, [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        if (end > 0 && (value.blockHeight < start || value.blockHeight > end))
+            return true;
+        CAddressUtxoRecord record;
+        record.address = strAddress;
+        record.txhash = key.txhash;
+        record.index = key.index;
+        record.script = value.script;
+        record.satoshis = value.satoshis;
+        record.height = value.blockHeight;
+        return stream.Write(record);
+    });
+    stream.Finish(fComplete);
+    return true;
+}
+
+static bool rest_addressutxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address_unspent(req, strURIPart, false);
+}
+
+static bool rest_ccaddressutxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address_unspent(req, strURIPart, true);
+}
+
+// Not static, zcbenchmarks compares it against the getaddressdeltas RPC
+bool rest_addressdeltas(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::string strAddress;
+    uint160 hashBytes;
+    int type = 0, start, end;
+    if (!ParseAddressRange(req, params[0], false, strAddress, hashBytes, type, start, end))
+        return false;
+
+    RESTStream stream(req, rf);
+    bool fComplete = ForEachAddressIndex(hashBytes, type, start, end, [&](const CAddressIndexKey& key, CAmount nValue) {
+        CAddressDeltaRecord record;
+        record.address = strAddress;
+        record.txhash = key.txhash;
+        record.index = key.index;
+        record.blockindex = key.txindex;
+        record.height = key.blockHeight;
+        record.satoshis = nValue;
+        return stream.Write(record);
+    });
+    stream.Finish(fComplete);
+    return true;
+}
+
+static bool rest_addresstxids(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::string strAddress;
+    uint160 hashBytes;
+    int type = 0, start, end;
+    if (!ParseAddressRange(req, params[0], false, strAddress, hashBytes, type, start, end))
+        return false;
+
+    // Entries are in height order and the entries of one tx are adjacent
+    RESTStream stream(req, rf);
+    uint256 lastTxid;
+    bool fComplete = ForEachAddressIndex(hashBytes, type, start, end, [&](const CAddressIndexKey& key, CAmount nValue) {
+        if (key.txhash != lastTxid) {
+            CAddressTxidRecord record;
+            record.txhash = lastTxid = key.txhash;
+            return stream.Write(record);
+        }
+        return true;
+    });
+    stream.Finish(fComplete);
+    return true;
+}
+
+static bool rest_spentinfo(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+
+    vector<string> uriParts;
+    boost::split(uriParts, params[0], boost::is_any_of("/"));
+    uint256 txid;
+    int32_t n;
+    if (uriParts.size() != 2 || !ParseHashStr(uriParts[0], txid) || !ParseInt32(uriParts[1], &n) || n < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/spentinfo/<txid>/<n>.<ext>");
+    if (!fSpentIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Spent index not enabled, start with -spentindex");
+
+    CSpentIndexKey key(txid, n);
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        return RESTERR(req, HTTP_NOT_FOUND, params[0] + " not spent");
+
+    CDataStream ssSpent(SER_NETWORK, PROTOCOL_VERSION);
+    ssSpent << value.txid << value.inputIndex << value.blockHeight;
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binarySpent = ssSpent.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binarySpent);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssSpent.begin(), ssSpent.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", value.txid.GetHex()));
+        obj.push_back(Pair("index", (int)value.inputIndex));
+        obj.push_back(Pair("height", value.blockHeight));
+        string strJSON = obj.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+// Prometheus scrape target, answered during warmup too
+static bool rest_metrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!strURIPart.empty())
+        return RESTERR(req, HTTP_NOT_FOUND, "Invalid URI format. Expected /rest/metrics");
+
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, RPCStatsToPrometheus());
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -617,6 +987,12 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/addressutxos/", rest_addressutxos},
+      {"/rest/addressdeltas/", rest_addressdeltas},
+      {"/rest/addresstxids/", rest_addresstxids},
+      {"/rest/ccaddressutxos/", rest_ccaddressutxos},
+      {"/rest/spentinfo/", rest_spentinfo},
+      {"/rest/metrics", rest_metrics},
 };
 
 bool StartREST()
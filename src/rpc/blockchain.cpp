@@ -1275,13 +1275,14 @@ UniValue gettxout(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
 UniValue verifychain(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
-    if (fHelp || params.size() > 2)
+    if (fHelp || params.size() > 3)
         throw runtime_error(
-            "verifychain ( checklevel numblocks )\n"
+            "verifychain ( checklevel numblocks seconds )\n"
             "\nVerifies blockchain database.\n"
             "\nArguments:\n"
             "1. checklevel   (numeric, optional, 0-4, default=3) How thorough the block verification is.\n"
             "2. numblocks    (numeric, optional, default=288, 0=all) The number of blocks to check.\n"
+            "3. seconds      (numeric, optional, default=0, 0=no limit) Stop checking after this many seconds.\n"
             "\nResult:\n"
             "true|false       (boolean) Verified or not\n"
             "\nExamples:\n"
@@ -1293,12 +1294,15 @@ UniValue verifychain(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
     int nCheckLevel = GetArg("-checklevel", 3);
     int nCheckDepth = GetArg("-checkblocks", 288);
+    int64_t nCheckSeconds = GetArg("-checktime", 0);
     if (params.size() > 0)
         nCheckLevel = params[0].get_int();
     if (params.size() > 1)
         nCheckDepth = params[1].get_int();
+    if (params.size() > 2)
+        nCheckSeconds = params[2].get_int64();
 
-    return CVerifyDB().VerifyDB(pcoinsTip, nCheckLevel, nCheckDepth);
+    return CVerifyDB().VerifyDB(pcoinsTip, nCheckLevel, nCheckDepth, nCheckSeconds);
 }
 
 /** Implementation of IsSuperMajority with better feedback */
@@ -1613,6 +1617,9 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("size", (int64_t)mempool.size()));
     ret.push_back(Pair("bytes", (int64_t)mempool.GetTotalTxSize()));
     ret.push_back(Pair("usage", (int64_t)mempool.DynamicMemoryUsage()));
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    ret.push_back(Pair("maxmempool", (int64_t)maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
     if (Params().NetworkIDString() == "regtest") {
         ret.push_back(Pair("fullyNotified", mempool.IsFullyNotified()));
@@ -1632,6 +1639,8 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool, set by -maxmempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee per kB for a tx to be accepted, raised after evictions\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -113,6 +113,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importaddress", 2 },
     { "verifychain", 0 },
     { "verifychain", 1 },
+    { "verifychain", 2 },
     { "keypoolrefill", 0 },
     { "getrawmempool", 0 },
     { "estimatefee", 0 },
@@ -433,6 +433,10 @@ UniValue coinsupply(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "  \"zfunds\" : \"0.777\",           (float) The shielded coin supply (in zaddrs)\n"
             "  \"sprout\" : \"0.077\",           (float) The sprout coin supply (in zcaddrs)\n"
            "  \"total\" :  \"777.777\",         (float) The total coin supply, i.e. sum of supply + zfunds\n"
+            "  \"burned\" : \"0.7\",             (float) Coins sent to opreturns or the burn address, if accounted\n"
+            "  \"interest\" : \"7.0\",           (float) KMD interest claimed, if accounted\n"
+            "  \"sproutpool\" : \"0.077\",       (float) Value held by the Sprout pool, if known\n"
+            "  \"saplingpool\" : \"0.7\",        (float) Value held by the Sapling pool, if known\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("coinsupply", "420")
@@ -453,6 +457,19 @@ UniValue coinsupply(const UniValue& params, bool fHelp, const CPubKey& mypk)
             result.push_back(Pair("zfunds", ValueFromAmount(zfunds)));
             result.push_back(Pair("sprout", ValueFromAmount(sproutfunds)));
             result.push_back(Pair("total", ValueFromAmount(zfunds + supply)));
+            {
+                LOCK(cs_main);
+                CBlockIndex *pindex = chainActive[height];
+                if ( pindex != 0 && pindex->nChainSupply )
+                {
+                    result.push_back(Pair("burned", ValueFromAmount(pindex->nChainSupply->nBurned)));
+                    result.push_back(Pair("interest", ValueFromAmount(pindex->nChainSupply->nInterest)));
+                }
+                if ( pindex != 0 && pindex->nChainSproutValue )
+                    result.push_back(Pair("sproutpool", ValueFromAmount(*pindex->nChainSproutValue)));
+                if ( pindex != 0 && pindex->nChainSaplingValue )
+                    result.push_back(Pair("saplingpool", ValueFromAmount(*pindex->nChainSaplingValue)));
+            }
             if ( ASSETCHAINS_BLOCKTIME > 0 )
             {
                 blocks_per_year = 24*3600*365 / ASSETCHAINS_BLOCKTIME;
@@ -21,14 +21,19 @@
 
 #include "rpc/server.h"
 
+#include "httpserver.h"
 #include "init.h"
 #include "key_io.h"
+#include "main.h"
 #include "random.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "asyncrpcqueue.h"
+#ifdef ENABLE_WALLET
+#include "wallet/wallet.h"
+#endif
 
 #include <memory>
 
@@ -285,6 +290,224 @@ UniValue stop(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return buf;
 }
 
+/** Latency buckets, bucket i counts the calls that took less than 2^i microseconds */
+static const int RPC_LATENCY_BUCKETS = 32;
+
+struct CRPCCommandStats
+{
+    uint64_t nCount;
+    uint64_t nErrors;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    uint64_t vBuckets[RPC_LATENCY_BUCKETS];
+    std::map<std::string, int64_t> mapLockWaitMicros;
+
+    CRPCCommandStats() : nCount(0), nErrors(0), nTotalMicros(0), nMaxMicros(0)
+    {
+        memset(vBuckets, 0, sizeof(vBuckets));
+    }
+
+    void Add(int64_t nMicros, bool fError)
+    {
+        int nBucket = 0;
+        while (nBucket < RPC_LATENCY_BUCKETS - 1 && (int64_t(1) << nBucket) <= nMicros)
+            nBucket++;
+        vBuckets[nBucket]++;
+        nCount++;
+        nErrors += fError;
+        nTotalMicros += nMicros;
+        nMaxMicros = std::max(nMaxMicros, nMicros);
+    }
+
+    /** Latency below which a fraction q of the calls fall, to within a factor 2 */
+    int64_t Percentile(double q) const
+    {
+        uint64_t nRank = std::max((uint64_t)1, (uint64_t)ceil(q * nCount)), nSeen = 0;
+        for (int i = 0; i < RPC_LATENCY_BUCKETS; i++) {
+            nSeen += vBuckets[i];
+            if (nSeen >= nRank)
+                return std::min(int64_t(1) << i, nMaxMicros);
+        }
+        return nMaxMicros;
+    }
+};
+
+static CCriticalSection cs_rpcStats;
+static std::map<std::string, CRPCCommandStats> mapRPCStats;
+
+/** Name lock waits after the locks we want to see contention on */
+static std::string LockWaitName(void* cs)
+{
+    if (cs == (void*)&cs_main)
+        return "cs_main";
+    if (cs == (void*)&mempool.cs)
+        return "mempool.cs";
+#ifdef ENABLE_WALLET
+    if (pwalletMain && cs == (void*)&pwalletMain->cs_wallet)
+        return "cs_wallet";
+#endif
+    return "other";
+}
+
+/** Times one RPC command and collects the lock waits of its thread meanwhile */
+class CRPCCommandTimer
+{
+private:
+    std::string strMethod;
+    int64_t nStart;
+    LockWaits waits;
+    LockWaits* pprevWaits;
+
+public:
+    bool fError;
+
+    CRPCCommandTimer(const std::string& strMethodIn) : strMethod(strMethodIn), nStart(GetTimeMicros()), fError(true)
+    {
+        pprevWaits = SetThreadLockWaits(&waits);
+    }
+
+    ~CRPCCommandTimer()
+    {
+        int64_t nMicros = GetTimeMicros() - nStart;
+        SetThreadLockWaits(pprevWaits);
+
+        LOCK(cs_rpcStats);
+        CRPCCommandStats& stats = mapRPCStats[strMethod];
+        stats.Add(nMicros, fError);
+        for (LockWaits::const_iterator it = waits.begin(); it != waits.end(); ++it)
+            stats.mapLockWaitMicros[LockWaitName(it->first)] += it->second;
+    }
+};
+
+UniValue getrpcstats(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcstats\n"
+            "\nReturns latency statistics of the RPC commands called since startup and of the HTTP work queue.\n"
+            "Percentiles are accurate to within a factor 2. Lock waits only count the time a command\n"
+            "blocked on a lock held by another thread.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"commands\": {\n"
+            "    \"command\": {\n"
+            "      \"count\": n,            (numeric) Number of calls\n"
+            "      \"errors\": n,           (numeric) Number of calls that returned an error\n"
+            "      \"total_ms\": n,         (numeric) Time spent in all calls\n"
+            "      \"p50_ms\": n,           (numeric) Median latency\n"
+            "      \"p99_ms\": n,           (numeric) 99th percentile latency\n"
+            "      \"max_ms\": n,           (numeric) Largest latency\n"
+            "      \"lockwait_ms\": {       (object) Time the calls waited for cs_main, cs_wallet, mempool.cs and other locks\n"
+            "        \"lock\": n\n"
+            "      }\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"workqueue\": {\n"
+            "    \"depth\": n,              (numeric) Requests waiting for a worker thread\n"
+            "    \"capacity\": n,           (numeric) Most requests that can wait, set by -rpcworkqueue\n"
+            "    \"peak_depth\": n,         (numeric) Most requests that waited at once\n"
+            "    \"threads\": n,            (numeric) Worker threads, set by -rpcthreads\n"
+            "    \"enqueued\": n,           (numeric) Requests accepted\n"
+            "    \"rejected\": n,           (numeric) Requests rejected because the queue was full\n"
+            "    \"wait_avg_ms\": n,        (numeric) Average time a request waited for a worker\n"
+            "    \"wait_max_ms\": n         (numeric) Longest time a request waited for a worker\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcstats", "")
+            + HelpExampleRpc("getrpcstats", "")
+        );
+
+    UniValue commands(UniValue::VOBJ);
+    {
+        LOCK(cs_rpcStats);
+        for (std::map<std::string, CRPCCommandStats>::const_iterator it = mapRPCStats.begin(); it != mapRPCStats.end(); ++it) {
+            const CRPCCommandStats& stats = it->second;
+            UniValue command(UniValue::VOBJ), lockwaits(UniValue::VOBJ);
+            command.push_back(Pair("count", stats.nCount));
+            command.push_back(Pair("errors", stats.nErrors));
+            command.push_back(Pair("total_ms", stats.nTotalMicros / 1000.0));
+            command.push_back(Pair("p50_ms", stats.Percentile(0.5) / 1000.0));
+            command.push_back(Pair("p99_ms", stats.Percentile(0.99) / 1000.0));
+            command.push_back(Pair("max_ms", stats.nMaxMicros / 1000.0));
+            for (std::map<std::string, int64_t>::const_iterator lw = stats.mapLockWaitMicros.begin(); lw != stats.mapLockWaitMicros.end(); ++lw)
+                lockwaits.push_back(Pair(lw->first, lw->second / 1000.0));
+            command.push_back(Pair("lockwait_ms", lockwaits));
+            commands.push_back(Pair(it->first, command));
+        }
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("commands", commands));
+    HTTPWorkQueueStats wq;
+    if (GetHTTPWorkQueueStats(wq)) {
+        UniValue workqueue(UniValue::VOBJ);
+        workqueue.push_back(Pair("depth", (uint64_t)wq.depth));
+        workqueue.push_back(Pair("capacity", (uint64_t)wq.maxDepth));
+        workqueue.push_back(Pair("peak_depth", (uint64_t)wq.peakDepth));
+        workqueue.push_back(Pair("threads", wq.numThreads));
+        workqueue.push_back(Pair("enqueued", wq.numEnqueued));
+        workqueue.push_back(Pair("rejected", wq.numRejected));
+        workqueue.push_back(Pair("wait_avg_ms", wq.numEnqueued ? wq.totalWaitMicros / 1000.0 / wq.numEnqueued : 0.0));
+        workqueue.push_back(Pair("wait_max_ms", wq.maxWaitMicros / 1000.0));
+        ret.push_back(Pair("workqueue", workqueue));
+    }
+    return ret;
+}
+
+std::string RPCStatsToPrometheus()
+{
+    std::string strOut;
+    {
+        LOCK(cs_rpcStats);
+        strOut += "# HELP komodod_rpc_duration_seconds Latency of RPC commands.\n";
+        strOut += "# TYPE komodod_rpc_duration_seconds summary\n";
+        for (std::map<std::string, CRPCCommandStats>::const_iterator it = mapRPCStats.begin(); it != mapRPCStats.end(); ++it) {
+            const CRPCCommandStats& stats = it->second;
+            const char* method = it->first.c_str();
+            strOut += strprintf("komodod_rpc_duration_seconds{method=\"%s\",quantile=\"0.5\"} %.6f\n", method, stats.Percentile(0.5) / 1e6);
+            strOut += strprintf("komodod_rpc_duration_seconds{method=\"%s\",quantile=\"0.99\"} %.6f\n", method, stats.Percentile(0.99) / 1e6);
+            strOut += strprintf("komodod_rpc_duration_seconds{method=\"%s\",quantile=\"1\"} %.6f\n", method, stats.nMaxMicros / 1e6);
+            strOut += strprintf("komodod_rpc_duration_seconds_sum{method=\"%s\"} %.6f\n", method, stats.nTotalMicros / 1e6);
+            strOut += strprintf("komodod_rpc_duration_seconds_count{method=\"%s\"} %u\n", method, stats.nCount);
+        }
+        strOut += "# HELP komodod_rpc_errors_total RPC commands that returned an error.\n";
+        strOut += "# TYPE komodod_rpc_errors_total counter\n";
+        for (std::map<std::string, CRPCCommandStats>::const_iterator it = mapRPCStats.begin(); it != mapRPCStats.end(); ++it)
+            strOut += strprintf("komodod_rpc_errors_total{method=\"%s\"} %u\n", it->first, it->second.nErrors);
+        strOut += "# HELP komodod_rpc_lock_wait_seconds_total Time RPC commands blocked on locks held by other threads.\n";
+        strOut += "# TYPE komodod_rpc_lock_wait_seconds_total counter\n";
+        for (std::map<std::string, CRPCCommandStats>::const_iterator it = mapRPCStats.begin(); it != mapRPCStats.end(); ++it)
+            for (std::map<std::string, int64_t>::const_iterator lw = it->second.mapLockWaitMicros.begin(); lw != it->second.mapLockWaitMicros.end(); ++lw)
+                strOut += strprintf("komodod_rpc_lock_wait_seconds_total{method=\"%s\",lock=\"%s\"} %.6f\n", it->first, lw->first, lw->second / 1e6);
+    }
+
+    HTTPWorkQueueStats wq;
+    if (GetHTTPWorkQueueStats(wq)) {
+        strOut += "# HELP komodod_http_workqueue_depth Requests waiting for a worker thread.\n";
+        strOut += "# TYPE komodod_http_workqueue_depth gauge\n";
+        strOut += strprintf("komodod_http_workqueue_depth %u\n", wq.depth);
+        strOut += "# HELP komodod_http_workqueue_capacity Most requests that can wait, set by -rpcworkqueue.\n";
+        strOut += "# TYPE komodod_http_workqueue_capacity gauge\n";
+        strOut += strprintf("komodod_http_workqueue_capacity %u\n", wq.maxDepth);
+        strOut += "# HELP komodod_http_workqueue_peak_depth Most requests that waited at once.\n";
+        strOut += "# TYPE komodod_http_workqueue_peak_depth gauge\n";
+        strOut += strprintf("komodod_http_workqueue_peak_depth %u\n", wq.peakDepth);
+        strOut += "# HELP komodod_http_workqueue_threads Worker threads.\n";
+        strOut += "# TYPE komodod_http_workqueue_threads gauge\n";
+        strOut += strprintf("komodod_http_workqueue_threads %d\n", wq.numThreads);
+        strOut += "# HELP komodod_http_workqueue_rejected_total Requests rejected because the queue was full.\n";
+        strOut += "# TYPE komodod_http_workqueue_rejected_total counter\n";
+        strOut += strprintf("komodod_http_workqueue_rejected_total %u\n", wq.numRejected);
+        strOut += "# HELP komodod_http_workqueue_wait_seconds Time requests waited for a worker thread.\n";
+        strOut += "# TYPE komodod_http_workqueue_wait_seconds summary\n";
+        strOut += strprintf("komodod_http_workqueue_wait_seconds{quantile=\"1\"} %.6f\n", wq.maxWaitMicros / 1e6);
+        strOut += strprintf("komodod_http_workqueue_wait_seconds_sum %.6f\n", wq.totalWaitMicros / 1e6);
+        strOut += strprintf("komodod_http_workqueue_wait_seconds_count %u\n", wq.numEnqueued);
+    }
+    return strOut;
+}
+
 /**
  * Call Table
  */
@@ -296,6 +519,7 @@ static const CRPCCommand vRPCCommands[] =
     { "control",            "getiguanajson",          &getiguanajson,          true  },
     { "control",            "getnotarysendmany",      &getnotarysendmany,      true  },
     { "control",            "geterablockheights",     &geterablockheights,     true  },
+    { "control",            "getrpcstats",            &getrpcstats,            true  },
     { "control",            "stop",                   &stop,                   true  },
 
     /* P2P networking */
@@ -425,6 +649,7 @@ static const CRPCCommand vRPCCommands[] =
     { "DEX",   "DEX_stats",             &DEX_stats, true },
     { "DEX",   "DEX_orderbook",         &DEX_orderbook, true },
     { "DEX",   "DEX_cancel",            &DEX_cancel, true },
+    { "DEX",   "DEX_powcancel",         &DEX_powcancel, true },
     { "DEX",   "DEX_setpubkey",         &DEX_setpubkey, true },
     { "DEX",   "DEX_publish",           &DEX_publish, true },
     { "DEX",   "DEX_subscribe",         &DEX_subscribe, true },
@@ -658,6 +883,7 @@ static const CRPCCommand vRPCCommands[] =
     { "wallet",             "z_getoperationstatus",   &z_getoperationstatus,   true  },
     { "wallet",             "z_getoperationresult",   &z_getoperationresult,   true  },
     { "wallet",             "z_listoperationids",     &z_listoperationids,     true  },
+    { "wallet",             "z_getoperationstats",    &z_getoperationstats,    true  },
     { "wallet",             "z_getnewaddress",        &z_getnewaddress,        true  },
     { "wallet",             "z_listaddresses",        &z_listaddresses,        true  },
     { "wallet",             "z_exportkey",            &z_exportkey,            true  },
@@ -714,20 +940,15 @@ bool StartRPC()
     fRPCRunning = true;
     g_rpcSignals.Started();
 
-    // Launch one async rpc worker.  The ability to launch multiple workers is not recommended at present and thus the option is disabled.
-    getAsyncRPCQueue()->addWorker();
-/*
-    int n = GetArg("-rpcasyncthreads", 1);
-    if (n<1) {
+    // Launch the async rpc workers.  Operations reserve their inputs in the wallet when
+    // they select them, so several of them can build and prove transactions at once.
+    int n = GetArg("-rpcasyncthreads", DEFAULT_RPC_ASYNC_THREADS);
+    if (n < 1) {
         LogPrintf("ERROR: Invalid value %d for -rpcasyncthreads.  Must be at least 1.\n", n);
-        strerr = strprintf(_("An error occurred while setting up the Async RPC threads, invalid parameter value of %d (must be at least 1)."), n);
-        uiInterface.ThreadSafeMessageBox(strerr, "", CClientUIInterface::MSG_ERROR);
-        StartShutdown();
-        return;
+        return false;
     }
     for (int i = 0; i < n; i++)
         getAsyncRPCQueue()->addWorker();
-*/
     return true;
 }
 
@@ -856,10 +1077,13 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    UniValue result;
     try
     {
         // Execute
-        return pcmd->actor(params, false, CPubKey());
+        CRPCCommandTimer timer(strMethod);
+        result = pcmd->actor(params, false, CPubKey());
+        timer.fError = false;
     }
     catch (const std::exception& e)
     {
@@ -867,6 +1091,7 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     }
 
     g_rpcSignals.PostCommand(*pcmd);
+    return result;
 }
 
 std::string HelpExampleCli(const std::string& methodname, const std::string& args)
@@ -39,6 +39,9 @@
 class AsyncRPCQueue;
 class CRPCCommand;
 
+//! -rpcasyncthreads default
+static const int DEFAULT_RPC_ASYNC_THREADS = 1;
+
 namespace RPCServer
 {
     void OnStarted(boost::function<void ()> slot);
@@ -176,6 +179,10 @@ public:
 
 extern CRPCTable tableRPC;
 
+/** Latency, error and lock wait statistics of the RPC commands and the
+ *  HTTP work queue in the Prometheus text format, for /rest/metrics */
+std::string RPCStatsToPrometheus();
+
 /**
  * Utilities: convert hex-encoded Values
  * (throws error if not hex).
@@ -376,6 +383,7 @@ extern UniValue getinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
 extern UniValue getiguanajson(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue getnotarysendmany(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue geterablockheights(const UniValue& params, bool fHelp, const CPubKey& mypk);
+extern UniValue getrpcstats(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue setpubkey(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue setstakingsplit(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue getwalletinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -464,6 +472,7 @@ extern UniValue DEX_get(const UniValue& params, bool fHelp, const CPubKey& mypk)
 extern UniValue DEX_stats(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue DEX_orderbook(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue DEX_cancel(const UniValue& params, bool fHelp, const CPubKey& mypk);
+extern UniValue DEX_powcancel(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue DEX_setpubkey(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue DEX_publish(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue DEX_subscribe(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -490,6 +499,7 @@ extern UniValue z_shieldcoinbase(const UniValue& params, bool fHelp, const CPubK
 extern UniValue z_getoperationstatus(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcwallet.cpp
 extern UniValue z_getoperationresult(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcwallet.cpp
 extern UniValue z_listoperationids(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcwallet.cpp
+extern UniValue z_getoperationstats(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcwallet.cpp
 extern UniValue opreturn_burn(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcwallet.cpp
 extern UniValue z_validateaddress(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcmisc.cpp
 extern UniValue z_getpaymentdisclosure(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcdisclosure.cpp
@@ -27,6 +27,26 @@
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
+static thread_local LockWaits* plockwaits = NULL;
+
+LockWaits* SetThreadLockWaits(LockWaits* pwaits)
+{
+    LockWaits* pprev = plockwaits;
+    plockwaits = pwaits;
+    return pprev;
+}
+
+int64_t LockWaitStart()
+{
+    return plockwaits ? GetTimeMicros() : 0;
+}
+
+void LockWaitEnd(void* cs, int64_t nStart)
+{
+    if (nStart != 0 && plockwaits)
+        (*plockwaits)[cs] += GetTimeMicros() - nStart;
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
@@ -23,6 +23,9 @@
 
 #include "threadsafety.h"
 
+#include <map>
+#include <stdint.h>
+
 #undef __cpuid
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
@@ -115,6 +118,17 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Lock wait accounting. While a thread has set a LockWaits map with
+ * SetThreadLockWaits, LOCK adds the microseconds it blocks on a contended
+ * mutex to the entry of that mutex. Uncontended locks are not timed.
+ */
+typedef std::map<void*, int64_t> LockWaits;
+/** Set the map of this thread (NULL to stop), returns the previous one */
+LockWaits* SetThreadLockWaits(LockWaits* pwaits);
+int64_t LockWaitStart();
+void LockWaitEnd(void* cs, int64_t nStart);
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
@@ -125,14 +139,14 @@ private:
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            int64_t nWaitStart = LockWaitStart();
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            LockWaitEnd((void*)(lock.mutex()), nWaitStart);
         }
-#endif
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
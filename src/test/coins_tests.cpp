@@ -10,6 +10,7 @@
 #include "test/test_bitcoin.h"
 #include "consensus/validation.h"
 #include "main.h"
+#include "txdb.h"
 #include "undo.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
@@ -982,4 +983,169 @@ BOOST_AUTO_TEST_CASE(ccoins_serialization)
     }
 }
 
+class CCoinsViewDBSplitTest : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBSplitTest() : CCoinsViewDB(1 << 20, true) {}
+
+    // Reruns the startup migration with another -coinssplitoutputs on the same in-memory database
+    void Reopen(int64_t nSplitOutputs)
+    {
+        mapArgs["-coinssplitoutputs"] = i64tostr(nSplitOutputs);
+        mapSplitCoins.clear();
+        InitSplitCoins();
+    }
+
+    size_t SplitCount()
+    {
+        LOCK(cs_splitcoins);
+        return mapSplitCoins.size();
+    }
+
+    void WriteVersion(uint32_t nVersion)
+    {
+        db.Write('V', nVersion);
+    }
+};
+
+static std::map<uint256, CCoins> SplitTestCoins()
+{
+    std::map<uint256, CCoins> mapCoins;
+    for (int nOutputs = 1; nOutputs <= 12; nOutputs += 5) {
+        CCoins coins;
+        coins.nVersion = 1;
+        coins.fCoinBase = nOutputs == 6;
+        coins.nHeight = 100 + nOutputs;
+        coins.vout.resize(nOutputs);
+        for (int i = 0; i < nOutputs; i++) {
+            coins.vout[i].nValue = 1000 * nOutputs + i;
+            coins.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+        mapCoins[GetRandHash()] = coins;
+    }
+    return mapCoins;
+}
+
+static void WriteSplitTestCoins(CCoinsView &view, const std::map<uint256, CCoins> &mapCoins, const uint256 &hashBlock)
+{
+    CCoinsViewCache cache(&view);
+    for (std::map<uint256, CCoins>::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++)
+        *cache.ModifyCoins(it->first) = it->second;
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Flush());
+}
+
+static void CheckSplitTestCoins(CCoinsView &view, const std::map<uint256, CCoins> &mapCoins)
+{
+    for (std::map<uint256, CCoins>::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        CCoins coins;
+        if (it->second.IsPruned()) {
+            BOOST_CHECK(!view.HaveCoins(it->first));
+            continue;
+        }
+        BOOST_CHECK(view.HaveCoins(it->first));
+        BOOST_CHECK(view.GetCoins(it->first, coins));
+        BOOST_CHECK(coins == it->second);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_split_roundtrip, TestingSetup)
+{
+    uint256 hashBlock = GetRandHash();
+    CBlockIndex index;
+    {
+        LOCK(cs_main);
+        mapBlockIndex[hashBlock] = &index;
+    }
+    std::map<uint256, CCoins> mapCoins = SplitTestCoins();
+
+    mapArgs["-coinssplitoutputs"] = "5";
+    CCoinsViewDBSplitTest split;
+    mapArgs.erase("-coinssplitoutputs");
+    CCoinsViewDBSplitTest whole;
+    WriteSplitTestCoins(split, mapCoins, hashBlock);
+    WriteSplitTestCoins(whole, mapCoins, hashBlock);
+    BOOST_CHECK_EQUAL(split.SplitCount(), 2);
+    BOOST_CHECK_EQUAL(whole.SplitCount(), 0);
+    CheckSplitTestCoins(split, mapCoins);
+
+    // The UTXO set hash does not depend on the layout
+    CCoinsStats statsSplit, statsWhole;
+    BOOST_CHECK(split.GetStats(statsSplit));
+    BOOST_CHECK(whole.GetStats(statsWhole));
+    BOOST_CHECK(statsSplit.hashSerialized == statsWhole.hashSerialized);
+    BOOST_CHECK_EQUAL(statsSplit.nTransactionOutputs, statsWhole.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(statsSplit.nTotalAmount, statsWhole.nTotalAmount);
+
+    // Spend some outputs of each split transaction and all outputs of one of them
+    for (std::map<uint256, CCoins>::iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.vout.size() == 11) {
+            it->second.Spend(0);
+            it->second.Spend(7);
+        } else if (it->second.vout.size() == 6) {
+            for (int i = 0; i < 6; i++)
+                it->second.Spend(i);
+        }
+    }
+    WriteSplitTestCoins(split, mapCoins, hashBlock);
+    WriteSplitTestCoins(whole, mapCoins, hashBlock);
+    BOOST_CHECK_EQUAL(split.SplitCount(), 1);
+    CheckSplitTestCoins(split, mapCoins);
+    BOOST_CHECK(split.GetStats(statsSplit));
+    BOOST_CHECK(whole.GetStats(statsWhole));
+    BOOST_CHECK(statsSplit.hashSerialized == statsWhole.hashSerialized);
+
+    {
+        LOCK(cs_main);
+        mapBlockIndex.erase(hashBlock);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_split_migration, TestingSetup)
+{
+    uint256 hashBlock = GetRandHash();
+    CBlockIndex index;
+    {
+        LOCK(cs_main);
+        mapBlockIndex[hashBlock] = &index;
+    }
+    std::map<uint256, CCoins> mapCoins = SplitTestCoins();
+
+    CCoinsViewDBSplitTest view;
+    WriteSplitTestCoins(view, mapCoins, hashBlock);
+    CCoinsStats stats, statsMigrated;
+    BOOST_CHECK(view.GetStats(stats));
+    BOOST_CHECK_EQUAL(view.SplitCount(), 0);
+
+    // Lowering the threshold converts the existing records
+    view.Reopen(5);
+    BOOST_CHECK_EQUAL(view.SplitCount(), 2);
+    CheckSplitTestCoins(view, mapCoins);
+    BOOST_CHECK(view.GetStats(statsMigrated));
+    BOOST_CHECK(statsMigrated.hashSerialized == stats.hashSerialized);
+
+    view.Reopen(2);
+    BOOST_CHECK_EQUAL(view.SplitCount(), 2);
+    view.Reopen(1);
+    BOOST_CHECK_EQUAL(view.SplitCount(), 3);
+    CheckSplitTestCoins(view, mapCoins);
+
+    // -coinssplitoutputs=0 merges everything back for older versions
+    view.Reopen(0);
+    BOOST_CHECK_EQUAL(view.SplitCount(), 0);
+    CheckSplitTestCoins(view, mapCoins);
+    BOOST_CHECK(view.GetStats(statsMigrated));
+    BOOST_CHECK(statsMigrated.hashSerialized == stats.hashSerialized);
+
+    // A chainstate in a newer format is refused
+    view.WriteVersion(2);
+    BOOST_CHECK_THROW(view.Reopen(0), std::runtime_error);
+
+    mapArgs.erase("-coinssplitoutputs");
+    {
+        LOCK(cs_main);
+        mapBlockIndex.erase(hashBlock);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include "consensus/upgrades.h"
 #include "main.h"
+#include "memusage.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -212,6 +213,273 @@ BOOST_AUTO_TEST_CASE(RemoveWithoutBranchId) {
     BOOST_CHECK_EQUAL(pool.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    // Fill the pool with independent transactions of increasing fee
+    std::vector<CMutableTransaction> vtx;
+    for (int i = 1; i <= 200; i++) {
+        CMutableTransaction tx = CMutableTransaction();
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = i * COIN;
+        pool.addUnchecked(tx.GetHash(), entry.Fee(i * 1000LL).FromTx(tx));
+        vtx.push_back(tx);
+    }
+
+    // A zero fee parent is carried by its high fee child
+    CMutableTransaction txParent = CMutableTransaction();
+    txParent.vout.resize(1);
+    txParent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txParent.vout[0].nValue = 1000 * COIN;
+    pool.addUnchecked(txParent.GetHash(), entry.Fee(0LL).FromTx(txParent));
+    CMutableTransaction txChild = CMutableTransaction();
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout.hash = txParent.GetHash();
+    txChild.vin[0].prevout.n = 0;
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 999 * COIN;
+    pool.addUnchecked(txChild.GetHash(), entry.Fee(1000000LL).HadNoDependencies(false).FromTx(txChild));
+    entry.hadNoDependencies = true;
+
+    CTxMemPool::indexed_transaction_set::const_iterator itParent = pool.mapTx.find(txParent.GetHash());
+    BOOST_CHECK_EQUAL(itParent->GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(itParent->GetModFeesWithDescendants(), 1000000LL);
+
+    // Paying to a CC output does not protect a transaction, spending one does.
+    // The spend's CC input is confirmed, so it does not depend on txCC.
+    CMutableTransaction txCC = CMutableTransaction();
+    txCC.vout.resize(1);
+    txCC.vout[0].scriptPubKey = CScript() << std::vector<unsigned char>(32, 0xcc) << OP_CHECKCRYPTOCONDITION;
+    txCC.vout[0].nValue = 10000;
+    pool.addUnchecked(txCC.GetHash(), entry.Fee(0LL).FromTx(txCC));
+    BOOST_CHECK(!pool.mapTx.find(txCC.GetHash())->IsProtected());
+    CMutableTransaction txCCSpend = CMutableTransaction();
+    txCCSpend.vin.resize(1);
+    txCCSpend.vin[0].prevout.hash = GetRandHash();
+    txCCSpend.vin[0].prevout.n = 0;
+    txCCSpend.vout.resize(1);
+    txCCSpend.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txCCSpend.vout[0].nValue = 10000;
+    CTxMemPoolEntry entryCCSpend = entry.Fee(0LL).FromTx(txCCSpend);
+    entryCCSpend.SetProtected();
+    pool.addUnchecked(txCCSpend.GetHash(), entryCCSpend);
+    BOOST_CHECK(pool.mapTx.find(txCCSpend.GetHash())->IsProtected());
+    BOOST_CHECK_EQUAL(pool.size(), 204);
+
+    // Trim to half, the cheapest transactions go first
+    size_t nLimit = pool.DynamicMemoryUsage() / 2;
+    BOOST_CHECK(pool.TrimToSize(nLimit) > 0);
+    BOOST_CHECK(pool.DynamicMemoryUsage() <= nLimit);
+    BOOST_CHECK(!pool.exists(vtx.front().GetHash()));
+    BOOST_CHECK(pool.exists(vtx.back().GetHash()));
+    BOOST_CHECK(pool.exists(txParent.GetHash()));
+    BOOST_CHECK(pool.exists(txChild.GetHash()));
+    BOOST_CHECK(!pool.exists(txCC.GetHash()));
+    BOOST_CHECK(pool.exists(txCCSpend.GetHash()));
+    CAmount nMaxRemoved = 0, nMinKept = 0;
+    for (int i = 0; i < (int)vtx.size(); i++) {
+        if (pool.exists(vtx[i].GetHash())) {
+            if (nMinKept == 0)
+                nMinKept = (i + 1) * 1000LL;
+        } else {
+            BOOST_CHECK(nMinKept == 0);
+            nMaxRemoved = (i + 1) * 1000LL;
+        }
+    }
+    BOOST_CHECK(nMaxRemoved > 0 && nMinKept > nMaxRemoved);
+
+    // The rolling minimum fee now covers the evicted fee rate
+    CFeeRate removedRate(nMaxRemoved, pool.mapTx.find(vtx.back().GetHash())->GetTxSize());
+    BOOST_CHECK(pool.GetMinFee(nLimit) > removedRate);
+
+    // Removing the child updates the parent's descendant state
+    std::list<CTransaction> removed;
+    pool.remove(txChild, removed, false);
+    itParent = pool.mapTx.find(txParent.GetHash());
+    BOOST_CHECK_EQUAL(itParent->GetCountWithDescendants(), 1);
+    BOOST_CHECK_EQUAL(itParent->GetSizeWithDescendants(), itParent->GetTxSize());
+    BOOST_CHECK_EQUAL(itParent->GetModFeesWithDescendants(), 0);
+
+    // Protected transactions stay while they fit in their share of the limit
+    CTxMemPool::indexed_transaction_set::const_iterator itCCSpend = pool.mapTx.find(txCCSpend.GetHash());
+    size_t nProtectedLimit = (memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 18 * sizeof(void*)) + itCCSpend->DynamicMemoryUsage()) * MEMPOOL_PROTECTED_SHARE;
+    pool.TrimToSize(nProtectedLimit);
+    BOOST_CHECK(pool.DynamicMemoryUsage() <= nProtectedLimit);
+    BOOST_CHECK(pool.exists(txCCSpend.GetHash()));
+    BOOST_CHECK(pool.exists(vtx.back().GetHash()));
+    BOOST_CHECK(pool.size() > 1);
+
+    // Beyond it they are evicted like everything else
+    pool.TrimToSize(0);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolProtectedShareTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    std::vector<CMutableTransaction> vtx;
+    for (int i = 1; i <= 20; i++) {
+        CMutableTransaction tx = CMutableTransaction();
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = i * COIN;
+        pool.addUnchecked(tx.GetHash(), entry.Fee(100000LL).FromTx(tx));
+        vtx.push_back(tx);
+    }
+    size_t nLimit = pool.DynamicMemoryUsage() * 2;
+
+    // Flood the pool with zero fee protected transactions taking far more
+    // than their share of the limit
+    std::vector<CMutableTransaction> vtxProtected;
+    for (int i = 1; i <= 100; i++) {
+        CMutableTransaction tx = CMutableTransaction();
+        tx.vin.resize(1);
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].prevout.n = 0;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = i * COIN;
+        CTxMemPoolEntry entryProtected = entry.Fee(0LL).FromTx(tx);
+        entryProtected.SetProtected();
+        pool.addUnchecked(tx.GetHash(), entryProtected);
+        vtxProtected.push_back(tx);
+    }
+    BOOST_CHECK(pool.DynamicMemoryUsage() > nLimit);
+
+    // The protected transactions go rather than the normal ones paying more
+    BOOST_CHECK(pool.TrimToSize(nLimit) > 0);
+    BOOST_CHECK(pool.DynamicMemoryUsage() <= nLimit);
+    BOOST_FOREACH(const CMutableTransaction& tx, vtx)
+        BOOST_CHECK(pool.exists(tx.GetHash()));
+    int nProtectedKept = 0;
+    BOOST_FOREACH(const CMutableTransaction& tx, vtxProtected) {
+        if (pool.exists(tx.GetHash()))
+            nProtectedKept++;
+    }
+    BOOST_CHECK(nProtectedKept > 0 && nProtectedKept < (int)vtxProtected.size());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolReaddPackageTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction txParent = CMutableTransaction();
+    txParent.vout.resize(1);
+    txParent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txParent.vout[0].nValue = 10 * COIN;
+    CTxMemPoolEntry entryParent = entry.Fee(1000LL).HadNoDependencies(true).FromTx(txParent);
+    pool.addUnchecked(txParent.GetHash(), entryParent);
+    CMutableTransaction txChild = CMutableTransaction();
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout.hash = txParent.GetHash();
+    txChild.vin[0].prevout.n = 0;
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 9 * COIN;
+    CTxMemPoolEntry entryChild = entry.Fee(2000LL).HadNoDependencies(false).FromTx(txChild);
+    pool.addUnchecked(txChild.GetHash(), entryChild);
+
+    // Keep copies of the entries as they are in the pool, with the child
+    // already counted in the parent's descendant state
+    CTxMemPoolEntry copyParent = *pool.mapTx.find(txParent.GetHash());
+    CTxMemPoolEntry copyChild = *pool.mapTx.find(txChild.GetHash());
+    BOOST_CHECK_EQUAL(copyParent.GetCountWithDescendants(), 2);
+
+    std::list<CTransaction> removed;
+    pool.remove(txParent, removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+
+    // Re-adding the copies must not count the child twice
+    pool.addUnchecked(txParent.GetHash(), copyParent);
+    pool.addUnchecked(txChild.GetHash(), copyChild);
+    CTxMemPool::indexed_transaction_set::const_iterator itParent = pool.mapTx.find(txParent.GetHash());
+    CTxMemPool::indexed_transaction_set::const_iterator itChild = pool.mapTx.find(txChild.GetHash());
+    BOOST_CHECK_EQUAL(itParent->GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(itParent->GetSizeWithDescendants(), itParent->GetTxSize() + itChild->GetTxSize());
+    BOOST_CHECK_EQUAL(itParent->GetModFeesWithDescendants(), 3000LL);
+    BOOST_CHECK_EQUAL(itChild->GetCountWithDescendants(), 1);
+    BOOST_CHECK_EQUAL(itChild->GetModFeesWithDescendants(), 2000LL);
+
+    // A diamond: the top spends to a side and a bottom, and the bottom also
+    // spends the side. A reorg re-adds the top first, which takes in the
+    // bottom still left in the pool. Adding the side next must not count
+    // the bottom in the top a second time.
+    CMutableTransaction txTop = CMutableTransaction();
+    txTop.vout.resize(2);
+    txTop.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txTop.vout[0].nValue = 5 * COIN;
+    txTop.vout[1].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txTop.vout[1].nValue = 5 * COIN;
+    CMutableTransaction txSide = CMutableTransaction();
+    txSide.vin.resize(1);
+    txSide.vin[0].scriptSig = CScript() << OP_11;
+    txSide.vin[0].prevout.hash = txTop.GetHash();
+    txSide.vin[0].prevout.n = 0;
+    txSide.vout.resize(1);
+    txSide.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txSide.vout[0].nValue = 4 * COIN;
+    CMutableTransaction txBottom = CMutableTransaction();
+    txBottom.vin.resize(2);
+    txBottom.vin[0].scriptSig = CScript() << OP_11;
+    txBottom.vin[0].prevout.hash = txTop.GetHash();
+    txBottom.vin[0].prevout.n = 1;
+    txBottom.vin[1].scriptSig = CScript() << OP_11;
+    txBottom.vin[1].prevout.hash = txSide.GetHash();
+    txBottom.vin[1].prevout.n = 0;
+    txBottom.vout.resize(1);
+    txBottom.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txBottom.vout[0].nValue = 8 * COIN;
+    pool.addUnchecked(txTop.GetHash(), entry.Fee(4000LL).HadNoDependencies(true).FromTx(txTop));
+    pool.addUnchecked(txSide.GetHash(), entry.Fee(5000LL).HadNoDependencies(false).FromTx(txSide));
+    pool.addUnchecked(txBottom.GetHash(), entry.Fee(6000LL).HadNoDependencies(false).FromTx(txBottom));
+    CTxMemPoolEntry copyTop = *pool.mapTx.find(txTop.GetHash());
+    CTxMemPoolEntry copySide = *pool.mapTx.find(txSide.GetHash());
+    BOOST_CHECK_EQUAL(copyTop.GetCountWithDescendants(), 3);
+    BOOST_CHECK_EQUAL(copyTop.GetModFeesWithDescendants(), 15000LL);
+
+    // Disconnect the block holding the top and the side
+    removed.clear();
+    pool.remove(txTop, removed, false);
+    pool.remove(txSide, removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+    pool.addUnchecked(txTop.GetHash(), copyTop);
+    pool.addUnchecked(txSide.GetHash(), copySide);
+
+    CTxMemPool::indexed_transaction_set::const_iterator itTop = pool.mapTx.find(txTop.GetHash());
+    CTxMemPool::indexed_transaction_set::const_iterator itSide = pool.mapTx.find(txSide.GetHash());
+    CTxMemPool::indexed_transaction_set::const_iterator itBottom = pool.mapTx.find(txBottom.GetHash());
+    BOOST_CHECK_EQUAL(itTop->GetCountWithDescendants(), 3);
+    BOOST_CHECK_EQUAL(itTop->GetSizeWithDescendants(), itTop->GetTxSize() + itSide->GetTxSize() + itBottom->GetTxSize());
+    BOOST_CHECK_EQUAL(itTop->GetModFeesWithDescendants(), 15000LL);
+    BOOST_CHECK_EQUAL(itSide->GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(itSide->GetSizeWithDescendants(), itSide->GetTxSize() + itBottom->GetTxSize());
+    BOOST_CHECK_EQUAL(itSide->GetModFeesWithDescendants(), 11000LL);
+
+    // Removing the bottom leaves nothing behind in either branch
+    removed.clear();
+    pool.remove(txBottom, removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    itTop = pool.mapTx.find(txTop.GetHash());
+    itSide = pool.mapTx.find(txSide.GetHash());
+    BOOST_CHECK_EQUAL(itTop->GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(itTop->GetSizeWithDescendants(), itTop->GetTxSize() + itSide->GetTxSize());
+    BOOST_CHECK_EQUAL(itTop->GetModFeesWithDescendants(), 9000LL);
+    BOOST_CHECK_EQUAL(itSide->GetCountWithDescendants(), 1);
+    BOOST_CHECK_EQUAL(itSide->GetModFeesWithDescendants(), 5000LL);
+}
+
 // Test that nCheckFrequency is set correctly when calling setSanityCheck().
 // https://github.com/zcash/zcash/issues/3134
 BOOST_AUTO_TEST_CASE(SetSanityCheck) {
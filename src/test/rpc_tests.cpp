@@ -346,4 +346,22 @@ BOOST_AUTO_TEST_CASE(rpc_getnetworksolps)
     BOOST_CHECK_NO_THROW(CallRPC("getnetworksolps 120 -1"));
 }
 
+BOOST_AUTO_TEST_CASE(rpc_getrpcstats)
+{
+    // Only calls through CRPCTable::execute are counted
+    SetRPCWarmupFinished();
+    BOOST_CHECK_NO_THROW(tableRPC.execute("getnetworksolps", RPCConvertValues("getnetworksolps", {"120"})));
+    BOOST_CHECK_THROW(tableRPC.execute("getnetworksolps", RPCConvertValues("getnetworksolps", {"120", "-1", "1"})), UniValue);
+
+    UniValue stats = tableRPC.execute("getrpcstats", UniValue(UniValue::VARR));
+    UniValue command = find_value(find_value(stats, "commands").get_obj(), "getnetworksolps");
+    BOOST_CHECK_EQUAL(find_value(command, "count").get_int(), 2);
+    BOOST_CHECK_EQUAL(find_value(command, "errors").get_int(), 1);
+    BOOST_CHECK(find_value(command, "p50_ms").get_real() <= find_value(command, "max_ms").get_real());
+    BOOST_CHECK(find_value(command, "p99_ms").get_real() <= find_value(command, "max_ms").get_real());
+    BOOST_CHECK(find_value(stats, "workqueue").isNull()); // no HTTP server here
+
+    BOOST_CHECK(RPCStatsToPrometheus().find("komodod_rpc_duration_seconds_count{method=\"getnetworksolps\"} 2\n") != std::string::npos);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
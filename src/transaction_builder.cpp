@@ -8,9 +8,47 @@
 #include "pubkey.h"
 #include "script/sign.h"
 
+#include <atomic>
+#include <thread>
+
+#include <boost/thread.hpp>
 #include <boost/variant.hpp>
 #include <librustzcash.h>
 
+int GetSaplingBuilderThreads()
+{
+    int nThreads = GetArg("-saplingbuilderthreads", DEFAULT_SAPLING_BUILDER_THREADS);
+    if (nThreads <= 0)
+        nThreads += boost::thread::hardware_concurrency();
+    return std::max(1, std::min(nThreads, MAX_SAPLING_BUILDER_THREADS));
+}
+
+/**
+ * Run fn(i) for every i in [0, n) on up to nThreads threads, the calling
+ * thread included. Returns once all items are done.
+ */
+template <typename F>
+static void SaplingParallelFor(size_t n, int nThreads, F fn)
+{
+    size_t nWorkers = std::min((size_t)std::max(nThreads, 1), n);
+    if (nWorkers <= 1) {
+        for (size_t i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < n; i = next++)
+            fn(i);
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nWorkers; t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
 SpendDescriptionInfo::SpendDescriptionInfo(
     libzcash::SaplingExpandedSpendingKey expsk,
     libzcash::SaplingNote note,
@@ -167,67 +205,93 @@ boost::optional<CTransaction> TransactionBuilder::Build()
     // Sapling spends and outputs
     //
 
-    auto ctx = librustzcash_sapling_proving_ctx_init();
-
-    // Create Sapling SpendDescriptions
-    for (auto spend : spends) {
+    // The key derivations, commitments, nullifiers and note encryption of
+    // each spend and output are independent, so they run on the worker pool.
+    // The proofs themselves stay on this thread: every proof adds its value
+    // commitment randomness to the proving context, and the binding
+    // signature needs all of it in one context.
+    int nThreads = GetSaplingBuilderThreads();
+    std::vector<SpendDescription> vSpendDesc(spends.size());
+    std::vector<uint256> vSpendAk(spends.size());
+    std::vector<std::vector<unsigned char>> vSpendWitness(spends.size());
+    std::vector<OutputDescription> vOutputDesc(outputs.size());
+    std::vector<boost::optional<libzcash::SaplingNoteEncryption>> vEncryptors(outputs.size());
+    std::atomic<bool> fFailed(false);
+
+    SaplingParallelFor(spends.size(), nThreads, [&](size_t i) {
+        const SpendDescriptionInfo& spend = spends[i];
+        auto fvk = spend.expsk.full_viewing_key();
         auto cm = spend.note.cm();
-        auto nf = spend.note.nullifier(
-            spend.expsk.full_viewing_key(), spend.witness.position());
+        auto nf = spend.note.nullifier(fvk, spend.witness.position());
         if (!(cm && nf)) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            return boost::none;
+            fFailed = true;
+            return;
         }
 
         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
         ss << spend.witness.path();
-        std::vector<unsigned char> witness(ss.begin(), ss.end());
+        vSpendWitness[i].assign(ss.begin(), ss.end());
+        vSpendAk[i] = fvk.ak;
+        vSpendDesc[i].anchor = spend.anchor;
+        vSpendDesc[i].nullifier = *nf;
+    });
+    SaplingParallelFor(outputs.size(), nThreads, [&](size_t i) {
+        const OutputDescriptionInfo& output = outputs[i];
+        auto cm = output.note.cm();
+        if (!cm) {
+            fFailed = true;
+            return;
+        }
+
+        libzcash::SaplingNotePlaintext notePlaintext(output.note, output.memo);
+
+        auto res = notePlaintext.encrypt(output.note.pk_d);
+        if (!res) {
+            fFailed = true;
+            return;
+        }
+        auto enc = res.get();
+
+        vOutputDesc[i].cm = *cm;
+        vOutputDesc[i].ephemeralKey = enc.second.get_epk();
+        vOutputDesc[i].encCiphertext = enc.first;
+        vEncryptors[i] = enc.second;
+    });
+    if (fFailed) {
+        return boost::none;
+    }
 
-        SpendDescription sdesc;
+    auto ctx = librustzcash_sapling_proving_ctx_init();
+
+    // Create Sapling SpendDescriptions
+    for (size_t i = 0; i < spends.size(); i++) {
+        const SpendDescriptionInfo& spend = spends[i];
+        SpendDescription& sdesc = vSpendDesc[i];
         if (!librustzcash_sapling_spend_proof(
                 ctx,
-                spend.expsk.full_viewing_key().ak.begin(),
+                vSpendAk[i].begin(),
                 spend.expsk.nsk.begin(),
                 spend.note.d.data(),
                 spend.note.r.begin(),
                 spend.alpha.begin(),
                 spend.note.value(),
                 spend.anchor.begin(),
-                witness.data(),
+                vSpendWitness[i].data(),
                 sdesc.cv.begin(),
                 sdesc.rk.begin(),
                 sdesc.zkproof.data())) {
             librustzcash_sapling_proving_ctx_free(ctx);
             return boost::none;
         }
-
-        sdesc.anchor = spend.anchor;
-        sdesc.nullifier = *nf;
-        mtx.vShieldedSpend.push_back(sdesc);
     }
 
     // Create Sapling OutputDescriptions
-    for (auto output : outputs) {
-        auto cm = output.note.cm();
-        if (!cm) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            return boost::none;
-        }
-
-        libzcash::SaplingNotePlaintext notePlaintext(output.note, output.memo);
-
-        auto res = notePlaintext.encrypt(output.note.pk_d);
-        if (!res) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            return boost::none;
-        }
-        auto enc = res.get();
-        auto encryptor = enc.second;
-
-        OutputDescription odesc;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        const OutputDescriptionInfo& output = outputs[i];
+        OutputDescription& odesc = vOutputDesc[i];
         if (!librustzcash_sapling_output_proof(
                 ctx,
-                encryptor.get_esk().begin(),
+                vEncryptors[i]->get_esk().begin(),
                 output.note.d.data(),
                 output.note.pk_d.begin(),
                 output.note.r.begin(),
@@ -237,19 +301,21 @@ boost::optional<CTransaction> TransactionBuilder::Build()
             librustzcash_sapling_proving_ctx_free(ctx);
             return boost::none;
         }
+    }
 
-        odesc.cm = *cm;
-        odesc.ephemeralKey = encryptor.get_epk();
-        odesc.encCiphertext = enc.first;
-
-        libzcash::SaplingOutgoingPlaintext outPlaintext(output.note.pk_d, encryptor.get_esk());
+    // The outgoing ciphertexts commit to the value commitments from the proofs
+    SaplingParallelFor(outputs.size(), nThreads, [&](size_t i) {
+        const OutputDescriptionInfo& output = outputs[i];
+        OutputDescription& odesc = vOutputDesc[i];
+        libzcash::SaplingOutgoingPlaintext outPlaintext(output.note.pk_d, vEncryptors[i]->get_esk());
         odesc.outCiphertext = outPlaintext.encrypt(
             output.ovk,
             odesc.cv,
             odesc.cm,
-            encryptor);
-        mtx.vShieldedOutput.push_back(odesc);
-    }
+            *vEncryptors[i]);
+    });
+    mtx.vShieldedSpend.insert(mtx.vShieldedSpend.end(), vSpendDesc.begin(), vSpendDesc.end());
+    mtx.vShieldedOutput.insert(mtx.vShieldedOutput.end(), vOutputDesc.begin(), vOutputDesc.end());
 
     // add op_return if there is one to add
     AddOpRetLast();
@@ -271,13 +337,13 @@ boost::optional<CTransaction> TransactionBuilder::Build()
     }
 
     // Create Sapling spendAuth and binding signatures
-    for (size_t i = 0; i < spends.size(); i++) {
+    SaplingParallelFor(spends.size(), nThreads, [&](size_t i) {
         librustzcash_sapling_spend_sig(
             spends[i].expsk.ask.begin(),
             spends[i].alpha.begin(),
             dataToBeSigned.begin(),
             mtx.vShieldedSpend[i].spendAuthSig.data());
-    }
+    });
     librustzcash_sapling_binding_sig(
         ctx,
         mtx.valueBalance,
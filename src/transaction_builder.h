@@ -18,6 +18,14 @@
 
 #include <boost/optional.hpp>
 
+/** Default for -saplingbuilderthreads, 0 = one per core */
+static const int DEFAULT_SAPLING_BUILDER_THREADS = 0;
+/** Maximum number of threads TransactionBuilder uses for Sapling descriptions */
+static const int MAX_SAPLING_BUILDER_THREADS = 16;
+
+/** Number of threads TransactionBuilder::Build uses, from -saplingbuilderthreads */
+int GetSaplingBuilderThreads();
+
 struct SpendDescriptionInfo {
     libzcash::SaplingExpandedSpendingKey expsk;
     libzcash::SaplingNote note;
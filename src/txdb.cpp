@@ -40,6 +40,10 @@ static const char DB_SAPLING_ANCHOR = 'Z';
 static const char DB_NULLIFIER = 's';
 static const char DB_SAPLING_NULLIFIER = 'S';
 static const char DB_COINS = 'c';
+static const char DB_COINS_SPLIT = 'h';
+static const char DB_COINS_OUTPUT = 'o';
+static const char DB_COINS_SPLIT_OUTPUTS = 'O';
+static const char DB_COINS_VERSION = 'V';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'd';
@@ -56,12 +60,177 @@ static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
+//! chainstate format written to DB_COINS_VERSION: 1 = may hold per-outpoint coins records
+static const uint32_t COINS_DB_VERSION = 1;
+
 
 CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
+    InitSplitCoins();
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
 {
+    InitSplitCoins();
+}
+
+static std::pair<char, std::pair<uint256, uint32_t> > CoinsOutputKey(const uint256 &txid, uint32_t n)
+{
+    return make_pair(DB_COINS_OUTPUT, make_pair(txid, n));
+}
+
+void CCoinsViewDB::InitSplitCoins()
+{
+    nSplitOutputs = (unsigned int)std::max((int64_t)0, GetArg("-coinssplitoutputs", DEFAULT_COINS_SPLIT_OUTPUTS));
+
+    // Reading a layout this version does not know would silently miss coins,
+    // so fail here and let init offer a reindex.
+    uint32_t nVersion = 0;
+    if (db.Read(DB_COINS_VERSION, nVersion) && nVersion > COINS_DB_VERSION)
+        throw std::runtime_error(strprintf("CCoinsViewDB: chainstate format %u is newer than the supported %u, -reindex is required", nVersion, COINS_DB_VERSION));
+
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_COINS_SPLIT);
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        CCoinsSplitHeader header;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS_SPLIT)
+            break;
+        if (pcursor->GetValue(header))
+            mapSplitCoins[key.second] = header;
+        pcursor->Next();
+    }
+
+    if (nSplitOutputs == 0) {
+        if (!mapSplitCoins.empty())
+            MergeSplitCoins();
+        return;
+    }
+
+    // Existing chainstate only has to be converted when the threshold is
+    // lower than the one it was last migrated with.
+    uint32_t nMigrated = 0;
+    if (db.Read(DB_COINS_SPLIT_OUTPUTS, nMigrated) && nMigrated <= nSplitOutputs)
+        return;
+    LogPrintf("Migrating coins with at least %u outputs to per-outpoint records...\n", nSplitOutputs);
+    boost::scoped_ptr<CDBBatch> batch(new CDBBatch(db));
+    std::map<uint256, CCoinsSplitHeader> mapWritten;
+    size_t nTxs = 0, nOutputs = 0;
+    pcursor->Seek(DB_COINS);
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        CCoins coins;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        if (pcursor->GetValue(coins) && coins.vout.size() >= nSplitOutputs) {
+            batch->Erase(key);
+            WriteSplitCoins(*batch, key.second, coins, mapWritten, nOutputs);
+            if (++nTxs % 1000 == 0) {
+                batch->Write(DB_COINS_VERSION, COINS_DB_VERSION);
+                db.WriteBatch(*batch);
+                CommitSplitCoins(mapWritten);
+                batch.reset(new CDBBatch(db));
+            }
+        }
+        pcursor->Next();
+    }
+    batch->Write(DB_COINS_VERSION, COINS_DB_VERSION);
+    batch->Write(DB_COINS_SPLIT_OUTPUTS, (uint32_t)nSplitOutputs);
+    db.WriteBatch(*batch, true);
+    CommitSplitCoins(mapWritten);
+    LogPrintf("Migrated %u transactions (%u outputs) to per-outpoint records\n", (unsigned int)nTxs, (unsigned int)nOutputs);
+}
+
+void CCoinsViewDB::MergeSplitCoins()
+{
+    LogPrintf("Merging %u per-outpoint coins records back into whole transaction records...\n", (unsigned int)mapSplitCoins.size());
+    boost::scoped_ptr<CDBBatch> batch(new CDBBatch(db));
+    std::map<uint256, CCoinsSplitHeader> mapWritten;
+    std::map<uint256, CCoinsSplitHeader> mapSplit = mapSplitCoins;
+    size_t nTxs = 0, nOutputs = 0;
+    for (std::map<uint256, CCoinsSplitHeader>::const_iterator it = mapSplit.begin(); it != mapSplit.end(); it++) {
+        CCoins coins;
+        if (!ReadSplitCoins(it->first, it->second, coins))
+            throw std::runtime_error("CCoinsViewDB: unable to read per-outpoint coins records");
+        WriteSplitCoins(*batch, it->first, CCoins(), mapWritten, nOutputs);
+        if (!coins.IsPruned())
+            batch->Write(make_pair(DB_COINS, it->first), coins);
+        if (++nTxs % 1000 == 0) {
+            db.WriteBatch(*batch);
+            CommitSplitCoins(mapWritten);
+            batch.reset(new CDBBatch(db));
+        }
+    }
+    batch->Erase(DB_COINS_SPLIT_OUTPUTS);
+    batch->Erase(DB_COINS_VERSION);
+    db.WriteBatch(*batch, true);
+    CommitSplitCoins(mapWritten);
+    LogPrintf("Merged %u transactions, the chainstate can now be opened by versions without -coinssplitoutputs\n", (unsigned int)nTxs);
+}
+
+void CCoinsViewDB::CommitSplitCoins(std::map<uint256, CCoinsSplitHeader> &mapWritten)
+{
+    for (std::map<uint256, CCoinsSplitHeader>::const_iterator it = mapWritten.begin(); it != mapWritten.end(); it++) {
+        if (it->second.nOutputs == 0)
+            mapSplitCoins.erase(it->first);
+        else
+            mapSplitCoins[it->first] = it->second;
+    }
+    mapWritten.clear();
+}
+
+bool CCoinsViewDB::ReadSplitCoins(const uint256 &txid, const CCoinsSplitHeader &header, CCoins &coins) const
+{
+    coins.Clear();
+    coins.fCoinBase = header.fCoinBase;
+    coins.nHeight = header.nHeight;
+    coins.nVersion = header.nVersion;
+    coins.vout.resize(header.nOutputs);
+
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+    pcursor->Seek(CoinsOutputKey(txid, 0));
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint32_t> > key;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS_OUTPUT || key.second.first != txid)
+            break;
+        uint32_t n = key.second.second;
+        if (n >= coins.vout.size())
+            return error("CCoinsViewDB::ReadSplitCoins() : output %u out of range for %s", n, txid.ToString());
+        CTxOutCompressor compressed(coins.vout[n]);
+        if (!pcursor->GetValue(compressed))
+            return error("CCoinsViewDB::ReadSplitCoins() : unable to read output %u of %s", n, txid.ToString());
+        pcursor->Next();
+    }
+    coins.Cleanup();
+    return true;
+}
+
+void CCoinsViewDB::WriteSplitCoins(CDBBatch &batch, const uint256 &txid, const CCoins &coins, std::map<uint256, CCoinsSplitHeader> &mapWritten, size_t &nOutputsWritten)
+{
+    std::map<uint256, CCoinsSplitHeader>::iterator it = mapSplitCoins.find(txid);
+    bool fStored = it != mapSplitCoins.end();
+    CCoinsSplitHeader header;
+    if (!coins.IsPruned())
+        header.FromCoins(coins);
+
+    // Outputs of a txid never change, only their spentness, so only the
+    // records whose availability differs from what is on disk are touched.
+    uint32_t nMax = std::max(header.nOutputs, fStored ? it->second.nOutputs : 0);
+    for (uint32_t i = 0; i < nMax; i++) {
+        bool fOld = fStored && it->second.IsAvailable(i);
+        bool fNew = header.IsAvailable(i);
+        if (fOld && !fNew)
+            batch.Erase(CoinsOutputKey(txid, i));
+        else if (fNew && !fOld) {
+            batch.Write(CoinsOutputKey(txid, i), CTxOutCompressor(REF(coins.vout[i])));
+            nOutputsWritten++;
+        }
+    }
+    if (coins.IsPruned())
+        batch.Erase(make_pair(DB_COINS_SPLIT, txid));
+    else
+        batch.Write(make_pair(DB_COINS_SPLIT, txid), header);
+    // mapSplitCoins describes what is on disk, CommitSplitCoins applies this once the batch is written
+    mapWritten[txid] = header;
 }
 
 
@@ -106,10 +275,21 @@ bool CCoinsViewDB::GetNullifier(const uint256 &nf, ShieldedType type) const {
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
+    {
+        LOCK(cs_splitcoins);
+        std::map<uint256, CCoinsSplitHeader>::const_iterator it = mapSplitCoins.find(txid);
+        if (it != mapSplitCoins.end())
+            return ReadSplitCoins(txid, it->second, coins);
+    }
     return db.Read(make_pair(DB_COINS, txid), coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
+    {
+        LOCK(cs_splitcoins);
+        if (mapSplitCoins.count(txid) != 0)
+            return true;
+    }
     return db.Exists(make_pair(DB_COINS, txid));
 }
 
@@ -184,9 +364,18 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
+    size_t split = 0;
+    std::map<uint256, CCoinsSplitHeader> mapWritten;
+    LOCK(cs_splitcoins);
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
+            const CCoins &coins = it->second.coins;
+            if (mapSplitCoins.count(it->first) != 0) {
+                WriteSplitCoins(batch, it->first, coins, mapWritten, split);
+            } else if (nSplitOutputs != 0 && !coins.IsPruned() && coins.vout.size() >= nSplitOutputs) {
+                batch.Erase(make_pair(DB_COINS, it->first));
+                WriteSplitCoins(batch, it->first, coins, mapWritten, split);
+            } else if (it->second.coins.IsPruned())
                 batch.Erase(make_pair(DB_COINS, it->first));
             else
                 batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
@@ -210,8 +399,14 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
     if (!hashSaplingAnchor.IsNull())
         batch.Write(DB_BEST_SAPLING_ANCHOR, hashSaplingAnchor);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    if (!mapWritten.empty())
+        batch.Write(DB_COINS_VERSION, COINS_DB_VERSION);
+
+    LogPrint("coindb", "Committing %u changed transactions (out of %u, %u split outputs) to coin database...\n", (unsigned int)changed, (unsigned int)count, (unsigned int)split);
+    if (!db.WriteBatch(batch))
+        return false;
+    CommitSplitCoins(mapWritten);
+    return true;
 }
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, compression, maxOpenFiles) {
@@ -248,31 +443,43 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
-    while (pcursor->Valid()) {
+    // Split transactions are merged in txid order so the hash matches the
+    // one computed over a chainstate that only has whole-txid records.
+    std::map<uint256, CCoinsSplitHeader> mapSplit;
+    {
+        LOCK(cs_splitcoins);
+        mapSplit = mapSplitCoins;
+    }
+    std::map<uint256, CCoinsSplitHeader>::const_iterator itSplit = mapSplit.begin();
+    while (true) {
         boost::this_thread::interruption_point();
         std::pair<char, uint256> key;
         CCoins coins;
-        if (pcursor->GetKey(key) && key.first == DB_COINS) {
-            if (pcursor->GetValue(coins)) {
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + pcursor->GetValueSize();
-                ss << VARINT(0);
-            } else {
+        bool fCursor = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_COINS;
+        if (itSplit != mapSplit.end() && (!fCursor || itSplit->first < key.second)) {
+            if (!ReadSplitCoins(itSplit->first, itSplit->second, coins))
+                return error("CCoinsViewDB::GetStats() : unable to read split coins");
+            stats.nSerializedSize += 32 + ::GetSerializeSize(coins, SER_DISK, CLIENT_VERSION);
+            ++itSplit;
+        } else if (fCursor) {
+            if (!pcursor->GetValue(coins))
                 return error("CCoinsViewDB::GetStats() : unable to read value");
-            }
+            stats.nSerializedSize += 32 + pcursor->GetValueSize();
+            pcursor->Next();
         } else {
             break;
         }
-        pcursor->Next();
+        stats.nTransactions++;
+        for (unsigned int i=0; i<coins.vout.size(); i++) {
+            const CTxOut &out = coins.vout[i];
+            if (!out.IsNull()) {
+                stats.nTransactionOutputs++;
+                ss << VARINT(i+1);
+                ss << out;
+                nTotalAmount += out.nValue;
+            }
+        }
+        ss << VARINT(0);
     }
     {
         LOCK(cs_main);
@@ -344,6 +551,14 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ForEachAddressUnspent(addressHash, type, [&unspentOutputs](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        unspentOutputs.push_back(make_pair(key, value));
+        return true;
+    });
+}
+
+bool CBlockTreeDB::ForEachAddressUnspent(uint160 addressHash, int type,
+                                         const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -352,7 +567,6 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
             pair<char, CAddressUnspentKey> keyObj;
             pcursor->GetKey(keyObj);
             char chType = keyObj.first;
@@ -362,7 +576,8 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                 try {
                     CAddressUnspentValue nValue;
                     pcursor->GetValue(nValue);
-                    unspentOutputs.push_back(make_pair(indexKey, nValue));
+                    if (!fn(indexKey, nValue))
+                        break;
                     pcursor->Next();
                 } catch (const std::exception& e) {
                     return error("failed to get address unspent value");
@@ -394,6 +609,14 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    return ForEachAddressIndex(addressHash, type, start, end, [&addressIndex](const CAddressIndexKey& key, CAmount nValue) {
+        addressIndex.push_back(make_pair(key, nValue));
+        return true;
+    });
+}
+
+bool CBlockTreeDB::ForEachAddressIndex(uint160 addressHash, int type, int start, int end,
+                                       const std::function<bool(const CAddressIndexKey&, CAmount)>& fn) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -419,7 +642,8 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                     CAmount nValue;
                     pcursor->GetValue(nValue);
 
-                    addressIndex.push_back(make_pair(indexKey, nValue));
+                    if (!fn(indexKey, nValue))
+                        break;
                     pcursor->Next();
                 } catch (const std::exception& e) {
                     return error("failed to get address index value");
@@ -720,6 +944,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
                 pindexNew->nSaplingValue  = diskindex.nSaplingValue;
                 pindexNew->segid          = diskindex.segid;
                 pindexNew->nNotaryPay     = diskindex.nNotaryPay;
+                pindexNew->nBlockSupply   = diskindex.nBlockSupply;
 //fprintf(stderr,"loadguts ht.%d\n",pindexNew->GetHeight());
                 // Consistency checks
                 auto header = pindexNew->GetBlockHeader();
@@ -23,7 +23,9 @@
 
 #include "coins.h"
 #include "dbwrapper.h"
+#include "sync.h"
 
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
@@ -52,6 +54,52 @@ static const int64_t nDefaultDbCache = 450;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! -coinssplitoutputs default (0 = store every transaction's coins in one record)
+static const int64_t DEFAULT_COINS_SPLIT_OUTPUTS = 0;
+
+/**
+ * Header of a transaction whose unspent outputs are stored one record per
+ * outpoint. The bitmask mirrors which outputs currently have a record, so a
+ * flush only has to touch the outputs whose spentness changed.
+ */
+struct CCoinsSplitHeader
+{
+    int nVersion;
+    bool fCoinBase;
+    int nHeight;
+    uint32_t nOutputs;
+    std::vector<unsigned char> vchAvail;
+
+    CCoinsSplitHeader() : nVersion(0), fCoinBase(false), nHeight(0), nOutputs(0) {}
+
+    void FromCoins(const CCoins &coins)
+    {
+        nVersion = coins.nVersion;
+        fCoinBase = coins.fCoinBase;
+        nHeight = coins.nHeight;
+        nOutputs = coins.vout.size();
+        vchAvail.assign((nOutputs + 7) / 8, 0);
+        for (uint32_t i = 0; i < nOutputs; i++)
+            if (!coins.vout[i].IsNull())
+                vchAvail[i / 8] |= (1 << (i % 8));
+    }
+
+    bool IsAvailable(uint32_t n) const
+    {
+        return n < nOutputs && (vchAvail[n / 8] & (1 << (n % 8))) != 0;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(VARINT(nVersion));
+        READWRITE(fCoinBase);
+        READWRITE(VARINT(nHeight));
+        READWRITE(VARINT(nOutputs));
+        READWRITE(vchAvail);
+    }
+};
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
@@ -59,6 +107,19 @@ class CCoinsViewDB : public CCoinsView
 protected:
     CDBWrapper db;
     CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    //! transactions with at least this many outputs are written per outpoint (0 = never)
+    unsigned int nSplitOutputs;
+    //! headers of every transaction currently stored per outpoint
+    mutable CCriticalSection cs_splitcoins;
+    std::map<uint256, CCoinsSplitHeader> mapSplitCoins;
+
+    void InitSplitCoins();
+    void MergeSplitCoins();
+    bool ReadSplitCoins(const uint256 &txid, const CCoinsSplitHeader &header, CCoins &coins) const;
+    void WriteSplitCoins(CDBBatch &batch, const uint256 &txid, const CCoins &coins, std::map<uint256, CCoinsSplitHeader> &mapWritten, size_t &nOutputsWritten);
+    //! apply the headers of a batch that was written, a header without outputs removes the entry
+    void CommitSplitCoins(std::map<uint256, CCoinsSplitHeader> &mapWritten);
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -107,6 +168,11 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /** Walk the address index in key order, stopping early when fn returns false */
+    bool ForEachAddressUnspent(uint160 addressHash, int type,
+                               const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
+    bool ForEachAddressIndex(uint160 addressHash, int type, int start, int end,
+                             const std::function<bool(const CAddressIndexKey&, CAmount)>& fn);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
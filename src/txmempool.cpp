@@ -23,6 +23,7 @@
 #include "clientversion.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "komodo_defs.h"
 #include "main.h"
 #include "policy/fees.h"
 #include "streams.h"
@@ -37,11 +38,26 @@ using namespace std;
 
 CTxMemPoolEntry::CTxMemPoolEntry():
     nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0),
-    hadNoDependencies(false), spendsCoinbase(false)
+    hadNoDependencies(false), spendsCoinbase(false), fProtected(false), feeDelta(0),
+    nCountWithDescendants(1), nSizeWithDescendants(0), nModFeesWithDescendants(0)
 {
     nHeight = MEMPOOL_HEIGHT;
 }
 
+// Notarisations and imports carry chain state that other nodes wait on, so a
+// fee spam wave should not push them out. CC spends, which advance contract
+// state, are marked by AcceptToMemoryPool since that needs the spent outputs.
+// Merely paying to a CC output is not enough, anyone can do that for free.
+static bool IsProtectedMempoolTx(const CTransaction& tx)
+{
+    static const CScript scriptCrypto777 = CScript() << ParseHex(CRYPTO777_PUBSECPSTR) << OP_CHECKSIG;
+    if (tx.IsCoinImport() || tx.IsPegsImport())
+        return true;
+    if (tx.vout.size() >= 2 && tx.vout[0].scriptPubKey == scriptCrypto777 && tx.vout.back().scriptPubKey.IsOpReturn())
+        return true;
+    return false;
+}
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
                                  int64_t _nTime, double _dPriority,
                                  unsigned int _nHeight, bool poolHasNoInputsOf,
@@ -54,6 +70,12 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nModSize = tx.CalculateModifiedSize(nTxSize);
     nUsageSize = RecursiveDynamicUsage(tx);
     feeRate = CFeeRate(nFee, nTxSize);
+    fProtected = IsProtectedMempoolTx(tx);
+    feeDelta = 0;
+
+    nCountWithDescendants = 1;
+    nSizeWithDescendants = nTxSize;
+    nModFeesWithDescendants = nFee;
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -70,8 +92,28 @@ CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
     return dResult;
 }
 
+void CTxMemPoolEntry::UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount)
+{
+    nSizeWithDescendants += modifySize;
+    nModFeesWithDescendants += modifyFee;
+    nCountWithDescendants += modifyCount;
+}
+
+void CTxMemPoolEntry::ResetDescendantState()
+{
+    nCountWithDescendants = 1;
+    nSizeWithDescendants = nTxSize;
+    nModFeesWithDescendants = GetModifiedFee();
+}
+
+void CTxMemPoolEntry::UpdateFeeDelta(CAmount newFeeDelta)
+{
+    nModFeesWithDescendants += newFeeDelta - feeDelta;
+    feeDelta = newFeeDelta;
+}
+
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) :
-    nTransactionsUpdated(0)
+    nTransactionsUpdated(0), minReasonableRelayFee(_minRelayFee)
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -79,6 +121,10 @@ CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) :
     nCheckFrequency = 0;
 
     minerPolicyEstimator = new CBlockPolicyEstimator(_minRelayFee);
+
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
 }
 
 CTxMemPool::~CTxMemPool()
@@ -112,14 +158,116 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
 }
 
 
+void CTxMemPool::CalculateMemPoolAncestors(const CTransaction &tx, std::set<uint256> &setAncestors, const uint256 &hashSkip) const
+{
+    LOCK(cs);
+    std::deque<const CTransaction*> parents;
+    parents.push_back(&tx);
+    while (!parents.empty())
+    {
+        const CTransaction *ptx = parents.front();
+        parents.pop_front();
+        BOOST_FOREACH(const CTxIn& txin, ptx->vin) {
+            if (!hashSkip.IsNull() && txin.prevout.hash == hashSkip)
+                continue;
+            indexed_transaction_set::const_iterator it = mapTx.find(txin.prevout.hash);
+            if (it != mapTx.end() && setAncestors.insert(txin.prevout.hash).second)
+                parents.push_back(&it->GetTx());
+        }
+    }
+}
+
+void CTxMemPool::UpdateAncestorsOf(const std::set<uint256> &setAncestors, int64_t modifySize, CAmount modifyFee, int64_t modifyCount)
+{
+    BOOST_FOREACH(const uint256& hash, setAncestors) {
+        indexed_transaction_set::iterator it = mapTx.find(hash);
+        if (it != mapTx.end())
+            mapTx.modify(it, update_descendant_state(modifySize, modifyFee, modifyCount));
+    }
+}
+
+/**
+ * Account for a new entry in the descendant state. Normally it has no
+ * in-mempool children, but after a reorg a transaction from a disconnected
+ * block may be re-added while its children are still in the pool, so those
+ * are folded into the new entry and passed on to its ancestors. An ancestor
+ * may already count some of them through another path, e.g. a child that
+ * spends both the new entry and another output of the new entry's parent,
+ * and must not count them twice.
+ */
+void CTxMemPool::UpdateForAdd(indexed_transaction_set::iterator newit)
+{
+    const uint256 hash = newit->GetTx().GetHash();
+    int64_t nSize = newit->GetTxSize();
+    CAmount nModFees = newit->GetModifiedFee();
+    int64_t nCount = 1;
+
+    std::set<uint256> setDescendants;
+    std::deque<uint256> children;
+    children.push_back(hash);
+    while (!children.empty())
+    {
+        uint256 parent = children.front();
+        children.pop_front();
+        std::map<COutPoint, CInPoint>::const_iterator it = mapNextTx.lower_bound(COutPoint(parent, 0));
+        for (; it != mapNextTx.end() && it->first.hash == parent; it++) {
+            const uint256 &childhash = it->second.ptx->GetHash();
+            if (childhash != hash && setDescendants.insert(childhash).second)
+                children.push_back(childhash);
+        }
+    }
+    BOOST_FOREACH(const uint256& childhash, setDescendants) {
+        indexed_transaction_set::const_iterator it = mapTx.find(childhash);
+        if (it != mapTx.end()) {
+            nSize += it->GetTxSize();
+            nModFees += it->GetModifiedFee();
+            nCount++;
+        }
+    }
+    if (nCount > 1)
+        mapTx.modify(newit, update_descendant_state(nSize - newit->GetTxSize(), nModFees - newit->GetModifiedFee(), nCount - 1));
+
+    std::set<uint256> setAncestors;
+    CalculateMemPoolAncestors(newit->GetTx(), setAncestors);
+    if (setAncestors.empty())
+        return;
+    UpdateAncestorsOf(setAncestors, newit->GetTxSize(), newit->GetModifiedFee(), 1);
+    BOOST_FOREACH(const uint256& childhash, setDescendants) {
+        indexed_transaction_set::const_iterator it = mapTx.find(childhash);
+        if (it == mapTx.end())
+            continue;
+        std::set<uint256> setCounted;
+        CalculateMemPoolAncestors(it->GetTx(), setCounted, hash);
+        std::set<uint256> setUpdate;
+        BOOST_FOREACH(const uint256& ancestorhash, setAncestors) {
+            if (!setCounted.count(ancestorhash))
+                setUpdate.insert(ancestorhash);
+        }
+        UpdateAncestorsOf(setUpdate, it->GetTxSize(), it->GetModifiedFee(), 1);
+    }
+}
+
+// Memory an entry takes in mapTx, estimated the same way as in DynamicMemoryUsage
+static size_t MemPoolEntryUsage(const CTxMemPoolEntry &entry)
+{
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 18 * sizeof(void*)) + entry.DynamicMemoryUsage();
+}
+
 bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry, bool fCurrentEstimate)
 {
     // Add to memory pool without checking anything.
     // Used by main.cpp AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     LOCK(cs);
-    mapTx.insert(entry);
-    const CTransaction& tx = mapTx.find(hash)->GetTx();
+    indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
+    // entry may be a copy of one from this or another pool (CheckBlock re-adds
+    // them), UpdateForAdd recomputes the descendants that are actually here
+    mapTx.modify(newit, reset_descendant_state());
+    // Apply any prioritisation made before the transaction arrived
+    std::map<uint256, std::pair<double, CAmount> >::const_iterator pos = mapDeltas.find(hash);
+    if (pos != mapDeltas.end() && pos->second.second != 0)
+        mapTx.modify(newit, update_fee_delta(pos->second.second));
+    const CTransaction& tx = newit->GetTx();
     mapRecentlyAddedTx[tx.GetHash()] = &tx;
     nRecentlyAddedSequence += 1;
     if (!tx.IsCoinImport()) {
@@ -137,8 +285,11 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     for (const SpendDescription &spendDescription : tx.vShieldedSpend) {
         mapSaplingNullifiers[spendDescription.nullifier] = &tx;
     }
+    UpdateForAdd(newit);
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    if (entry.IsProtected())
+        cachedProtectedUsage += MemPoolEntryUsage(entry);
     cachedInnerUsage += entry.DynamicMemoryUsage();
     minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
 
@@ -353,12 +504,18 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
                 txToRemove.push_back(it->second.ptx->GetHash());
             }
         }
+        // Collect everything being removed first, so the descendant state of
+        // the ancestors left behind can be updated while the whole set is
+        // still linked through mapTx.
+        std::vector<uint256> vRemove;
+        std::set<uint256> setRemove;
         while (!txToRemove.empty())
         {
             uint256 hash = txToRemove.front();
             txToRemove.pop_front();
-            if (!mapTx.count(hash))
+            if (!mapTx.count(hash) || !setRemove.insert(hash).second)
                 continue;
+            vRemove.push_back(hash);
             const CTransaction& tx = mapTx.find(hash)->GetTx();
             if (fRecursive) {
                 for (unsigned int i = 0; i < tx.vout.size(); i++) {
@@ -368,6 +525,21 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
                     txToRemove.push_back(it->second.ptx->GetHash());
                 }
             }
+        }
+        BOOST_FOREACH(const uint256& hash, vRemove)
+        {
+            indexed_transaction_set::const_iterator it = mapTx.find(hash);
+            std::set<uint256> setAncestors, setKeep;
+            CalculateMemPoolAncestors(it->GetTx(), setAncestors);
+            BOOST_FOREACH(const uint256& ancestor, setAncestors) {
+                if (setRemove.count(ancestor) == 0)
+                    setKeep.insert(ancestor);
+            }
+            UpdateAncestorsOf(setKeep, -(int64_t)it->GetTxSize(), -it->GetModifiedFee(), -1);
+        }
+        BOOST_FOREACH(const uint256& hash, vRemove)
+        {
+            const CTransaction& tx = mapTx.find(hash)->GetTx();
             mapRecentlyAddedTx.erase(hash);
             BOOST_FOREACH(const CTxIn& txin, tx.vin)
                 mapNextTx.erase(txin.prevout);
@@ -381,6 +553,8 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
             }
             removed.push_back(tx);
             totalTxSize -= mapTx.find(hash)->GetTxSize();
+            if (mapTx.find(hash)->IsProtected())
+                cachedProtectedUsage -= MemPoolEntryUsage(*mapTx.find(hash));
             cachedInnerUsage -= mapTx.find(hash)->DynamicMemoryUsage();
             mapTx.erase(hash);
             nTransactionsUpdated++;
@@ -403,11 +577,26 @@ void CTxMemPool::removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMem
     // Remove transactions spending a coinbase which are now immature and no-longer-final transactions
     LOCK(cs);
     list<CTransaction> transactionsToRemove;
-    for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+    // Only entries locked at or past the next block's height or time can have
+    // become non-final, the same bounds CheckFinalTx uses.
+    const int nBlockHeight = chainActive.Height() + 1;
+    const int64_t nBlockTime = (std::max(flags, 0) & LOCKTIME_MEDIAN_TIME_PAST) ? chainActive.Tip()->GetMedianTimePast() : GetTime();
+    const indexed_transaction_set::nth_index<3>::type &byLockTime = mapTx.get<3>();
+    std::set<uint256> setNonFinal;
+    indexed_transaction_set::nth_index<3>::type::const_iterator itLock = byLockTime.lower_bound((uint32_t)nBlockHeight);
+    for (; itLock != byLockTime.end() && itLock->GetTx().nLockTime < LOCKTIME_THRESHOLD; itLock++) {
+        if (!CheckFinalTx(itLock->GetTx(), flags) && setNonFinal.insert(itLock->GetTx().GetHash()).second)
+            transactionsToRemove.push_back(itLock->GetTx());
+    }
+    itLock = byLockTime.lower_bound((uint32_t)std::min(std::max(nBlockTime, (int64_t)LOCKTIME_THRESHOLD), (int64_t)0xffffffff));
+    for (; itLock != byLockTime.end(); itLock++) {
+        if (!CheckFinalTx(itLock->GetTx(), flags) && setNonFinal.insert(itLock->GetTx().GetHash()).second)
+            transactionsToRemove.push_back(itLock->GetTx());
+    }
+    const indexed_transaction_set::nth_index<4>::type &bySpendsCoinbase = mapTx.get<4>();
+    for (indexed_transaction_set::nth_index<4>::type::const_iterator it = bySpendsCoinbase.lower_bound(true); it != bySpendsCoinbase.end(); it++) {
         const CTransaction& tx = it->GetTx();
-        if (!CheckFinalTx(tx, flags)) {
-            transactionsToRemove.push_back(tx);
-        } else if (it->GetSpendsCoinbase()) {
+        if (setNonFinal.count(tx.GetHash()) == 0) {
             BOOST_FOREACH(const CTxIn& txin, tx.vin) {
                 indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
                 if (it2 != mapTx.end())
@@ -513,21 +702,33 @@ extern char ASSETCHAINS_SYMBOL[];
 
 void CTxMemPool::removeExpired(unsigned int nBlockHeight)
 {
-    CBlockIndex *tipindex;
+    CBlockIndex *tipindex = chainActive.LastTip();
     // Remove expired txs from the mempool
     LOCK(cs);
     list<CTransaction> transactionsToRemove;
-    for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++)
+    std::set<uint256> setRemove;
+    // Entries with 0 < nExpiryHeight < nBlockHeight are the expired ones
+    const indexed_transaction_set::nth_index<2>::type &byExpiry = mapTx.get<2>();
+    for (indexed_transaction_set::nth_index<2>::type::const_iterator it = byExpiry.upper_bound(0); it != byExpiry.end() && it->GetTx().nExpiryHeight < nBlockHeight; it++)
     {
         const CTransaction& tx = it->GetTx();
-        tipindex = chainActive.LastTip();
-
-        bool fInterestNotValidated = ASSETCHAINS_SYMBOL[0] == 0 && tipindex != 0 && komodo_validate_interest(tx,tipindex->GetHeight()+1,tipindex->GetMedianTimePast() + 777,0) < 0;
-        if (IsExpiredTx(tx, nBlockHeight) || fInterestNotValidated)
-        {
-            if (fInterestNotValidated && tipindex != 0)
-                LogPrintf("Removing interest violate txid.%s nHeight.%d nTime.%u vs locktime.%u\n",tx.GetHash().ToString(),tipindex->GetHeight()+1,tipindex->GetMedianTimePast() + 777,tx.nLockTime);
+        if (IsExpiredTx(tx, nBlockHeight) && setRemove.insert(tx.GetHash()).second)
             transactionsToRemove.push_back(tx);
+    }
+    if (ASSETCHAINS_SYMBOL[0] == 0 && tipindex != 0)
+    {
+        // komodo_validate_interest rejects time locks older than cmptime - KOMODO_MAXMEMPOOLTIME,
+        // so only that prefix of the lock time index needs checking. The median time is computed once.
+        const uint32_t cmptime = tipindex->GetMedianTimePast() + 777;
+        const indexed_transaction_set::nth_index<3>::type &byLockTime = mapTx.get<3>();
+        for (indexed_transaction_set::nth_index<3>::type::const_iterator it = byLockTime.lower_bound((uint32_t)LOCKTIME_THRESHOLD); it != byLockTime.end() && (int64_t)it->GetTx().nLockTime < (int64_t)cmptime - KOMODO_MAXMEMPOOLTIME; it++)
+        {
+            const CTransaction& tx = it->GetTx();
+            if (komodo_validate_interest(tx,tipindex->GetHeight()+1,cmptime,0) < 0 && setRemove.insert(tx.GetHash()).second)
+            {
+                LogPrintf("Removing interest violate txid.%s nHeight.%d nTime.%u vs locktime.%u\n",tx.GetHash().ToString(),tipindex->GetHeight()+1,cmptime,tx.nLockTime);
+                transactionsToRemove.push_back(tx);
+            }
         }
     }
     for (const CTransaction& tx : transactionsToRemove) {
@@ -562,6 +763,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
     }
     // After the txs in the new block have been removed from the mempool, update policy estimates
     minerPolicyEstimator->processBlock(nBlockHeight, entries, fCurrentEstimate);
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 /**
@@ -592,7 +795,11 @@ void CTxMemPool::clear()
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
+    cachedProtectedUsage = 0;
     cachedInnerUsage = 0;
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
 }
 
@@ -607,6 +814,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     LogPrint("mempool", "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
+    uint64_t checkProtected = 0;
     uint64_t innerUsage = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
@@ -617,6 +825,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->GetTxSize();
+        if (it->IsProtected())
+            checkProtected += MemPoolEntryUsage(*it);
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
         bool fDependsWait = false;
@@ -704,10 +914,32 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(it->first == it->second.ptx->vin[it->second.n].prevout);
     }
 
+    // Every entry's descendant state covers itself and each transaction
+    // that has it as an ancestor, counted once.
+    std::map<uint256, uint64_t> mapDescendantCount, mapDescendantSize;
+    std::map<uint256, CAmount> mapDescendantFees;
+    for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+        std::set<uint256> setAncestors;
+        CalculateMemPoolAncestors(it->GetTx(), setAncestors);
+        setAncestors.insert(it->GetTx().GetHash());
+        BOOST_FOREACH(const uint256& hash, setAncestors) {
+            mapDescendantCount[hash]++;
+            mapDescendantSize[hash] += it->GetTxSize();
+            mapDescendantFees[hash] += it->GetModifiedFee();
+        }
+    }
+    for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+        const uint256 hash = it->GetTx().GetHash();
+        assert(it->GetCountWithDescendants() == mapDescendantCount[hash]);
+        assert(it->GetSizeWithDescendants() == mapDescendantSize[hash]);
+        assert(it->GetModFeesWithDescendants() == mapDescendantFees[hash]);
+    }
+
     checkNullifiers(SPROUT);
     checkNullifiers(SAPLING);
 
     assert(totalTxSize == checkTotal);
+    assert(cachedProtectedUsage == checkProtected);
     assert(innerUsage == cachedInnerUsage);
 }
 
@@ -805,6 +1037,13 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
         std::pair<double, CAmount> &deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+        indexed_transaction_set::iterator it = mapTx.find(hash);
+        if (it != mapTx.end() && nFeeDelta != 0) {
+            mapTx.modify(it, update_fee_delta(deltas.second));
+            std::set<uint256> setAncestors;
+            CalculateMemPoolAncestors(it->GetTx(), setAncestors);
+            UpdateAncestorsOf(setAncestors, 0, nFeeDelta, 0);
+        }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
 }
@@ -914,6 +1153,76 @@ bool CCoinsViewMemPool::HaveCoins(const uint256 &txid) const {
 
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 6 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 6 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + cachedInnerUsage;
+    // Estimate the overhead of mapTx to be 18 pointers (3 per index) + an allocation, as no exact formula for boost::multi_index_contained is implemented.
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 18 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + cachedInnerUsage;
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate(rollingMinimumFeeRate);
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < minReasonableRelayFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate(rollingMinimumFeeRate), minReasonableRelayFee);
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate) {
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+unsigned int CTxMemPool::TrimToSize(size_t sizelimit) {
+    LOCK(cs);
+
+    unsigned int nTxnRemoved = 0;
+    CFeeRate maxFeeRateRemoved(0);
+    while (DynamicMemoryUsage() > sizelimit) {
+        // Protected transactions are passed over while they stay within their
+        // share of the limit. Beyond it the cheapest of them go first, so
+        // that they cannot push out normal transactions paying higher fees.
+        bool fProtected = cachedProtectedUsage > sizelimit / MEMPOOL_PROTECTED_SHARE;
+        indexed_transaction_set::nth_index<5>::type::iterator it = mapTx.get<5>().begin();
+        while (it != mapTx.get<5>().end() && it->IsProtected() != fProtected)
+            it++;
+        if (it == mapTx.get<5>().end()) {
+            if (!mapTx.empty())
+                LogPrint("mempool", "TrimToSize: only protected transactions left, usage %u > %u\n", DynamicMemoryUsage(), sizelimit);
+            break;
+        }
+        // We set the new mempool min fee to the feerate of the removed package,
+        // plus the minimum relay fee. This way, we don't allow txn to enter
+        // the mempool with a feerate equal to the evicted ones with no block
+        // in between.
+        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        removed = CFeeRate(removed.GetFeePerK() + minReasonableRelayFee.GetFeePerK());
+        trackPackageRemoved(removed);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+        const CTransaction tx = it->GetTx();
+        std::list<CTransaction> removedTxs;
+        remove(tx, removedTxs, true);
+        nTxnRemoved += removedTxs.size();
+    }
+
+    if (maxFeeRateRemoved > CFeeRate(0))
+        LogPrint("mempool", "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
+    return nTxnRemoved;
 }
@@ -22,6 +22,7 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <list>
+#include <set>
 
 #include "addressindex.h"
 #include "spentindex.h"
@@ -50,6 +51,8 @@ inline bool AllowFree(double dPriority)
 
 /** Fake height value used in CCoins to signify they are only in the memory pool (since 0.8) */
 static const unsigned int MEMPOOL_HEIGHT = 0x7FFFFFFF;
+/** Protected entries are only evicted last while their memory usage stays below 1/n of the TrimToSize limit */
+static const unsigned int MEMPOOL_PROTECTED_SHARE = 10;
 
 /**
  * CTxMemPool stores these:
@@ -69,6 +72,14 @@ private:
     bool hadNoDependencies; //! Not dependent on any other txs when it entered the mempool
     bool spendsCoinbase; //! keep track of transactions that spend a coinbase
     uint32_t nBranchId; //! Branch ID this transaction is known to commit to, cached for efficiency
+    bool fProtected; //! CC spends, notarisations and imports are evicted by TrimToSize last, see MEMPOOL_PROTECTED_SHARE
+    CAmount feeDelta; //! Fee delta applied by PrioritiseTransaction
+
+    // Information about the in-mempool descendants of this transaction,
+    // including the transaction itself. Kept up to date by CTxMemPool.
+    uint64_t nCountWithDescendants; //! number of descendant transactions
+    uint64_t nSizeWithDescendants; //! ... and size
+    CAmount nModFeesWithDescendants; //! ... and total modified fees
 
 public:
     CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
@@ -89,6 +100,52 @@ public:
 
     bool GetSpendsCoinbase() const { return spendsCoinbase; }
     uint32_t GetValidatedBranchId() const { return nBranchId; }
+    bool IsProtected() const { return fProtected; }
+
+    CAmount GetModifiedFee() const { return nFee + feeDelta; }
+    uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
+    uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
+    CAmount GetModFeesWithDescendants() const { return nModFeesWithDescendants; }
+
+    // Adjusts the descendant state when a descendant enters or leaves the mempool
+    void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
+    // Drops the descendant state of an entry copied from a pool, so only the entry itself is counted
+    void ResetDescendantState();
+    // Set by AcceptToMemoryPool for transactions that spend a CC output
+    void SetProtected() { fProtected = true; }
+    // Updates the fee delta used for the modified fee, as set by PrioritiseTransaction
+    void UpdateFeeDelta(CAmount newFeeDelta);
+};
+
+// Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
+struct update_descendant_state
+{
+    update_descendant_state(int64_t _modifySize, CAmount _modifyFee, int64_t _modifyCount) :
+        modifySize(_modifySize), modifyFee(_modifyFee), modifyCount(_modifyCount)
+    {}
+
+    void operator() (CTxMemPoolEntry &e)
+        { e.UpdateDescendantState(modifySize, modifyFee, modifyCount); }
+
+    private:
+        int64_t modifySize;
+        CAmount modifyFee;
+        int64_t modifyCount;
+};
+
+struct reset_descendant_state
+{
+    void operator() (CTxMemPoolEntry &e) { e.ResetDescendantState(); }
+};
+
+struct update_fee_delta
+{
+    update_fee_delta(CAmount _feeDelta) : feeDelta(_feeDelta) { }
+
+    void operator() (CTxMemPoolEntry &e) { e.UpdateFeeDelta(feeDelta); }
+
+private:
+    CAmount feeDelta;
 };
 
 // extracts a TxMemPoolEntry's transaction hash
@@ -101,10 +158,40 @@ struct mempoolentry_txid
     }
 };
 
+// extracts a TxMemPoolEntry's expiry height, 0 if it never expires
+struct mempoolentry_expiry
+{
+    typedef uint32_t result_type;
+    result_type operator() (const CTxMemPoolEntry &entry) const
+    {
+        return entry.GetTx().nExpiryHeight;
+    }
+};
+
+// extracts a TxMemPoolEntry's lock time, which also bounds its KMD interest validity
+struct mempoolentry_locktime
+{
+    typedef uint32_t result_type;
+    result_type operator() (const CTxMemPoolEntry &entry) const
+    {
+        return entry.GetTx().nLockTime;
+    }
+};
+
+// extracts whether a TxMemPoolEntry spends a coinbase
+struct mempoolentry_spendscoinbase
+{
+    typedef bool result_type;
+    result_type operator() (const CTxMemPoolEntry &entry) const
+    {
+        return entry.GetSpendsCoinbase();
+    }
+};
+
 class CompareTxMemPoolEntryByFee
 {
 public:
-    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b)
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
     {
         if (a.GetFeeRate() == b.GetFeeRate())
             return a.GetTime() < b.GetTime();
@@ -112,6 +199,42 @@ public:
     }
 };
 
+/** Sort an entry by the higher of its own modified fee rate and the fee rate
+ *  of it together with all its descendants, cheapest first. This is the
+ *  order TrimToSize evicts in: a low fee parent with a high fee child is
+ *  only as cheap as the package.
+ */
+class CompareTxMemPoolEntryByDescendantScore
+{
+public:
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        double aFee, aSize, bFee, bSize;
+        GetScore(a, aFee, aSize);
+        GetScore(b, bFee, bSize);
+        // Avoid division by rewriting (a/b > c/d) as (a*d > c*b).
+        double f1 = aFee * bSize;
+        double f2 = aSize * bFee;
+        if (f1 == f2)
+            return a.GetTime() > b.GetTime();
+        return f1 < f2;
+    }
+
+    // Use the package fee rate only when it is higher than the entry's own
+    void GetScore(const CTxMemPoolEntry &a, double &fee, double &size) const
+    {
+        double f1 = (double)a.GetModifiedFee() * a.GetSizeWithDescendants();
+        double f2 = (double)a.GetModFeesWithDescendants() * a.GetTxSize();
+        if (f2 > f1) {
+            fee = a.GetModFeesWithDescendants();
+            size = a.GetSizeWithDescendants();
+        } else {
+            fee = a.GetModifiedFee();
+            size = a.GetTxSize();
+        }
+    }
+};
+
 class CBlockPolicyEstimator;
 
 /** An inpoint - a combination of a transaction and an index n into its vin */
@@ -147,11 +270,20 @@ private:
 
     uint64_t totalTxSize = 0; //! sum of all mempool tx' byte sizes
     uint64_t cachedInnerUsage; //! sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t cachedProtectedUsage = 0; //! memory usage of the protected entries, including their share of mapTx
 
     std::map<uint256, const CTransaction*> mapRecentlyAddedTx;
     uint64_t nRecentlyAddedSequence = 0;
     uint64_t nNotifiedSequence = 0;
 
+    CFeeRate minReasonableRelayFee;
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
+
+    void trackPackageRemoved(const CFeeRate& rate);
+
     std::map<uint256, const CTransaction*> mapSproutNullifiers;
     std::map<uint256, const CTransaction*> mapSaplingNullifiers;
 
@@ -167,6 +299,17 @@ public:
             boost::multi_index::ordered_non_unique<
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByFee
+            >,
+            // sorted by expiry height, so removeExpired only visits the due ones
+            boost::multi_index::ordered_non_unique<mempoolentry_expiry>,
+            // sorted by lock time, for finality after a reorg and KMD interest validity
+            boost::multi_index::ordered_non_unique<mempoolentry_locktime>,
+            // coinbase spenders, which may become immature after a reorg
+            boost::multi_index::ordered_non_unique<mempoolentry_spendscoinbase>,
+            // sorted by fee rate including descendants, cheapest first, for TrimToSize
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::identity<CTxMemPoolEntry>,
+                CompareTxMemPoolEntryByDescendantScore
             >
         >
     > indexed_transaction_set;
@@ -187,10 +330,15 @@ private:
     typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
+    void UpdateAncestorsOf(const std::set<uint256> &setAncestors, int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
+    void UpdateForAdd(indexed_transaction_set::iterator newit);
+
 public:
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
 
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
+
     CTxMemPool(const CFeeRate& _minRelayFee);
     ~CTxMemPool();
 
@@ -231,6 +379,22 @@ public:
      */
     bool HasNoInputsOf(const CTransaction& tx) const;
 
+    /** Collect the hashes of all in-mempool ancestors of tx, not including tx itself.
+     *  Ancestors only reachable through hashSkip are left out. */
+    void CalculateMemPoolAncestors(const CTransaction &tx, std::set<uint256> &setAncestors, const uint256 &hashSkip = uint256()) const;
+
+    /** The minimum fee to get into the mempool, which may itself not be enough
+     *  for larger-sized transactions.
+     *  The minReasonableRelayFee constructor arg is used to bound the time it
+     *  takes the fee rate to go back down all the way to 0. When the feerate
+     *  would otherwise be half of this, it is set to 0 instead.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+
+    /** Remove transactions from the mempool until its dynamic size is <= sizelimit,
+     *  cheapest package first. Returns the number of transactions removed. */
+    unsigned int TrimToSize(size_t sizelimit);
+
     /** Affect CreateNewBlock prioritisation of transactions */
     void PrioritiseTransaction(const uint256 hash, const std::string strHash, double dPriorityDelta, const CAmount& nFeeDelta);
     void ApplyDeltas(const uint256 hash, double &dPriorityDelta, CAmount &nFeeDelta);
@@ -207,8 +207,11 @@ void AsyncRPCOperation_mergetoaddress::main()
     }
     LogPrintf("%s", s);
 
-    unlock_utxos(); // clean up
-    unlock_notes(); // clean up
+    // On success the inputs stay reserved until AddToWallet sees the spend
+    if (!success) {
+        unlock_utxos(); // clean up
+        unlock_notes(); // clean up
+    }
 
     // !!! Payment disclosure START
     if (success && paymentDisclosureMode && paymentDisclosureData_.size() > 0) {
@@ -1074,48 +1077,50 @@ UniValue AsyncRPCOperation_mergetoaddress::getStatus() const
 }
 
 /**
- * Lock input utxos
+ * Reserve input utxos so concurrent async operations do not select them
  */
 void AsyncRPCOperation_mergetoaddress::lock_utxos() {
     LOCK2(cs_main, pwalletMain->cs_wallet);
+    int64_t nExpiry = GetTime() + WALLET_RESERVATION_EXPIRY;
     for (auto utxo : utxoInputs_) {
-        pwalletMain->LockCoin(std::get<0>(utxo));
+        pwalletMain->ReserveCoin(std::get<0>(utxo), nExpiry);
     }
 }
 
 /**
- * Unlock input utxos
+ * Release input utxo reservations
  */
 void AsyncRPCOperation_mergetoaddress::unlock_utxos() {
     LOCK2(cs_main, pwalletMain->cs_wallet);
     for (auto utxo : utxoInputs_) {
-        pwalletMain->UnlockCoin(std::get<0>(utxo));
+        pwalletMain->ReleaseCoin(std::get<0>(utxo));
     }
 }
 
 
 /**
- * Lock input notes
+ * Reserve input notes so concurrent async operations do not select them
  */
 void AsyncRPCOperation_mergetoaddress::lock_notes() {
     LOCK2(cs_main, pwalletMain->cs_wallet);
+    int64_t nExpiry = GetTime() + WALLET_RESERVATION_EXPIRY;
     for (auto note : sproutNoteInputs_) {
-        pwalletMain->LockNote(std::get<0>(note));
+        pwalletMain->ReserveNote(std::get<0>(note), nExpiry);
     }
     for (auto note : saplingNoteInputs_) {
-        pwalletMain->LockNote(std::get<0>(note));
+        pwalletMain->ReserveNote(std::get<0>(note), nExpiry);
     }
 }
 
 /**
- * Unlock input notes
+ * Release input note reservations
  */
 void AsyncRPCOperation_mergetoaddress::unlock_notes() {
     LOCK2(cs_main, pwalletMain->cs_wallet);
     for (auto note : sproutNoteInputs_) {
-        pwalletMain->UnlockNote(std::get<0>(note));
+        pwalletMain->ReleaseNote(std::get<0>(note));
     }
     for (auto note : saplingNoteInputs_) {
-        pwalletMain->UnlockNote(std::get<0>(note));
+        pwalletMain->ReleaseNote(std::get<0>(note));
     }
 }
@@ -210,6 +210,12 @@ void AsyncRPCOperation_sendmany::main() {
     }
     LogPrintf("%s",s);
 
+    // On success the inputs stay reserved until AddToWallet sees the spend or
+    // the reservation lapses, otherwise they are free again
+    if (!success) {
+        unlock_inputs();
+    }
+
     // !!! Payment disclosure START
     if (success && paymentDisclosureMode && paymentDisclosureData_.size()>0) {
         uint256 txidhash = tx_.GetHash();
@@ -229,7 +235,8 @@ void AsyncRPCOperation_sendmany::main() {
 // Notes:
 // 1. #1159 Currently there is no limit set on the number of joinsplits, so size of tx could be invalid.
 // 2. #1360 Note selection is not optimal
-// 3. #1277 Spendable notes are not locked, so an operation running in parallel could also try to use them
+// 3. #1277 Candidate inputs are reserved in the wallet when found, so operations running in parallel
+//    on other -rpcasyncthreads workers skip them until they are released
 bool AsyncRPCOperation_sendmany::main_impl() {
 
     assert(isfromtaddr_ != isfromzaddr_);
@@ -343,6 +350,13 @@ bool AsyncRPCOperation_sendmany::main_impl() {
                 FormatMoney(t_inputs_total), FormatMoney(dustThreshold - dustChange), FormatMoney(dustChange), FormatMoney(dustThreshold)));
         }
 
+        // The selection is a prefix of the sorted candidates, hand the rest back
+        {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            for (size_t i = selectedTInputs.size(); i < t_inputs_.size(); i++) {
+                pwalletMain->ReleaseCoin(COutPoint(std::get<0>(t_inputs_[i]), std::get<1>(t_inputs_[i])));
+            }
+        }
         t_inputs_ = selectedTInputs;
         t_inputs_total = selectedUTXOAmount;
 
@@ -474,6 +488,13 @@ bool AsyncRPCOperation_sendmany::main_impl() {
                 break;
             }
         }
+        {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            for (size_t i = ops.size(); i < z_sapling_inputs_.size(); i++) {
+                pwalletMain->ReleaseNote(z_sapling_inputs_[i].op);
+            }
+        }
+        z_sapling_inputs_.resize(ops.size());
 
         // Fetch Sapling anchor and witnesses
         uint256 anchor;
@@ -1106,6 +1127,12 @@ bool AsyncRPCOperation_sendmany::find_utxos(bool fAcceptCoinbase=false) {
         t_inputs_.push_back(utxo);
     }
 
+    // Reserve the candidates while cs_wallet is still held so no other operation can select them
+    int64_t nExpiry = GetTime() + WALLET_RESERVATION_EXPIRY;
+    for (SendManyInputUTXO & t : t_inputs_) {
+        pwalletMain->ReserveCoin(COutPoint(std::get<0>(t), std::get<1>(t)), nExpiry);
+    }
+
     // sort in ascending order, so smaller utxos appear first
     std::sort(t_inputs_.begin(), t_inputs_.end(), [](SendManyInputUTXO i, SendManyInputUTXO j) -> bool {
         return ( std::get<2>(i) < std::get<2>(j));
@@ -1121,15 +1148,24 @@ bool AsyncRPCOperation_sendmany::find_unspent_notes() {
     {
         LOCK2(cs_main, pwalletMain->cs_wallet);
         pwalletMain->GetFilteredNotes(sproutEntries, saplingEntries, fromaddress_, mindepth_);
-    }
 
-    // If using the TransactionBuilder, we only want Sapling notes.
-    // If not using it, we only want Sprout notes.
-    // TODO: Refactor `GetFilteredNotes()` so we only fetch what we need.
-    if (isUsingBuilder_) {
-        sproutEntries.clear();
-    } else {
-        saplingEntries.clear();
+        // If using the TransactionBuilder, we only want Sapling notes.
+        // If not using it, we only want Sprout notes.
+        // TODO: Refactor `GetFilteredNotes()` so we only fetch what we need.
+        if (isUsingBuilder_) {
+            sproutEntries.clear();
+        } else {
+            saplingEntries.clear();
+        }
+
+        // Reserve the candidates while cs_wallet is still held so no other operation can select them
+        int64_t nExpiry = GetTime() + WALLET_RESERVATION_EXPIRY;
+        for (CSproutNotePlaintextEntry & entry : sproutEntries) {
+            pwalletMain->ReserveNote(entry.jsop, nExpiry);
+        }
+        for (SaplingNoteEntry & entry : saplingEntries) {
+            pwalletMain->ReserveNote(entry.op, nExpiry);
+        }
     }
 
     for (CSproutNotePlaintextEntry & entry : sproutEntries) {
@@ -1452,3 +1488,19 @@ UniValue AsyncRPCOperation_sendmany::getStatus() const {
     obj.push_back(Pair("params", contextinfo_ ));
     return obj;
 }
+
+/**
+ * Release the wallet reservations on the inputs this operation selected
+ */
+void AsyncRPCOperation_sendmany::unlock_inputs() {
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    for (SendManyInputUTXO & t : t_inputs_) {
+        pwalletMain->ReleaseCoin(COutPoint(std::get<0>(t), std::get<1>(t)));
+    }
+    for (SendManyInputJSOP & t : z_sprout_inputs_) {
+        pwalletMain->ReleaseNote(std::get<0>(t));
+    }
+    for (SaplingNoteEntry & t : z_sapling_inputs_) {
+        pwalletMain->ReleaseNote(t.op);
+    }
+}
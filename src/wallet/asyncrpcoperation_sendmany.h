@@ -88,6 +88,10 @@ public:
 
     virtual UniValue getStatus() const;
 
+    virtual std::string getMethodName() const {
+        return "z_sendmany";
+    }
+
     bool testmode = false;  // Set to true to disable sending txs and generating proofs
 
     bool paymentDisclosureMode = true; // Set to true to save esk for encrypted notes in payment disclosure database.
@@ -127,6 +131,7 @@ private:
     void add_taddr_outputs_to_tx();
     bool find_unspent_notes();
     bool find_utxos(bool fAcceptCoinbase);
+    void unlock_inputs();
     std::array<unsigned char, ZC_MEMO_SIZE> get_memo_from_hex_string(std::string s);
     bool main_impl();
 
@@ -178,7 +178,10 @@ void AsyncRPCOperation_shieldcoinbase::main() {
     }
     LogPrintf("%s",s);
 
-    unlock_utxos(); // clean up
+    // On success the inputs stay reserved until AddToWallet sees the spend
+    if (!success) {
+        unlock_utxos(); // clean up
+    }
 
     // !!! Payment disclosure START
     if (success && paymentDisclosureMode && paymentDisclosureData_.size()>0) {
@@ -580,23 +583,24 @@ UniValue AsyncRPCOperation_shieldcoinbase::getStatus() const {
 }
 
 /**
- * Lock input utxos
+ * Reserve input utxos so concurrent async operations do not select them
  */
  void AsyncRPCOperation_shieldcoinbase::lock_utxos() {
     LOCK2(cs_main, pwalletMain->cs_wallet);
+    int64_t nExpiry = GetTime() + WALLET_RESERVATION_EXPIRY;
     for (auto utxo : inputs_) {
         COutPoint outpt(utxo.txid, utxo.vout);
-        pwalletMain->LockCoin(outpt);
+        pwalletMain->ReserveCoin(outpt, nExpiry);
     }
 }
 
 /**
- * Unlock input utxos
+ * Release input utxo reservations
  */
 void AsyncRPCOperation_shieldcoinbase::unlock_utxos() {
     LOCK2(cs_main, pwalletMain->cs_wallet);
     for (auto utxo : inputs_) {
         COutPoint outpt(utxo.txid, utxo.vout);
-        pwalletMain->UnlockCoin(outpt);
+        pwalletMain->ReleaseCoin(outpt);
     }
 }
@@ -1943,6 +1943,206 @@ TEST(WalletTests, UpdatedSaplingNoteData) {
     UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
 }
 
+TEST(WalletTests, SproutNotePlaintextCache) {
+    SelectParams(CBaseChainParams::TESTNET);
+    CWallet wallet;
+    auto sk = libzcash::SproutSpendingKey::random();
+    wallet.AddSproutSpendingKey(sk);
+
+    auto wtx = GetValidReceive(sk, 10, true);
+    auto note = GetNote(sk, wtx, 0, 1);
+    auto nullifier = note.nullifier(sk);
+
+    mapSproutNoteData_t noteData;
+    JSOutPoint jsoutpt {wtx.GetHash(), 0, 1};
+    SproutNoteData nd {sk.address(), nullifier};
+    noteData[jsoutpt] = nd;
+    wtx.SetSproutNoteData(noteData);
+    wallet.AddToWallet(wtx, true, NULL);
+
+    // The first decryption fills the cache, later ones are served from it
+    CWalletTx& wtxWallet = wallet.mapWallet[wtx.GetHash()];
+    EXPECT_FALSE(static_cast<bool>(wtxWallet.mapSproutNoteData[jsoutpt].plaintext));
+    auto decrypted = wtxWallet.DecryptSproutNote(jsoutpt);
+    EXPECT_EQ(note.value(), decrypted.first.value());
+    EXPECT_EQ(sk.address(), decrypted.second);
+    ASSERT_TRUE(static_cast<bool>(wtxWallet.mapSproutNoteData[jsoutpt].plaintext));
+    EXPECT_EQ(note.value(), wtxWallet.DecryptSproutNote(jsoutpt).first.value());
+
+    // Replacing the note data drops the cache
+    wtxWallet.SetSproutNoteData(noteData);
+    EXPECT_FALSE(static_cast<bool>(wtxWallet.mapSproutNoteData[jsoutpt].plaintext));
+    EXPECT_EQ(note.value(), wtxWallet.DecryptSproutNote(jsoutpt).first.value());
+
+    // The cache is never written to disk
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << wtxWallet.mapSproutNoteData;
+    mapSproutNoteData_t noteData2;
+    ss >> noteData2;
+    EXPECT_FALSE(static_cast<bool>(noteData2[jsoutpt].plaintext));
+}
+
+TEST(WalletTests, SaplingNotePlaintextCache) {
+    SelectParams(CBaseChainParams::REGTEST);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_SAPLING, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+    auto consensusParams = Params().GetConsensus();
+
+    TestWallet wallet;
+
+    // Generate dummy Sapling address
+    std::vector<unsigned char, secure_allocator<unsigned char>> rawSeed(32);
+    HDSeed seed(rawSeed);
+    auto sk = libzcash::SaplingExtendedSpendingKey::Master(seed);
+    auto expsk = sk.expsk;
+    auto fvk = expsk.full_viewing_key();
+    auto pk = sk.DefaultAddress();
+    ASSERT_TRUE(wallet.AddSaplingZKey(sk, pk));
+
+    // Generate dummy Sapling note
+    libzcash::SaplingNote note(pk, 50000);
+    auto cm = note.cm().get();
+    SaplingMerkleTree tree;
+    tree.append(cm);
+    auto anchor = tree.root();
+    auto witness = tree.witness();
+
+    // Generate transaction paying back to the wallet
+    auto builder = TransactionBuilder(consensusParams, 1);
+    ASSERT_TRUE(builder.AddSaplingSpend(expsk, note, anchor, witness));
+    builder.AddSaplingOutput(fvk.ovk, pk, 25000, {});
+    auto maybe_tx = builder.Build();
+    ASSERT_EQ(static_cast<bool>(maybe_tx), true);
+    auto tx = maybe_tx.get();
+
+    CWalletTx wtx {&wallet, tx};
+    auto saplingNoteData = wallet.FindMySaplingNotes(wtx).first;
+    ASSERT_EQ(2, saplingNoteData.size());
+    wtx.SetSaplingNoteData(saplingNoteData);
+    wallet.AddToWallet(wtx, true, NULL);
+
+    // The first decryption fills the cache, later ones are served from it
+    CWalletTx& wtxWallet = wallet.mapWallet[wtx.GetHash()];
+    SaplingOutPoint op = saplingNoteData.begin()->first;
+    EXPECT_FALSE(static_cast<bool>(wtxWallet.mapSaplingNoteData[op].plaintext));
+    EXPECT_FALSE(static_cast<bool>(wtxWallet.mapSaplingNoteData[op].address));
+    auto decrypted = wtxWallet.DecryptSaplingNote(op);
+    ASSERT_TRUE(static_cast<bool>(decrypted));
+    EXPECT_EQ(pk, decrypted->second);
+    ASSERT_TRUE(static_cast<bool>(wtxWallet.mapSaplingNoteData[op].plaintext));
+    ASSERT_TRUE(static_cast<bool>(wtxWallet.mapSaplingNoteData[op].address));
+    EXPECT_EQ(pk, *wtxWallet.mapSaplingNoteData[op].address);
+    auto cached = wtxWallet.DecryptSaplingNote(op);
+    ASSERT_TRUE(static_cast<bool>(cached));
+    EXPECT_EQ(decrypted->first.value(), cached->first.value());
+    EXPECT_EQ(decrypted->first.rcm, cached->first.rcm);
+
+    // Replacing the note data drops the cache
+    wtxWallet.SetSaplingNoteData(saplingNoteData);
+    EXPECT_FALSE(static_cast<bool>(wtxWallet.mapSaplingNoteData[op].plaintext));
+    EXPECT_FALSE(static_cast<bool>(wtxWallet.mapSaplingNoteData[op].address));
+    auto redecrypted = wtxWallet.DecryptSaplingNote(op);
+    ASSERT_TRUE(static_cast<bool>(redecrypted));
+    EXPECT_EQ(decrypted->first.value(), redecrypted->first.value());
+
+    // The cache is never written to disk
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << wtxWallet.mapSaplingNoteData;
+    mapSaplingNoteData_t saplingNoteData2;
+    ss >> saplingNoteData2;
+    EXPECT_FALSE(static_cast<bool>(saplingNoteData2[op].plaintext));
+    EXPECT_FALSE(static_cast<bool>(saplingNoteData2[op].address));
+
+    // Revert to default
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_SAPLING, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
+}
+
+TEST(WalletTests, GetFilteredNotesByAddress) {
+    SelectParams(CBaseChainParams::REGTEST);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_SAPLING, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+    auto consensusParams = Params().GetConsensus();
+
+    TestWallet wallet;
+
+    std::vector<unsigned char, secure_allocator<unsigned char>> rawSeed(32);
+    HDSeed seed(rawSeed);
+    auto m = libzcash::SaplingExtendedSpendingKey::Master(seed);
+
+    // Generate dummy Sapling address
+    auto sk = m.Derive(0);
+    auto expsk = sk.expsk;
+    auto fvk = expsk.full_viewing_key();
+    auto pk = sk.DefaultAddress();
+    ASSERT_TRUE(wallet.AddSaplingZKey(sk, pk));
+
+    // Generate dummy recipient Sapling address, also in the wallet
+    auto sk2 = m.Derive(1);
+    auto pk2 = sk2.DefaultAddress();
+    ASSERT_TRUE(wallet.AddSaplingZKey(sk2, pk2));
+
+    // Generate dummy Sapling note
+    libzcash::SaplingNote note(pk, 50000);
+    auto cm = note.cm().get();
+    SaplingMerkleTree tree;
+    tree.append(cm);
+    auto anchor = tree.root();
+    auto witness = tree.witness();
+
+    // Pay pk2, with the change going back to pk
+    auto builder = TransactionBuilder(consensusParams, 1);
+    ASSERT_TRUE(builder.AddSaplingSpend(expsk, note, anchor, witness));
+    builder.AddSaplingOutput(fvk.ovk, pk2, 25000, {});
+    auto maybe_tx = builder.Build();
+    ASSERT_EQ(static_cast<bool>(maybe_tx), true);
+    CWalletTx wtx {&wallet, maybe_tx.get()};
+    auto saplingNoteData = wallet.FindMySaplingNotes(wtx).first;
+    ASSERT_EQ(2, saplingNoteData.size());
+    wtx.SetSaplingNoteData(saplingNoteData);
+    wallet.AddToWallet(wtx, true, NULL);
+
+    // Each address only sees its own note. The unconfirmed tx has depth -1.
+    std::vector<CSproutNotePlaintextEntry> sproutEntries;
+    std::vector<SaplingNoteEntry> saplingEntries;
+    wallet.GetFilteredNotes(sproutEntries, saplingEntries, EncodePaymentAddress(pk2), -1);
+    ASSERT_EQ(1, saplingEntries.size());
+    EXPECT_EQ(pk2, saplingEntries[0].address);
+    EXPECT_EQ(25000, saplingEntries[0].note.value());
+    saplingEntries.clear();
+    wallet.GetFilteredNotes(sproutEntries, saplingEntries, EncodePaymentAddress(pk), -1);
+    ASSERT_EQ(1, saplingEntries.size());
+    EXPECT_EQ(pk, saplingEntries[0].address);
+    saplingEntries.clear();
+
+    // The same notes are found without a filter
+    wallet.GetFilteredNotes(sproutEntries, saplingEntries, "", -1);
+    EXPECT_EQ(2, saplingEntries.size());
+    saplingEntries.clear();
+
+    // A tx added after the index was built is picked up by the filtered call
+    auto builder2 = TransactionBuilder(consensusParams, 1);
+    ASSERT_TRUE(builder2.AddSaplingSpend(expsk, note, anchor, witness));
+    builder2.AddSaplingOutput(fvk.ovk, pk2, 20000, {});
+    auto maybe_tx2 = builder2.Build();
+    ASSERT_EQ(static_cast<bool>(maybe_tx2), true);
+    CWalletTx wtx2 {&wallet, maybe_tx2.get()};
+    auto saplingNoteData2 = wallet.FindMySaplingNotes(wtx2).first;
+    ASSERT_EQ(2, saplingNoteData2.size());
+    wtx2.SetSaplingNoteData(saplingNoteData2);
+    wallet.AddToWallet(wtx2, true, NULL);
+
+    wallet.GetFilteredNotes(sproutEntries, saplingEntries, EncodePaymentAddress(pk2), -1);
+    ASSERT_EQ(2, saplingEntries.size());
+    CAmount total = saplingEntries[0].note.value() + saplingEntries[1].note.value();
+    EXPECT_EQ(45000, total);
+    EXPECT_EQ(0, sproutEntries.size());
+
+    // Revert to default
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_SAPLING, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
+}
+
 TEST(WalletTests, MarkAffectedSproutTransactionsDirty) {
     TestWallet wallet;
 
@@ -2160,3 +2360,36 @@ TEST(WalletTests, SaplingNoteLocking) {
     EXPECT_FALSE(wallet.IsLockedNote(sop1));
     EXPECT_FALSE(wallet.IsLockedNote(sop2));
 }
+
+TEST(WalletTests, SaplingNoteReservation) {
+    TestWallet wallet;
+    SaplingOutPoint sop1 {uint256(), 1};
+    SaplingOutPoint sop2 {uint256(), 2};
+
+    SetMockTime(1000);
+
+    // Reservations are independent of the lockunspent set
+    wallet.LockNote(sop1);
+    wallet.ReserveNote(sop1, 1000 + WALLET_RESERVATION_EXPIRY);
+    wallet.ReleaseNote(sop1);
+    EXPECT_FALSE(wallet.IsReservedNote(sop1));
+    EXPECT_TRUE(wallet.IsLockedNote(sop1));
+
+    // Reservations lapse on their own
+    wallet.ReserveNote(sop2, 1010);
+    EXPECT_TRUE(wallet.IsReservedNote(sop2));
+    SetMockTime(1010);
+    EXPECT_FALSE(wallet.IsReservedNote(sop2));
+
+    // Reserving again moves the expiry, the old one no longer drops it
+    wallet.ReserveNote(sop2, 1020);
+    wallet.ReserveNote(sop2, 1100);
+    SetMockTime(1050);
+    wallet.ReserveNote(sop1, 1100);
+    EXPECT_TRUE(wallet.IsReservedNote(sop2));
+    wallet.ReleaseNote(sop2);
+    EXPECT_FALSE(wallet.IsReservedNote(sop2));
+    EXPECT_TRUE(wallet.IsReservedNote(sop1));
+
+    SetMockTime(0);
+}
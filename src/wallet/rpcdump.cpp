@@ -1038,6 +1038,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *fname,int32_t priority,uint3
 UniValue komodo_DEXstream(char *fname,int32_t priority);
 UniValue komodo_DEXstreamsub(char *fname,int32_t priority,char *pubkeystr);
 UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *tagB);
+int32_t komodo_DEXpowcancel();
 UniValue komodo_DEXanonsend(char *message,int32_t priority,char *destpub33);
 UniValue komodo_DEX_notarize(char *coin,int32_t height);
 int32_t is_hexstr(char *str,int32_t n);
@@ -1195,6 +1196,18 @@ UniValue DEX_cancel(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return(komodo_DEXcancel(pubkeystr,shorthash,tagA,tagB));
 }
 
+UniValue DEX_powcancel(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    UniValue result(UniValue::VOBJ);
+    if ( fHelp || params.size() != 0 )
+        throw runtime_error("DEX_powcancel\nstops the nonce search of the DEX_broadcast in progress, which then returns without issuing the quote\n");
+    if ( KOMODO_DEX_P2P == 0 )
+        throw runtime_error("only -dexp2p nodes have DEX_powcancel\n");
+    result.push_back(Pair((char *)"result",(char *)"success"));
+    result.push_back(Pair((char *)"cancelled",(int64_t)komodo_DEXpowcancel()));
+    return(result);
+}
+
 UniValue DEX_get(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     uint32_t id=0;
@@ -3417,6 +3417,86 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             sample_times.push_back(benchmark_verify_sapling_spend());
         } else if (benchmarktype == "verifysaplingoutput") {
             sample_times.push_back(benchmark_verify_sapling_output());
+        } else if (benchmarktype == "socketthroughput") {
+            // Number of loopback peers each streaming 1 MiB
+            int nPeers = 256;
+            if (params.size() >= 3) {
+                nPeers = params[2].get_int();
+            }
+            if (nPeers <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of peers");
+            }
+            sample_times.push_back(benchmark_socket_throughput(nPeers));
+        } else if (benchmarktype == "dexcontention") {
+            // Concurrent DEX_list/DEX_orderbook readers while quotes are added
+            int nReaders = 4, nQuotes = 1000;
+            if (params.size() >= 3) {
+                nReaders = params[2].get_int();
+            }
+            if (params.size() >= 4) {
+                nQuotes = params[3].get_int();
+            }
+            if (nReaders < 0 || nReaders > 64 || nQuotes <= 0 || nQuotes > 100000) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of readers or quotes, must be 0 to 64 readers and 1 to 100000 quotes");
+            }
+            sample_times.push_back(benchmark_dex_contention(nReaders, nQuotes));
+        } else if (benchmarktype == "nspvloopback") {
+            // nSPV txproof requests answered in-process by the fullnode handler
+            int nTxs = 100;
+            if (params.size() >= 3) {
+                nTxs = params[2].get_int();
+            }
+            if (nTxs <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of txids");
+            }
+            sample_times.push_back(benchmark_nspv_loopback(nTxs));
+        } else if (benchmarktype == "dexpow") {
+            // DEX quote nonce search rate at priorities 0 to maxpriority
+            int nMaxPriority = 8, nBytes = 256;
+            if (params.size() >= 3) {
+                nMaxPriority = params[2].get_int();
+            }
+            if (params.size() >= 4) {
+                nBytes = params[3].get_int();
+            }
+            // every priority level doubles the expected tries, 8 already takes minutes on one core
+            if (nMaxPriority < 0 || nMaxPriority > 8 || nBytes <= 0 || nBytes > (1 << 20)) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid priority or quote size");
+            }
+            sample_times.push_back(benchmark_dex_pow(nMaxPriority, nBytes));
+        } else if (benchmarktype == "buildsapling") {
+            // TransactionBuilder::Build with nspends Sapling spends, see -saplingbuilderthreads
+            int nSpends = 10;
+            if (params.size() >= 3) {
+                nSpends = params[2].get_int();
+            }
+            if (nSpends < 1 || nSpends > 100) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of spends, must be 1 to 100");
+            }
+            sample_times.push_back(benchmark_build_sapling(nSpends));
+        } else if (benchmarktype == "incsaplingwitnesses") {
+            // Connect a block of 100 foreign Sapling outputs to a wallet holding nnotes notes
+            int nNotes = 1000;
+            if (params.size() >= 3) {
+                nNotes = params[2].get_int();
+            }
+            if (nNotes < 1 || nNotes > 100000) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of notes, must be 1 to 100000");
+            }
+            sample_times.push_back(benchmark_increment_sapling_witnesses(nNotes));
+        } else if (benchmarktype == "addressdeltas") {
+            // Address history of one address through the RPC or the REST endpoint, needs -addressindex
+            if (params.size() < 3) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Missing address");
+            }
+            std::string strFormat = "bin";
+            if (params.size() >= 4) {
+                strFormat = params[3].get_str();
+            }
+            if (strFormat != "rpc" && strFormat != "bin" && strFormat != "hex" && strFormat != "json") {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid format, must be rpc, bin, hex or json");
+            }
+            sample_times.push_back(benchmark_address_deltas(params[2].get_str(), strFormat));
         } else {
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid benchmarktype");
         }
@@ -5500,6 +5580,62 @@ UniValue z_listoperationids(const UniValue& params, bool fHelp, const CPubKey& m
 }
 
 
+UniValue z_getoperationstats(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (!EnsureWalletIsAvailable(fHelp))
+        return NullUniValue;
+
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "z_getoperationstats\n"
+            "\nReturns execution statistics for the async operations run by the wallet, per RPC method.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"workers\": n,                (numeric) number of -rpcasyncthreads workers\n"
+            "  \"queued\": n,                 (numeric) operations waiting for a worker\n"
+            "  \"methods\": {\n"
+            "    \"method\": {\n"
+            "      \"success\": n,            (numeric) operations that succeeded\n"
+            "      \"failed\": n,             (numeric) operations that failed\n"
+            "      \"cancelled\": n,          (numeric) operations cancelled while executing\n"
+            "      \"total_secs\": x.xxx,     (numeric) time spent executing\n"
+            "      \"avg_secs\": x.xxx,       (numeric) average execution time\n"
+            "      \"max_secs\": x.xxx,       (numeric) longest execution time\n"
+            "      \"per_minute\": x.xxx      (numeric) operations finished per minute between the first start and the last finish\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("z_getoperationstats", "")
+            + HelpExampleRpc("z_getoperationstats", "")
+        );
+
+    std::shared_ptr<AsyncRPCQueue> q = getAsyncRPCQueue();
+    AsyncRPCOperationStatsMap stats = q->getOperationStats();
+
+    UniValue methods(UniValue::VOBJ);
+    for (auto & entry : stats) {
+        const AsyncRPCOperationStats &s = entry.second;
+        uint64_t n = s.nSuccess + s.nFailed + s.nCancelled;
+        std::chrono::duration<double> window = s.lastFinish - s.firstStart;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("success", s.nSuccess));
+        obj.push_back(Pair("failed", s.nFailed));
+        obj.push_back(Pair("cancelled", s.nCancelled));
+        obj.push_back(Pair("total_secs", s.totalSecs));
+        obj.push_back(Pair("avg_secs", n > 0 ? s.totalSecs / n : 0.0));
+        obj.push_back(Pair("max_secs", s.maxSecs));
+        obj.push_back(Pair("per_minute", window.count() > 0 ? n * 60.0 / window.count() : 0.0));
+        methods.push_back(Pair(entry.first, obj));
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("workers", (uint64_t)q->getNumberOfWorkers()));
+    ret.push_back(Pair("queued", (uint64_t)q->getOperationCount()));
+    ret.push_back(Pair("methods", methods));
+    return ret;
+}
+
 #include "script/sign.h"
 int32_t decode_hex(uint8_t *bytes,int32_t n,char *hex);
 extern std::string NOTARY_PUBKEY;
@@ -7780,6 +7916,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "z_getoperationstatus",     &z_getoperationstatus,     true  },
     { "wallet",             "z_getoperationresult",     &z_getoperationresult,     true  },
     { "wallet",             "z_listoperationids",       &z_listoperationids,       true  },
+    { "wallet",             "z_getoperationstats",      &z_getoperationstats,      true  },
     { "wallet",             "z_getnewaddress",          &z_getnewaddress,          true  },
     { "wallet",             "z_listaddresses",          &z_listaddresses,          true  },
     { "wallet",             "z_exportkey",              &z_exportkey,              true  },
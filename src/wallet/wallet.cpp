@@ -977,7 +977,8 @@ void CWallet::ClearNoteWitnessCache()
 }
 
 template<typename NoteDataMap>
-void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize)
+void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize,
+                           std::vector<typename NoteDataMap::mapped_type*>& vWitnessed)
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
@@ -995,6 +996,7 @@ void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nW
             // Copy the witness for the previous block if we have one
             if (nd->witnesses.size() > 0) {
                 nd->witnesses.push_front(nd->witnesses.front());
+                vWitnessed.push_back(nd);
             }
             if (nd->witnesses.size() > WITNESS_CACHE_SIZE) {
                 nd->witnesses.pop_back();
@@ -1003,22 +1005,8 @@ void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nW
     }
 }
 
-template<typename NoteDataMap>
-void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const uint256& note_commitment)
-{
-    for (auto& item : noteDataMap) {
-        auto* nd = &(item.second);
-        if (nd->witnessHeight < indexHeight && nd->witnesses.size() > 0) {
-            // Check the validity of the cache
-            // See comment in CopyPreviousWitnesses about validity.
-            assert(nWitnessCacheSize >= nd->witnesses.size());
-            nd->witnesses.front().append(note_commitment);
-        }
-    }
-}
-
 template<typename OutPoint, typename NoteData, typename Witness>
-void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
+NoteData* WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
 {
     if (noteDataMap.count(key) && noteDataMap[key].witnessHeight < indexHeight) {
         auto* nd = &(noteDataMap[key]);
@@ -1044,7 +1032,68 @@ void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeigh
         nd->witnessHeight = indexHeight - 1;
         // Check the validity of the cache
         assert(nWitnessCacheSize >= nd->witnesses.size());
+        return nd;
+    }
+    return nullptr;
+}
+
+/**
+ * A note of ours created in the block being connected, with its witness
+ * taken right after its own commitment (the nCommitments-th of the block).
+ */
+template<typename OutPoint, typename NoteData, typename Witness>
+struct BlockNoteWitness
+{
+    size_t nCommitments;
+    std::map<OutPoint, NoteData>* pNoteDataMap;
+    OutPoint key;
+    Witness witness;
+};
+
+/**
+ * Append a block's note commitments to the latest witness of every note in
+ * vWitnessed. The commitments are applied in runs between our own new notes
+ * with IncrementalWitness::append_batch, which shares the hashing between
+ * witnesses, so the cost no longer grows with notes x commitments.
+ *
+ * append_batch only shares work between witnesses of the same tree size.
+ * Here they all are: the copied witnesses are at the tree as of the previous
+ * block, and a new note's witness joins after exactly the commitments that
+ * preceded it in this block have been applied to the others. A witness that
+ * is out of step, e.g. from a damaged cache, is still appended to correctly,
+ * just without sharing.
+ */
+template<typename OutPoint, typename NoteData, typename Witness, typename Hash>
+void AppendNoteCommitments(std::vector<NoteData*>& vWitnessed, int indexHeight, int64_t nWitnessCacheSize,
+                           const std::vector<Hash>& vCommitments,
+                           const std::vector<BlockNoteWitness<OutPoint, NoteData, Witness>>& vMine)
+{
+    size_t nAppended = 0;
+    auto appendTo = [&](size_t nEnd) {
+        if (nEnd == nAppended) {
+            return;
+        }
+        std::vector<Witness*> vFront;
+        vFront.reserve(vWitnessed.size());
+        for (NoteData* nd : vWitnessed) {
+            // Check the validity of the cache
+            // See comment in CopyPreviousWitnesses about validity.
+            assert(nWitnessCacheSize >= nd->witnesses.size());
+            vFront.push_back(&nd->witnesses.front());
+        }
+        std::vector<Hash> vRun(vCommitments.begin() + nAppended, vCommitments.begin() + nEnd);
+        Witness::append_batch(vFront, vRun);
+        nAppended = nEnd;
+    };
+
+    for (const auto& mine : vMine) {
+        appendTo(mine.nCommitments);
+        NoteData* nd = ::WitnessNoteIfMine(*mine.pNoteDataMap, indexHeight, nWitnessCacheSize, mine.key, mine.witness);
+        if (nd && std::find(vWitnessed.begin(), vWitnessed.end(), nd) == vWitnessed.end()) {
+            vWitnessed.push_back(nd);
+        }
     }
+    appendTo(vCommitments.size());
 }
 
 
@@ -1068,9 +1117,11 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
                                      SaplingMerkleTree& saplingTree)
 {
     LOCK(cs_wallet);
+    std::vector<SproutNoteData*> vSproutWitnessed;
+    std::vector<SaplingNoteData*> vSaplingWitnessed;
     for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-       ::CopyPreviousWitnesses(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize);
-       ::CopyPreviousWitnesses(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize);
+       ::CopyPreviousWitnesses(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize, vSproutWitnessed);
+       ::CopyPreviousWitnesses(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, vSaplingWitnessed);
     }
 
     if (nWitnessCacheSize < WITNESS_CACHE_SIZE) {
@@ -1084,25 +1135,30 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         pblock = &block;
     }
 
+    // Advance the trees over the block first, witnessing our own new notes
+    // as their commitments go in; the cached witnesses catch up afterwards.
+    std::vector<libzcash::SHA256Compress> vSproutCommitments;
+    std::vector<libzcash::PedersenHash> vSaplingCommitments;
+    std::vector<BlockNoteWitness<JSOutPoint, SproutNoteData, SproutWitness>> vSproutMine;
+    std::vector<BlockNoteWitness<SaplingOutPoint, SaplingNoteData, SaplingWitness>> vSaplingMine;
     for (const CTransaction& tx : pblock->vtx) {
         auto hash = tx.GetHash();
-        bool txIsOurs = mapWallet.count(hash);
+        auto it = mapWallet.find(hash);
+        bool txIsOurs = it != mapWallet.end();
         // Sprout
         for (size_t i = 0; i < tx.vjoinsplit.size(); i++) {
             const JSDescription& jsdesc = tx.vjoinsplit[i];
             for (uint8_t j = 0; j < jsdesc.commitments.size(); j++) {
                 const uint256& note_commitment = jsdesc.commitments[j];
                 sproutTree.append(note_commitment);
-
-                // Increment existing witnesses
-                for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                    ::AppendNoteCommitment(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize, note_commitment);
-                }
+                vSproutCommitments.push_back(note_commitment);
 
                 // If this is our note, witness it
                 if (txIsOurs) {
                     JSOutPoint jsoutpt {hash, i, j};
-                    ::WitnessNoteIfMine(mapWallet[hash].mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize, jsoutpt, sproutTree.witness());
+                    if (it->second.mapSproutNoteData.count(jsoutpt)) {
+                        vSproutMine.push_back({vSproutCommitments.size(), &it->second.mapSproutNoteData, jsoutpt, sproutTree.witness()});
+                    }
                 }
             }
         }
@@ -1110,20 +1166,22 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         for (uint32_t i = 0; i < tx.vShieldedOutput.size(); i++) {
             const uint256& note_commitment = tx.vShieldedOutput[i].cm;
             saplingTree.append(note_commitment);
-
-            // Increment existing witnesses
-            for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                ::AppendNoteCommitment(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, note_commitment);
-            }
+            vSaplingCommitments.push_back(note_commitment);
 
             // If this is our note, witness it
             if (txIsOurs) {
                 SaplingOutPoint outPoint {hash, i};
-                ::WitnessNoteIfMine(mapWallet[hash].mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, outPoint, saplingTree.witness());
+                if (it->second.mapSaplingNoteData.count(outPoint)) {
+                    vSaplingMine.push_back({vSaplingCommitments.size(), &it->second.mapSaplingNoteData, outPoint, saplingTree.witness()});
+                }
             }
         }
     }
 
+    // Increment existing witnesses
+    ::AppendNoteCommitments(vSproutWitnessed, pindex->GetHeight(), nWitnessCacheSize, vSproutCommitments, vSproutMine);
+    ::AppendNoteCommitments(vSaplingWitnessed, pindex->GetHeight(), nWitnessCacheSize, vSaplingCommitments, vSaplingMine);
+
     // Update witness heights
     for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
         ::UpdateWitnessHeights(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize);
@@ -1459,6 +1517,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
+        // new keys or scripts can make outputs of settled transactions ours
+        fUnspentIndexDirty = true;
     }
 }
 
@@ -1595,6 +1655,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         mapWallet[hash].BindWallet(this);
         UpdateNullifierNoteMapWithTx(mapWallet[hash]);
         AddToSpends(hash);
+        setUnspentCandidates.insert(hash);
+        fNoteAddressIndexDirty = true;
     }
     else
     {
@@ -1604,6 +1666,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         CWalletTx& wtx = (*ret.first).second;
         wtx.BindWallet(this);
         UpdateNullifierNoteMapWithTx(wtx);
+        setUnspentCandidates.insert(hash);
         bool fInsertedNew = ret.second;
         if (fInsertedNew)
         {
@@ -1656,6 +1719,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            ReleaseSpentReservations(wtx);
         }
 
         bool fUpdated = false;
@@ -1682,6 +1746,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                 fUpdated = true;
             }
         }
+        AddToNoteAddressIndex(hash, wtx);
 
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
@@ -1854,7 +1919,10 @@ void CWallet::MarkAffectedTransactionsDirty(const CTransaction& tx)
     BOOST_FOREACH(const CTxIn& txin, tx.vin)
     {
         if (mapWallet.count(txin.prevout.hash))
+        {
             mapWallet[txin.prevout.hash].MarkDirty();
+            setUnspentCandidates.insert(txin.prevout.hash);
+        }
     }
     for (const JSDescription& jsdesc : tx.vjoinsplit) {
         for (const uint256& nullifier : jsdesc.nullifiers) {
@@ -2502,8 +2570,11 @@ std::pair<SproutNotePlaintext, SproutPaymentAddress> CWalletTx::DecryptSproutNot
 {
     LOCK(pwallet->cs_wallet);
 
-    auto nd = this->mapSproutNoteData.at(jsop);
+    const SproutNoteData& nd = this->mapSproutNoteData.at(jsop);
     SproutPaymentAddress pa = nd.address;
+    if (nd.plaintext) {
+        return std::make_pair(*nd.plaintext, pa);
+    }
 
     // Get cached decryptor
     ZCNoteDecryption decryptor;
@@ -2523,6 +2594,7 @@ std::pair<SproutNotePlaintext, SproutPaymentAddress> CWalletTx::DecryptSproutNot
                 hSig,
                 (unsigned char) jsop.n);
 
+        nd.plaintext = plaintext;
         return std::make_pair(plaintext, pa);
     } catch (const note_decryption_failed &err) {
         // Couldn't decrypt with this spending key
@@ -2541,13 +2613,19 @@ boost::optional<std::pair<
     SaplingNotePlaintext,
     SaplingPaymentAddress>> CWalletTx::DecryptSaplingNote(SaplingOutPoint op) const
 {
+    // The plaintext cache in the note data is written under the wallet lock
+    LOCK(pwallet->cs_wallet);
+
     // Check whether we can decrypt this SaplingOutPoint
     if (this->mapSaplingNoteData.count(op) == 0) {
         return boost::none;
     }
 
-    auto output = this->vShieldedOutput[op.n];
-    auto nd = this->mapSaplingNoteData.at(op);
+    const SaplingNoteData& nd = this->mapSaplingNoteData.at(op);
+    if (nd.plaintext && nd.address) {
+        return std::make_pair(*nd.plaintext, *nd.address);
+    }
+    const OutputDescription& output = this->vShieldedOutput[op.n];
 
     auto maybe_pt = SaplingNotePlaintext::decrypt(
         output.encCiphertext,
@@ -2561,6 +2639,8 @@ boost::optional<std::pair<
     assert(static_cast<bool>(maybe_pa));
     auto pa = maybe_pa.get();
 
+    nd.plaintext = notePt;
+    nd.address = pa;
     return std::make_pair(notePt, pa);
 }
 
@@ -3388,6 +3468,34 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
 uint64_t komodo_interestnew(int32_t txheight,uint64_t nValue,uint32_t nLockTime,uint32_t tiptime);
 uint64_t komodo_accrued_interest(int32_t *txheightp,uint32_t *locktimep,uint256 hash,int32_t n,int32_t checkheight,uint64_t checkvalue,int32_t tipheight);
 
+/**
+ * A wallet tx is settled when it and the spends of all its outputs that are
+ * ours are WALLET_UNSPENT_SETTLEDEPTH deep. Shallower spends can still be
+ * reorged out or dropped from the mempool, which makes the output unspent
+ * again without any wallet callback.
+ */
+bool CWallet::IsUnspentSettled(const uint256& wtxid, const CWalletTx& wtx) const
+{
+    if (wtx.GetDepthInMainChain() < WALLET_UNSPENT_SETTLEDEPTH)
+        return false;
+    for (int i = 0; i < wtx.vout.size(); i++)
+    {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+        bool fSettled = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(wtxid, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSettled; ++it)
+        {
+            std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            if (mit != mapWallet.end() && mit->second.GetDepthInMainChain() >= WALLET_UNSPENT_SETTLEDEPTH)
+                fSettled = true;
+        }
+        if (!fSettled)
+            return false;
+    }
+    return true;
+}
+
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, bool fIncludeCoinBase) const
 {
     uint64_t interest,*ptr;
@@ -3395,8 +3503,22 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        if (fUnspentIndexDirty)
+        {
+            setUnspentCandidates.clear();
+            for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+                setUnspentCandidates.insert(it->first);
+            fUnspentIndexDirty = false;
+        }
+        for (std::set<uint256>::const_iterator cit = setUnspentCandidates.begin(); cit != setUnspentCandidates.end(); )
         {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(*cit);
+            if (it == mapWallet.end() || IsUnspentSettled(it->first, it->second))
+            {
+                cit = setUnspentCandidates.erase(cit);
+                continue;
+            }
+            ++cit;
             const uint256& wtxid = it->first;
             const CWalletTx* pcoin = &(*it).second;
 
@@ -3420,7 +3542,7 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
             {
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    !IsLockedCoin((*it).first, i) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                    !IsLockedCoin((*it).first, i) && !IsReservedCoin(COutPoint((*it).first, i)) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
                     (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected((*it).first, i)))
                 {
                     if ( KOMODO_EXCHANGEWALLET == 0 )
@@ -4797,6 +4919,118 @@ std::vector<SaplingOutPoint> CWallet::ListLockedSaplingNotes()
     return vOutputs;
 }
 
+// Input Reservations
+
+template<typename OutPoint>
+static bool IsReservedOutPoint(const CReservedOutPoints<OutPoint>& reserved, const OutPoint& output)
+{
+    typename std::map<OutPoint, int64_t>::const_iterator it = reserved.mapExpiry.find(output);
+    return it != reserved.mapExpiry.end() && it->second > GetTime();
+}
+
+template<typename OutPoint>
+static void ReleaseOutPoint(CReservedOutPoints<OutPoint>& reserved, const OutPoint& output)
+{
+    typename std::map<OutPoint, int64_t>::iterator it = reserved.mapExpiry.find(output);
+    if (it == reserved.mapExpiry.end())
+        return;
+    reserved.setByExpiry.erase(std::make_pair(it->second, output));
+    reserved.mapExpiry.erase(it);
+}
+
+template<typename OutPoint>
+static void ReserveOutPoint(CReservedOutPoints<OutPoint>& reserved, const OutPoint& output, int64_t nExpiry)
+{
+    // Drop lapsed reservations left behind by operations that never released them
+    int64_t nNow = GetTime();
+    while (!reserved.setByExpiry.empty() && reserved.setByExpiry.begin()->first <= nNow) {
+        reserved.mapExpiry.erase(reserved.setByExpiry.begin()->second);
+        reserved.setByExpiry.erase(reserved.setByExpiry.begin());
+    }
+    ReleaseOutPoint(reserved, output);
+    reserved.mapExpiry[output] = nExpiry;
+    reserved.setByExpiry.insert(std::make_pair(nExpiry, output));
+}
+
+bool CWallet::IsReservedCoin(const COutPoint& output) const
+{
+    AssertLockHeld(cs_wallet); // mapReservedCoins
+    return IsReservedOutPoint(mapReservedCoins, output);
+}
+
+void CWallet::ReserveCoin(const COutPoint& output, int64_t nExpiry)
+{
+    AssertLockHeld(cs_wallet); // mapReservedCoins
+    ReserveOutPoint(mapReservedCoins, output, nExpiry);
+}
+
+void CWallet::ReleaseCoin(const COutPoint& output)
+{
+    AssertLockHeld(cs_wallet); // mapReservedCoins
+    ReleaseOutPoint(mapReservedCoins, output);
+}
+
+bool CWallet::IsReservedNote(const JSOutPoint& output) const
+{
+    AssertLockHeld(cs_wallet); // mapReservedSproutNotes
+    return IsReservedOutPoint(mapReservedSproutNotes, output);
+}
+
+void CWallet::ReserveNote(const JSOutPoint& output, int64_t nExpiry)
+{
+    AssertLockHeld(cs_wallet); // mapReservedSproutNotes
+    ReserveOutPoint(mapReservedSproutNotes, output, nExpiry);
+}
+
+void CWallet::ReleaseNote(const JSOutPoint& output)
+{
+    AssertLockHeld(cs_wallet); // mapReservedSproutNotes
+    ReleaseOutPoint(mapReservedSproutNotes, output);
+}
+
+bool CWallet::IsReservedNote(const SaplingOutPoint& output) const
+{
+    AssertLockHeld(cs_wallet); // mapReservedSaplingNotes
+    return IsReservedOutPoint(mapReservedSaplingNotes, output);
+}
+
+void CWallet::ReserveNote(const SaplingOutPoint& output, int64_t nExpiry)
+{
+    AssertLockHeld(cs_wallet); // mapReservedSaplingNotes
+    ReserveOutPoint(mapReservedSaplingNotes, output, nExpiry);
+}
+
+void CWallet::ReleaseNote(const SaplingOutPoint& output)
+{
+    AssertLockHeld(cs_wallet); // mapReservedSaplingNotes
+    ReleaseOutPoint(mapReservedSaplingNotes, output);
+}
+
+/**
+ * Release the reservations on the inputs a transaction entering the wallet
+ * spends. Async operations keep their inputs reserved on success, so they
+ * cannot be selected again before the spend is visible to the wallet.
+ */
+void CWallet::ReleaseSpentReservations(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    for (const CTxIn& txin : wtx.vin) {
+        ReleaseOutPoint(mapReservedCoins, txin.prevout);
+    }
+    for (const JSDescription& jsdesc : wtx.vjoinsplit) {
+        for (const uint256& nullifier : jsdesc.nullifiers) {
+            std::map<uint256, JSOutPoint>::const_iterator it = mapSproutNullifiersToNotes.find(nullifier);
+            if (it != mapSproutNullifiersToNotes.end())
+                ReleaseOutPoint(mapReservedSproutNotes, it->second);
+        }
+    }
+    for (const SpendDescription& spend : wtx.vShieldedSpend) {
+        std::map<uint256, SaplingOutPoint>::const_iterator it = mapSaplingNullifiersToNotes.find(spend.nullifier);
+        if (it != mapSaplingNullifiersToNotes.end())
+            ReleaseOutPoint(mapReservedSaplingNotes, it->second);
+    }
+}
+
 /** @} */ // end of Actions
 
 class CAffectedKeysVisitor : public boost::static_visitor<void> {
@@ -5026,6 +5260,23 @@ bool CMerkleTx::AcceptToMemoryPool(bool fLimitFree, bool fRejectAbsurdFee)
     return ::AcceptToMemoryPool(mempool, state, *this, fLimitFree, NULL, fRejectAbsurdFee);
 }
 
+void CWallet::AddToNoteAddressIndex(const uint256& wtxid, const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (fNoteAddressIndexDirty) {
+        return;
+    }
+    for (const auto & pair : wtx.mapSproutNoteData) {
+        mapNoteTxsByAddress[PaymentAddress(pair.second.address)].insert(wtxid);
+    }
+    for (const auto & pair : wtx.mapSaplingNoteData) {
+        auto decrypted = wtx.DecryptSaplingNote(pair.first);
+        if (decrypted) {
+            mapNoteTxsByAddress[PaymentAddress(decrypted->second)].insert(wtxid);
+        }
+    }
+}
+
 /**
  * Find notes in the wallet filtered by payment address, min depth and ability to spend.
  * These notes are decrypted and added to the output parameter vector, outEntries.
@@ -5064,8 +5315,39 @@ void CWallet::GetFilteredNotes(
 {
     LOCK2(cs_main, cs_wallet);
 
-    for (auto & p : mapWallet) {
-        CWalletTx wtx = p.second;
+    // With an address filter only the transactions holding notes for those
+    // addresses are visited, in the same txid order as a walk of mapWallet.
+    std::vector<CWalletTx*> vCandidates;
+    if (filterAddresses.empty()) {
+        vCandidates.reserve(mapWallet.size());
+        for (auto & p : mapWallet) {
+            vCandidates.push_back(&p.second);
+        }
+    } else {
+        if (fNoteAddressIndexDirty) {
+            mapNoteTxsByAddress.clear();
+            fNoteAddressIndexDirty = false;
+            for (auto & p : mapWallet) {
+                AddToNoteAddressIndex(p.first, p.second);
+            }
+        }
+        std::set<uint256> setTxids;
+        for (const PaymentAddress& pa : filterAddresses) {
+            auto it = mapNoteTxsByAddress.find(pa);
+            if (it != mapNoteTxsByAddress.end()) {
+                setTxids.insert(it->second.begin(), it->second.end());
+            }
+        }
+        for (const uint256& txid : setTxids) {
+            auto mi = mapWallet.find(txid);
+            if (mi != mapWallet.end()) {
+                vCandidates.push_back(&mi->second);
+            }
+        }
+    }
+
+    for (CWalletTx* pwtx : vCandidates) {
+        const CWalletTx& wtx = *pwtx;
 
         // Filter the transactions before checking for notes
         if (!CheckFinalTx(wtx) || wtx.GetBlocksToMaturity() > 0)
@@ -5087,7 +5369,7 @@ void CWallet::GetFilteredNotes(
 
         for (auto & pair : wtx.mapSproutNoteData) {
             JSOutPoint jsop = pair.first;
-            SproutNoteData nd = pair.second;
+            const SproutNoteData& nd = pair.second;
             SproutPaymentAddress pa = nd.address;
 
             // skip notes which belong to a different payment address in the wallet
@@ -5105,57 +5387,23 @@ void CWallet::GetFilteredNotes(
                 continue;
             }
 
-            // skip locked notes
-            if (ignoreLocked && IsLockedNote(jsop)) {
+            // skip locked notes and notes reserved by a running async operation
+            if (ignoreLocked && (IsLockedNote(jsop) || IsReservedNote(jsop))) {
                 continue;
             }
 
-            int i = jsop.js; // Index into CTransaction.vjoinsplit
-            int j = jsop.n; // Index into JSDescription.ciphertexts
-
-            // Get cached decryptor
-            ZCNoteDecryption decryptor;
-            if (!GetNoteDecryptor(pa, decryptor)) {
-                // Note decryptors are created when the wallet is loaded, so it should always exist
-                throw std::runtime_error(strprintf("Could not find note decryptor for payment address %s", EncodePaymentAddress(pa)));
-            }
-
-            // determine amount of funds in the note
-            auto hSig = wtx.vjoinsplit[i].h_sig(*pzcashParams, wtx.joinSplitPubKey);
-            try {
-                SproutNotePlaintext plaintext = SproutNotePlaintext::decrypt(
-                        decryptor,
-                        wtx.vjoinsplit[i].ciphertexts[j],
-                        wtx.vjoinsplit[i].ephemeralKey,
-                        hSig,
-                        (unsigned char) j);
-
-                sproutEntries.push_back(CSproutNotePlaintextEntry{jsop, pa, plaintext, wtx.GetDepthInMainChain()});
-
-            } catch (const note_decryption_failed &err) {
-                // Couldn't decrypt with this spending key
-                throw std::runtime_error(strprintf("Could not decrypt note for payment address %s", EncodePaymentAddress(pa)));
-            } catch (const std::exception &exc) {
-                // Unexpected failure
-                throw std::runtime_error(strprintf("Error while decrypting note for payment address %s: %s", EncodePaymentAddress(pa), exc.what()));
-            }
+            // determine amount of funds in the note, decrypted once and cached in the note data
+            SproutNotePlaintext plaintext = wtx.DecryptSproutNote(jsop).first;
+            sproutEntries.push_back(CSproutNotePlaintextEntry{jsop, pa, plaintext, wtx.GetDepthInMainChain()});
         }
 
         for (auto & pair : wtx.mapSaplingNoteData) {
             SaplingOutPoint op = pair.first;
-            SaplingNoteData nd = pair.second;
-
-            auto maybe_pt = SaplingNotePlaintext::decrypt(
-                wtx.vShieldedOutput[op.n].encCiphertext,
-                nd.ivk,
-                wtx.vShieldedOutput[op.n].ephemeralKey,
-                wtx.vShieldedOutput[op.n].cm);
-            assert(static_cast<bool>(maybe_pt));
-            auto notePt = maybe_pt.get();
+            const SaplingNoteData& nd = pair.second;
 
-            auto maybe_pa = nd.ivk.address(notePt.d);
-            assert(static_cast<bool>(maybe_pa));
-            auto pa = maybe_pa.get();
+            auto decrypted = wtx.DecryptSaplingNote(op).get();
+            const SaplingNotePlaintext& notePt = decrypted.first;
+            const SaplingPaymentAddress& pa = decrypted.second;
 
             // skip notes which belong to a different payment address in the wallet
             if (!(filterAddresses.empty() || filterAddresses.count(pa))) {
@@ -5177,13 +5425,13 @@ void CWallet::GetFilteredNotes(
                 }
             }
 
-            // skip locked notes
-            // TODO: Add locking for Sapling notes -> done
-             if (ignoreLocked && IsLockedNote(op)) {
+            // skip locked notes and notes reserved by a running async operation
+             if (ignoreLocked && (IsLockedNote(op) || IsReservedNote(op))) {
                  continue;
              }
 
-            auto note = notePt.note(nd.ivk).get();
+            // the address already carries pk_d, so the note needs no further key derivation
+            SaplingNote note(notePt.d, pa.pk_d, notePt.value(), notePt.rcm);
             saplingEntries.push_back(SaplingNoteEntry {
                 op, pa, note, notePt.memo(), wtx.GetDepthInMainChain() });
         }
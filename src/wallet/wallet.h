@@ -78,6 +78,10 @@ static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 //  unless there is some exceptional network disruption.
 extern unsigned int WITNESS_CACHE_SIZE;
 
+//! Depth at which a wallet tx whose outputs are all spent drops out of the AvailableCoins candidates
+static const int WALLET_UNSPENT_SETTLEDEPTH = 100;
+//! Seconds an async operation's input reservation lasts if it is never released
+static const int64_t WALLET_RESERVATION_EXPIRY = 60 * 60;
 //! Size of HD seed in bytes
 static const size_t HD_WALLET_SEED_LENGTH = 32;
 
@@ -85,6 +89,17 @@ class CBlockIndex;
 class CCoinControl;
 class COutput;
 class CReserveKey;
+
+/**
+ * Expiry times of reserved inputs, indexed both by outpoint and by expiry so
+ * lapsed reservations can be dropped from the front without a full scan.
+ */
+template<typename OutPoint>
+struct CReservedOutPoints
+{
+    std::map<OutPoint, int64_t> mapExpiry;
+    std::set<std::pair<int64_t, OutPoint> > setByExpiry;
+};
 class CScript;
 class CTxMemPool;
 class CWalletTx;
@@ -253,6 +268,13 @@ public:
      */
     int witnessHeight;
 
+    /**
+     * Decrypted note plaintext, cached in memory the first time the note is
+     * read through CWalletTx::DecryptSproutNote. It is not serialized, so the
+     * wallet file only ever holds the ciphertext of the transaction.
+     */
+    mutable boost::optional<libzcash::SproutNotePlaintext> plaintext;
+
     SproutNoteData() : address(), nullifier(), witnessHeight {-1} { }
     SproutNoteData(libzcash::SproutPaymentAddress a) :
             address {a}, nullifier(), witnessHeight {-1} { }
@@ -299,6 +321,13 @@ public:
     libzcash::SaplingIncomingViewingKey ivk;
     boost::optional<uint256> nullifier;
 
+    /**
+     * Decrypted note plaintext and its payment address, cached in memory like
+     * SproutNoteData::plaintext by CWalletTx::DecryptSaplingNote. Not serialized.
+     */
+    mutable boost::optional<libzcash::SaplingNotePlaintext> plaintext;
+    mutable boost::optional<libzcash::SaplingPaymentAddress> address;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -784,6 +813,29 @@ private:
     void AddToSaplingSpends(const uint256& nullifier, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+    /**
+     * Wallet transactions that may still have spendable transparent outputs,
+     * so AvailableCoins does not have to walk all of mapWallet. Every tx
+     * added to the wallet starts here and is dropped by AvailableCoins once
+     * it is settled (see IsUnspentSettled). A settled tx only comes back if
+     * a tx spending it changes (MarkAffectedTransactionsDirty), or if
+     * fUnspentIndexDirty is set after key imports and the set is rebuilt.
+     */
+    mutable std::set<uint256> setUnspentCandidates;
+    mutable bool fUnspentIndexDirty;
+    bool IsUnspentSettled(const uint256& wtxid, const CWalletTx& wtx) const;
+
+    /**
+     * Wallet transactions holding notes for each shielded payment address,
+     * so GetFilteredNotes with an address filter does not decrypt the notes
+     * of the whole wallet. Built on first use, since a Sapling note has to
+     * be decrypted once to learn its address, then kept up to date by
+     * AddToWallet. Transactions erased from the wallet are skipped at lookup.
+     */
+    std::map<libzcash::PaymentAddress, std::set<uint256> > mapNoteTxsByAddress;
+    bool fNoteAddressIndexDirty;
+    void AddToNoteAddressIndex(const uint256& wtxid, const CWalletTx& wtx);
+
 public:
     /*
      * Size of the incremental witness cache for the notes in our wallet.
@@ -919,6 +971,8 @@ public:
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nWitnessCacheSize = 0;
+        fUnspentIndexDirty = false;
+        fNoteAddressIndexDirty = true;
     }
 
     /**
@@ -986,6 +1040,17 @@ public:
     std::set<JSOutPoint> setLockedSproutNotes;
     std::set<SaplingOutPoint> setLockedSaplingNotes;
 
+    /**
+     * Inputs reserved by async operations between selecting them and the
+     * spending transaction entering the wallet, mapped to the time the
+     * reservation lapses. Kept apart from the lockunspent sets so releasing
+     * a reservation never unlocks a coin the user locked.
+     */
+    CReservedOutPoints<COutPoint> mapReservedCoins;
+    CReservedOutPoints<JSOutPoint> mapReservedSproutNotes;
+    CReservedOutPoints<SaplingOutPoint> mapReservedSaplingNotes;
+    void ReleaseSpentReservations(const CWalletTx& wtx);
+
     int64_t nTimeFirstKey;
 
     const CWalletTx* GetWalletTx(const uint256& hash) const;
@@ -1018,6 +1083,18 @@ public:
     void UnlockAllSaplingNotes();
     std::vector<SaplingOutPoint> ListLockedSaplingNotes();
 
+    bool IsReservedCoin(const COutPoint& output) const;
+    void ReserveCoin(const COutPoint& output, int64_t nExpiry);
+    void ReleaseCoin(const COutPoint& output);
+
+    bool IsReservedNote(const JSOutPoint& output) const;
+    void ReserveNote(const JSOutPoint& output, int64_t nExpiry);
+    void ReleaseNote(const JSOutPoint& output);
+
+    bool IsReservedNote(const SaplingOutPoint& output) const;
+    void ReserveNote(const SaplingOutPoint& output, int64_t nExpiry);
+    void ReleaseNote(const SaplingOutPoint& output);
+
     /**
      * keystore implementation
      * Generate a new key
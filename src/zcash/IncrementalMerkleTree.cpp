@@ -348,6 +348,107 @@ void IncrementalWitness<Depth, Hash>::append(Hash obj) {
     }
 }
 
+// Number of leaves appended to the tree being witnessed, including those
+// folded into filled and cursor since the witness was taken.
+template<size_t Depth, typename Hash>
+size_t IncrementalWitness<Depth, Hash>::witnessed_size() const {
+    size_t ret = tree.size();
+    for (size_t i = 0; i < filled.size(); i++) {
+        ret += ((size_t)1) << tree.next_depth(i);
+    }
+    if (cursor) {
+        ret += cursor->size();
+    }
+    return ret;
+}
+
+template<size_t Depth, typename Hash>
+void IncrementalWitness<Depth, Hash>::append_batch(const std::vector<IncrementalWitness<Depth, Hash>*>& witnesses,
+                                                   const std::vector<Hash>& objs) {
+    if (objs.empty()) {
+        return;
+    }
+
+    // A cursor always holds the most recently appended object, so two
+    // cursors of the same depth are the same aligned subtree. Keep one
+    // shared cursor per depth along with the witnesses following it.
+    std::vector<boost::optional<IncrementalMerkleTree<Depth, Hash>>> shared(Depth);
+    std::vector<std::vector<IncrementalWitness*>> followers(Depth);
+    // Witnesses without a cursor pick their next depth on the next append
+    std::vector<IncrementalWitness*> idle;
+    // Witnesses at another tree size than the first one, or that disagree
+    // with the shared cursor, are appended one by one
+    std::vector<IncrementalWitness*> independent;
+
+    size_t nSize = witnesses.empty() ? 0 : witnesses.front()->witnessed_size();
+    for (IncrementalWitness* w : witnesses) {
+        if (w->witnessed_size() != nSize) {
+            independent.push_back(w);
+        } else if (!w->cursor) {
+            idle.push_back(w);
+        } else if (!shared[w->cursor_depth]) {
+            shared[w->cursor_depth] = w->cursor;
+            followers[w->cursor_depth].push_back(w);
+        } else if (*shared[w->cursor_depth] == *w->cursor) {
+            followers[w->cursor_depth].push_back(w);
+        } else {
+            independent.push_back(w);
+        }
+    }
+
+    for (const Hash& obj : objs) {
+        std::vector<IncrementalWitness*> completed;
+        for (size_t d = 0; d < Depth; d++) {
+            if (!shared[d]) {
+                continue;
+            }
+            shared[d]->append(obj);
+            if (shared[d]->is_complete(d)) {
+                Hash root = shared[d]->root(d);
+                for (IncrementalWitness* w : followers[d]) {
+                    w->filled.push_back(root);
+                    w->cursor = boost::none;
+                }
+                completed.insert(completed.end(), followers[d].begin(), followers[d].end());
+                followers[d].clear();
+                shared[d] = boost::none;
+            }
+        }
+
+        for (IncrementalWitness* w : idle) {
+            w->cursor_depth = w->tree.next_depth(w->filled.size());
+
+            if (w->cursor_depth >= Depth) {
+                throw std::runtime_error("tree is full");
+            }
+
+            if (w->cursor_depth == 0) {
+                w->filled.push_back(obj);
+                completed.push_back(w);
+            } else {
+                // Every cursor started by this object is the same subtree
+                if (!shared[w->cursor_depth]) {
+                    shared[w->cursor_depth] = IncrementalMerkleTree<Depth, Hash>();
+                    shared[w->cursor_depth]->append(obj);
+                }
+                followers[w->cursor_depth].push_back(w);
+            }
+        }
+        idle.swap(completed);
+
+        for (IncrementalWitness* w : independent) {
+            w->append(obj);
+        }
+    }
+
+    for (size_t d = 0; d < Depth; d++) {
+        for (IncrementalWitness* w : followers[d]) {
+            w->cursor = shared[d];
+            w->cursor_depth = d;
+        }
+    }
+}
+
 template class IncrementalMerkleTree<INCREMENTAL_MERKLE_TREE_DEPTH, SHA256Compress>;
 template class IncrementalMerkleTree<INCREMENTAL_MERKLE_TREE_DEPTH_TESTING, SHA256Compress>;
 
@@ -180,6 +180,15 @@ public:
 
     void append(Hash obj);
 
+    // Append the same objects, in order, to every witness in the batch.
+    // Witnesses of one tree whose cursors have the same depth are filling
+    // the same subtree, so each distinct cursor is hashed once and shared.
+    // This only holds for witnesses that have seen the same number of
+    // leaves; any witness behind or ahead of the first one is appended to
+    // on its own, so the result is always the same as calling append().
+    static void append_batch(const std::vector<IncrementalWitness<Depth, Hash>*>& witnesses,
+                             const std::vector<Hash>& objs);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -201,6 +210,7 @@ private:
     boost::optional<IncrementalMerkleTree<Depth, Hash>> cursor;
     size_t cursor_depth = 0;
     std::deque<Hash> partial_path() const;
+    size_t witnessed_size() const;
     IncrementalWitness(IncrementalMerkleTree<Depth, Hash> tree) : tree(tree) {}
 };
 
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <cstdio>
 #include <future>
 #include <map>
@@ -6,6 +7,7 @@
 #include <boost/filesystem.hpp>
 
 #include "coins.h"
+#include "httpserver.h"
 #include "util.h"
 #include "init.h"
 #include "primitives/transaction.h"
@@ -17,12 +19,16 @@
 #include "consensus/validation.h"
 #include "main.h"
 #include "miner.h"
+#include "net.h"
+#include "netbase.h"
 #include "pow.h"
 #include "rpc/server.h"
+#include "komodo_nSPV_defs.h"
 #include "script/sign.h"
 #include "sodium.h"
 #include "streams.h"
 #include "txdb.h"
+#include "transaction_builder.h"
 #include "utiltest.h"
 #include "wallet/wallet.h"
 
@@ -354,6 +360,58 @@ double benchmark_increment_note_witnesses(size_t nTxs)
     return timer_stop(tv_start);
 }
 
+double benchmark_increment_sapling_witnesses(size_t nNotes)
+{
+    // A wallet holding nNotes witnessed Sapling notes, timed while it
+    // connects a block of 100 Sapling outputs that are not its own.
+    CWallet wallet;
+    SproutMerkleTree sproutTree;
+    SaplingMerkleTree saplingTree;
+
+    auto address = libzcash::SaplingSpendingKey::random().default_address();
+    auto saplingTx = [&address](uint32_t nLockTime) {
+        CMutableTransaction mtx;
+        mtx.fOverwintered = true;
+        mtx.nVersionGroupId = SAPLING_VERSION_GROUP_ID;
+        mtx.nVersion = SAPLING_TX_VERSION;
+        mtx.nLockTime = nLockTime;
+        OutputDescription odesc;
+        odesc.cm = SaplingNote(address, COIN).cm().get();
+        mtx.vShieldedOutput.push_back(odesc);
+        return CTransaction(mtx);
+    };
+
+    // First block
+    CBlock block1;
+    for (size_t i = 0; i < nNotes; i++) {
+        CWalletTx wtx(&wallet, saplingTx(i));
+        mapSaplingNoteData_t noteData;
+        noteData[SaplingOutPoint(wtx.GetHash(), 0)] = SaplingNoteData();
+        wtx.SetSaplingNoteData(noteData);
+        wallet.AddToWallet(wtx, true, NULL);
+        block1.vtx.push_back(wtx);
+    }
+    CBlockIndex index1(block1);
+    index1.SetHeight(1);
+
+    // Increment to get the notes witnessed
+    wallet.ChainTip(&index1, &block1, sproutTree, saplingTree, true);
+
+    // Second block
+    CBlock block2;
+    block2.hashPrevBlock = block1.GetHash();
+    for (size_t i = 0; i < 100; i++) {
+        block2.vtx.push_back(saplingTx(nNotes + i));
+    }
+    CBlockIndex index2(block2);
+    index2.SetHeight(2);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    wallet.ChainTip(&index2, &block2, sproutTree, saplingTree, true);
+    return timer_stop(tv_start);
+}
+
 // Fake the input of a given block
 class FakeCoinsViewDB : public CCoinsViewDB {
     uint256 hash;
@@ -469,10 +527,20 @@ extern UniValue listunspent(const UniValue& params, bool fHelp, const CPubKey& m
 double benchmark_listunspent()
 {
     UniValue params(UniValue::VARR);
+    // MarkDirty makes the next AvailableCoins rebuild the unspent candidates
+    // from all of mapWallet, which is what every call used to cost.
+    pwalletMain->MarkDirty();
+    struct timeval tv_full;
+    timer_start(tv_full);
+    auto unspentFull = listunspent(params, false, CPubKey());
+    double tFull = timer_stop(tv_full);
+
     struct timeval tv_start;
     timer_start(tv_start);
     auto unspent = listunspent(params, false, CPubKey());
-    return timer_stop(tv_start);
+    double t = timer_stop(tv_start);
+    LogPrint("bench", "listunspent: %u utxos of %u wallet txs, %.6fs after rebuild, %.6fs from the unspent candidates\n", unspent.size(), pwalletMain->mapWallet.size(), tFull, t);
+    return t;
 }
 
 double benchmark_create_sapling_spend()
@@ -567,6 +635,49 @@ double benchmark_create_sapling_output()
     return t;
 }
 
+double benchmark_build_sapling(size_t nSpends)
+{
+    // A transaction spending nSpends notes of one key back to itself, the
+    // shape of a z_mergetoaddress. The single change output is added by Build.
+    auto sk = libzcash::SaplingSpendingKey::random();
+    auto expsk = sk.expanded_spending_key();
+    auto address = sk.default_address();
+
+    SaplingMerkleTree tree;
+    std::vector<SaplingNote> notes;
+    std::vector<SaplingWitness> witnesses;
+    for (size_t i = 0; i < nSpends; i++) {
+        SaplingNote note(address, COIN);
+        auto cm = note.cm().get();
+        for (auto& witness : witnesses) {
+            witness.append(cm);
+        }
+        tree.append(cm);
+        witnesses.push_back(tree.witness());
+        notes.push_back(note);
+    }
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height() + 1;
+    }
+    auto builder = TransactionBuilder(Params().GetConsensus(), nHeight);
+    for (size_t i = 0; i < nSpends; i++) {
+        builder.AddSaplingSpend(expsk, notes[i], tree.root(), witnesses[i]);
+    }
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    auto maybe_tx = builder.Build();
+    double t = timer_stop(tv_start);
+    if (!maybe_tx) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "TransactionBuilder::Build() failed");
+    }
+    LogPrint("bench", "buildsapling: %u spends on %d threads in %.3fs\n", nSpends, GetSaplingBuilderThreads(), t);
+    return t;
+}
+
 // Verify Sapling spend from testnet
 // txid: abbd823cbd3d4e3b52023599d81a96b74817e95ce5bb58354f979156bd22ecc8
 // position: 0
@@ -630,3 +741,312 @@ double benchmark_verify_sapling_output()
     }
     return timer_stop(tv_start);
 }
+
+// Stream 1 MiB from each of nPeers loopback connections and time how long the
+// receiving side takes to drain them through WaitSocketEvents.
+double benchmark_socket_throughput(size_t nPeers)
+{
+    const size_t nBytesPerPeer = 1 << 20;
+    std::vector<SOCKET> vClients, vServers;
+    auto closeAll = [&]() {
+        for (SOCKET hSocket : vServers)
+            CloseSocket(hSocket);
+        for (SOCKET hSocket : vClients)
+            CloseSocket(hSocket);
+    };
+
+    SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addrlen = sizeof(addr);
+    if (hListen == INVALID_SOCKET ||
+        ::bind(hListen, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(hListen, SOMAXCONN) == SOCKET_ERROR ||
+        getsockname(hListen, (struct sockaddr*)&addr, &addrlen) == SOCKET_ERROR) {
+        CloseSocket(hListen);
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "could not open loopback listener");
+    }
+    for (size_t i = 0; i < nPeers; i++) {
+        SOCKET hClient = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (hClient == INVALID_SOCKET || connect(hClient, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            CloseSocket(hClient);
+            break;
+        }
+        vClients.push_back(hClient);
+        SOCKET hServer = accept(hListen, NULL, NULL);
+        if (hServer == INVALID_SOCKET)
+            break;
+        SetSocketNonBlocking(hServer, true);
+        vServers.push_back(hServer);
+    }
+    CloseSocket(hListen);
+    if (vServers.size() != nPeers) {
+        closeAll();
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "could not open all loopback connections, check the file descriptor limit");
+    }
+
+    std::thread writer([&vClients, nBytesPerPeer]() {
+        std::vector<char> vchBuf(0x10000, 'x');
+        for (size_t nSent = 0; nSent < nBytesPerPeer; nSent += vchBuf.size()) {
+            for (SOCKET hSocket : vClients) {
+                for (size_t nOffset = 0; nOffset < vchBuf.size(); ) {
+                    int nBytes = send(hSocket, &vchBuf[nOffset], vchBuf.size() - nOffset, MSG_NOSIGNAL);
+                    if (nBytes <= 0)
+                        return;
+                    nOffset += nBytes;
+                }
+            }
+        }
+    });
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    size_t nTotal = nPeers * nBytesPerPeer, nReceived = 0;
+    std::vector<std::pair<SOCKET, int> > vSockets;
+    char pchBuf[0x10000];
+    while (nReceived < nTotal) {
+        vSockets.clear();
+        for (SOCKET hSocket : vServers)
+            vSockets.push_back(std::make_pair(hSocket, (int)SOCKET_EVENT_RECV));
+        if (!WaitSocketEvents(vSockets, 1000))
+            break;
+        for (const auto &socketevents : vSockets) {
+            if (socketevents.second & SOCKET_EVENT_RECV) {
+                int nBytes = recv(socketevents.first, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                if (nBytes > 0)
+                    nReceived += nBytes;
+            }
+        }
+    }
+    double t = timer_stop(tv_start);
+
+    // closing the receiving ends unblocks the writer if we stopped early
+    for (SOCKET& hSocket : vServers)
+        CloseSocket(hSocket);
+    vServers.clear();
+    writer.join();
+    closeAll();
+    if (nReceived < nTotal) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "socket wait failed before all data was received");
+    }
+    return t;
+}
+
+void komodo_DEX_init();
+int32_t komodo_DEXlocalquote(char *tagA,char *tagB,uint64_t amountA,uint64_t amountB,uint8_t *data,int32_t datalen);
+UniValue komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB,char *stophashstr);
+UniValue komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB);
+
+double benchmark_dex_contention(size_t nReaders, size_t nQuotes)
+{
+    // The quotes are DEX datablobs tagged benchmark/contention, added
+    // locally without a nonce search and never relayed to DEX peers.
+    komodo_DEX_init();
+    std::atomic<size_t> nLists(0);
+    std::vector<std::thread> readers;
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nReaders; i++) {
+        readers.emplace_back([&nLists, nQuotes]() {
+            char empty[1] = "";
+            for (size_t j = 0; j < nQuotes / 10 + 1; j++) {
+                if (j & 1)
+                    komodo_DEXorderbook(0, 100, 0, (char *)"benchmark", (char *)"contention", empty, empty, empty, empty, empty);
+                else komodo_DEXlist(0, 0, (char *)"benchmark", (char *)"contention", empty, empty, empty, empty, empty, empty);
+                nLists++;
+            }
+        });
+    }
+    // A shorthash collision or a full slot fails the add, the readers must
+    // still be joined before throwing or their destructors terminate the node
+    bool fFailed = false;
+    for (size_t i = 0; i < nQuotes && !fFailed; i++) {
+        uint32_t payload[2] = { (uint32_t)i, (uint32_t)GetRand(0xffffffff) };
+        if (komodo_DEXlocalquote((char *)"benchmark", (char *)"contention", COIN, 2 * COIN, (uint8_t *)payload, sizeof(payload)) < 0)
+            fFailed = true;
+    }
+    for (auto& reader : readers)
+        reader.join();
+    if (fFailed) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "could not add DEX quote");
+    }
+    double t = timer_stop(tv_start);
+    LogPrint("bench", "dexcontention: %u quotes, %u readers, %u list/orderbook calls in %.3fs\n", nQuotes, nReaders, (size_t)nLists, t);
+    return t;
+}
+
+struct DEX_powstatus;
+int32_t komodo_DEXpowsearch(uint8_t *quote,int32_t len,int32_t priority,struct DEX_powstatus *status);
+
+double benchmark_dex_pow(int maxPriority, size_t nBytes)
+{
+    // Relay header, funcid, timestamp, payload and nonce, like the quotes of DEX_broadcast
+    std::vector<uint8_t> quote(2 + 2 * sizeof(uint32_t) + nBytes);
+    GetRandBytes(&quote[0], quote.size());
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (int priority = 0; priority <= maxPriority; priority++) {
+        struct timeval tv_priority;
+        timer_start(tv_priority);
+        size_t nQuotes = 0;
+        double t;
+        do {
+            if (komodo_DEXpowsearch(&quote[0], quote.size(), priority, NULL) < 0) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "nonce search cancelled");
+            }
+            nQuotes++;
+        } while ((t = timer_stop(tv_priority)) < 1.0);
+        LogPrint("bench", "dexpow: priority %d, %u byte quotes, %.2f quotes/sec\n", priority, nBytes, nQuotes / t);
+    }
+    return timer_stop(tv_start);
+}
+
+void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request);
+void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response);
+int32_t NSPV_txproofmsg(uint8_t *msg,int32_t vout,uint256 txid,int32_t height);
+int32_t NSPV_txproof_find(struct NSPV_txproof *dest,uint256 txid);
+void NSPV_txproof_purge(struct NSPV_txproof *ptr);
+
+static bool ReadLoopbackMessage(CNode *pfrom, SOCKET hSocket, std::vector<uint8_t> &payload)
+{
+    std::vector<char> vchMsg;
+    char pchBuf[0x10000];
+    while (true) {
+        if (vchMsg.size() >= CMessageHeader::HEADER_SIZE) {
+            uint32_t nSize = ReadLE32((const unsigned char*)&vchMsg[CMessageHeader::MESSAGE_SIZE_OFFSET]);
+            if (vchMsg.size() >= CMessageHeader::HEADER_SIZE + nSize) {
+                CDataStream ss(&vchMsg[CMessageHeader::HEADER_SIZE], &vchMsg[CMessageHeader::HEADER_SIZE] + nSize, SER_NETWORK, PROTOCOL_VERSION);
+                ss >> payload;
+                return true;
+            }
+        }
+        {
+            // responses larger than the socket buffer are only partly sent by the optimistic write
+            LOCK(pfrom->cs_vSend);
+            SocketSendData(pfrom);
+        }
+        std::vector<std::pair<SOCKET, int> > vSockets(1, std::make_pair(hSocket, (int)SOCKET_EVENT_RECV));
+        if (!WaitSocketEvents(vSockets, 1000) || !(vSockets[0].second & SOCKET_EVENT_RECV))
+            return false;
+        int nBytes = recv(hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        if (nBytes <= 0)
+            return false;
+        vchMsg.insert(vchMsg.end(), pchBuf, pchBuf + nBytes);
+    }
+}
+
+double benchmark_nspv_loopback(size_t nTxs)
+{
+    // The fullnode handler answers txproof requests for recent transactions
+    // of this node's chain (needs -txindex) over a socketpair, and the
+    // superlite handler parses the responses into its txproof cache. A
+    // second pass then serves the same txids from the cache.
+    std::vector<std::pair<uint256, int32_t> > vTxids;
+    {
+        LOCK(cs_main);
+        for (CBlockIndex *pindex = chainActive.Tip(); pindex != NULL && vTxids.size() < nTxs; pindex = pindex->pprev) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, false))
+                break;
+            for (const CTransaction &tx : block.vtx) {
+                if (vTxids.size() == nTxs)
+                    break;
+                vTxids.push_back(std::make_pair(tx.GetHash(), (int32_t)pindex->GetHeight()));
+            }
+        }
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "could not open loopback socketpair");
+    SOCKET hSuperlite = fds[1];
+    CNode *pfullnode = new CNode(fds[0], CAddress(), "", true);
+    CNode *psuperlite = new CNode(INVALID_SOCKET, CAddress(), "", true);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    size_t nProofs = 0;
+    for (const auto &item : vTxids) {
+        uint8_t msg[128];
+        std::vector<uint8_t> request, response;
+        int32_t len = NSPV_txproofmsg(msg, 0, item.first, item.second);
+        request.assign(msg, msg + len);
+        // the fullnode answers one request per type per second to each peer
+        memset(pfullnode->prevtimes, 0, sizeof(pfullnode->prevtimes));
+        komodo_nSPVreq(pfullnode, request);
+        if (!ReadLoopbackMessage(pfullnode, hSuperlite, response))
+            break;
+        komodo_nSPVresp(psuperlite, response);
+        nProofs++;
+    }
+    double tLoopback = timer_stop(tv_start);
+
+    struct timeval tv_cache;
+    timer_start(tv_cache);
+    size_t nHits = 0;
+    struct NSPV_txproof P;
+    memset(&P, 0, sizeof(P));
+    for (const auto &item : vTxids)
+        nHits += NSPV_txproof_find(&P, item.first);
+    NSPV_txproof_purge(&P);
+    double tCache = timer_stop(tv_cache);
+
+    delete psuperlite;
+    delete pfullnode;
+    CloseSocket(hSuperlite);
+    if (nProofs != vTxids.size())
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("txproof loopback failed after %u of %u txids, is -txindex enabled?", nProofs, vTxids.size()));
+    LogPrint("bench", "nspvloopback: %u txproofs in %.3fs, %u cache hits in %.6fs\n", nProofs, tLoopback, nHits, tCache);
+    return tLoopback + tCache;
+}
+
+extern bool rest_addressdeltas(HTTPRequest* req, const std::string& strURIPart);
+
+// Sink for REST replies that only counts the bytes the handler produces
+class BenchRESTRequest : public HTTPRequest
+{
+public:
+    size_t nBytes;
+    int nStatus;
+
+    BenchRESTRequest() : HTTPRequest(nullptr), nBytes(0), nStatus(0) {}
+    void WriteHeader(const std::string& hdr, const std::string& value) {}
+    void WriteReply(int nStatusIn, const std::string& strReply)
+    {
+        nStatus = nStatusIn;
+        nBytes += strReply.size();
+        replySent = true;
+    }
+    void StartReplyChunks(int nStatusIn) { nStatus = nStatusIn; }
+    bool WriteReplyChunk(const std::string& strChunk) { nBytes += strChunk.size(); return true; }
+    void EndReplyChunks() { replySent = true; }
+    void AbortReplyChunks() { replySent = true; }
+};
+
+double benchmark_address_deltas(const std::string& strAddress, const std::string& strFormat)
+{
+    // The getaddressdeltas RPC builds the whole reply as one UniValue
+    // document, the REST endpoint streams it from the index in chunks.
+    struct timeval tv_start;
+    size_t nBytes;
+    timer_start(tv_start);
+    if (strFormat == "rpc") {
+        UniValue addresses(UniValue::VARR), request(UniValue::VOBJ), params(UniValue::VARR);
+        addresses.push_back(strAddress);
+        request.push_back(Pair("addresses", addresses));
+        params.push_back(request);
+        nBytes = getaddressdeltas(params, false, CPubKey()).write().size();
+    } else {
+        BenchRESTRequest req;
+        rest_addressdeltas(&req, strAddress + "." + strFormat);
+        if (req.nStatus != HTTP_OK)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("REST request failed with status %d", req.nStatus));
+        nBytes = req.nBytes;
+    }
+    double tElapsed = timer_stop(tv_start);
+    LogPrint("bench", "addressdeltas: %u bytes of %s in %.3fs\n", nBytes, strFormat, tElapsed);
+    return tElapsed;
+}
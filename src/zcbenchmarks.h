@@ -3,6 +3,7 @@
 
 #include <sys/time.h>
 #include <stdlib.h>
+#include <string>
 
 extern double benchmark_sleep();
 extern double benchmark_parameter_loading();
@@ -15,13 +16,20 @@ extern double benchmark_verify_equihash();
 extern double benchmark_large_tx(size_t nInputs);
 extern double benchmark_try_decrypt_notes(size_t nAddrs);
 extern double benchmark_increment_note_witnesses(size_t nTxs);
+extern double benchmark_increment_sapling_witnesses(size_t nNotes);
 extern double benchmark_connectblock_slow();
 extern double benchmark_sendtoaddress(CAmount amount);
 extern double benchmark_loadwallet();
 extern double benchmark_listunspent();
 extern double benchmark_create_sapling_spend();
 extern double benchmark_create_sapling_output();
+extern double benchmark_build_sapling(size_t nSpends);
 extern double benchmark_verify_sapling_spend();
 extern double benchmark_verify_sapling_output();
+extern double benchmark_socket_throughput(size_t nPeers);
+extern double benchmark_dex_contention(size_t nReaders, size_t nQuotes);
+extern double benchmark_nspv_loopback(size_t nTxs);
+extern double benchmark_dex_pow(int maxPriority, size_t nBytes);
+extern double benchmark_address_deltas(const std::string& strAddress, const std::string& strFormat);
 
 #endif
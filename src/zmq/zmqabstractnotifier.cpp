@@ -25,3 +25,13 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifySyncTransaction(const CTransaction &transaction, const CBlock * /*pblock*/)
+{
+    return NotifyTransaction(transaction);
+}
+
+bool CZMQAbstractNotifier::NotifyChainTip(const CBlockIndex * /*pindex*/, const CBlock * /*pblock*/, bool /*added*/)
+{
+    return true;
+}
@@ -35,6 +35,10 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyBlock(const CBlock& pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    // Called for every SyncTransaction, pblock is the block containing the
+    // transaction or NULL for the mempool. Defaults to NotifyTransaction.
+    virtual bool NotifySyncTransaction(const CTransaction &transaction, const CBlock *pblock);
+    virtual bool NotifyChainTip(const CBlockIndex *pindex, const CBlock *pblock, bool added);
 
 protected:
     void *psocket;
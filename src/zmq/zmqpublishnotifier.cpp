@@ -4,6 +4,7 @@
 
 #include "zmqpublishnotifier.h"
 #include "main.h"
+#include "notarisationdb.h"
 #include "util.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
@@ -13,6 +14,12 @@ static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_CHECKEDBLOCK = "checkedblock";
+static const char *MSG_CCTX = "cctx";
+static const char *MSG_NOTARISATION = "notarisation";
+static const char *MSG_ADDRESSDELTA = "addressdelta";
+
+extern int8_t GetAddressType(const CScript &scriptPubKey, CTxDestination &vDest, txnouttype &txType, std::vector<std::vector<unsigned char>> &vSols);
+extern bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address);
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -204,3 +211,174 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+// Height of the transaction for the notifiers below, -1 for the mempool.
+// Returns false for blocks that are not (or no longer) on the active chain.
+static bool GetNotificationHeight(const CBlock *pblock, int32_t &nHeight)
+{
+    nHeight = -1;
+    if (pblock == NULL)
+        return true;
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(pblock->GetHash());
+    if (mi == mapBlockIndex.end() || mi->second == NULL || !chainActive.Contains(mi->second))
+        return false;
+    nHeight = mi->second->GetHeight();
+    return true;
+}
+
+bool CZMQPublishCCTransactionNotifier::NotifySyncTransaction(const CTransaction &transaction, const CBlock *pblock)
+{
+    bool fCC = false;
+    for (const CTxOut &txout : transaction.vout) {
+        if (txout.scriptPubKey.IsPayToCryptoCondition()) {
+            fCC = true;
+            break;
+        }
+    }
+    std::vector<unsigned char> vopret;
+    if (!fCC || transaction.vout.empty() || !GetOpReturnData(transaction.vout.back().scriptPubKey, vopret) || vopret.size() < 2)
+        return true;
+
+    int32_t nHeight;
+    if (!GetNotificationHeight(pblock, nHeight))
+        return true;
+
+    uint8_t evalcode = vopret[0], funcid = vopret[1];
+    std::string topic = strprintf("%s%02x%c", MSG_CCTX, evalcode, funcid);
+    LogPrint("zmq", "zmq: Publish %s %s\n", topic, transaction.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << evalcode << funcid << nHeight << transaction;
+    return SendMessage(topic.c_str(), &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishNotarisationNotifier::NotifyChainTip(const CBlockIndex *pindex, const CBlock *pblock, bool added)
+{
+    if (!added || pblock == NULL)
+        return true;
+
+    // ConnectBlock has already recorded the notarisations of the block
+    NotarisationsInBlock nibs;
+    if (!GetBlockNotarisations(pblock->GetHash(), nibs))
+        return true;
+
+    int32_t nHeight = pindex->GetHeight();
+    for (const Notarisation &notarisation : nibs) {
+        std::string topic = std::string(MSG_NOTARISATION) + notarisation.second.symbol;
+        LogPrint("zmq", "zmq: Publish %s %s\n", topic, notarisation.first.GetHex());
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << nHeight << notarisation.first << notarisation.second;
+        if (!SendMessage(topic.c_str(), &(*ss.begin()), ss.size()))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishAddressDeltaNotifier::Initialize(void *pcontext)
+{
+    for (const std::string &strAddress : mapMultiArgs["-zmqaddressfilter"]) {
+        uint160 hashBytes;
+        int type = 0;
+        if (!CBitcoinAddress(strAddress).GetIndexKey(hashBytes, type, false)) {
+            LogPrint("zmq", "zmq: Invalid address %s in -zmqaddressfilter\n", strAddress);
+            return false;
+        }
+        setAddressFilter.insert(hashBytes);
+    }
+    return CZMQAbstractPublishNotifier::Initialize(pcontext);
+}
+
+// Index key and value of the output spent by txin. The spent index has it
+// for mempool and block transactions alike. Without it, the output of a
+// mempool transaction is still in the mempool or the UTXO cache, where
+// AcceptToMemoryPool just found it. The output of a block transaction is
+// already spent by then, and reading it back with -txindex for every input
+// would stall block connection under cs_main, so it is skipped.
+bool CZMQPublishAddressDeltaNotifier::SpentOutput(const CTxIn &txin, bool fBlock, int &type, uint160 &hash, CAmount &nValue)
+{
+    CSpentIndexKey spentKey(txin.prevout.hash, txin.prevout.n);
+    CSpentIndexValue spentValue;
+    if (GetSpentIndex(spentKey, spentValue)) {
+        type = spentValue.addressType;
+        hash = spentValue.addressHash;
+        nValue = spentValue.satoshis;
+        return true;
+    }
+    if (fBlock)
+        return false;
+
+    CTxOut prevout;
+    CTransaction prevTx;
+    if (mempool.lookup(txin.prevout.hash, prevTx)) {
+        if (txin.prevout.n >= prevTx.vout.size())
+            return false;
+        prevout = prevTx.vout[txin.prevout.n];
+    } else {
+        LOCK(cs_main);
+        const CCoins *coins = pcoinsTip->AccessCoins(txin.prevout.hash);
+        if (coins == NULL || !coins->IsAvailable(txin.prevout.n))
+            return false;
+        prevout = coins->vout[txin.prevout.n];
+    }
+    std::vector<std::vector<unsigned char>> vSols;
+    CTxDestination vDest;
+    txnouttype txType = TX_PUBKEYHASH;
+    type = GetAddressType(prevout.scriptPubKey, vDest, txType, vSols);
+    if (type == 0 || vSols.empty())
+        return false;
+    hash = vSols[0].size() == 20 ? uint160(vSols[0]) : Hash160(vSols[0]);
+    nValue = prevout.nValue;
+    return true;
+}
+
+bool CZMQPublishAddressDeltaNotifier::SendDelta(const std::string &address, const uint256 &txid, uint32_t index, bool spending, CAmount satoshis, int32_t height)
+{
+    std::string topic = MSG_ADDRESSDELTA + address;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << txid << index << spending << satoshis << height;
+    return SendMessage(topic.c_str(), &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishAddressDeltaNotifier::NotifySyncTransaction(const CTransaction &transaction, const CBlock *pblock)
+{
+    int32_t nHeight;
+    if (!GetNotificationHeight(pblock, nHeight))
+        return true;
+
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish addressdelta %s\n", hash.GetHex());
+
+    if (!transaction.IsCoinBase() && !transaction.IsCoinImport()) {
+        for (uint32_t j = 0; j < transaction.vin.size(); j++) {
+            int type;
+            uint160 addrHash;
+            CAmount nValue;
+            std::string address;
+            if (!SpentOutput(transaction.vin[j], pblock != NULL, type, addrHash, nValue) || !Wanted(addrHash))
+                continue;
+            if (!getAddressFromIndex(type, addrHash, address))
+                continue;
+            if (!SendDelta(address, hash, j, true, -nValue, nHeight))
+                return false;
+        }
+    }
+
+    for (uint32_t k = 0; k < transaction.vout.size(); k++) {
+        const CTxOut &out = transaction.vout[k];
+        std::vector<std::vector<unsigned char>> vSols;
+        CTxDestination vDest;
+        txnouttype txType = TX_PUBKEYHASH;
+        int keyType = GetAddressType(out.scriptPubKey, vDest, txType, vSols);
+        if (keyType == 0)
+            continue;
+        for (const std::vector<unsigned char> &addr : vSols) {
+            uint160 addrHash = addr.size() == 20 ? uint160(addr) : Hash160(addr);
+            std::string address;
+            if (!Wanted(addrHash) || !getAddressFromIndex(keyType, addrHash, address))
+                continue;
+            if (!SendDelta(address, hash, k, false, out.nValue, nHeight))
+                return false;
+        }
+    }
+    return true;
+}
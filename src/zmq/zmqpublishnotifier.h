@@ -7,6 +7,8 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <set>
+
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
@@ -58,4 +60,38 @@ public:
     bool NotifyBlock(const CBlock &block);
 };
 
+/* Transactions with a CC output, the topic is cctx followed by the eval
+   code in hex and the funcid of the CC OP_RETURN, e.g. cctxf2t */
+class CZMQPublishCCTransactionNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySyncTransaction(const CTransaction &transaction, const CBlock *pblock);
+};
+
+/* Notarisations in newly connected blocks, the topic is notarisation
+   followed by the symbol of the notarised chain, e.g. notarisationKMD */
+class CZMQPublishNotarisationNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyChainTip(const CBlockIndex *pindex, const CBlock *pblock, bool added);
+};
+
+/* Address index deltas of transactions, the topic is addressdelta followed
+   by the address. -zmqaddressfilter limits them to the given addresses. */
+class CZMQPublishAddressDeltaNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    // Index hashes of the -zmqaddressfilter addresses, compared before any
+    // lookup or address encoding is done for an input or output
+    std::set<uint160> setAddressFilter;
+
+    bool Wanted(const uint160 &hash) const { return setAddressFilter.empty() || setAddressFilter.count(hash) != 0; }
+    bool SpentOutput(const CTxIn &txin, bool fBlock, int &type, uint160 &hash, CAmount &nValue);
+    bool SendDelta(const std::string &address, const uint256 &txid, uint32_t index, bool spending, CAmount satoshis, int32_t height);
+
+public:
+    bool Initialize(void *pcontext);
+    bool NotifySyncTransaction(const CTransaction &transaction, const CBlock *pblock);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H